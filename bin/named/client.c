@@ -42,6 +42,7 @@
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>
 #include <dns/view.h>
@@ -977,6 +978,110 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	return (result);
 }
 
+/*
+ * Count a response of 'respsize' octets in the traffic size histograms.
+ */
+static void
+client_sizestats(ns_client_t *client, size_t respsize) {
+	isc_stats_t *stats;
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		stats = TCP_CLIENT(client) ? ns_g_server->tcpoutstats4 :
+					     ns_g_server->udpoutstats4;
+		break;
+	case AF_INET6:
+		stats = TCP_CLIENT(client) ? ns_g_server->tcpoutstats6 :
+					     ns_g_server->udpoutstats6;
+		break;
+	default:
+		INSIST(0);
+		return;
+	}
+	isc_stats_increment(stats, ISC_MIN((int)respsize / 16, 256));
+}
+
+/*
+ * The key of the current query in the view's response cache.
+ */
+static void
+client_respcachekey(ns_client_t *client, dns_respcachekey_t *key) {
+	key->qname = client->query.origqname;
+	key->qtype = client->query.qtype;
+	key->qclass = client->message->rdclass;
+	key->flags = client->query.respcacheflags;
+	key->udpsize = TCP_CLIENT(client) ? 0 : client->udpsize;
+}
+
+isc_result_t
+ns_client_sendcached(ns_client_t *client, dns_db_t *db,
+		     dns_dbversion_t *version, unsigned char *header)
+{
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_buffer_t tcpbuffer;
+	isc_region_t r;
+	dns_respcachekey_t key;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+	unsigned int flags;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(client->view != NULL && client->view->respcache != NULL);
+
+	CTRACE("sendcached");
+
+	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0,
+				     sendbuf, &data);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+
+	client_respcachekey(client, &key);
+	result = dns_respcache_find(client->view->respcache, &key, db,
+				    version, client->message->id, &buffer);
+	if (result != ISC_R_SUCCESS) {
+		if (client->tcpbuf != NULL) {
+			isc_mem_put(client->mctx, client->tcpbuf,
+				    TCP_BUFFER_SIZE);
+			client->tcpbuf = NULL;
+		}
+		return (ISC_R_NOTFOUND);
+	}
+
+	isc_buffer_usedregion(&buffer, &r);
+	memmove(header, r.base, DNS_MESSAGE_HEADERLEN);
+	flags = (r.base[2] << 8) | r.base[3];
+
+	if (TCP_CLIENT(client)) {
+		isc_buffer_putuint16(&tcpbuffer, (isc_uint16_t) r.length);
+		isc_buffer_add(&tcpbuffer, r.length);
+		result = client_sendpkg(client, &tcpbuffer);
+	} else
+		result = client_sendpkg(client, &buffer);
+	client_sizestats(client, r.length);
+
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_response);
+	dns_rcodestats_increment(ns_g_server->rcodestats,
+				 (dns_rcode_t)(flags & 0x000f));
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0out);
+	}
+	if ((flags & DNS_MESSAGEFLAG_TC) != 0)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_truncatedresp);
+
+	if (result != ISC_R_SUCCESS) {
+		if (client->tcpbuf != NULL) {
+			isc_mem_put(client->mctx, client->tcpbuf,
+				    TCP_BUFFER_SIZE);
+			client->tcpbuf = NULL;
+		}
+		ns_client_next(client, result);
+	}
+	return (ISC_R_SUCCESS);
+}
+
 void
 ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_result_t result;
@@ -1186,6 +1291,19 @@ client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
+	if ((client->query.attributes & NS_QUERYATTR_RESPCACHE) != 0) {
+		dns_respcachekey_t key;
+
+		/*
+		 * Failing to cache the response is not an error.
+		 */
+		client_respcachekey(client, &key);
+		isc_buffer_usedregion(&buffer, &r);
+		(void)dns_respcache_add(client->view->respcache, &key,
+					client->query.authdb,
+					client->query.respcacheversion, &r);
+	}
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -1229,20 +1347,7 @@ client_send(ns_client_t *client) {
 		/* don't count the 2-octet length header */
 		respsize = isc_buffer_usedlength(&tcpbuffer) - 2;
 		result = client_sendpkg(client, &tcpbuffer);
-
-		switch (isc_sockaddr_pf(&client->peeraddr)) {
-		case AF_INET:
-			isc_stats_increment(ns_g_server->tcpoutstats4,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		case AF_INET6:
-			isc_stats_increment(ns_g_server->tcpoutstats6,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		default:
-			INSIST(0);
-			break;
-		}
+		client_sizestats(client, respsize);
 	} else {
 		respsize = isc_buffer_usedlength(&buffer);
 		result = client_sendpkg(client, &buffer);
@@ -1255,20 +1360,7 @@ client_send(ns_client_t *client) {
 				    &client->requesttime, NULL, &buffer);
 		}
 #endif /* HAVE_DNSTAP */
-
-		switch (isc_sockaddr_pf(&client->peeraddr)) {
-		case AF_INET:
-			isc_stats_increment(ns_g_server->udpoutstats4,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		case AF_INET6:
-			isc_stats_increment(ns_g_server->udpoutstats6,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		default:
-			INSIST(0);
-			break;
-		}
+		client_sizestats(client, respsize);
 	}
 
 	/* update statistics (XXXJT: is it okay to access message->xxxkey?) */
@@ -2927,11 +3019,13 @@ client_timeout(isc_task_t *task, isc_event_t *event) {
 }
 
 static isc_result_t
-get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
+get_clientmctx(ns_clientmgr_t *manager, unsigned int threadid,
+	       isc_mem_t **mctxp)
+{
 	isc_mem_t *clientmctx;
 	isc_result_t result;
 #if NMCTXS > 0
-	unsigned int nextmctx;
+	unsigned int nextmctx, nbands, perband;
 #endif
 
 	MTRACE("clientmctx");
@@ -2946,9 +3040,17 @@ get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
 		return (result);
 	}
 #if NMCTXS > 0
-	nextmctx = manager->nextmctx++;
-	if (manager->nextmctx == NMCTXS)
-		manager->nextmctx = 0;
+	/*
+	 * The pool is divided into one band per worker thread, and a
+	 * client takes its context from the band of the worker its task
+	 * runs on.  Memory is then mostly allocated and first touched by
+	 * that worker, which keeps it local to the worker's NUMA node
+	 * when "task-cpus" binds the workers to CPUs.
+	 */
+	nbands = ISC_MAX(1, ISC_MIN(ns_g_cpus, NMCTXS));
+	perband = NMCTXS / nbands;
+	nextmctx = (threadid % nbands) * perband +
+		   manager->nextmctx++ % perband;
 
 	INSIST(nextmctx < NMCTXS);
 
@@ -2962,6 +3064,7 @@ get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
 		manager->mctxpool[nextmctx] = clientmctx;
 	}
 #else
+	UNUSED(threadid);
 	clientmctx = manager->mctx;
 #endif
 
@@ -2975,6 +3078,7 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 	ns_client_t *client;
 	isc_result_t result;
 	isc_mem_t *mctx = NULL;
+	isc_task_t *task = NULL;
 
 	/*
 	 * Caller must be holding the manager lock.
@@ -2986,21 +3090,25 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 
 	REQUIRE(clientp != NULL && *clientp == NULL);
 
-	result = get_clientmctx(manager, &mctx);
+	result = isc_task_create(manager->taskmgr, 0, &task);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
+	result = get_clientmctx(manager, isc_task_getthreadid(task), &mctx);
+	if (result != ISC_R_SUCCESS) {
+		isc_task_detach(&task);
+		return (result);
+	}
+
 	client = isc_mem_get(mctx, sizeof(*client));
 	if (client == NULL) {
 		isc_mem_detach(&mctx);
+		isc_task_detach(&task);
 		return (ISC_R_NOMEMORY);
 	}
 	client->mctx = mctx;
 
-	client->task = NULL;
-	result = isc_task_create(manager->taskmgr, 0, &client->task);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup_client;
+	client->task = task;
 	isc_task_setname(client->task, "client", client);
 
 	client->timer = NULL;
@@ -3140,7 +3248,6 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
  cleanup_task:
 	isc_task_detach(&client->task);
 
- cleanup_client:
 	isc_mem_putanddetach(&client->mctx, client, sizeof(*client));
 
 	return (result);
@@ -123,6 +123,7 @@ options {\n\
 	send-cookie true;\n\
 	request-nsid false;\n\
 	reserved-sockets 512;\n\
+	reuseport false;\n\
 \n\
 	/* DLV */\n\
 	dnssec-lookaside . trust-anchor dlv.isc.org;\n\
@@ -159,6 +160,7 @@ options {\n\
 	max-cache-ttl 604800; /* 1 week */\n\
 	transfer-format many-answers;\n\
 	max-cache-size 90%;\n\
+	cache-shards 1;\n\
 	check-names master fail;\n\
 	check-names slave warn;\n\
 	check-names response ignore;\n\
@@ -169,6 +171,7 @@ options {\n\
 	dnssec-validation yes; \n\
 	dnssec-accept-expired no;\n\
 	fetches-per-zone 0;\n\
+	fetch-quota-adaptive no;\n\
 	fetch-quota-params 100 0.1 0.3 0.7;\n\
 	clients-per-query 10;\n\
 	max-clients-per-query 100;\n\
@@ -188,6 +191,7 @@ options {\n\
 	require-server-cookie no;\n\
 	v6-bias 50;\n\
 	message-compression yes;\n\
+	response-cache-size 0;\n\
 "
 #ifdef HAVE_DNSTAP
 "\
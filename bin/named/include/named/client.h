@@ -37,6 +37,7 @@
  * \code
  *   ns_client_send()	(sending a non-error response)
  *   ns_client_sendraw() (sending a raw response)
+ *   ns_client_sendcached() (sending a cached response)
  *   ns_client_error()	(sending an error response)
  *   ns_client_next()	(sending no response)
  *\endcode
@@ -227,6 +228,20 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, dns_db_t *db,
+		     dns_dbversion_t *version, unsigned char *header);
+/*%
+ * If the view's response cache holds the response to the current query
+ * built from version 'version' of 'db', finish processing the current
+ * client request and send that response, copying its header to 'header'
+ * (DNS_MESSAGE_HEADERLEN octets) for the caller's statistics.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		the request has been finished
+ *\li	#ISC_R_NOTFOUND		nothing was sent
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%
@@ -28,6 +28,7 @@
 #define NS_EVENT_RELOAD		(NS_EVENTCLASS + 0)
 #define NS_EVENT_CLIENTCONTROL	(NS_EVENTCLASS + 1)
 #define NS_EVENT_DELZONE	(NS_EVENTCLASS + 2)
+#define NS_EVENT_CATZCHANGES	(NS_EVENTCLASS + 3)
 
 /*%
  * Name server state.  Better here than in lots of separate global variables.
@@ -84,6 +85,8 @@ struct ns_server {
 	isc_mutex_t		reload_event_lock;
 	isc_event_t *		reload_event;
 
+	isc_mutex_t		newzone_lock;	/*%< Runtime zone changes */
+
 	isc_boolean_t		flushonshutdown;
 	isc_boolean_t		log_queries;	/*%< For BIND 8 compatibility */
 
@@ -205,7 +208,10 @@ enum {
 	dns_nsstatscounter_cookienew = 56,
 	dns_nsstatscounter_badcookie = 57,
 
-	dns_nsstatscounter_max = 58
+	dns_nsstatscounter_respcachehit = 58,
+	dns_nsstatscounter_respcachemiss = 59,
+
+	dns_nsstatscounter_max = 60
 };
 
 /*%
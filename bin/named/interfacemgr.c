@@ -429,8 +429,21 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
-	ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
+	/*
+	 * With "reuseport", each worker thread gets a listener with a
+	 * socket of its own, and the kernel balances the queries among
+	 * them.  Otherwise the listeners share duplicates of one socket.
+	 */
+	if (ns_g_reuseport) {
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+		ifp->nudpdispatch = ISC_MIN(ns_g_cpus, MAX_UDP_DISPATCH);
+	} else
+		ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
+		isc_boolean_t share;
+
+		share = ISC_TF(disp != 0 &&
+			       (attrs & DNS_DISPATCHATTR_REUSEPORT) == 0);
 		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
 						 ns_g_socketmgr,
 						 ns_g_taskmgr, &ifp->addr,
@@ -438,9 +451,27 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 						 32768, 8219, 8237,
 						 attrs, attrmask,
 						 &ifp->udpdispatch[disp],
-						 disp == 0
-						    ? NULL
-						    : ifp->udpdispatch[0]);
+						 share
+						    ? ifp->udpdispatch[0]
+						    : NULL);
+		if (result == ISC_R_NOTIMPLEMENTED &&
+		    (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+		{
+			/*
+			 * SO_REUSEPORT isn't available; this can only
+			 * happen on the first listener.  Start over with
+			 * shared sockets.
+			 */
+			INSIST(disp == 0);
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "SO_REUSEPORT is not supported, "
+				      "sharing one UDP socket per interface");
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp,
+						    MAX_UDP_DISPATCH);
+			disp = -1;
+			continue;
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
@@ -809,15 +809,21 @@ create_managers(void) {
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_timermgr_create(ns_g_mctx, &ns_g_timermgr);
+	result = isc_timermgr_create2(ns_g_mctx, &ns_g_timermgr,
+				      ns_g_udpdisp);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_timermgr_create() failed: %s",
+				 "isc_timermgr_create2() failed: %s",
 				 isc_result_totext(result));
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks);
+	/*
+	 * Run one socket watcher per UDP listener so that the duplicated
+	 * listener sockets are spread over separate event loops.
+	 */
+	result = isc_socketmgr_create3(ns_g_mctx, &ns_g_socketmgr, maxsocks,
+				       ns_g_udpdisp);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
@@ -534,6 +534,11 @@ static void
 query_error(ns_client_t *client, isc_result_t result, int line) {
 	int loglevel = ISC_LOG_DEBUG(3);
 
+	/*
+	 * Never cache an error response.
+	 */
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	switch (result) {
 	case DNS_R_SERVFAIL:
 		loglevel = ISC_LOG_DEBUG(1);
@@ -1159,6 +1164,17 @@ query_validatezonedb(ns_client_t *client, const dns_name_t *name,
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * A cached response is only valid for the zone database and version
+ * it is stored under, so a response that uses any other database is
+ * not stored.
+ */
+static inline void
+query_respcachedb(ns_client_t *client, dns_db_t *db) {
+	if (db != client->query.authdb)
+		client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+}
+
 static inline isc_result_t
 query_getzonedb(ns_client_t *client, const dns_name_t *name,
 		dns_rdatatype_t qtype, unsigned int options,
@@ -1196,6 +1212,8 @@ query_getzonedb(ns_client_t *client, const dns_name_t *name,
 	if (result != ISC_R_SUCCESS)
 		goto fail;
 
+	query_respcachedb(client, db);
+
 	/* Transfer ownership. */
 	*zonep = zone;
 	*dbp = db;
@@ -1539,6 +1557,7 @@ query_getdb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 
 	/* If successful, Transfer ownership of zone. */
 	if (result == ISC_R_SUCCESS) {
+		query_respcachedb(client, *dbp);
 		*zonep = zone;
 		/*
 		 * If neither attempt above succeeded, return the cache instead
@@ -1786,6 +1805,7 @@ query_addadditional(void *arg, const dns_name_t *name, dns_rdatatype_t qtype) {
 	if (dbversion == NULL)
 		goto cleanup;
 
+	query_respcachedb(client, client->query.gluedb);
 	dns_db_attach(client->query.gluedb, &db);
 	version = dbversion->version;
 	additionaltype = dns_rdatasetadditional_fromglue;
@@ -4757,6 +4777,138 @@ query_setup(ns_client_t *client, dns_rdatatype_t qtype) {
 	return (query_start(&qctx));
 }
 
+/*%
+ * Can the response to the current query be taken from, or stored in,
+ * the view's response cache?  Only queries answered from a single zone
+ * database qualify, and nothing in the response may depend on the
+ * client's address, on EDNS options other than DO, on a transaction
+ * signature, or on data outside that database.
+ */
+static isc_boolean_t
+query_respcacheok(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_view_t *view = client->view;
+
+	if (view->respcache == NULL || !qctx->is_zone || qctx->zone == NULL) {
+		return (ISC_FALSE);
+	}
+	if (dns_zone_gettype(qctx->zone) != dns_zone_master &&
+	    dns_zone_gettype(qctx->zone) != dns_zone_slave)
+	{
+		return (ISC_FALSE);
+	}
+	if (RECURSIONOK(client) || USECACHE(client)) {
+		return (ISC_FALSE);
+	}
+	if ((client->attributes & (NS_CLIENTATTR_WANTNSID |
+				   NS_CLIENTATTR_WANTCOOKIE |
+				   NS_CLIENTATTR_HAVECOOKIE |
+				   NS_CLIENTATTR_WANTEXPIRE |
+				   NS_CLIENTATTR_HAVEECS |
+				   NS_CLIENTATTR_WANTPAD |
+				   NS_CLIENTATTR_USEKEEPALIVE)) != 0)
+	{
+		return (ISC_FALSE);
+	}
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL || client->signer != NULL)
+	{
+		return (ISC_FALSE);
+	}
+	if (view->rrl != NULL || view->sortlist != NULL ||
+	    view->nocasecompress != NULL || view->dtenv != NULL ||
+	    view->redirect != NULL || view->redirectzone != NULL ||
+	    !ISC_LIST_EMPTY(view->dns64) ||
+	    (view->rpzs != NULL && view->rpzs->p.num_zones != 0))
+	{
+		return (ISC_FALSE);
+	}
+#ifdef ALLOW_FILTER_AAAA
+	if (view->v4_aaaa != dns_aaaa_ok || view->v6_aaaa != dns_aaaa_ok) {
+		return (ISC_FALSE);
+	}
+#endif
+
+	return (ISC_TRUE);
+}
+
+/*%
+ * Send the response to the current query from the view's response cache
+ * if it holds it.  Otherwise arrange for the response to be stored there
+ * once it is rendered, and return ISC_FALSE.
+ */
+static isc_boolean_t
+query_respcache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	unsigned char header[DNS_MESSAGE_HEADERLEN];
+	unsigned int flags;
+	isc_result_t result;
+
+	if (!query_respcacheok(qctx)) {
+		return (ISC_FALSE);
+	}
+
+	/*
+	 * Everything about the query, other than its question, that the
+	 * response depends on.
+	 */
+	flags = (client->message->flags &
+		 (DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_CD)) << 16;
+	flags |= client->attributes & (NS_CLIENTATTR_TCP |
+				       NS_CLIENTATTR_RA |
+				       NS_CLIENTATTR_WANTDNSSEC |
+				       NS_CLIENTATTR_WANTAD |
+				       NS_CLIENTATTR_WANTOPT);
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		flags |= 0x80000000U;
+	}
+	client->query.respcacheflags = flags;
+
+	result = ns_client_sendcached(client, qctx->db, qctx->version,
+				      header);
+	if (result != ISC_R_SUCCESS) {
+		inc_stats(client, dns_nsstatscounter_respcachemiss);
+		client->query.respcacheversion = qctx->version;
+		client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+		return (ISC_FALSE);
+	}
+
+	/*
+	 * Count the response as query_send() would have.  A cached
+	 * response comes from a zone, so an empty NOERROR answer is a
+	 * referral unless it is authoritative.
+	 */
+	flags = (header[2] << 8) | header[3];
+	inc_stats(client, dns_nsstatscounter_respcachehit);
+	if ((flags & DNS_MESSAGEFLAG_AA) == 0) {
+		inc_stats(client, dns_nsstatscounter_nonauthans);
+	} else {
+		inc_stats(client, dns_nsstatscounter_authans);
+	}
+	switch (flags & 0x000f) {
+	case dns_rcode_noerror:
+		if (header[6] != 0 || header[7] != 0) {
+			inc_stats(client, dns_nsstatscounter_success);
+		} else if ((flags & DNS_MESSAGEFLAG_AA) == 0) {
+			inc_stats(client, dns_nsstatscounter_referral);
+		} else {
+			inc_stats(client, dns_nsstatscounter_nxrrset);
+		}
+		break;
+	case dns_rcode_nxdomain:
+		inc_stats(client, dns_nsstatscounter_nxdomain);
+		break;
+	default:
+		inc_stats(client, dns_nsstatscounter_failure);
+		break;
+	}
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+	ns_client_detach(&qctx->client);
+	return (ISC_TRUE);
+}
+
 /*%
  * Starting point for a client query or a chaining query.
  *
@@ -4903,6 +5055,10 @@ query_start(query_ctx_t *qctx) {
 		} else {
 			inc_stats(qctx->client, dns_nsstatscounter_udp);
 		}
+
+		if (query_respcache(qctx)) {
+			return (ISC_R_SUCCESS);
+		}
 	}
 
 	return (query_lookup(qctx));
@@ -9202,6 +9358,11 @@ query_done(query_ctx_t *qctx) {
 	 * Do we need to restart the query (e.g. for CNAME chaining)?
 	 */
 	if (qctx->want_restart && qctx->client->query.restarts < MAX_RESTARTS) {
+		/*
+		 * The rest of a CNAME or DNAME chain may come from other
+		 * zones; don't store the response.
+		 */
+		qctx->client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
 		qctx->client->query.restarts++;
 		return (query_start(qctx));
 	}
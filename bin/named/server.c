@@ -36,6 +36,7 @@
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/resource.h>
+#include <isc/sha1.h>
 #include <isc/sha2.h>
 #include <isc/socket.h>
 #include <isc/stat.h>
@@ -284,18 +285,28 @@ typedef struct {
 		isc_refcount_t refs;
 } ns_zoneload_t;
 
+typedef ISC_LIST(struct catz_chgzone) catz_changelist_t;
+
+/*%
+ * Changes to the member zones of catalog zones are queued here and
+ * carried out in batches by catz_changes_taskaction().
+ */
 typedef struct {
 	ns_server_t *server;
+	isc_mutex_t lock;
+	catz_changelist_t changes;
+	isc_boolean_t posted;	/*%< catz_changes_taskaction() is pending */
 } catz_cb_data_t;
 
-typedef struct catz_chgzone_event {
-	ISC_EVENT_COMMON(struct catz_chgzone_event);
+typedef struct catz_chgzone {
+	isc_eventtype_t type;	/*%< DNS_EVENT_CATZ{ADD,MOD,DEL}ZONE */
 	dns_catz_entry_t *entry;
 	dns_catz_zone_t *origin;
 	dns_view_t *view;
 	catz_cb_data_t *cbd;
 	isc_boolean_t mod;
-} catz_chgzone_event_t;
+	ISC_LINK(struct catz_chgzone) link;
+} catz_chgzone_t;
 
 /*
  * These zones should not leak onto the Internet.
@@ -444,11 +455,12 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	       const cfg_obj_t *vconfig, isc_mem_t *mctx, dns_view_t *view,
 	       dns_viewlist_t *viewlist, cfg_aclconfctx_t *aclconf,
 	       isc_boolean_t added, isc_boolean_t old_rpz_ok,
-	       isc_boolean_t modify);
+	       isc_boolean_t modify, const unsigned char *viewhash);
 
 static isc_result_t
 configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
-		   isc_mem_t *mctx, cfg_aclconfctx_t *actx);
+		   isc_mem_t *mctx, cfg_aclconfctx_t *actx,
+		   const unsigned char *viewhash);
 
 static isc_result_t
 add_keydata_zone(dns_view_t *view, const char *directory, isc_mem_t *mctx);
@@ -497,7 +509,8 @@ static isc_result_t
 nzd_count(dns_view_t *view, int *countp);
 #else
 static isc_result_t
-nzf_append(dns_view_t *view, const cfg_obj_t *zconfig);
+nzf_append(dns_view_t *view, const cfg_obj_t **zconfigs,
+	   unsigned int count);
 #endif
 
 /*%
@@ -1717,7 +1730,7 @@ cachelist_find(ns_cachelist_t *cachelist, const char *cachename,
 
 static isc_boolean_t
 cache_reusable(dns_view_t *originview, dns_view_t *view,
-	       isc_boolean_t new_zero_no_soattl)
+	       isc_boolean_t new_zero_no_soattl, unsigned int new_cache_shards)
 {
 	if (originview->rdclass != view->rdclass ||
 	    originview->checknames != view->checknames ||
@@ -1726,7 +1739,8 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 	    originview->acceptexpired != view->acceptexpired ||
 	    originview->enablevalidation != view->enablevalidation ||
 	    originview->maxcachettl != view->maxcachettl ||
-	    originview->maxncachettl != view->maxncachettl) {
+	    originview->maxncachettl != view->maxncachettl ||
+	    dns_cache_getshards(originview->cache) != new_cache_shards) {
 		return (ISC_FALSE);
 	}
 
@@ -1736,6 +1750,7 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 static isc_boolean_t
 cache_sharable(dns_view_t *originview, dns_view_t *view,
 	       isc_boolean_t new_zero_no_soattl,
+	       unsigned int new_cache_shards,
 	       unsigned int new_cleaning_interval,
 	       isc_uint64_t new_max_cache_size)
 {
@@ -1743,7 +1758,8 @@ cache_sharable(dns_view_t *originview, dns_view_t *view,
 	 * If the cache cannot even reused for the same view, it cannot be
 	 * shared with other views.
 	 */
-	if (!cache_reusable(originview, view, new_zero_no_soattl))
+	if (!cache_reusable(originview, view, new_zero_no_soattl,
+			    new_cache_shards))
 		return (ISC_FALSE);
 
 	/*
@@ -2152,9 +2168,82 @@ configure_rpz(dns_view_t *view, const cfg_obj_t *rpz_obj,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Zones are added at runtime while the server keeps answering queries,
+ * as the zone table of a view does its own locking.  Zones that also
+ * change other state of their view, which queries read without
+ * locking, are configured in exclusive mode with the view thawed:
+ * hint, redirect and delegation-only zones, zones with "in-view" or
+ * "delegation-only", and response policy and catalog zones.
+ */
+static isc_boolean_t
+newzone_needexclusive(dns_view_t *view, const dns_name_t *name,
+		      const cfg_obj_t *zoneobj)
+{
+	const cfg_obj_t *zoptions;
+	const cfg_obj_t *obj = NULL;
+	const char *ztypestr;
+	dns_rpz_num_t rpz_num;
+
+	zoptions = cfg_tuple_get(zoneobj, "options");
+	if (cfg_map_get(zoptions, "in-view", &obj) == ISC_R_SUCCESS)
+		return (ISC_TRUE);
+
+	obj = NULL;
+	if (cfg_map_get(zoptions, "delegation-only", &obj) == ISC_R_SUCCESS &&
+	    cfg_obj_asboolean(obj))
+		return (ISC_TRUE);
+
+	obj = NULL;
+	if (cfg_map_get(zoptions, "type", &obj) == ISC_R_SUCCESS) {
+		ztypestr = cfg_obj_asstring(obj);
+		if (strcasecmp(ztypestr, "hint") == 0 ||
+		    strcasecmp(ztypestr, "redirect") == 0 ||
+		    strcasecmp(ztypestr, "delegation-only") == 0)
+			return (ISC_TRUE);
+	}
+
+	if (view->rpzs != NULL) {
+		for (rpz_num = 0; rpz_num < view->rpzs->p.num_zones; ++rpz_num)
+		{
+			if (dns_name_equal(&view->rpzs->zones[rpz_num]->origin,
+					   name))
+				return (ISC_TRUE);
+		}
+	}
+
+	if (view->catzs != NULL && dns_catz_get_zone(view->catzs, name) != NULL)
+		return (ISC_TRUE);
+
+	return (ISC_FALSE);
+}
+
+/*
+ * Enter exclusive mode while holding server->newzone_lock.  The lock
+ * is dropped while waiting, as a task blocked on it would otherwise
+ * keep exclusive mode from being granted; exclusive mode is always
+ * entered before the lock is taken.
+ */
+static void
+newzone_beginexclusive(ns_server_t *server, isc_task_t *task) {
+	isc_result_t result;
+
+	UNLOCK(&server->newzone_lock);
+	result = isc_task_beginexclusive(task);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	LOCK(&server->newzone_lock);
+}
+
+/*
+ * Add or modify a member zone of a catalog zone, with the new zone
+ * lock held.  A modified zone is reconfigured in place, which is done
+ * in exclusive mode; '*exclusivep' is set when it has been entered,
+ * and the caller leaves it when the whole batch is done.
+ */
 static void
-catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
-	catz_chgzone_event_t *ev = (catz_chgzone_event_t *) event0;
+catz_addmodzone(isc_task_t *task, catz_chgzone_t *chg,
+		isc_boolean_t *exclusivep)
+{
 	isc_result_t result;
 	isc_buffer_t namebuf;
 	isc_buffer_t *confbuf;
@@ -2164,8 +2253,10 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 	cfg_obj_t *zoneobj = NULL;
 	ns_cfgctx_t *cfg;
 	dns_zone_t *zone = NULL;
+	dns_name_t *name = dns_catz_entry_getname(chg->entry);
+	isc_boolean_t thaw;
 
-	cfg = (ns_cfgctx_t *) ev->view->new_zone_config;
+	cfg = (ns_cfgctx_t *) chg->view->new_zone_config;
 	if (cfg == NULL) {
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -2175,14 +2266,42 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 	}
 
 	isc_buffer_init(&namebuf, nameb, DNS_NAME_FORMATSIZE);
-	dns_name_totext(dns_catz_entry_getname(ev->entry), ISC_TRUE, &namebuf);
+	dns_name_totext(name, ISC_TRUE, &namebuf);
 	isc_buffer_putuint8(&namebuf, 0);
 
+	/* Create a config for new zone */
+	confbuf = NULL;
+	dns_catz_generate_zonecfg(chg->origin, chg->entry, &confbuf);
+	cfg_parser_reset(cfg->add_parser);
+	result = cfg_parse_buffer3(cfg->add_parser, confbuf, "catz", 0,
+				   &cfg_type_addzoneconf, &zoneconf);
+	isc_buffer_free(&confbuf);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "catz: error \"%s\" while trying to generate "
+			      "config for zone \"%s\"",
+			      isc_result_totext(result), nameb);
+		goto cleanup;
+	}
+	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+	if (!cfg_obj_islist(zlist))
+		CHECK(ISC_R_FAILURE);
+
+	/* For now we only support adding one zone at a time */
+	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
+
+	thaw = ISC_TF(chg->mod ||
+		      newzone_needexclusive(chg->view, name, zoneobj));
+	if (thaw && !*exclusivep) {
+		newzone_beginexclusive(chg->cbd->server, task);
+		*exclusivep = ISC_TRUE;
+	}
+
 	/* Zone shouldn't already exist */
-	result = dns_zt_find(ev->view->zonetable,
-			     dns_catz_entry_getname(ev->entry), 0, NULL, &zone);
+	result = dns_zt_find(chg->view->zonetable, name, 0, NULL, &zone);
 
-	if (ev->mod == ISC_TRUE) {
+	if (chg->mod == ISC_TRUE) {
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 				      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
@@ -2196,16 +2315,16 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 				isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 					      NS_LOGMODULE_SERVER,
 					      ISC_LOG_WARNING,
-					      "catz: catz_addmodzone_taskaction: "
+					      "catz: catz_addmodzone: "
 					      "zone '%s' is not a dynamically "
 					      "added zone",
 					      nameb);
 				goto cleanup;
 			}
-			if (dns_zone_get_parentcatz(zone) != ev->origin) {
+			if (dns_zone_get_parentcatz(zone) != chg->origin) {
 				isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 					      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
-					      "catz: catz_delzone_taskaction: "
+					      "catz: catz_addmodzone: "
 					      "zone '%s' exists in multiple "
 					      "catalog zones",
 					      nameb);
@@ -2229,39 +2348,15 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 		}
 	}
 	RUNTIME_CHECK(zone == NULL);
-	/* Create a config for new zone */
-	confbuf = NULL;
-	dns_catz_generate_zonecfg(ev->origin, ev->entry, &confbuf);
-	cfg_parser_reset(cfg->add_parser);
-	result = cfg_parse_buffer3(cfg->add_parser, confbuf, "catz", 0,
-				   &cfg_type_addzoneconf, &zoneconf);
-	isc_buffer_free(&confbuf);
-	if (result != ISC_R_SUCCESS) {
-		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
-			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
-			      "catz: error \"%s\" while trying to generate "
-			      "config for zone \"%s\"",
-			      isc_result_totext(result), nameb);
-		goto cleanup;
-	}
-	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
-	if (!cfg_obj_islist(zlist))
-		CHECK(ISC_R_FAILURE);
 
-	/* For now we only support adding one zone at a time */
-	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
-
-	/* Mark view unfrozen so that zone can be added */
-
-	result = isc_task_beginexclusive(task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-	dns_view_thaw(ev->view);
+	if (thaw)
+		dns_view_thaw(chg->view);
 	result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
-				ev->cbd->server->mctx, ev->view,
-				&ev->cbd->server->viewlist, cfg->actx,
-				ISC_TRUE, ISC_FALSE, ev->mod);
-	dns_view_freeze(ev->view);
-	isc_task_endexclusive(task);
+				chg->cbd->server->mctx, chg->view,
+				&chg->cbd->server->viewlist, cfg->actx,
+				ISC_TRUE, ISC_FALSE, chg->mod, NULL);
+	if (thaw)
+		dns_view_freeze(chg->view);
 
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
@@ -2272,8 +2367,7 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 	}
 
 	/* Is it there yet? */
-	CHECK(dns_zt_find(ev->view->zonetable,
-			dns_catz_entry_getname(ev->entry), 0, NULL, &zone));
+	CHECK(dns_zt_find(chg->view->zonetable, name, 0, NULL, &zone));
 
 	/*
 	 * Load the zone from the master file.	If this fails, we'll
@@ -2295,45 +2389,40 @@ catz_addmodzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 		}
 
 		/* Remove the zone from the zone table */
-		dns_zt_unmount(ev->view->zonetable, zone);
+		dns_zt_unmount(chg->view->zonetable, zone);
 		goto cleanup;
 	}
 
 	/* Flag the zone as having been added at runtime */
 	dns_zone_setadded(zone, ISC_TRUE);
-	dns_zone_set_parentcatz(zone, ev->origin);
+	dns_zone_set_parentcatz(zone, chg->origin);
 
  cleanup:
 	if (zone != NULL)
 		dns_zone_detach(&zone);
 	if (zoneconf != NULL)
 		cfg_obj_destroy(cfg->add_parser, &zoneconf);
-	dns_catz_entry_detach(ev->origin, &ev->entry);
-	dns_catz_zone_detach(&ev->origin);
-	dns_view_detach(&ev->view);
-	isc_event_free(ISC_EVENT_PTR(&ev));
 }
 
+/*
+ * Delete a member zone of a catalog zone, with the new zone lock held.
+ */
 static void
-catz_delzone_taskaction(isc_task_t *task, isc_event_t *event0) {
-	catz_chgzone_event_t *ev = (catz_chgzone_event_t *) event0;
+catz_delzone_change(catz_chgzone_t *chg) {
 	isc_result_t result;
 	dns_zone_t *zone = NULL;
 	dns_db_t *dbp = NULL;
 	char cname[DNS_NAME_FORMATSIZE];
 	const char * file;
 
-	result = isc_task_beginexclusive(task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-
-	dns_name_format(dns_catz_entry_getname(ev->entry), cname,
+	dns_name_format(dns_catz_entry_getname(chg->entry), cname,
 			DNS_NAME_FORMATSIZE);
-	result = dns_zt_find(ev->view->zonetable,
-			     dns_catz_entry_getname(ev->entry), 0, NULL, &zone);
+	result = dns_zt_find(chg->view->zonetable,
+			     dns_catz_entry_getname(chg->entry), 0, NULL, &zone);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
-			      "catz: catz_delzone_taskaction: "
+			      "catz: catz_delzone_change: "
 			      "zone '%s' not found", cname);
 		goto cleanup;
 	}
@@ -2341,16 +2430,16 @@ catz_delzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 	if (!dns_zone_getadded(zone)) {
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
-			      "catz: catz_delzone_taskaction: "
+			      "catz: catz_delzone_change: "
 			      "zone '%s' is not a dynamically added zone",
 			      cname);
 		goto cleanup;
 	}
 
-	if (dns_zone_get_parentcatz(zone) != ev->origin) {
+	if (dns_zone_get_parentcatz(zone) != chg->origin) {
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
-			      "catz: catz_delzone_taskaction: zone "
+			      "catz: catz_delzone_change: zone "
 			      "'%s' exists in multiple catalog zones",
 			      cname);
 		goto cleanup;
@@ -2362,67 +2451,130 @@ catz_delzone_taskaction(isc_task_t *task, isc_event_t *event0) {
 		dns_zone_unload(zone);
 	}
 
-	CHECK(dns_zt_unmount(ev->view->zonetable, zone));
+	CHECK(dns_zt_unmount(chg->view->zonetable, zone));
 	file = dns_zone_getfile(zone);
 	if (file != NULL)
 		isc_file_remove(file);
 
 	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 		      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
-		      "catz: catz_delzone_taskaction: "
+		      "catz: catz_delzone_change: "
 		      "zone '%s' deleted", cname);
   cleanup:
-	isc_task_endexclusive(task);
 	if (zone != NULL)
 		dns_zone_detach(&zone);
-	dns_catz_entry_detach(ev->origin, &ev->entry);
-	dns_catz_zone_detach(&ev->origin);
-	dns_view_detach(&ev->view);
-	isc_event_free(ISC_EVENT_PTR(&ev));
+}
+
+/*
+ * Carry out all the queued catalog zone changes.  An update of a
+ * catalog zone queues a change for each member zone added, modified
+ * or deleted; they are applied here in order, with the new zone lock
+ * taken once for the whole batch.  Additions and deletions leave the
+ * server running.  If any zone needs exclusive mode, it is entered
+ * once and kept for the rest of the batch.
+ */
+static void
+catz_changes_taskaction(isc_task_t *task, isc_event_t *event) {
+	catz_cb_data_t *cbd = event->ev_arg;
+	catz_chgzone_t *chg;
+	catz_changelist_t changes;
+	isc_boolean_t exclusive = ISC_FALSE;
+	unsigned int count = 0;
+
+	isc_event_free(&event);
+
+	ISC_LIST_INIT(changes);
+	LOCK(&cbd->lock);
+	ISC_LIST_APPENDLIST(changes, cbd->changes, link);
+	cbd->posted = ISC_FALSE;
+	UNLOCK(&cbd->lock);
+
+	LOCK(&cbd->server->newzone_lock);
+	while ((chg = ISC_LIST_HEAD(changes)) != NULL) {
+		ISC_LIST_UNLINK(changes, chg, link);
+
+		if (chg->type == DNS_EVENT_CATZDELZONE)
+			catz_delzone_change(chg);
+		else
+			catz_addmodzone(task, chg, &exclusive);
+		count++;
+
+		dns_catz_entry_detach(chg->origin, &chg->entry);
+		dns_catz_zone_detach(&chg->origin);
+		dns_view_detach(&chg->view);
+		isc_mem_put(cbd->server->mctx, chg, sizeof(*chg));
+	}
+	if (exclusive)
+		isc_task_endexclusive(task);
+	UNLOCK(&cbd->server->newzone_lock);
+
+	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+		      NS_LOGMODULE_SERVER, ISC_LOG_DEBUG(1),
+		      "catz: applied %u zone change%s%s", count,
+		      count == 1 ? "" : "s",
+		      exclusive ? " in exclusive mode" : "");
 }
 
 static isc_result_t
-catz_create_chg_task(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
+catz_queue_change(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
 		     dns_view_t *view, isc_taskmgr_t *taskmgr, void *udata,
 		     isc_eventtype_t type)
 {
-	catz_chgzone_event_t *event;
+	catz_cb_data_t *cbd = (catz_cb_data_t *) udata;
+	catz_chgzone_t *chg;
+	isc_event_t *run = NULL;
 	isc_task_t *task;
 	isc_result_t result;
-	isc_taskaction_t action;
 
-	switch (type) {
-	case DNS_EVENT_CATZADDZONE:
-	case DNS_EVENT_CATZMODZONE:
-		action = catz_addmodzone_taskaction;
-		break;
-	case DNS_EVENT_CATZDELZONE:
-		action = catz_delzone_taskaction;
-		break;
-	default:
-		REQUIRE(0);
-	}
+	REQUIRE(type == DNS_EVENT_CATZADDZONE ||
+		type == DNS_EVENT_CATZMODZONE ||
+		type == DNS_EVENT_CATZDELZONE);
 
-	event = (catz_chgzone_event_t *) isc_event_allocate(view->mctx, origin,
-							    type, action, NULL,
-							    sizeof(*event));
-	if (event == NULL)
+	/*
+	 * The change is queued rather than sent.  Only the first change
+	 * queued since the last batch sends the event that applies them.
+	 */
+	chg = isc_mem_get(cbd->server->mctx, sizeof(*chg));
+	if (chg == NULL)
 		return (ISC_R_NOMEMORY);
 
-	event->cbd = (catz_cb_data_t *) udata;
-	event->entry = NULL;
-	event->origin = NULL;
-	event->view = NULL;
-	event->mod = ISC_TF(type == DNS_EVENT_CATZMODZONE);
-	dns_catz_entry_attach(entry, &event->entry);
-	dns_catz_zone_attach(origin, &event->origin);
-	dns_view_attach(view, &event->view);
-
-	task = NULL;
-	result = isc_taskmgr_excltask(taskmgr, &task);
-	REQUIRE(result == ISC_R_SUCCESS);
-	isc_task_send(task, ISC_EVENT_PTR(&event));
-	isc_task_detach(&task);
+	chg->type = type;
+	chg->cbd = cbd;
+	chg->entry = NULL;
+	chg->origin = NULL;
+	chg->view = NULL;
+	chg->mod = ISC_TF(type == DNS_EVENT_CATZMODZONE);
+	ISC_LINK_INIT(chg, link);
+	dns_catz_entry_attach(entry, &chg->entry);
+	dns_catz_zone_attach(origin, &chg->origin);
+	dns_view_attach(view, &chg->view);
+
+	LOCK(&cbd->lock);
+	if (!cbd->posted) {
+		run = isc_event_allocate(cbd->server->mctx, cbd,
+					 NS_EVENT_CATZCHANGES,
+					 catz_changes_taskaction, cbd,
+					 sizeof(isc_event_t));
+		if (run == NULL) {
+			UNLOCK(&cbd->lock);
+			dns_catz_entry_detach(origin, &chg->entry);
+			dns_catz_zone_detach(&chg->origin);
+			dns_view_detach(&chg->view);
+			isc_mem_put(cbd->server->mctx, chg, sizeof(*chg));
+			return (ISC_R_NOMEMORY);
+		}
+		cbd->posted = ISC_TRUE;
+	}
+	ISC_LIST_APPEND(cbd->changes, chg, link);
+	UNLOCK(&cbd->lock);
+
+	if (run != NULL) {
+		task = NULL;
+		result = isc_taskmgr_excltask(taskmgr, &task);
+		REQUIRE(result == ISC_R_SUCCESS);
+		isc_task_send(task, &run);
+		isc_task_detach(&task);
+	}
 
 	return (ISC_R_SUCCESS);
 }
@@ -2431,7 +2583,7 @@ static isc_result_t
 catz_addzone(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
 	     dns_view_t *view, isc_taskmgr_t *taskmgr, void *udata)
 {
-	return (catz_create_chg_task(entry, origin, view, taskmgr, udata,
+	return (catz_queue_change(entry, origin, view, taskmgr, udata,
 				     DNS_EVENT_CATZADDZONE));
 }
 
@@ -2439,7 +2591,7 @@ static isc_result_t
 catz_delzone(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
 	     dns_view_t *view, isc_taskmgr_t *taskmgr, void *udata)
 {
-	return (catz_create_chg_task(entry, origin, view, taskmgr, udata,
+	return (catz_queue_change(entry, origin, view, taskmgr, udata,
 				     DNS_EVENT_CATZDELZONE));
 }
 
@@ -2447,7 +2599,7 @@ static isc_result_t
 catz_modzone(dns_catz_entry_t *entry, dns_catz_zone_t *origin,
 	     dns_view_t *view, isc_taskmgr_t *taskmgr, void *udata)
 {
-	return (catz_create_chg_task(entry, origin, view, taskmgr, udata,
+	return (catz_queue_change(entry, origin, view, taskmgr, udata,
 				     DNS_EVENT_CATZMODZONE));
 }
 
@@ -2600,9 +2752,6 @@ configure_catz(dns_view_t *view, const cfg_obj_t *config,
 	dns_view_t *pview = NULL;
 	isc_result_t result;
 
-	/* xxxwpk TODO do it cleaner, once, somewhere */
-	ns_catz_cbdata.server = ns_g_server;
-
 	zone_element = cfg_list_first(cfg_tuple_get(catz_obj, "zone list"));
 	if (zone_element == NULL)
 		return (ISC_R_SUCCESS);
@@ -3291,6 +3440,53 @@ create_mapped_acl(void) {
 	return (result);
 }
 
+static void
+hashtext(void *closure, const char *text, int textlen) {
+	isc_sha1_update(closure, (const unsigned char *)text, textlen);
+}
+
+/*
+ * Hash 'obj', leaving out any zone and view statements, into 'digest'.
+ * If 'prefix' is not NULL the hash is chained onto it.  Zones are
+ * hashed with the hash of their view's configuration as the prefix,
+ * which is in turn chained onto the hash of the global configuration,
+ * so a zone's hash changes when anything it may inherit does.
+ */
+static void
+hashconfig(const unsigned char *prefix, const cfg_obj_t *obj,
+	   unsigned char *digest)
+{
+	isc_sha1_t sha1;
+
+	INSIST(ISC_SHA1_DIGESTLENGTH == DNS_ZONE_CONFIGHASHLEN);
+
+	isc_sha1_init(&sha1);
+	if (prefix != NULL)
+		isc_sha1_update(&sha1, prefix, DNS_ZONE_CONFIGHASHLEN);
+	if (obj != NULL)
+		cfg_printx(obj, CFG_PRINTER_ONELINE | CFG_PRINTER_NOZONES,
+			   hashtext, &sha1);
+	isc_sha1_final(&sha1, digest);
+}
+
+/*
+ * Keep the reserved dispatches for the notify and transfer sources of
+ * a zone that is not reconfigured because its configuration hash is
+ * unchanged; ns_zone_configure() would have added them, and those not
+ * added again are released at the end of the reload.
+ */
+static void
+keep_zone_dispatches(dns_zone_t *zone, dns_zone_t *raw) {
+	dns_zone_t *mayberaw = (raw != NULL) ? raw : zone;
+
+	ns_add_reserved_dispatch(ns_g_server, dns_zone_getnotifysrc4(zone));
+	ns_add_reserved_dispatch(ns_g_server, dns_zone_getnotifysrc6(zone));
+	ns_add_reserved_dispatch(ns_g_server,
+				 dns_zone_getxfrsource4(mayberaw));
+	ns_add_reserved_dispatch(ns_g_server,
+				 dns_zone_getxfrsource6(mayberaw));
+}
+
 /*
  * Configure 'view' according to 'vconfig', taking defaults from 'config'
  * where values are missing in 'vconfig'.
@@ -3303,8 +3499,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	       cfg_obj_t *config, cfg_obj_t *vconfig,
 	       ns_cachelist_t *cachelist, const cfg_obj_t *bindkeys,
 	       isc_mem_t *mctx, cfg_aclconfctx_t *actx,
-	       isc_boolean_t need_hints)
+	       isc_boolean_t need_hints, const unsigned char *confighash)
 {
+	unsigned char viewhash[DNS_ZONE_CONFIGHASHLEN];
 	const cfg_obj_t *maps[4];
 	const cfg_obj_t *cfgmaps[3];
 	const cfg_obj_t *optionmaps[3];
@@ -3329,6 +3526,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	unsigned int cleaning_interval;
 	size_t max_cache_size;
 	isc_uint32_t max_cache_size_percent = 0;
+	isc_uint32_t cache_shards;
+	char shardsbuf[sizeof("4294967295")];
+	char *shardsargv[1];
+	isc_uint64_t respcache_size;
 	size_t max_adb_size;
 	isc_uint32_t lame_ttl, fail_ttl;
 	dns_tsig_keyring_t *ring = NULL;
@@ -3420,8 +3621,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	}
 
 	/*
-	 * Configure the zones.
+	 * Configure the zones.  Zones reused from the production view
+	 * whose configuration, including what they inherit, has not
+	 * changed are not reconfigured; see configure_zone().
 	 */
+	hashconfig(confighash, vconfig, viewhash);
 	zonelist = NULL;
 	if (voptions != NULL)
 		(void)cfg_map_get(voptions, "zone", &zonelist);
@@ -3438,7 +3642,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		const cfg_obj_t *zconfig = cfg_listelt_value(element);
 		CHECK(configure_zone(config, zconfig, vconfig, mctx, view,
 				     viewlist, actx, ISC_FALSE, old_rpz_ok,
-				     ISC_FALSE));
+				     ISC_FALSE, viewhash));
 	}
 
 	/*
@@ -3446,7 +3650,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	 * from the newzone file for zones that were added during previous
 	 * runs.
 	 */
-	CHECK(configure_newzones(view, config, vconfig, mctx, actx));
+	CHECK(configure_newzones(view, config, vconfig, mctx, actx,
+				 viewhash));
 
 	/*
 	 * Create Dynamically Loadable Zone driver.
@@ -3573,6 +3778,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		}
 	}
 
+	obj = NULL;
+	result = ns_config_get(maps, "cache-shards", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_shards = cfg_obj_asuint32(obj);
+
 	/* Check-names. */
 	obj = NULL;
 	result = ns_checknames_get(maps, "response", &obj);
@@ -3766,7 +3976,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	nsc = cachelist_find(cachelist, cachename, view->rdclass);
 	if (nsc != NULL) {
 		if (!cache_sharable(nsc->primaryview, view, zero_no_soattl,
-				    cleaning_interval, max_cache_size)) {
+				    cache_shards, cleaning_interval,
+				    max_cache_size)) {
 			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 				      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
 				      "views %s and %s can't share the cache "
@@ -3786,7 +3997,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 				goto cleanup;
 			if (pview != NULL) {
 				if (!cache_reusable(pview, view,
-						    zero_no_soattl)) {
+						    zero_no_soattl,
+						    cache_shards)) {
 					isc_log_write(ns_g_lctx,
 						      NS_LOGCATEGORY_GENERAL,
 						      NS_LOGMODULE_SERVER,
@@ -3823,15 +4035,33 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 			 * We use two separate memory contexts for the
 			 * cache, for the main cache memory and the heap
 			 * memory.
+			 *
+			 * With "cache-shards" greater than 1 the cache
+			 * is spread over that many databases.
 			 */
 			CHECK(isc_mem_create(0, 0, &cmctx));
 			isc_mem_setname(cmctx, "cache", NULL);
 			CHECK(isc_mem_create(0, 0, &hmctx));
 			isc_mem_setname(hmctx, "cache_heap", NULL);
-			CHECK(dns_cache_create3(cmctx, hmctx, ns_g_taskmgr,
-						ns_g_timermgr, view->rdclass,
-						cachename, "rbt", 0, NULL,
-						&cache));
+			if (cache_shards > 1) {
+				snprintf(shardsbuf, sizeof(shardsbuf), "%u",
+					 cache_shards);
+				shardsargv[0] = shardsbuf;
+				CHECK(dns_cache_create3(cmctx, hmctx,
+							ns_g_taskmgr,
+							ns_g_timermgr,
+							view->rdclass,
+							cachename, "sharded",
+							1, shardsargv,
+							&cache));
+			} else {
+				CHECK(dns_cache_create3(cmctx, hmctx,
+							ns_g_taskmgr,
+							ns_g_timermgr,
+							view->rdclass,
+							cachename, "rbt",
+							0, NULL, &cache));
+			}
 			isc_mem_detach(&cmctx);
 			isc_mem_detach(&hmctx);
 		}
@@ -3888,8 +4118,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	}
 
 	if (resstats == NULL) {
-		CHECK(isc_stats_create(mctx, &resstats,
-				       dns_resstatscounter_max));
+		CHECK(isc_stats_create2(mctx, &resstats,
+					dns_resstatscounter_max,
+					ISC_STATSCREATE_STRIPED));
 	}
 	dns_view_setresstats(view, resstats);
 	if (resquerystats == NULL)
@@ -3977,6 +4208,13 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		discount = (double) cfg_obj_asfixedpoint(obj2) / 100.0;
 
 		dns_adb_setquota(view->adb, fps, freq, low, high, discount);
+
+		obj = NULL;
+		result = ns_config_get(maps, "fetch-quota-adaptive", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		dns_adb_setquotaadaptive(view->adb, cfg_obj_asboolean(obj));
+		dns_resolver_setzonequotaadaptive(view->resolver,
+						  cfg_obj_asboolean(obj));
 	}
 
 	/*
@@ -4854,6 +5092,26 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 			goto cleanup;
 	}
 
+	/*
+	 * Set up the cache of rendered authoritative responses.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "response-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	respcache_size = cfg_obj_asuint64(obj);
+	if (respcache_size > SIZE_MAX) {
+		cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+			    "'response-cache-size "
+			    "%" ISC_PRINT_QUADFORMAT "u' "
+			    "is too large for this system; reducing to %lu",
+			    respcache_size, (unsigned long)SIZE_MAX);
+		respcache_size = SIZE_MAX;
+	}
+	if (respcache_size != 0) {
+		CHECK(dns_respcache_create(mctx, (size_t)respcache_size,
+					   &view->respcache));
+	}
+
 	/*
 	 * Set the servfail-ttl.
 	 */
@@ -5263,7 +5521,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	       const cfg_obj_t *vconfig, isc_mem_t *mctx, dns_view_t *view,
 	       dns_viewlist_t *viewlist, cfg_aclconfctx_t *aclconf,
 	       isc_boolean_t added, isc_boolean_t old_rpz_ok,
-	       isc_boolean_t modify)
+	       isc_boolean_t modify, const unsigned char *viewhash)
 {
 	dns_view_t *pview = NULL;	/* Production view */
 	dns_zone_t *zone = NULL;	/* New or reused zone */
@@ -5287,6 +5545,8 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	const char *ztypestr;
 	dns_rpz_num_t rpz_num;
 	isc_boolean_t zone_is_catz = ISC_FALSE;
+	isc_boolean_t reused = ISC_FALSE;
+	unsigned char zonehash[DNS_ZONE_CONFIGHASHLEN];
 
 	options = NULL;
 	(void)cfg_map_get(config, "options", &options);
@@ -5552,6 +5812,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 		 * new view.
 		 */
 		dns_zone_setview(zone, view);
+		reused = ISC_TRUE;
 	} else {
 		/*
 		 * We cannot reuse an existing zone, we have
@@ -5624,15 +5885,39 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	}
 
 	/*
-	 * Configure the zone.
+	 * Configure the zone, unless it is reused and was configured
+	 * with the same configuration last time.  The hash is only
+	 * recorded when the whole configuration is being loaded, in
+	 * the context 'viewhash' is the hash of.  Policy and catalog
+	 * zones are always reconfigured, as they are bound to data
+	 * belonging to the new view.
 	 */
-	CHECK(ns_zone_configure(config, vconfig, zconfig, aclconf, zone, raw));
+	if (viewhash != NULL)
+		hashconfig(viewhash, zconfig, zonehash);
+	if (viewhash != NULL && reused && rpz_num == DNS_RPZ_INVALID_NUM &&
+	    !zone_is_catz && dns_zone_confighashequal(zone, zonehash))
+	{
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "configuration unchanged");
+		keep_zone_dispatches(zone, raw);
+	} else {
+		dns_zone_setconfighash(zone, NULL);
+		CHECK(ns_zone_configure(config, vconfig, zconfig, aclconf,
+					zone, raw));
+		if (viewhash != NULL)
+			dns_zone_setconfighash(zone, zonehash);
+	}
 
 	/*
-	 * Add the zone to its view in the new view list.
+	 * Add the zone to its view in the new view list.  Zones added
+	 * at runtime usually go into a view that is frozen and serving
+	 * queries, so they are mounted in its zone table directly; see
+	 * newzone_needexclusive().
 	 */
-	if (!modify)
-	CHECK(dns_view_addzone(view, zone));
+	if (!modify && added)
+		CHECK(dns_zt_mount(view->zonetable, zone));
+	else if (!modify)
+		CHECK(dns_view_addzone(view, zone));
 
 	if (zone_is_catz) {
 		/*
@@ -6777,7 +7062,8 @@ setup_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 
 static isc_result_t
 configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
-		   isc_mem_t *mctx, cfg_aclconfctx_t *actx)
+		   isc_mem_t *mctx, cfg_aclconfctx_t *actx,
+		   const unsigned char *viewhash)
 {
 	isc_result_t result;
 	ns_cfgctx_t *nzctx;
@@ -6803,7 +7089,8 @@ configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		const cfg_obj_t *zconfig = cfg_listelt_value(element);
 		CHECK(configure_zone(config, zconfig, vconfig, mctx,
 				     view, &ns_g_server->viewlist, actx,
-				     ISC_TRUE, ISC_FALSE, ISC_FALSE));
+				     ISC_TRUE, ISC_FALSE, ISC_FALSE,
+				     viewhash));
 	}
 
 	result = ISC_R_SUCCESS;
@@ -6885,7 +7172,8 @@ data_to_cfg(dns_view_t *view, MDB_val *key, MDB_val *data,
 
 static isc_result_t
 configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
-		   isc_mem_t *mctx, cfg_aclconfctx_t *actx)
+		   isc_mem_t *mctx, cfg_aclconfctx_t *actx,
+		   const unsigned char *viewhash)
 {
 	isc_result_t result = ISC_R_SUCCESS;
 	int status;
@@ -6932,7 +7220,8 @@ configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		zoneobj = cfg_listelt_value(cfg_list_first(zlist));
 		CHECK(configure_zone(config, zoneobj, vconfig, mctx,
 				     view, &ns_g_server->viewlist, actx,
-				     ISC_TRUE, ISC_FALSE, ISC_FALSE));
+				     ISC_TRUE, ISC_FALSE, ISC_FALSE,
+				     viewhash));
 
 		cfg_obj_destroy(ns_g_addparser, &zoneconf);
 	}
@@ -7108,6 +7397,57 @@ check_lockfile(ns_server_t *server, const cfg_obj_t *config,
 	return (ISC_R_FAILURE);
 }
 
+/*
+ * Bind the task manager's workers, or the socket manager's watchers, to
+ * the CPUs listed in option 'name'.  Without the option they are unbound.
+ */
+static void
+configure_cpus(const cfg_obj_t **maps, const char *name,
+	       isc_taskmgr_t *taskmgr, isc_socketmgr_t *socketmgr)
+{
+	const cfg_obj_t *obj = NULL;
+	const cfg_listelt_t *element;
+	isc_uint32_t *cpus = NULL;
+	unsigned int i, ncpus = 0;
+	isc_result_t result;
+
+	INSIST((taskmgr == NULL) != (socketmgr == NULL));
+
+	(void)ns_config_get(maps, name, &obj);
+	if (obj != NULL)
+		ncpus = cfg_list_length(obj, ISC_FALSE);
+	if (ncpus != 0) {
+		cpus = isc_mem_get(ns_g_mctx, ncpus * sizeof(*cpus));
+		if (cpus == NULL) {
+			cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+				    "%s: out of memory", name);
+			return;
+		}
+		for (i = 0, element = cfg_list_first(obj);
+		     element != NULL;
+		     i++, element = cfg_list_next(element))
+			cpus[i] = cfg_obj_asuint32(cfg_listelt_value(element));
+	}
+
+	if (taskmgr != NULL)
+		result = isc_taskmgr_setcpus(taskmgr, cpus, ncpus);
+	else
+		result = isc_socketmgr_setcpus(socketmgr, cpus, ncpus);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "%s: unable to bind threads to CPUs: %s",
+			      name, isc_result_totext(result));
+	else if (ncpus != 0)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "%s: bound threads to %u CPU%s", name,
+			      ncpus, ncpus == 1 ? "" : "s");
+
+	if (cpus != NULL)
+		isc_mem_put(ns_g_mctx, cpus, ncpus * sizeof(*cpus));
+}
+
 static isc_result_t
 load_configuration(const char *filename, ns_server_t *server,
 		   isc_boolean_t first_time)
@@ -7144,6 +7484,7 @@ load_configuration(const char *filename, ns_server_t *server,
 	ns_cachelist_t cachelist, tmpcachelist;
 	unsigned int maxsocks;
 	isc_uint32_t softquota = 0;
+	unsigned char confighash[DNS_ZONE_CONFIGHASHLEN];
 
 	ISC_LIST_INIT(viewlist);
 	ISC_LIST_INIT(builtin_viewlist);
@@ -7259,6 +7600,12 @@ load_configuration(const char *filename, ns_server_t *server,
 			      server->bindkeysfile);
 	}
 
+	/*
+	 * Hash the global part of the configuration, which the zones of
+	 * every view inherit from, while the server is still running.
+	 */
+	hashconfig(NULL, config, confighash);
+
 	/* Ensure exclusive access to configuration data. */
 	if (!exclusive) {
 		result = isc_task_beginexclusive(server->task);
@@ -7579,6 +7926,20 @@ load_configuration(const char *filename, ns_server_t *server,
 	if ((ns_g_listen > 0) && (ns_g_listen < 10))
 		ns_g_listen = 10;
 
+	/*
+	 * Whether each worker gets its own SO_REUSEPORT UDP listener.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_g_reuseport = cfg_obj_asboolean(obj);
+
+	/*
+	 * Bind worker and socket watcher threads to CPUs.
+	 */
+	configure_cpus(maps, "task-cpus", ns_g_taskmgr, NULL);
+	configure_cpus(maps, "socket-cpus", NULL, ns_g_socketmgr);
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -7823,7 +8184,7 @@ load_configuration(const char *filename, ns_server_t *server,
 		CHECK(find_view(vconfig, &viewlist, &view));
 		CHECK(configure_view(view, &viewlist, config, vconfig,
 				     &cachelist, bindkeys, ns_g_mctx,
-				     ns_g_aclconfctx, ISC_TRUE));
+				     ns_g_aclconfctx, ISC_TRUE, confighash));
 		dns_view_freeze(view);
 		dns_view_detach(&view);
 	}
@@ -7837,7 +8198,8 @@ load_configuration(const char *filename, ns_server_t *server,
 		CHECK(find_view(NULL, &viewlist, &view));
 		CHECK(configure_view(view, &viewlist, config, NULL,
 				     &cachelist, bindkeys,
-				     ns_g_mctx, ns_g_aclconfctx, ISC_TRUE));
+				     ns_g_mctx, ns_g_aclconfctx, ISC_TRUE,
+				     confighash));
 		dns_view_freeze(view);
 		dns_view_detach(&view);
 	}
@@ -7857,7 +8219,8 @@ load_configuration(const char *filename, ns_server_t *server,
 		CHECK(create_view(vconfig, &builtin_viewlist, &view));
 		CHECK(configure_view(view, &viewlist, config, vconfig,
 				     &cachelist, bindkeys,
-				     ns_g_mctx, ns_g_aclconfctx, ISC_FALSE));
+				     ns_g_mctx, ns_g_aclconfctx, ISC_FALSE,
+				     confighash));
 		dns_view_freeze(view);
 		dns_view_detach(&view);
 		view = NULL;
@@ -8251,6 +8614,33 @@ load_configuration(const char *filename, ns_server_t *server,
 	if (v6portset != NULL)
 		isc_portset_destroy(ns_g_mctx, &v6portset);
 
+	if (view != NULL)
+		dns_view_detach(&view);
+
+	/*
+	 * Adjust the listening interfaces in accordance with the source
+	 * addresses specified in views and zones.
+	 */
+	if (isc_net_probeipv6() == ISC_R_SUCCESS)
+		adjust_interfaces(server, ns_g_mctx);
+
+	/*
+	 * Record the time of most recent configuration
+	 */
+	tresult = isc_time_now(&ns_g_configtime);
+	if (tresult != ISC_R_SUCCESS)
+		ns_main_earlyfatal("isc_time_now() failed: %s",
+				   isc_result_totext(result));
+
+	/* Relinquish exclusive access to configuration data. */
+	if (exclusive)
+		isc_task_endexclusive(server->task);
+
+	/*
+	 * Nothing below is reachable from the production view list
+	 * any more, so it is released while the server runs.  Clients
+	 * still using an old view hold references to it.
+	 */
 	if (conf_parser != NULL) {
 		if (config != NULL)
 			cfg_obj_destroy(conf_parser, &config);
@@ -8263,9 +8653,6 @@ load_configuration(const char *filename, ns_server_t *server,
 		cfg_parser_destroy(&bindkeys_parser);
 	}
 
-	if (view != NULL)
-		dns_view_detach(&view);
-
 	ISC_LIST_APPENDLIST(viewlist, builtin_viewlist, link);
 
 	/*
@@ -8292,25 +8679,6 @@ load_configuration(const char *filename, ns_server_t *server,
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
 
-	/*
-	 * Adjust the listening interfaces in accordance with the source
-	 * addresses specified in views and zones.
-	 */
-	if (isc_net_probeipv6() == ISC_R_SUCCESS)
-		adjust_interfaces(server, ns_g_mctx);
-
-	/*
-	 * Record the time of most recent configuration
-	 */
-	tresult = isc_time_now(&ns_g_configtime);
-	if (tresult != ISC_R_SUCCESS)
-		ns_main_earlyfatal("isc_time_now() failed: %s",
-				   isc_result_totext(result));
-
-	/* Relinquish exclusive access to configuration data. */
-	if (exclusive)
-		isc_task_endexclusive(server->task);
-
 	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_SERVER,
 		      ISC_LOG_DEBUG(1), "load_configuration: %s",
 		      isc_result_totext(result));
@@ -8655,6 +9023,15 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 		   ISC_R_NOMEMORY : ISC_R_SUCCESS,
 		   "allocating reload event");
 
+	CHECKFATAL(isc_mutex_init(&server->newzone_lock),
+		   "initializing new zone lock");
+
+	ns_catz_cbdata.server = server;
+	CHECKFATAL(isc_mutex_init(&ns_catz_cbdata.lock),
+		   "initializing catalog zone change lock");
+	ISC_LIST_INIT(ns_catz_cbdata.changes);
+	ns_catz_cbdata.posted = ISC_FALSE;
+
 	server->tkeyctx = NULL;
 	CHECKFATAL(dns_tkeyctx_create(ns_g_mctx, ns_g_entropy,
 				      &server->tkeyctx),
@@ -8706,8 +9083,9 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->tcpoutstats4 = NULL;
 	server->tcpinstats6 = NULL;
 	server->tcpoutstats6 = NULL;
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
+	CHECKFATAL(isc_stats_create2(server->mctx, &server->sockstats,
+				     isc_sockstatscounter_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "isc_stats_create");
 	isc_socketmgr_setstats(ns_g_socketmgr, server->sockstats);
 
@@ -8736,12 +9114,14 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->server_usehostname = ISC_FALSE;
 	server->server_id = NULL;
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->nsstats,
-				    dns_nsstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->nsstats,
+				     dns_nsstatscounter_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (server)");
 
-	CHECKFATAL(dns_rdatatypestats_create(ns_g_mctx,
-					     &server->rcvquerystats),
+	CHECKFATAL(dns_rdatatypestats_create2(ns_g_mctx,
+					      &server->rcvquerystats,
+					      ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (rcvquery)");
 
 	CHECKFATAL(dns_opcodestats_create(ns_g_mctx, &server->opcodestats),
@@ -8754,40 +9134,49 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 				    dns_zonestatscounter_max),
 		   "dns_stats_create (zone)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->resolverstats,
-				    dns_resstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->resolverstats,
+				     dns_resstatscounter_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (resolver)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (inbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (outbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (inbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (outbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (inbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (outbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (inbound TCP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_STRIPED),
 		   "dns_stats_create (outbound TCP IPv6 traffic size)");
 
 	server->flushonshutdown = ISC_FALSE;
@@ -8870,6 +9259,9 @@ ns_server_destroy(ns_server_t **serverp) {
 
 	isc_event_free(&server->reload_event);
 
+	DESTROYLOCK(&server->newzone_lock);
+	DESTROYLOCK(&ns_catz_cbdata.lock);
+
 	INSIST(ISC_LIST_EMPTY(server->viewlist));
 	INSIST(ISC_LIST_EMPTY(server->cachelist));
 
@@ -11085,12 +11477,20 @@ dumpzone(void *arg, const char *buf, int len) {
 	(void) isc_stdio_write(buf, len, 1, fp, NULL);
 }
 
+/*
+ * Append the 'count' zone configurations in 'zconfigs' to the NZF file
+ * of 'view'.  If any of them can't be written, the file is truncated to
+ * its former length.
+ */
 static isc_result_t
-nzf_append(dns_view_t *view, const cfg_obj_t *zconfig) {
+nzf_append(dns_view_t *view, const cfg_obj_t **zconfigs,
+	   unsigned int count)
+{
 	isc_result_t result;
 	off_t offset;
 	FILE *fp = NULL;
 	isc_boolean_t offsetok = ISC_FALSE;
+	unsigned int i;
 
 	LOCK(&view->new_zone_lock);
 
@@ -11102,9 +11502,11 @@ nzf_append(dns_view_t *view, const cfg_obj_t *zconfig) {
 	if (offset == 0)
 		CHECK(add_comment(fp, view->name));
 
-	CHECK(isc_stdio_write("zone ", 5, 1, fp, NULL));
-	cfg_printx(zconfig, CFG_PRINTER_ONELINE, dumpzone, fp);
-	CHECK(isc_stdio_write(";\n", 2, 1, fp, NULL));
+	for (i = 0; i < count; i++) {
+		CHECK(isc_stdio_write("zone ", 5, 1, fp, NULL));
+		cfg_printx(zconfigs[i], CFG_PRINTER_ONELINE, dumpzone, fp);
+		CHECK(isc_stdio_write(";\n", 2, 1, fp, NULL));
+	}
 	CHECK(isc_stdio_flush(fp));
 	result = isc_stdio_close(fp);
 	fp = NULL;
@@ -11187,14 +11589,18 @@ dumpzone(void *arg, const char *buf, int len) {
 	putmem(text, buf, len);
 }
 
+/*
+ * Store the configuration 'zconfig' of 'zone' in the NZD transaction
+ * 'txn', or delete it if 'zconfig' is NULL.  Returns ISC_R_NOTFOUND if
+ * there was nothing to delete.
+ */
 static isc_result_t
-nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
-	 const cfg_obj_t *zconfig)
+nzd_put(MDB_txn *txn, MDB_dbi dbi, dns_zone_t *zone,
+	const cfg_obj_t *zconfig)
 {
 	isc_result_t result;
 	int status;
 	dns_view_t *view;
-	isc_boolean_t commit = ISC_FALSE;
 	isc_buffer_t *text = NULL;
 	char namebuf[1024];
 	MDB_val key, data;
@@ -11203,12 +11609,12 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 
 	nzd_setkey(&key, dns_zone_getorigin(zone), namebuf, sizeof(namebuf));
 
-	LOCK(&view->new_zone_lock);
-
 	if (zconfig == NULL) {
 		/* We're deleting the zone from the database */
-		status = mdb_del(*txnp, dbi, &key, NULL);
-		if (status != 0 && status != MDB_NOTFOUND) {
+		status = mdb_del(txn, dbi, &key, NULL);
+		if (status == MDB_NOTFOUND)
+			return (ISC_R_NOTFOUND);
+		if (status != 0) {
 			isc_log_write(ns_g_lctx,
 				      NS_LOGCATEGORY_GENERAL,
 				      NS_LOGMODULE_SERVER,
@@ -11216,10 +11622,8 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 				      "Error deleting zone %s "
 				      "from NZD database: %s",
 				      namebuf, mdb_strerror(status));
-			result = ISC_R_FAILURE;
-			goto cleanup;
-		} else if (status != MDB_NOTFOUND)
-			commit = ISC_TRUE;
+			return (ISC_R_FAILURE);
+		}
 	} else {
 		/* We're creating or overwriting the zone */
 		const cfg_obj_t *zoptions;
@@ -11231,7 +11635,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 				      NS_LOGMODULE_SERVER,
 				      ISC_LOG_ERROR,
 				      "Unable to allocate buffer in "
-				      "nzd_save(): %s",
+				      "nzd_put(): %s",
 				      isc_result_totext(result));
 			goto cleanup;
 		}
@@ -11243,7 +11647,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 				      NS_LOGMODULE_SERVER,
 				      ISC_LOG_ERROR,
 				      "Unable to get options from config in "
-				      "nzd_save()");
+				      "nzd_put()");
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		}
@@ -11253,7 +11657,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 		data.mv_data = isc_buffer_base(text);
 		data.mv_size = isc_buffer_usedlength(text);
 
-		status = mdb_put(*txnp, dbi, &key, &data, 0);
+		status = mdb_put(txn, dbi, &key, &data, 0);
 		if (status != 0) {
 			isc_log_write(ns_g_lctx,
 				      NS_LOGCATEGORY_GENERAL,
@@ -11265,14 +11669,25 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		}
-
-		commit = ISC_TRUE;
 	}
 
 	result = ISC_R_SUCCESS;
 
  cleanup:
-	if (!commit || result != ISC_R_SUCCESS)
+	if (text != NULL)
+		isc_buffer_free(&text);
+	return (result);
+}
+
+/*
+ * Commit the NZD transaction '*txnp', or abort it if 'commit' is false.
+ */
+static isc_result_t
+nzd_commit(MDB_txn **txnp, isc_boolean_t commit) {
+	isc_result_t result = ISC_R_SUCCESS;
+	int status;
+
+	if (!commit)
 		(void) mdb_txn_abort(*txnp);
 	else {
 		status = mdb_txn_commit(*txnp);
@@ -11289,10 +11704,31 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 	}
 	*txnp = NULL;
 
+	return (result);
+}
+
+static isc_result_t
+nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
+	 const cfg_obj_t *zconfig)
+{
+	isc_result_t result;
+	dns_view_t *view;
+
+	view = dns_zone_getview(zone);
+
+	LOCK(&view->new_zone_lock);
+
+	result = nzd_put(*txnp, dbi, zone, zconfig);
+	if (result == ISC_R_SUCCESS)
+		result = nzd_commit(txnp, ISC_TRUE);
+	else {
+		(void) nzd_commit(txnp, ISC_FALSE);
+		if (result == ISC_R_NOTFOUND)
+			result = ISC_R_SUCCESS;
+	}
+
 	UNLOCK(&view->new_zone_lock);
 
-	if (text != NULL)
-		isc_buffer_free(&text);
 	return (result);
 }
 
@@ -11658,6 +12094,89 @@ migrate_nzf(dns_view_t *view) {
 
 #endif /* HAVE_LMDB */
 
+/*
+ * Check that the zone configured by 'zoneobj' is of a type that
+ * 'command' ("addzone" or "modzone") supports, and note whether it is
+ * a redirect zone.
+ */
+static isc_result_t
+newzone_checktype(const cfg_obj_t *zoneobj, const char *command,
+		  isc_boolean_t *redirectp, isc_buffer_t **text)
+{
+	const cfg_obj_t *zoptions;
+	const cfg_obj_t *obj = NULL;
+
+	zoptions = cfg_tuple_get(zoneobj, "options");
+
+	(void)cfg_map_get(zoptions, "type", &obj);
+	if (obj == NULL) {
+		(void) cfg_map_get(zoptions, "in-view", &obj);
+		if (obj != NULL) {
+			(void) putstr(text,
+				      "'in-view' zones not supported by ");
+			(void) putstr(text, command);
+		} else
+			(void) putstr(text, "zone type not specified");
+		return (ISC_R_FAILURE);
+	}
+
+	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
+	    strcasecmp(cfg_obj_asstring(obj), "forward") == 0 ||
+	    strcasecmp(cfg_obj_asstring(obj), "delegation-only") == 0)
+	{
+		(void) putstr(text, "'");
+		(void) putstr(text, cfg_obj_asstring(obj));
+		(void) putstr(text, "' zones not supported by ");
+		(void) putstr(text, command);
+		return (ISC_R_FAILURE);
+	}
+
+	*redirectp = ISC_TF(strcasecmp(cfg_obj_asstring(obj),
+				       "redirect") == 0);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find the view the zone configured by 'zoneobj' belongs to.
+ */
+static isc_result_t
+newzone_findview(ns_server_t *server, const cfg_obj_t *zoneobj,
+		 dns_view_t **viewp, isc_buffer_t **text)
+{
+	isc_result_t result;
+	const cfg_obj_t *obj;
+	const char *viewname = NULL;
+	dns_rdataclass_t rdclass;
+
+	/* Make sense of optional class argument */
+	obj = cfg_tuple_get(zoneobj, "class");
+	result = ns_config_getclass(obj, dns_rdataclass_in, &rdclass);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/* Make sense of optional view argument */
+	obj = cfg_tuple_get(zoneobj, "view");
+	if (obj && cfg_obj_isstring(obj))
+		viewname = cfg_obj_asstring(obj);
+	if (viewname == NULL || *viewname == '\0')
+		viewname = "_default";
+	result = dns_viewlist_find(&server->viewlist, viewname, rdclass,
+				   viewp);
+	if (result == ISC_R_NOTFOUND) {
+		(void) putstr(text, "no matching view found for '");
+		(void) putstr(text, viewname);
+		(void) putstr(text, "'");
+	}
+
+	return (result);
+}
+
+/*
+ * Parse an "addzone" or "modzone" command.  "addzone" may add several
+ * zones of one view, each after the first introduced by the keyword
+ * "zone"; '*zoneobjp' and '*redirectp' describe the first of them.
+ */
 static isc_result_t
 newzone_parse(ns_server_t *server, char *command, dns_view_t **viewp,
 	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
@@ -11665,15 +12184,13 @@ newzone_parse(ns_server_t *server, char *command, dns_view_t **viewp,
 {
 	isc_result_t result;
 	isc_buffer_t argbuf;
-	isc_boolean_t redirect = ISC_FALSE;
+	isc_boolean_t redirect = ISC_FALSE, zredirect;
 	cfg_obj_t *zoneconf = NULL;
 	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *element;
 	const cfg_obj_t *zoneobj = NULL;
-	const cfg_obj_t *zoptions = NULL;
-	const cfg_obj_t *obj = NULL;
-	const char *viewname = NULL;
-	dns_rdataclass_t rdclass;
-	dns_view_t *view = NULL;
+	dns_view_t *view = NULL, *zview = NULL;
+	unsigned int count = 0;
 	const char *bn;
 
 	REQUIRE(viewp != NULL && *viewp == NULL);
@@ -11705,58 +12222,45 @@ newzone_parse(ns_server_t *server, char *command, dns_view_t **viewp,
 	if (!cfg_obj_islist(zlist))
 		CHECK(ISC_R_FAILURE);
 
-	/* For now we only support adding one zone at a time */
-	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
-
-	/* Check the zone type for ones that are not supported by addzone. */
-	zoptions = cfg_tuple_get(zoneobj, "options");
-
-	obj = NULL;
-	(void)cfg_map_get(zoptions, "type", &obj);
-	if (obj == NULL) {
-		(void) cfg_map_get(zoptions, "in-view", &obj);
-		if (obj != NULL) {
-			(void) putstr(text,
-				      "'in-view' zones not supported by ");
-			(void) putstr(text, bn);
-		} else
-			(void) putstr(text, "zone type not specified");
-		CHECK(ISC_R_FAILURE);
-	}
-
-	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
-	    strcasecmp(cfg_obj_asstring(obj), "forward") == 0 ||
-	    strcasecmp(cfg_obj_asstring(obj), "delegation-only") == 0)
+	for (element = cfg_list_first(zlist);
+	     element != NULL;
+	     element = cfg_list_next(element))
 	{
-		(void) putstr(text, "'");
-		(void) putstr(text, cfg_obj_asstring(obj));
-		(void) putstr(text, "' zones not supported by ");
-		(void) putstr(text, bn);
-		CHECK(ISC_R_FAILURE);
-	}
+		const cfg_obj_t *zobj = cfg_listelt_value(element);
 
-	if (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0)
-		redirect = ISC_TRUE;
+		if (++count > 1 && strcmp(bn, "modzone") == 0) {
+			(void) putstr(text, "modzone changes one zone "
+					    "at a time");
+			CHECK(ISC_R_FAILURE);
+		}
 
-	/* Make sense of optional class argument */
-	obj = cfg_tuple_get(zoneobj, "class");
-	CHECK(ns_config_getclass(obj, dns_rdataclass_in, &rdclass));
+		/*
+		 * Check the zone type for ones that are not supported
+		 * by addzone.
+		 */
+		CHECK(newzone_checktype(zobj, bn, &zredirect, text));
+		CHECK(newzone_findview(server, zobj, &zview, text));
+
+		if (zoneobj == NULL) {
+			zoneobj = zobj;
+			redirect = zredirect;
+			view = zview;
+			zview = NULL;
+			continue;
+		}
 
-	/* Make sense of optional view argument */
-	obj = cfg_tuple_get(zoneobj, "view");
-	if (obj && cfg_obj_isstring(obj))
-		viewname = cfg_obj_asstring(obj);
-	if (viewname == NULL || *viewname == '\0')
-		viewname = "_default";
-	result = dns_viewlist_find(&server->viewlist, viewname, rdclass,
-				   &view);
-	if (result == ISC_R_NOTFOUND) {
-		(void) putstr(text, "no matching view found for '");
-		(void) putstr(text, viewname);
-		(void) putstr(text, "'");
-		goto cleanup;
-	} else if (result != ISC_R_SUCCESS) {
-		goto cleanup;
+		if (zview != view) {
+			(void) putstr(text, "zones added together must "
+					    "belong to one view");
+			CHECK(ISC_R_FAILURE);
+		}
+		dns_view_detach(&zview);
+
+		if (redirect || zredirect) {
+			(void) putstr(text, "redirect zones must be added "
+					    "on their own");
+			CHECK(ISC_R_FAILURE);
+		}
 	}
 
 	*viewp = view;
@@ -11769,12 +12273,41 @@ newzone_parse(ns_server_t *server, char *command, dns_view_t **viewp,
  cleanup:
 	if (zoneconf != NULL)
 		cfg_obj_destroy(ns_g_addparser, &zoneconf);
+	if (zview != NULL)
+		dns_view_detach(&zview);
 	if (view != NULL)
 		dns_view_detach(&view);
 
 	return (result);
 }
 
+/*
+ * Get the name of the zone configured by 'zoneobj'.
+ */
+static isc_result_t
+newzone_name(const cfg_obj_t *zoneobj, isc_boolean_t redirect,
+	     dns_name_t *name, isc_buffer_t **text)
+{
+	isc_result_t result;
+	const char *zonename;
+	isc_buffer_t buf;
+
+	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+	isc_buffer_constinit(&buf, zonename, strlen(zonename));
+	isc_buffer_add(&buf, strlen(zonename));
+
+	result = dns_name_fromtext(name, &buf, dns_rootname, 0, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (redirect && !dns_name_equal(name, dns_rootname)) {
+		(void) putstr(text, "redirect zones must be called \".\"");
+		return (ISC_R_FAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 delete_zoneconf(dns_view_t *view, cfg_parser_t *pctx,
 		const cfg_obj_t *config, const dns_name_t *zname,
@@ -11837,21 +12370,35 @@ delete_zoneconf(dns_view_t *view, cfg_parser_t *pctx,
 	return (result);
 }
 
+/*
+ * Remove 'zone', added at runtime but not yet saved, from 'view'.
+ */
+static void
+newzone_revert(dns_view_t *view, dns_zone_t *zone) {
+	dns_db_t *dbp = NULL;
+
+	/* If the zone loaded partially, unload it */
+	if (dns_zone_getdb(zone, &dbp) == ISC_R_SUCCESS) {
+		dns_db_detach(&dbp);
+		dns_zone_unload(zone);
+	}
+
+	/* Remove the zone from the zone table */
+	dns_zt_unmount(view->zonetable, zone);
+}
+
+/*
+ * Configure and load a new zone 'name' in 'view', returning it in
+ * '*zonep'.  The caller saves its configuration.
+ */
 static isc_result_t
 do_addzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
-	   dns_name_t *name, cfg_obj_t *zoneconf, const cfg_obj_t *zoneobj,
-	   isc_boolean_t redirect, isc_buffer_t **text)
+	   dns_name_t *name, const cfg_obj_t *zoneobj,
+	   isc_boolean_t redirect, isc_buffer_t **text, dns_zone_t **zonep)
 {
 	isc_result_t result, tresult;
 	dns_zone_t *zone = NULL;
-#ifndef HAVE_LMDB
-	FILE *fp = NULL;
-#else /* HAVE_LMDB */
-	MDB_txn *txn = NULL;
-	MDB_dbi dbi;
-
-	UNUSED(zoneconf);
-#endif /* HAVE_LMDB */
+	isc_boolean_t exclusive;
 
 	/* Zone shouldn't already exist */
 	if (redirect) {
@@ -11869,44 +12416,23 @@ do_addzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	} else if (result != ISC_R_NOTFOUND)
 		goto cleanup;
 
-#ifndef HAVE_LMDB
 	/*
-	 * Make sure we can open the configuration save file
+	 * Configure the zone.  Most zones are added while the server
+	 * keeps answering queries; the others need the view unfrozen.
 	 */
-	result = isc_stdio_open(view->new_zone_file, "a", &fp);
-	if (result != ISC_R_SUCCESS) {
-		TCHECK(putstr(text, "unable to create '"));
-		TCHECK(putstr(text, view->new_zone_file));
-		TCHECK(putstr(text, "': "));
-		TCHECK(putstr(text, isc_result_totext(result)));
-		goto cleanup;
+	exclusive = newzone_needexclusive(view, name, zoneobj);
+	if (exclusive) {
+		newzone_beginexclusive(server, server->task);
+		dns_view_thaw(view);
 	}
-
-	(void)isc_stdio_close(fp);
-	fp = NULL;
-#else /* HAVE_LMDB */
-	/* Make sure we can open the NZD database */
-	result = nzd_writable(view);
-	if (result != ISC_R_SUCCESS) {
-		TCHECK(putstr(text, "unable to open NZD database for '"));
-		TCHECK(putstr(text, view->new_zone_db));
-		TCHECK(putstr(text, "'"));
-		result = ISC_R_FAILURE;
-		goto cleanup;
-	}
-#endif /* HAVE_LMDB */
-
-	result = isc_task_beginexclusive(server->task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-
-	/* Mark view unfrozen and configure zone */
-	dns_view_thaw(view);
 	result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
 				server->mctx, view, &server->viewlist,
-				cfg->actx, ISC_TRUE, ISC_FALSE, ISC_FALSE);
-	dns_view_freeze(view);
-
-	isc_task_endexclusive(server->task);
+				cfg->actx, ISC_TRUE, ISC_FALSE, ISC_FALSE,
+				NULL);
+	if (exclusive) {
+		dns_view_freeze(view);
+		isc_task_endexclusive(server->task);
+	}
 
 	if (result != ISC_R_SUCCESS) {
 		TCHECK(putstr(text, "configure_zone failed: "));
@@ -11932,30 +12458,12 @@ do_addzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 		}
 	}
 
-#ifndef HAVE_LMDB
-	/*
-	 * If there wasn't a previous newzone config, just save the one
-	 * we've created. If there was a previous one, merge the new
-	 * zone into it.
-	 */
-	if (cfg->nzf_config == NULL)
-		cfg_obj_attach(zoneconf, &cfg->nzf_config);
-	else {
-		cfg_obj_t *z;
-		DE_CONST(zoneobj, z);
-		CHECK(cfg_parser_mapadd(cfg->add_parser,
-					cfg->nzf_config, z, "zone"));
-	}
-#endif /* HAVE_LMDB */
-
 	/*
 	 * Load the zone from the master file.  If this fails, we'll
 	 * need to undo the configuration we've done already.
 	 */
 	result = dns_zone_loadnew(zone);
 	if (result != ISC_R_SUCCESS) {
-		dns_db_t *dbp = NULL;
-
 		TCHECK(putstr(text, "dns_zone_loadnew failed: "));
 		TCHECK(putstr(text, isc_result_totext(result)));
 
@@ -11963,41 +12471,174 @@ do_addzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
 			      "addzone failed; reverting.");
 
-		/* If the zone loaded partially, unload it */
-		if (dns_zone_getdb(zone, &dbp) == ISC_R_SUCCESS) {
-			dns_db_detach(&dbp);
-			dns_zone_unload(zone);
-		}
-
-		/* Remove the zone from the zone table */
-		dns_zt_unmount(view->zonetable, zone);
+		newzone_revert(view, zone);
 		goto cleanup;
 	}
 
 	/* Flag the zone as having been added at runtime */
 	dns_zone_setadded(zone, ISC_TRUE);
 
-#ifdef HAVE_LMDB
-	/* Save the new zone configuration into the NZD */
-	CHECK(nzd_open(view, 0, &txn, &dbi));
-	CHECK(nzd_save(&txn, dbi, zone, zoneobj));
-#else
-	/* Append the zone configuration to the NZF */
-	result = nzf_append(view, zoneobj);
-#endif /* HAVE_LMDB */
+	*zonep = zone;
+	zone = NULL;
 
  cleanup:
+	if (zone != NULL)
+		dns_zone_detach(&zone);
+
+	return (result);
+}
 
+/*
+ * Add the zones listed in 'zoneconf' to 'view', and save their
+ * configuration with one NZF write or NZD transaction.  If one of them
+ * can't be added, those added before it are removed again and nothing
+ * is saved.
+ */
+static isc_result_t
+do_addzones(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
+	    cfg_obj_t *zoneconf, isc_buffer_t **text)
+{
+	isc_result_t result, tresult;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *element;
+	const cfg_obj_t **zoneobjs = NULL;
+	dns_zone_t **zones = NULL;
+	unsigned int i, count = 0, added = 0;
+	isc_boolean_t redirect = ISC_FALSE;
+	dns_fixedname_t fname;
+	dns_name_t *name;
 #ifndef HAVE_LMDB
-	if (fp != NULL)
-		(void)isc_stdio_close(fp);
+	FILE *fp = NULL;
+#else /* HAVE_LMDB */
+	MDB_txn *txn = NULL;
+	MDB_dbi dbi;
+#endif /* HAVE_LMDB */
+
+	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+	for (element = cfg_list_first(zlist);
+	     element != NULL;
+	     element = cfg_list_next(element))
+		count++;
+	INSIST(count > 0);
+
+	zoneobjs = isc_mem_get(server->mctx, count * sizeof(*zoneobjs));
+	zones = isc_mem_get(server->mctx, count * sizeof(*zones));
+	if (zoneobjs == NULL || zones == NULL)
+		CHECK(ISC_R_NOMEMORY);
+
+#ifndef HAVE_LMDB
+	/*
+	 * Make sure we can open the configuration save file
+	 */
+	result = isc_stdio_open(view->new_zone_file, "a", &fp);
+	if (result != ISC_R_SUCCESS) {
+		TCHECK(putstr(text, "unable to create '"));
+		TCHECK(putstr(text, view->new_zone_file));
+		TCHECK(putstr(text, "': "));
+		TCHECK(putstr(text, isc_result_totext(result)));
+		goto cleanup;
+	}
+
+	(void)isc_stdio_close(fp);
+	fp = NULL;
 #else /* HAVE_LMDB */
+	/* Make sure we can open the NZD database */
+	result = nzd_writable(view);
+	if (result != ISC_R_SUCCESS) {
+		TCHECK(putstr(text, "unable to open NZD database for '"));
+		TCHECK(putstr(text, view->new_zone_db));
+		TCHECK(putstr(text, "'"));
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+#endif /* HAVE_LMDB */
+
+	dns_fixedname_init(&fname);
+	name = dns_fixedname_name(&fname);
+	for (element = cfg_list_first(zlist);
+	     element != NULL;
+	     element = cfg_list_next(element))
+	{
+		zoneobjs[added] = cfg_listelt_value(element);
+		zones[added] = NULL;
+		CHECK(newzone_checktype(zoneobjs[added], "addzone",
+					&redirect, text));
+		CHECK(newzone_name(zoneobjs[added], redirect, name, text));
+		result = do_addzone(server, cfg, view, name, zoneobjs[added],
+				    redirect, text, &zones[added]);
+		if (result != ISC_R_SUCCESS) {
+			if (count > 1) {
+				TCHECK(putstr(text, "\nadding zone '"));
+				TCHECK(putstr(text, cfg_obj_asstring(
+					cfg_tuple_get(zoneobjs[added],
+						      "name"))));
+				TCHECK(putstr(text, "' failed; no zones "
+						    "were added"));
+			}
+			goto cleanup;
+		}
+		added++;
+	}
+
+#ifdef HAVE_LMDB
+	/* Save the new zone configurations into the NZD */
+	CHECK(nzd_open(view, 0, &txn, &dbi));
+	LOCK(&view->new_zone_lock);
+	for (i = 0; i < count && result == ISC_R_SUCCESS; i++)
+		result = nzd_put(txn, dbi, zones[i], zoneobjs[i]);
+	if (result == ISC_R_SUCCESS)
+		result = nzd_commit(&txn, ISC_TRUE);
+	UNLOCK(&view->new_zone_lock);
+	CHECK(result);
+#else /* HAVE_LMDB */
+	/*
+	 * If there wasn't a previous newzone config, just save the one
+	 * we've created. If there was a previous one, merge the new
+	 * zones into it.
+	 */
+	if (cfg->nzf_config == NULL)
+		cfg_obj_attach(zoneconf, &cfg->nzf_config);
+	else {
+		for (i = 0; i < count; i++) {
+			cfg_obj_t *z;
+			DE_CONST(zoneobjs[i], z);
+			CHECK(cfg_parser_mapadd(cfg->add_parser,
+						cfg->nzf_config, z, "zone"));
+		}
+	}
+
+	/* Append the zone configurations to the NZF */
+	CHECK(nzf_append(view, zoneobjs, count));
+#endif /* HAVE_LMDB */
+
+	for (i = 0; i < count; i++)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "added zone %s in view %s via %s",
+			      cfg_obj_asstring(cfg_tuple_get(zoneobjs[i],
+							     "name")),
+			      view->name, NS_COMMAND_ADDZONE);
+
+ cleanup:
+#ifdef HAVE_LMDB
 	if (txn != NULL)
 		(void) nzd_close(&txn, ISC_FALSE);
 #endif /* HAVE_LMDB */
 
-	if (zone != NULL)
-		dns_zone_detach(&zone);
+	/*
+	 * Zones that were added stay if only saving their configuration
+	 * failed, as a single addzone always did.
+	 */
+	for (i = 0; zones != NULL && i < added; i++) {
+		if (added < count)
+			newzone_revert(view, zones[i]);
+		dns_zone_detach(&zones[i]);
+	}
+	if (zones != NULL)
+		isc_mem_put(server->mctx, zones, count * sizeof(*zones));
+	if (zoneobjs != NULL)
+		isc_mem_put(server->mctx, zoneobjs,
+			    count * sizeof(*zoneobjs));
 
 	return (result);
 }
@@ -12042,10 +12683,6 @@ do_modzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	}
 #endif
 
-	result = isc_task_beginexclusive(server->task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-	exclusive = ISC_TRUE;
-
 #ifndef HAVE_LMDB
 	/* Make sure we can open the configuration save file */
 	result = isc_stdio_open(view->new_zone_file, "a", &fp);
@@ -12070,11 +12707,18 @@ do_modzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 	}
 #endif /* HAVE_LMDB */
 
-	/* Reconfigure the zone */
+	/*
+	 * Reconfigure the zone.  It is serving queries, which read some
+	 * of its settings without locking, so this is done in exclusive
+	 * mode.
+	 */
+	newzone_beginexclusive(server, server->task);
+	exclusive = ISC_TRUE;
 	dns_view_thaw(view);
 	result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
 				server->mctx, view, &server->viewlist,
-				cfg->actx, ISC_TRUE, ISC_FALSE, ISC_TRUE);
+				cfg->actx, ISC_TRUE, ISC_FALSE, ISC_TRUE,
+				NULL);
 	dns_view_freeze(view);
 
 	exclusive = ISC_FALSE;
@@ -12181,7 +12825,7 @@ do_modzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 		CHECK(nzd_open(view, 0, &txn, &dbi));
 		CHECK(nzd_save(&txn, dbi, zone, zoneobj));
 #else
-		result = nzf_append(view, zoneobj);
+		result = nzf_append(view, &zoneobj, 1);
 		if (result != ISC_R_SUCCESS) {
 			TCHECK(putstr(text, "\nNew zone config not saved: "));
 			TCHECK(putstr(text, isc_result_totext(result)));
@@ -12220,6 +12864,7 @@ do_modzone(ns_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
 
 /*
  * Act on an "addzone" or "modzone" command from the command channel.
+ * The zones of one "addzone" command are added and saved together.
  */
 isc_result_t
 ns_server_changezone(ns_server_t *server, char *command, isc_buffer_t **text) {
@@ -12231,7 +12876,6 @@ ns_server_changezone(ns_server_t *server, char *command, isc_buffer_t **text) {
 	const cfg_obj_t *zoneobj = NULL;
 	const char *zonename;
 	dns_view_t *view = NULL;
-	isc_buffer_t buf;
 	dns_fixedname_t fname;
 	dns_name_t *dnsname;
 
@@ -12242,6 +12886,8 @@ ns_server_changezone(ns_server_t *server, char *command, isc_buffer_t **text) {
 		addzone = ISC_FALSE;
 	}
 
+	LOCK(&server->newzone_lock);
+
 	CHECK(newzone_parse(server, command, &view, &zoneconf,
 			    &zoneobj, &redirect, text));
 
@@ -12265,35 +12911,21 @@ ns_server_changezone(ns_server_t *server, char *command, isc_buffer_t **text) {
 		goto cleanup;
 	}
 
-	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
-	isc_buffer_constinit(&buf, zonename, strlen(zonename));
-	isc_buffer_add(&buf, strlen(zonename));
-
-	dns_fixedname_init(&fname);
-	dnsname = dns_fixedname_name(&fname);
-	CHECK(dns_name_fromtext(dnsname, &buf, dns_rootname, 0, NULL));
-
-	if (redirect) {
-		if (!dns_name_equal(dnsname, dns_rootname)) {
-			(void) putstr(text,
-				      "redirect zones must be called \".\"");
-			CHECK(ISC_R_FAILURE);
-		}
-	}
-
 	if (addzone)
-		CHECK(do_addzone(server, cfg, view, dnsname, zoneconf,
-				 zoneobj, redirect, text));
-	else
+		CHECK(do_addzones(server, cfg, view, zoneconf, text));
+	else {
+		zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+		dns_fixedname_init(&fname);
+		dnsname = dns_fixedname_name(&fname);
+		CHECK(newzone_name(zoneobj, redirect, dnsname, text));
 		CHECK(do_modzone(server, cfg, view, dnsname, zonename,
 				 zoneobj, redirect, text));
 
-	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
-		      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
-		      "%s zone %s in view %s via %s",
-		      addzone ? "added" : "updated",
-		      zonename, view->name,
-		      addzone ? NS_COMMAND_ADDZONE : NS_COMMAND_MODZONE);
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "updated zone %s in view %s via %s",
+			      zonename, view->name, NS_COMMAND_MODZONE);
+	}
 
 	/* Changing a zone counts as reconfiguration */
 	CHECK(isc_time_now(&ns_g_configtime));
@@ -12303,6 +12935,7 @@ ns_server_changezone(ns_server_t *server, char *command, isc_buffer_t **text) {
 		(void) putnull(text);
 	if (zoneconf != NULL)
 		cfg_obj_destroy(ns_g_addparser, &zoneconf);
+	UNLOCK(&server->newzone_lock);
 	if (view != NULL)
 		dns_view_detach(&view);
 
@@ -12366,6 +12999,8 @@ rmzone(isc_task_t *task, isc_event_t *event) {
 	/* Remove the zone from configuration (and NZF file if applicable) */
 	added = dns_zone_getadded(zone);
 
+	LOCK(&ns_g_server->newzone_lock);
+
 	if (added && cfg != NULL) {
 #ifdef HAVE_LMDB
 		/* Make sure we can open the NZD database */
@@ -12425,6 +13060,8 @@ rmzone(isc_task_t *task, isc_event_t *event) {
 		}
 	}
 
+	UNLOCK(&ns_g_server->newzone_lock);
+
 	/* Unload zone database */
 	if (dns_zone_getdb(zone, &dbp) == ISC_R_SUCCESS) {
 		dns_db_detach(&dbp);
@@ -12711,7 +13348,7 @@ ns_server_showzone(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 	dns_view_t *view = NULL;
 	dns_zone_t *zone = NULL;
 	ns_cfgctx_t *cfg = NULL;
-	isc_boolean_t exclusive = ISC_FALSE;
+	isc_boolean_t locked = ISC_FALSE;
 #ifdef HAVE_LMDB
 	cfg_obj_t *nzconfig = NULL;
 #endif /* HAVE_LMDB */
@@ -12736,9 +13373,8 @@ ns_server_showzone(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 		goto cleanup;
 	}
 
-	result = isc_task_beginexclusive(server->task);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-	exclusive = ISC_TRUE;
+	LOCK(&server->newzone_lock);
+	locked = ISC_TRUE;
 
 	if (!added) {
 		/* Find the view statement */
@@ -12787,8 +13423,8 @@ ns_server_showzone(ns_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 #endif /* HAVE_LMDB */
 	if (isc_buffer_usedlength(*text) > 0)
 		(void) putnull(text);
-	if (exclusive)
-		isc_task_endexclusive(server->task);
+	if (locked)
+		UNLOCK(&server->newzone_lock);
 
 	return (result);
 }
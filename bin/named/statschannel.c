@@ -290,6 +290,11 @@ init_desc(void) {
 		"resulted in a successful remote lookup",
 		"QryNXRedirRLookup");
 	SET_NSSTATDESC(badcookie, "sent badcookie response", "QryBADCOOKIE");
+	SET_NSSTATDESC(respcachehit, "responses sent from the response cache",
+		       "RespCacheHit");
+	SET_NSSTATDESC(respcachemiss,
+		       "cacheable responses not in the response cache",
+		       "RespCacheMiss");
 	INSIST(i == dns_nsstatscounter_max);
 
 	/* Initialize resolver statistics */
@@ -377,6 +382,10 @@ init_desc(void) {
 	SET_RESSTATDESC(serverquota, "spilled due to server quota",
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
+	SET_RESSTATDESC(zonewindowed, "zones with a reduced fetch window",
+			"ZoneWindowed");
+	SET_RESSTATDESC(zonewindowcuts, "zone fetch window reductions",
+			"ZoneWindowCuts");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -399,6 +408,10 @@ init_desc(void) {
 	SET_ADBSTATDESC(entriescnt, "Addresses in hash table", "entriescnt");
 	SET_ADBSTATDESC(nnames, "Name hash table size", "nnames");
 	SET_ADBSTATDESC(namescnt, "Names in hash table", "namescnt");
+	SET_ADBSTATDESC(windowed, "Addresses with a reduced fetch window",
+			"windowed");
+	SET_ADBSTATDESC(windowcuts, "Address fetch window reductions",
+			"windowcuts");
 
 	INSIST(i == dns_adbstats_max);
 
@@ -552,6 +565,22 @@ init_desc(void) {
 	SET_SOCKSTATDESC(unixactive, "Unix domain sockets active",
 			 "UnixActive");
 	SET_SOCKSTATDESC(rawactive, "Raw sockets active", "RawActive");
+	SET_SOCKSTATDESC(udp4recvbatch, "UDP/IPv4 batched recv calls",
+			 "UDP4RecvBatch");
+	SET_SOCKSTATDESC(udp6recvbatch, "UDP/IPv6 batched recv calls",
+			 "UDP6RecvBatch");
+	SET_SOCKSTATDESC(udp4recvbatchmsg, "UDP/IPv4 batched recv datagrams",
+			 "UDP4RecvBatchMsg");
+	SET_SOCKSTATDESC(udp6recvbatchmsg, "UDP/IPv6 batched recv datagrams",
+			 "UDP6RecvBatchMsg");
+	SET_SOCKSTATDESC(udp4sendbatch, "UDP/IPv4 batched send calls",
+			 "UDP4SendBatch");
+	SET_SOCKSTATDESC(udp6sendbatch, "UDP/IPv6 batched send calls",
+			 "UDP6SendBatch");
+	SET_SOCKSTATDESC(udp4sendbatchmsg, "UDP/IPv4 batched send datagrams",
+			 "UDP4SendBatchMsg");
+	SET_SOCKSTATDESC(udp6sendbatchmsg, "UDP/IPv6 batched send datagrams",
+			 "UDP6SendBatchMsg");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
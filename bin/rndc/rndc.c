@@ -97,7 +97,8 @@ Usage: %s [-b address] [-c config] [-s server] [-p port]\n\
 command is one of the following:\n\
 \n\
   addzone zone [class [view]] { zone-options }\n\
-		Add zone to given view. Requires allow-new-zones option.\n\
+	  [zone zone [class [view]] { zone-options }...]\n\
+		Add zones to given view. Requires allow-new-zones option.\n\
   delzone [-clean] zone [class [view]]\n\
 		Removes zone from given view.\n\
   dnstap -reopen\n\
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+usage () {
+    echo "Usage: $0 [-n queries] [dig options...]"
+    exit 1
+}
+
+nqueries=1000
+if [ "$1" = "-n" ]; then
+    [ "$#" -ge 2 ] || usage
+    nqueries=$2
+    shift 2
+fi
+
+. ../system/conf.sh
+
+[ -f named.conf ] || sh setup.sh
+
+query () {
+    n=$1
+    shift
+    i=0
+    while [ $i -lt $n ]; do
+        $DIG +tries=1 +time=2 -p 5300 @127.0.0.1 example SOA "$@" \
+            > /dev/null 2>&1
+        i=`expr $i + 1`
+    done
+}
+
+count () {
+    sleep 1
+    grep -c '^add ' named.run
+}
+
+$NAMED -g -m trace -c named.conf > named.run 2>&1 &
+pid=$!
+sleep 2
+
+# Warm up the server so that one-time allocations are not counted.
+query 10 "$@"
+before=`count`
+query $nqueries "$@"
+after=`count`
+
+kill -TERM $pid
+wait $pid
+
+allocs=`expr $after - $before`
+echo "I:queries:      $nqueries"
+echo "I:allocations:  $allocs"
+awk -v a=$allocs -v n=$nqueries \
+    'BEGIN { printf("I:per query:    %.2f\n", a / n) }'
@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+cat > named.conf << EOF2
+options {
+	directory "`pwd`";
+	listen-on port 5300 { 127.0.0.1; };
+	listen-on-v6 { none; };
+	pid-file "named.pid";
+	recursion no;
+};
+
+zone example { type master; file "example.db"; };
+EOF2
+
+cat > example.db << EOF2
+\$TTL 300
+@	SOA	ns.example. hostmaster.example. 1 3600 1200 604800 300
+	NS	ns.example.
+ns	A	127.0.0.1
+EOF2
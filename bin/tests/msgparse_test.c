@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Time dns_message_parse() on messages with a growing number of owner
+ * names, or on messages read from files in the format used by wire_test.
+ *
+ * The generated messages look like a zone transfer of "example": for
+ * each of N owner names there is an A record, then an AAAA record under
+ * the same name in upper case, then a second A record.  When parsing
+ * scales linearly, the time per record stays flat as N grows.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+
+isc_mem_t *mctx = NULL;
+int parseflags = 0;
+
+static inline void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, dns_result_totext(result));
+
+		exit(1);
+	}
+}
+
+static int
+fromhex(char c) {
+	if (c >= '0' && c <= '9')
+		return (c - '0');
+	else if (c >= 'a' && c <= 'f')
+		return (c - 'a' + 10);
+	else if (c >= 'A' && c <= 'F')
+		return (c - 'A' + 10);
+
+	fprintf(stderr, "bad input format: %02x\n", c);
+	exit(3);
+	/* NOTREACHED */
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "msgparse_test [-p] [-i iterations] [-n maxnames] "
+		"[filename ...]\n\n");
+	fprintf(stderr, "\t-i\tParse each message this many times\n");
+	fprintf(stderr, "\t-n\tLargest number of owner names to generate\n");
+	fprintf(stderr, "\t-p\tPreserve order of the records in messages\n");
+	fprintf(stderr, "\nFiles are read in the hex format of wire_test.\n");
+}
+
+/*
+ * Read a message in wire_test's hex format.
+ */
+static void
+readhex(const char *filename, isc_buffer_t **bufferp) {
+	char s[BUFSIZ];
+	isc_result_t result;
+	FILE *f;
+
+	f = fopen(filename, "r");
+	if (f == NULL) {
+		fprintf(stderr, "%s: fopen failed\n", filename);
+		exit(1);
+	}
+
+	while (fgets(s, sizeof(s), f) != NULL) {
+		char *rp = s, *wp = s;
+		size_t i, len = 0;
+
+		while (*rp != '\0') {
+			if (*rp == '#')
+				break;
+			if (*rp != ' ' && *rp != '\t' &&
+			    *rp != '\r' && *rp != '\n') {
+				*wp++ = *rp;
+				len++;
+			}
+			rp++;
+		}
+		if (len == 0U)
+			continue;
+		if (len % 2 != 0U) {
+			fprintf(stderr, "bad input format: %lu\n",
+				(unsigned long)len);
+			exit(1);
+		}
+
+		rp = s;
+		for (i = 0; i < len; i += 2) {
+			isc_uint8_t c;
+
+			c = fromhex(*rp++);
+			c *= 16;
+			c += fromhex(*rp++);
+			result = isc_buffer_reserve(bufferp, 1);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			isc_buffer_putuint8(*bufferp, c);
+		}
+	}
+
+	fclose(f);
+}
+
+static void
+putrr(isc_buffer_t **bufferp, unsigned int n, isc_boolean_t upper,
+      isc_uint16_t type, isc_uint32_t addr)
+{
+	char label[16];
+	unsigned int i, len;
+	isc_result_t result;
+
+	len = snprintf(label, sizeof(label), upper ? "H%u" : "h%u", n);
+	result = isc_buffer_reserve(bufferp, 1 + len + 2 + 10 + 16);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	/* Owner name: one label and a pointer to "example." at offset 12 */
+	isc_buffer_putuint8(*bufferp, len);
+	isc_buffer_putmem(*bufferp, (unsigned char *)label, len);
+	isc_buffer_putuint16(*bufferp, 0xc00c);
+
+	isc_buffer_putuint16(*bufferp, type);
+	isc_buffer_putuint16(*bufferp, 1);	/* IN */
+	isc_buffer_putuint32(*bufferp, 3600);
+	if (type == 1) {
+		isc_buffer_putuint16(*bufferp, 4);
+		isc_buffer_putuint32(*bufferp, addr);
+	} else {
+		isc_buffer_putuint16(*bufferp, 16);
+		for (i = 0; i < 12; i++)
+			isc_buffer_putuint8(*bufferp, 0);
+		isc_buffer_putuint32(*bufferp, addr);
+	}
+}
+
+/*
+ * Build the zone transfer shaped message with 'names' owner names
+ * described above.
+ */
+static void
+generate(unsigned int names, isc_buffer_t **bufferp) {
+	static const unsigned char header[] = {
+		0x00, 0x01, 0x84, 0x00, 0x00, 0x01, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00,
+		7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0,
+		0x00, 0xfc, 0x00, 0x01			/* AXFR IN */
+	};
+	unsigned char *base;
+	unsigned int i;
+	isc_result_t result;
+
+	INSIST(names * 3 <= 0xffff);
+
+	result = isc_buffer_reserve(bufferp, sizeof(header));
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	isc_buffer_putmem(*bufferp, header, sizeof(header));
+
+	for (i = 0; i < names; i++)
+		putrr(bufferp, i, ISC_FALSE, 1, 0x0a000000 + i);
+	for (i = 0; i < names; i++)
+		putrr(bufferp, i, ISC_TRUE, 28, i);
+	for (i = 0; i < names; i++)
+		putrr(bufferp, i, ISC_FALSE, 1, 0x0b000000 + i);
+
+	/* ANCOUNT */
+	base = isc_buffer_base(*bufferp);
+	base[6] = (names * 3) >> 8;
+	base[7] = (names * 3) & 0xff;
+}
+
+static unsigned int
+countnames(dns_message_t *msg, dns_section_t section, unsigned int *rdsp) {
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	unsigned int names = 0, rdatasets = 0;
+
+	for (name = ISC_LIST_HEAD(msg->sections[section]);
+	     name != NULL;
+	     name = ISC_LIST_NEXT(name, link))
+	{
+		names++;
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+			rdatasets++;
+	}
+
+	*rdsp = rdatasets;
+	return (names);
+}
+
+/*
+ * Parse the message in 'source' 'iterations' times and print the time
+ * taken per message and per record.
+ */
+static void
+bench(const char *label, isc_buffer_t *source, unsigned int iterations,
+      unsigned int expectnames)
+{
+	dns_message_t *msg = NULL;
+	isc_time_t start, finish;
+	isc_uint64_t usecs;
+	unsigned int i, records = 0, names = 0, rdatasets = 0;
+	isc_result_t result;
+
+	isc_time_now(&start);
+	for (i = 0; i < iterations; i++) {
+		isc_buffer_t b = *source;
+
+		result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE,
+					    &msg);
+		CHECKRESULT(result, "dns_message_create failed");
+
+		result = dns_message_parse(msg, &b, parseflags);
+		if (result == DNS_R_RECOVERABLE)
+			result = ISC_R_SUCCESS;
+		CHECKRESULT(result, "dns_message_parse failed");
+
+		if (i == 0) {
+			records = msg->counts[DNS_SECTION_ANSWER] +
+				  msg->counts[DNS_SECTION_AUTHORITY] +
+				  msg->counts[DNS_SECTION_ADDITIONAL];
+			names = countnames(msg, DNS_SECTION_ANSWER,
+					   &rdatasets);
+		}
+
+		dns_message_destroy(&msg);
+	}
+	isc_time_now(&finish);
+
+	if (expectnames != 0 &&
+	    (parseflags & DNS_MESSAGEPARSE_PRESERVEORDER) == 0 &&
+	    (names != expectnames || rdatasets != expectnames * 2))
+	{
+		fprintf(stderr, "%s: parsed %u names and %u rdatasets, "
+			"expected %u and %u\n", label, names, rdatasets,
+			expectnames, expectnames * 2);
+		exit(1);
+	}
+
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("%-24s %8u records %10.2f us/message %8.1f ns/record\n",
+	       label, records, (double)usecs / iterations,
+	       records == 0 ? 0.0 :
+	       (double)usecs * 1000 / iterations / records);
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_buffer_t *input = NULL;
+	unsigned int iterations = 0, maxnames = 8192, names;
+	char label[32];
+	int ch;
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+
+	while ((ch = isc_commandline_parse(argc, argv, "i:n:p")) != -1) {
+		switch (ch) {
+		case 'i':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			maxnames = atoi(isc_commandline_argument);
+			break;
+		case 'p':
+			parseflags |= DNS_MESSAGEPARSE_PRESERVEORDER;
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	if (maxnames > 0xffff / 3)
+		maxnames = 0xffff / 3;
+
+	if (argc > 0) {
+		for (; argc > 0; argc--, argv++) {
+			RUNTIME_CHECK(isc_buffer_allocate(mctx, &input,
+							  64 * 1024) ==
+				      ISC_R_SUCCESS);
+			readhex(argv[0], &input);
+			bench(argv[0], input,
+			      iterations != 0 ? iterations : 10000, 0);
+			isc_buffer_free(&input);
+		}
+	} else {
+		for (names = 4; names <= maxnames; names *= 2) {
+			RUNTIME_CHECK(isc_buffer_allocate(mctx, &input,
+							  64 * 1024) ==
+				      ISC_R_SUCCESS);
+			generate(names, &input);
+			snprintf(label, sizeof(label), "%u names", names);
+			/* Keep the number of records parsed roughly constant */
+			bench(label, input, iterations != 0 ? iterations :
+			      ISC_MAX(2000000 / (names * 3), 10), names);
+			isc_buffer_free(&input);
+		}
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -14,10 +14,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <isc/commandline.h>
+#include <isc/mutex.h>
 #include <isc/print.h>
 #include <isc/thread.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #ifdef WIN32
@@ -90,16 +93,158 @@ run2(void *arg) {
 	return ((isc_threadresult_t)0);
 }
 
+/*
+ * Benchmark: each thread takes and releases the lock 'iterations' times,
+ * for writing in 'writes' out of every 1000 iterations and for reading
+ * otherwise.
+ */
+#define BENCH_MAXTHREADS	64
+
+static isc_mutex_t start_lock;
+static unsigned int iterations = 1000000;
+static unsigned int writes = 0;
+static volatile unsigned int shared_value;
+static volatile unsigned int sink;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+bench_run(void *arg) {
+	unsigned int i, v = 0;
+
+	UNUSED(arg);
+
+	/* Wait for the start signal. */
+	LOCK(&start_lock);
+	UNLOCK(&start_lock);
+
+	for (i = 0; i < iterations; i++) {
+		if (i % 1000 < writes) {
+			RUNTIME_CHECK(isc_rwlock_lock(&lock,
+						      isc_rwlocktype_write) ==
+				      ISC_R_SUCCESS);
+			shared_value++;
+			RUNTIME_CHECK(isc_rwlock_unlock(&lock,
+							isc_rwlocktype_write) ==
+				      ISC_R_SUCCESS);
+		} else {
+			RUNTIME_CHECK(isc_rwlock_lock(&lock,
+						      isc_rwlocktype_read) ==
+				      ISC_R_SUCCESS);
+			v += shared_value;
+			RUNTIME_CHECK(isc_rwlock_unlock(&lock,
+							isc_rwlocktype_read) ==
+				      ISC_R_SUCCESS);
+		}
+	}
+
+	sink = v;
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+bench(unsigned int maxthreads) {
+	isc_thread_t workers[BENCH_MAXTHREADS];
+	isc_time_t start, finish;
+	isc_uint64_t usec;
+	double ops;
+	unsigned int nthreads, i;
+	int bias;
+
+	RUNTIME_CHECK(isc_mutex_init(&start_lock) == ISC_R_SUCCESS);
+
+	printf("%u iterations per thread, %u writes per 1000\n",
+	       iterations, writes);
+	printf("%-8s %7s %14s %14s\n", "lock", "threads", "ops/s",
+	       "ops/s/thread");
+
+	for (bias = 0; bias < 2; bias++) {
+		for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+			RUNTIME_CHECK(isc_rwlock_init(&lock, 0, 0) ==
+				      ISC_R_SUCCESS);
+			isc_rwlock_setreaderbias(&lock, ISC_TF(bias));
+
+			LOCK(&start_lock);
+			for (i = 0; i < nthreads; i++)
+				RUNTIME_CHECK(isc_thread_create(bench_run,
+								NULL,
+								&workers[i]) ==
+					      ISC_R_SUCCESS);
+			RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+			UNLOCK(&start_lock);
+
+			for (i = 0; i < nthreads; i++)
+				(void)isc_thread_join(workers[i], NULL);
+			RUNTIME_CHECK(isc_time_now(&finish) == ISC_R_SUCCESS);
+
+			isc_rwlock_destroy(&lock);
+
+			usec = isc_time_microdiff(&finish, &start);
+			if (usec == 0)
+				usec = 1;
+			ops = (double)iterations * nthreads * 1000000 / usec;
+			printf("%-8s %7u %14.0f %14.0f\n",
+			       bias ? "biased" : "default", nthreads,
+			       ops, ops / nthreads);
+		}
+	}
+
+	DESTROYLOCK(&start_lock);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: rwlock_test [nworkers]\n"
+		"       rwlock_test -b [-i iterations] [-n maxthreads] "
+		"[-w writes-per-1000]\n");
+	exit(1);
+}
+
 int
 main(int argc, char *argv[]) {
 	unsigned int nworkers;
+	unsigned int maxthreads = BENCH_MAXTHREADS;
 	unsigned int i;
 	isc_thread_t workers[100];
 	char name[100];
 	void *dupname;
+	isc_boolean_t benchmark = ISC_FALSE;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "bi:n:w:")) != -1) {
+		switch (ch) {
+		case 'b':
+			benchmark = ISC_TRUE;
+			break;
+		case 'i':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			maxthreads = atoi(isc_commandline_argument);
+			if (maxthreads == 0 || maxthreads > BENCH_MAXTHREADS)
+				maxthreads = BENCH_MAXTHREADS;
+			break;
+		case 'w':
+			writes = atoi(isc_commandline_argument);
+			if (writes > 1000)
+				writes = 1000;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	if (benchmark) {
+		bench(maxthreads);
+		return (0);
+	}
 
-	if (argc > 1)
-		nworkers = atoi(argv[1]);
+	if (argc > 0)
+		nworkers = atoi(argv[0]);
 	else
 		nworkers = 2;
 	if (nworkers > 100)
@@ -9,4 +9,5 @@
 # $Id: clean.sh,v 1.3 2011/09/02 23:46:31 tbox Exp $
 
 rm -rf zones
-rm -f named.conf
+rm -f named.conf zones.list named.pid
+rm -f named.log named.log.*
@@ -9,19 +9,28 @@
 # $Id: setup.sh,v 1.4 2011/09/02 21:15:35 each Exp $
 
 usage () {
-    echo "Usage: $0 [-s] <number of zones> [<records per zone>]"
+    echo "Usage: $0 [-s] [-m] [-v <views>] <number of zones> [<records per zone>]"
     echo "       -s: use the same zone file all zones"
+    echo "       -m: compile the zone files to map format"
+    echo "       -v: serve every zone in this many views"
     exit 1
 }
 
-if [ "$#" -lt 1 -o "$#" -gt 3 ]; then
-    usage
-fi
-
 single_file=""
-if [ $1 = "-s" ]; then
-    single_file=yes
-    shift
+map=""
+nviews=0
+while getopts "smv:" opt; do
+    case $opt in
+    s) single_file=yes ;;
+    m) map=yes ;;
+    v) nviews=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+shift `expr $OPTIND - 1`
+
+if [ "$#" -lt 1 -o "$#" -gt 2 ]; then
+    usage
 fi
 
 nzones=$1
@@ -32,9 +41,13 @@ nrecords=5
 
 . ../system/conf.sh
 
+masterformat=""
+[ $map ] && masterformat="masterfile-format map;"
+
 cat << EOF
 options {
         directory "`pwd`";
+        pid-file "named.pid";
         listen-on { localhost; };
         listen-on-v6 { localhost; };
 	port 5300;
@@ -42,6 +55,7 @@ options {
         allow-transfer { localhost; };
         allow-recursion { none; };
         recursion no;
+        $masterformat
 };
 
 key rndc_key {
@@ -68,12 +82,40 @@ logging {
 
 EOF
 
+#
+# A map file holds the zone's origin, so with -m each zone gets its own
+# map file even with -s.  The views all load the same files.
+#
 $PERL makenames.pl $nzones | while read zonename; do
     if [ $single_file ]; then
-        echo "zone $zonename { type master; file \"smallzone.db\"; };"
+        file=smallzone.db
     else
         [ -d zones ] || mkdir zones
-        $PERL mkzonefile.pl $zonename $nrecords > zones/$zonename.db
-        echo "zone $zonename { type master; file \"zones/$zonename.db\"; };"
+        file=zones/$zonename.db
+        $PERL mkzonefile.pl $zonename $nrecords > $file
     fi
-done
+    if [ $map ]; then
+        [ -d zones ] || mkdir zones
+        $CHECKZONE -D -q -F map -o zones/$zonename.map $zonename $file
+        file=zones/$zonename.map
+    fi
+    echo "$zonename $file"
+done > zones.list
+
+zones () {
+    while read zonename file; do
+        echo "$1zone $zonename { type master; file \"$file\"; };"
+    done < zones.list
+}
+
+if [ "$nviews" -eq 0 ]; then
+    zones ""
+else
+    view=1
+    while [ $view -le $nviews ]; do
+        echo "view view$view {"
+        zones "    "
+        echo "};"
+        view=`expr $view + 1`
+    done
+fi
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#
+# Start named with the named.conf made by setup.sh, wait until all the
+# zones are loaded, and report how long that took and the memory used
+# by named.  named is stopped afterwards.
+#
+
+. ../system/conf.sh
+
+if [ ! -f named.conf ]; then
+    echo "$0: run setup.sh first" >&2
+    exit 1
+fi
+
+now () {
+    $PERL -MTime::HiRes=time -e 'printf("%.3f\n", time)'
+}
+
+rm -f named.log named.log.* named.pid
+
+start=`now`
+$NAMED -c named.conf -f > /dev/null 2>&1 &
+pid=$!
+
+while ! grep "all zones loaded" named.log > /dev/null 2>&1; do
+    if ! $KILL -0 $pid 2> /dev/null; then
+        echo "$0: named exited, see named.log" >&2
+        exit 1
+    fi
+    $PERL -e 'select(undef, undef, undef, 0.1)'
+done
+end=`now`
+
+$PERL -e "printf(\"startup: %.3f seconds\n\", $end - $start)"
+if [ -f /proc/$pid/status ]; then
+    grep -E '^Vm(RSS|HWM):' /proc/$pid/status
+else
+    echo "VmRSS: `ps -o rss= -p $pid` kB"
+fi
+
+$KILL $pid
+wait $pid 2> /dev/null
+exit 0
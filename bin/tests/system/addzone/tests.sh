@@ -100,6 +100,39 @@ n=`expr $n + 1`
 if [ $ret != 0 ]; then echo "I:failed"; fi
 status=`expr $status + $ret`
 
+echo "I:adding several zones in one command ($n)"
+ret=0
+$RNDC -c ../common/rndc.conf -s 10.53.0.2 -p 9953 addzone 'multi1.example { type master; file "added.db"; }; zone multi2.example { type master; file "added.db"; };' 2>&1 | sed 's/^/I:ns2 /'
+for zone in multi1.example multi2.example; do
+    $DIG $DIGOPTS @10.53.0.2 a.$zone a > dig.out.ns2.$zone.$n || ret=1
+    grep 'status: NOERROR' dig.out.ns2.$zone.$n > /dev/null || ret=1
+    grep "^a.$zone" dig.out.ns2.$zone.$n > /dev/null || ret=1
+    if [ -n "$NZD" ]; then
+        $NZD2NZF ns2/_default.nzd | grep "$zone" > /dev/null || ret=1
+    else
+        grep "$zone" ns2/3bf305731dd26307.nzf > /dev/null || ret=1
+    fi
+done
+n=`expr $n + 1`
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:checking a failed zone keeps the other zones of its command from being added ($n)"
+ret=0
+$RNDC -c ../common/rndc.conf -s 10.53.0.2 -p 9953 addzone 'multi3.example { type master; file "added.db"; }; zone multimissing.example { type master; file "missing.db"; };' 2> rndc.out.ns2.$n
+grep "file not found" rndc.out.ns2.$n > /dev/null || ret=1
+grep "no zones were added" rndc.out.ns2.$n > /dev/null || ret=1
+$DIG $DIGOPTS @10.53.0.2 a.multi3.example a > dig.out.ns2.$n || ret=1
+grep 'status: REFUSED' dig.out.ns2.$n > /dev/null || ret=1
+if [ -n "$NZD" ]; then
+    $NZD2NZF ns2/_default.nzd | grep "multi3.example" > /dev/null && ret=1
+else
+    grep "multi3.example" ns2/3bf305731dd26307.nzf > /dev/null && ret=1
+fi
+n=`expr $n + 1`
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
 if [ -z "$NZD" ]; then
     echo "I:verifying no comments in NZF file ($n)"
     ret=0
@@ -607,6 +607,7 @@ static dns_dbmethods_t sampledb_methods = {
 	hashsize,
 	NULL,
 	NULL,
+	NULL,
 };
 
 /* Auxiliary driver functions. */
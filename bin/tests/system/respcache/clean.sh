@@ -0,0 +1,11 @@
+#!/bin/sh
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+rm -f ns1/*.db ns1/*.jnl
+rm -f ns1/named.lock ns1/named.memstats ns1/named.run ns1/named.stats
+rm -f dig.out.* nsupdate.out.*
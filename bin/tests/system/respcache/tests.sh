@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+DIGOPTS="+tcp +nocookie +noadd +nosea +nostat +nocmd +norec -p 5300"
+RNDCCMD="$RNDC -c ../common/rndc.conf -p 9953 -s 10.53.0.1"
+
+status=0
+n=0
+
+# Print the number of responses sent from the response cache so far.
+hits() {
+	rm -f ns1/named.stats
+	$RNDCCMD stats > /dev/null 2>&1
+	sleep 1
+	awk '/responses sent from the response cache/ { n = $1 }
+	     END { print n + 0 }' ns1/named.stats
+}
+
+update() {
+	$NSUPDATE > nsupdate.out.test$n 2>&1 <<END
+server 10.53.0.1 5300
+update delete $1 A
+update add $1 300 A $2
+send
+END
+}
+
+n=`expr $n + 1`
+echo "I:checking that a repeated answer comes from the response cache ($n)"
+ret=0
+before=`hits`
+$DIG $DIGOPTS a.example a @10.53.0.1 > dig.out.1.test$n || ret=1
+$DIG $DIGOPTS a.example a @10.53.0.1 > dig.out.2.test$n || ret=1
+after=`hits`
+grep "^a.example.*10.0.0.1" dig.out.2.test$n > /dev/null || ret=1
+[ $after -gt $before ] || ret=1
+$PERL ../digcomp.pl dig.out.1.test$n dig.out.2.test$n > /dev/null || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking that an update of the zone invalidates its responses ($n)"
+ret=0
+update a.example 10.0.0.2 || ret=1
+$DIG $DIGOPTS a.example a @10.53.0.1 > dig.out.test$n || ret=1
+grep "^a.example.*10.0.0.2" dig.out.test$n > /dev/null || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking that a CNAME within the zone is answered correctly ($n)"
+ret=0
+$DIG $DIGOPTS local.example a @10.53.0.1 > dig.out.1.test$n || ret=1
+$DIG $DIGOPTS local.example a @10.53.0.1 > dig.out.2.test$n || ret=1
+grep "^a.example.*10.0.0.2" dig.out.2.test$n > /dev/null || ret=1
+update a.example 10.0.0.3 || ret=1
+$DIG $DIGOPTS local.example a @10.53.0.1 > dig.out.3.test$n || ret=1
+grep "^a.example.*10.0.0.3" dig.out.3.test$n > /dev/null || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+#
+# The answer stops at the CNAME, as the search is limited to the zone of
+# the query name, but whatever the restart looked at is not known to the
+# response cache.
+#
+n=`expr $n + 1`
+echo "I:checking that a CNAME into another zone is not answered from the response cache ($n)"
+ret=0
+$DIG $DIGOPTS remote.example a @10.53.0.1 > dig.out.1.test$n || ret=1
+before=`hits`
+$DIG $DIGOPTS remote.example a @10.53.0.1 > dig.out.2.test$n || ret=1
+after=`hits`
+grep "^remote.example.*CNAME.*www.other." dig.out.2.test$n > /dev/null || ret=1
+[ $after -eq $before ] || ret=1
+update www.other 10.0.1.2 || ret=1
+$DIG $DIGOPTS remote.example a @10.53.0.1 > dig.out.3.test$n || ret=1
+grep "^remote.example.*CNAME.*www.other." dig.out.3.test$n > /dev/null || ret=1
+grep "10.0.1.1" dig.out.3.test$n > /dev/null && ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:exit status: $status"
+[ $status -eq 0 ] || exit 1
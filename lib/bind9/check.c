@@ -1030,6 +1030,18 @@ check_options(const cfg_obj_t *options, isc_log_t *logctx, isc_mem_t *mctx,
 		}
 	}
 
+	obj = NULL;
+	cfg_map_get(options, "cache-shards", &obj);
+	if (obj != NULL) {
+		isc_uint32_t shards = cfg_obj_asuint32(obj);
+		if (shards == 0 || shards > 64) {
+			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+				    "cache-shards '%u' is out of "
+				    "range (1..64)", shards);
+			result = ISC_R_RANGE;
+		}
+	}
+
 	obj = NULL;
 	cfg_map_get(options, "sig-validity-interval", &obj);
 	if (obj != NULL) {
@@ -40,6 +40,9 @@
 #include <dns/result.h>
 #include <dns/stats.h>
 
+#include "fetchwindow.h"
+#include "hashindex.h"
+
 #define DNS_ADB_MAGIC             ISC_MAGIC('D', 'a', 'd', 'b')
 #define DNS_ADB_VALID(x)          ISC_MAGIC_VALID(x, DNS_ADB_MAGIC)
 #define DNS_ADBNAME_MAGIC         ISC_MAGIC('a', 'd', 'b', 'N')
@@ -65,6 +68,17 @@
 #define ADB_CACHE_MAXIMUM       86400   /*%< seconds (86400 = 24 hours) */
 #define ADB_ENTRY_WINDOW        1800    /*%< seconds */
 
+/*
+ * With adaptive fetch quotas, each server has a window of fetches that
+ * may be outstanding to it.  The window grows by one for each window's
+ * worth of responses that arrive within ADB_WINDOWGRADIENT times the
+ * server's smoothed RTT, and is halved, at most once a second, when a
+ * query to the server times out.  It is never less than one nor more
+ * than fetches-per-server, or ADB_WINDOWMAX if that is zero.
+ */
+#define ADB_WINDOWMAX		1000.0
+#define ADB_WINDOWGRADIENT	2
+
 /*%
  * The period in seconds after which an ADB name entry is regarded as stale
  * and forced to be cleaned up.
@@ -101,7 +115,6 @@ struct dns_adb {
 
 	isc_taskmgr_t                  *taskmgr;
 	isc_task_t                     *task;
-	isc_task_t                     *excl;
 
 	isc_interval_t                  tick_interval;
 	int                             next_cleanbucket;
@@ -126,7 +139,9 @@ struct dns_adb {
 	unsigned int			nnames;
 	isc_mutex_t                     namescntlock;
 	unsigned int			namescnt;
+	unsigned int			namechains; /*%< namescntlock */
 	dns_adbnamelist_t               *names;
+	dns_hashindex_t                 *nameindex;
 	dns_adbnamelist_t               *deadnames;
 	isc_mutex_t                     *namelocks;
 	isc_boolean_t                   *name_sd;
@@ -140,7 +155,9 @@ struct dns_adb {
 	unsigned int			nentries;
 	isc_mutex_t                     entriescntlock;
 	unsigned int			entriescnt;
+	unsigned int			entrychains; /*%< entriescntlock */
 	dns_adbentrylist_t              *entries;
+	dns_hashindex_t                 *entryindex;
 	dns_adbentrylist_t              *deadentries;
 	isc_mutex_t                     *entrylocks;
 	isc_boolean_t                   *entry_sd; /*%< shutting down */
@@ -150,16 +167,13 @@ struct dns_adb {
 	isc_boolean_t                   cevent_out;
 	isc_boolean_t                   shutting_down;
 	isc_eventlist_t                 whenshutdown;
-	isc_event_t			growentries;
-	isc_boolean_t			growentries_sent;
-	isc_event_t			grownames;
-	isc_boolean_t			grownames_sent;
 
 	isc_uint32_t			quota;
 	isc_uint32_t			atr_freq;
 	double				atr_low;
 	double				atr_high;
 	double				atr_discount;
+	isc_boolean_t			adaptive;
 };
 
 /*
@@ -190,6 +204,7 @@ struct dns_adbname {
 	isc_stdtime_t                   last_used;
 
 	ISC_LINK(dns_adbname_t)         plink;
+	dns_hashlink_t                  hlink;
 };
 
 /*% The adbfetch structure */
@@ -252,6 +267,7 @@ struct dns_adbentry {
 	isc_uint32_t			quota;
 	isc_uint32_t			active;
 	double				atr;
+	dns_fetchwindow_t		window;
 
 	/*
 	 * Allow for encapsulated IPv4/IPv6 UDP packet over ethernet.
@@ -276,6 +292,7 @@ struct dns_adbentry {
 
 	ISC_LIST(dns_adblameinfo_t)     lameinfo;
 	ISC_LINK(dns_adbentry_t)        plink;
+	dns_hashlink_t                  hlink;
 };
 
 /*
@@ -345,6 +362,8 @@ static isc_boolean_t kill_name(dns_adbname_t **, isc_eventtype_t);
 static void water(void *, int);
 static void dump_entry(FILE *, dns_adb_t *, dns_adbentry_t *,
 		       isc_boolean_t, isc_stdtime_t);
+static void adjust_window(dns_adb_t *adb, dns_adbentry_t *entry,
+			  unsigned int rtt);
 static void adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt,
 		       unsigned int factor, isc_stdtime_t now);
 static void shutdown_task(isc_task_t *task, isc_event_t *ev);
@@ -525,6 +544,15 @@ inc_adbstats(dns_adb_t *adb, isc_statscounter_t counter) {
 		isc_stats_increment(adb->view->adbstats, counter);
 }
 
+/*%
+ * The largest fetch window of a server: fetches-per-server, or
+ * ADB_WINDOWMAX when that is unlimited.
+ */
+static inline double
+windowmax(dns_adb_t *adb) {
+	return (adb->quota != 0 ? (double)adb->quota : ADB_WINDOWMAX);
+}
+
 static inline dns_ttl_t
 ttlclamp(dns_ttl_t ttl) {
 	if (ttl < ADB_CACHE_MINIMUM)
@@ -536,329 +564,72 @@ ttlclamp(dns_ttl_t ttl) {
 }
 
 /*
- * Hashing is most efficient if the number of buckets is prime.
- * The sequence below is the closest previous primes to 2^n and
- * 1.5 * 2^n, for values of n from 10 to 28.  (The tables will
- * no longer grow beyond 2^28 entries.)
+ * The names and entries are kept in a fixed number of lock buckets.  Each
+ * bucket has an LRU list of its live members and a hash index of them
+ * that grows a bucket at a time, under the bucket's lock only, so lookups
+ * in the other buckets carry on meanwhile.
  */
-static const unsigned nbuckets[] = { 1021, 1531, 2039, 3067, 4093, 6143,
-				     8191, 12281, 16381, 24571, 32749,
-				     49193, 65521, 98299, 131071, 199603,
-				     262139, 393209, 524287, 768431, 1048573,
-				     1572853, 2097143, 3145721, 4194301,
-				     6291449, 8388593, 12582893, 16777213,
-				     25165813, 33554393, 50331599, 67108859,
-				     100663291, 134217689, 201326557,
-				     268535431, 0 };
+#define ADB_NBUCKETS	1021		/* prime */
 
+/*
+ * Requires the name's bucket be locked.
+ */
 static void
-grow_entries(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbentry_t *e;
-	dns_adbentrylist_t *newdeadentries = NULL;
-	dns_adbentrylist_t *newentries = NULL;
-	isc_boolean_t *newentry_sd = NULL;
-	isc_mutex_t *newentrylocks = NULL;
-	isc_result_t result;
-	unsigned int *newentry_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nentries >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_entries to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nentries; i++)
-		if (adb->entry_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newentries = isc_mem_get(adb->mctx, sizeof(*newentries) * n);
-	newdeadentries = isc_mem_get(adb->mctx, sizeof(*newdeadentries) * n);
-	newentrylocks = isc_mem_get(adb->mctx, sizeof(*newentrylocks) * n);
-	newentry_sd = isc_mem_get(adb->mctx, sizeof(*newentry_sd) * n);
-	newentry_refcnt = isc_mem_get(adb->mctx, sizeof(*newentry_refcnt) * n);
-	if (newentries == NULL || newdeadentries == NULL ||
-	    newentrylocks == NULL || newentry_sd == NULL ||
-	    newentry_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newentrylocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newentries[i]);
-		ISC_LIST_INIT(newdeadentries[i]);
-		newentry_sd[i] = ISC_FALSE;
-		newentry_refcnt[i] = 0;
-		adb->irefcnt++;
+hash_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
+	unsigned int added;
+
+	added = dns_hashindex_add(adb->mctx, &adb->nameindex[bucket],
+				  &name->hlink, name,
+				  dns_name_fullhash(&name->name, ISC_FALSE));
+	if (added != 0) {
+		LOCK(&adb->namescntlock);
+		adb->namechains += added;
+		set_adbstat(adb, adb->namechains, dns_adbstats_nnames);
+		UNLOCK(&adb->namescntlock);
 	}
+}
 
-	/*
-	 * Move entries to new arrays.
-	 */
-	for (i = 0; i < adb->nentries; i++) {
-		e = ISC_LIST_HEAD(adb->entries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->entries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, ISC_TRUE) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->entries[i]);
-		}
-		e = ISC_LIST_HEAD(adb->deadentries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->deadentries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, ISC_TRUE) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->deadentries[i]);
-		}
-		INSIST(adb->entry_refcnt[i] == 0);
-		adb->irefcnt--;
+/*
+ * Requires the entry's bucket be locked.
+ */
+static void
+hash_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
+	unsigned int added;
+
+	added = dns_hashindex_add(adb->mctx, &adb->entryindex[bucket],
+				  &entry->hlink, entry,
+				  isc_sockaddr_hash(&entry->sockaddr,
+						    ISC_TRUE));
+	if (added != 0) {
+		LOCK(&adb->entriescntlock);
+		adb->entrychains += added;
+		set_adbstat(adb, adb->entrychains, dns_adbstats_nentries);
+		UNLOCK(&adb->entriescntlock);
 	}
-
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
-	isc_mem_put(adb->mctx, adb->entries,
-		    sizeof(*adb->entries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->deadentries,
-		    sizeof(*adb->deadentries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entrylocks,
-		    sizeof(*adb->entrylocks) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_sd,
-		    sizeof(*adb->entry_sd) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_refcnt,
-		    sizeof(*adb->entry_refcnt) * adb->nentries);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->entries = newentries;
-	adb->deadentries = newdeadentries;
-	adb->entrylocks = newentrylocks;
-	adb->entry_sd = newentry_sd;
-	adb->entry_refcnt = newentry_refcnt;
-	adb->nentries = n;
-
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-
-	/*
-	 * Only on success do we set adb->growentries_sent to ISC_FALSE.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->growentries_sent = ISC_FALSE;
-	goto done;
-
- cleanup:
-	if (newentries != NULL)
-		isc_mem_put(adb->mctx, newentries,
-			    sizeof(*newentries) * n);
-	if (newdeadentries != NULL)
-		isc_mem_put(adb->mctx, newdeadentries,
-			    sizeof(*newdeadentries) * n);
-	if (newentrylocks != NULL)
-		isc_mem_put(adb->mctx, newentrylocks,
-			    sizeof(*newentrylocks) * n);
-	if (newentry_sd != NULL)
-		isc_mem_put(adb->mctx, newentry_sd,
-			    sizeof(*newentry_sd) * n);
-	if (newentry_refcnt != NULL)
-		isc_mem_put(adb->mctx, newentry_refcnt,
-			     sizeof(*newentry_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_entries finished");
 }
 
+/*
+ * Free the bucket indexes.  Called when the adb is destroyed or could
+ * not be created.
+ */
 static void
-grow_names(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbname_t *name;
-	dns_adbnamelist_t *newdeadnames = NULL;
-	dns_adbnamelist_t *newnames = NULL;
-	isc_boolean_t *newname_sd = NULL;
-	isc_mutex_t *newnamelocks = NULL;
-	isc_result_t result;
-	unsigned int *newname_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nnames >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_names to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nnames; i++)
-		if (adb->name_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newnames = isc_mem_get(adb->mctx, sizeof(*newnames) * n);
-	newdeadnames = isc_mem_get(adb->mctx, sizeof(*newdeadnames) * n);
-	newnamelocks = isc_mem_get(adb->mctx, sizeof(*newnamelocks) * n);
-	newname_sd = isc_mem_get(adb->mctx, sizeof(*newname_sd) * n);
-	newname_refcnt = isc_mem_get(adb->mctx, sizeof(*newname_refcnt) * n);
-	if (newnames == NULL || newdeadnames == NULL ||
-	    newnamelocks == NULL || newname_sd == NULL ||
-	    newname_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newnamelocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+free_indexes(dns_adb_t *adb) {
+	unsigned int i;
 
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newnames[i]);
-		ISC_LIST_INIT(newdeadnames[i]);
-		newname_sd[i] = ISC_FALSE;
-		newname_refcnt[i] = 0;
-		adb->irefcnt++;
+	if (adb->nameindex != NULL) {
+		for (i = 0; i < adb->nnames; i++)
+			dns_hashindex_free(adb->mctx, &adb->nameindex[i]);
+		isc_mem_put(adb->mctx, adb->nameindex,
+			    sizeof(*adb->nameindex) * adb->nnames);
+		adb->nameindex = NULL;
 	}
-
-	/*
-	 * Move names to new arrays.
-	 */
-	for (i = 0; i < adb->nnames; i++) {
-		name = ISC_LIST_HEAD(adb->names[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->names[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, ISC_TRUE) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->names[i]);
-		}
-		name = ISC_LIST_HEAD(adb->deadnames[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->deadnames[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, ISC_TRUE) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->deadnames[i]);
-		}
-		INSIST(adb->name_refcnt[i] == 0);
-		adb->irefcnt--;
+	if (adb->entryindex != NULL) {
+		for (i = 0; i < adb->nentries; i++)
+			dns_hashindex_free(adb->mctx, &adb->entryindex[i]);
+		isc_mem_put(adb->mctx, adb->entryindex,
+			    sizeof(*adb->entryindex) * adb->nentries);
+		adb->entryindex = NULL;
 	}
-
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
-	isc_mem_put(adb->mctx, adb->names,
-		    sizeof(*adb->names) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->deadnames,
-		    sizeof(*adb->deadnames) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->namelocks,
-		    sizeof(*adb->namelocks) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_sd,
-		    sizeof(*adb->name_sd) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_refcnt,
-		    sizeof(*adb->name_refcnt) * adb->nnames);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->names = newnames;
-	adb->deadnames = newdeadnames;
-	adb->namelocks = newnamelocks;
-	adb->name_sd = newname_sd;
-	adb->name_refcnt = newname_refcnt;
-	adb->nnames = n;
-
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
-
-	/*
-	 * Only on success do we set adb->grownames_sent to ISC_FALSE.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->grownames_sent = ISC_FALSE;
-	goto done;
-
- cleanup:
-	if (newnames != NULL)
-		isc_mem_put(adb->mctx, newnames, sizeof(*newnames) * n);
-	if (newdeadnames != NULL)
-		isc_mem_put(adb->mctx, newdeadnames, sizeof(*newdeadnames) * n);
-	if (newnamelocks != NULL)
-		isc_mem_put(adb->mctx, newnamelocks, sizeof(*newnamelocks) * n);
-	if (newname_sd != NULL)
-		isc_mem_put(adb->mctx, newname_sd, sizeof(*newname_sd) * n);
-	if (newname_refcnt != NULL)
-		isc_mem_put(adb->mctx, newname_refcnt,
-			     sizeof(*newname_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_names finished");
 }
 
 /*
@@ -1061,6 +832,8 @@ kill_name(dns_adbname_t **n, isc_eventtype_t ev) {
 		if (!NAME_DEAD(name)) {
 			bucket = name->lock_bucket;
 			ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+			dns_hashindex_remove(&adb->nameindex[bucket],
+					     &name->hlink);
 			ISC_LIST_APPEND(adb->deadnames[bucket], name, plink);
 			name->flags |= NAME_IS_DEAD;
 		}
@@ -1125,6 +898,7 @@ link_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
 	INSIST(name->lock_bucket == DNS_ADB_INVALIDBUCKET);
 
 	ISC_LIST_PREPEND(adb->names[bucket], name, plink);
+	hash_name(adb, bucket, name);
 	name->lock_bucket = bucket;
 	adb->name_refcnt[bucket]++;
 }
@@ -1142,8 +916,10 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 
 	if (NAME_DEAD(name))
 		ISC_LIST_UNLINK(adb->deadnames[bucket], name, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+		dns_hashindex_remove(&adb->nameindex[bucket], &name->hlink);
+	}
 	name->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->name_refcnt[bucket] > 0);
 	adb->name_refcnt[bucket]--;
@@ -1173,11 +949,14 @@ link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
 			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
 			e->flags |= ENTRY_IS_DEAD;
 			ISC_LIST_UNLINK(adb->entries[bucket], e, plink);
+			dns_hashindex_remove(&adb->entryindex[bucket],
+					     &e->hlink);
 			ISC_LIST_PREPEND(adb->deadentries[bucket], e, plink);
 		}
 	}
 
 	ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
+	hash_entry(adb, bucket, entry);
 	entry->lock_bucket = bucket;
 	adb->entry_refcnt[bucket]++;
 }
@@ -1195,8 +974,10 @@ unlink_entry(dns_adb_t *adb, dns_adbentry_t *entry) {
 
 	if ((entry->flags & ENTRY_IS_DEAD) != 0)
 		ISC_LIST_UNLINK(adb->deadentries[bucket], entry, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
+		dns_hashindex_remove(&adb->entryindex[bucket], &entry->hlink);
+	}
 	entry->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->entry_refcnt[bucket] > 0);
 	adb->entry_refcnt[bucket]--;
@@ -1695,18 +1476,11 @@ new_adbname(dns_adb_t *adb, const dns_name_t *dnsname) {
 	name->fetch6_err = FIND_ERR_UNEXPECTED;
 	ISC_LIST_INIT(name->finds);
 	ISC_LINK_INIT(name, plink);
+	ISC_LINK_INIT(&name->hlink, link);
 
 	LOCK(&adb->namescntlock);
 	adb->namescnt++;
 	inc_adbstats(adb, dns_adbstats_namescnt);
-	if (!adb->grownames_sent && adb->excl != NULL &&
-	    adb->namescnt > (adb->nnames * 8))
-	{
-		isc_event_t *event = &adb->grownames;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->grownames_sent = ISC_TRUE;
-	}
 	UNLOCK(&adb->namescntlock);
 
 	return (name);
@@ -1842,19 +1616,15 @@ new_adbentry(dns_adb_t *adb) {
 	e->mode = 0;
 	e->quota = adb->quota;
 	e->atr = 0.0;
+	dns_fetchwindow_init(&e->window);
+	if (adb->adaptive)
+		e->quota = dns_fetchwindow_size(&e->window, windowmax(adb));
 	ISC_LIST_INIT(e->lameinfo);
 	ISC_LINK_INIT(e, plink);
+	ISC_LINK_INIT(&e->hlink, link);
 	LOCK(&adb->entriescntlock);
 	adb->entriescnt++;
 	inc_adbstats(adb, dns_adbstats_entriescnt);
-	if (!adb->growentries_sent && adb->excl != NULL &&
-	    adb->entriescnt > (adb->nentries * 8))
-	{
-		isc_event_t *event = &adb->growentries;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->growentries_sent = ISC_TRUE;
-	}
 	UNLOCK(&adb->entriescntlock);
 
 	return (e);
@@ -1885,6 +1655,9 @@ free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 		li = ISC_LIST_HEAD(e->lameinfo);
 	}
 
+	if (e->window.cut != 0)
+		dec_adbstats(adb, dns_adbstats_windowed);
+
 	isc_mempool_put(adb->emp, e);
 	LOCK(&adb->entriescntlock);
 	adb->entriescnt--;
@@ -2042,9 +1815,12 @@ find_name_and_lock(dns_adb_t *adb, const dns_name_t *name,
 		   unsigned int options, int *bucketp)
 {
 	dns_adbname_t *adbname;
+	dns_hashlink_t *hlink;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = dns_name_fullhash(name, ISC_FALSE) % adb->nnames;
+	hashval = dns_name_fullhash(name, ISC_FALSE);
+	bucket = hashval % adb->nnames;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->namelocks[bucket]);
@@ -2055,15 +1831,17 @@ find_name_and_lock(dns_adb_t *adb, const dns_name_t *name,
 		*bucketp = bucket;
 	}
 
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
-	while (adbname != NULL) {
-		if (!NAME_DEAD(adbname)) {
-			if (dns_name_equal(name, &adbname->name)
-			    && GLUEHINT_OK(adbname, options)
-			    && STARTATZONE_MATCHES(adbname, options))
-				return (adbname);
-		}
-		adbname = ISC_LIST_NEXT(adbname, plink);
+	for (hlink = dns_hashindex_first(&adb->nameindex[bucket], hashval);
+	     hlink != NULL;
+	     hlink = ISC_LIST_NEXT(hlink, link))
+	{
+		adbname = hlink->item;
+		INSIST(!NAME_DEAD(adbname));
+		if (hlink->hashval == hashval &&
+		    dns_name_equal(name, &adbname->name) &&
+		    GLUEHINT_OK(adbname, options) &&
+		    STARTATZONE_MATCHES(adbname, options))
+			return (adbname);
 	}
 
 	return (NULL);
@@ -2083,10 +1861,13 @@ static inline dns_adbentry_t *
 find_entry_and_lock(dns_adb_t *adb, const isc_sockaddr_t *addr, int *bucketp,
 	isc_stdtime_t now)
 {
-	dns_adbentry_t *entry, *entry_next;
+	dns_adbentry_t *entry;
+	dns_hashlink_t *hlink, *hlink_next;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = isc_sockaddr_hash(addr, ISC_TRUE) % adb->nentries;
+	hashval = isc_sockaddr_hash(addr, ISC_TRUE);
+	bucket = hashval % adb->nentries;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->entrylocks[bucket]);
@@ -2097,11 +1878,15 @@ find_entry_and_lock(dns_adb_t *adb, const isc_sockaddr_t *addr, int *bucketp,
 		*bucketp = bucket;
 	}
 
-	/* Search the list, while cleaning up expired entries. */
-	for (entry = ISC_LIST_HEAD(adb->entries[bucket]);
-	     entry != NULL;
-	     entry = entry_next) {
-		entry_next = ISC_LIST_NEXT(entry, plink);
+	/*
+	 * Search the entry's chain while cleaning up expired entries.
+	 */
+	for (hlink = dns_hashindex_first(&adb->entryindex[bucket], hashval);
+	     hlink != NULL;
+	     hlink = hlink_next)
+	{
+		hlink_next = ISC_LIST_NEXT(hlink, link);
+		entry = hlink->item;
 		(void)check_expire_entry(adb, &entry, now);
 		if (entry != NULL &&
 		    (entry->expires == 0 || entry->expires > now) &&
@@ -2469,8 +2254,6 @@ destroy(dns_adb_t *adb) {
 	adb->magic = 0;
 
 	isc_task_detach(&adb->task);
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 
 	isc_mempool_destroy(&adb->nmp);
 	isc_mempool_destroy(&adb->nhmp);
@@ -2480,6 +2263,8 @@ destroy(dns_adb_t *adb) {
 	isc_mempool_destroy(&adb->aimp);
 	isc_mempool_destroy(&adb->afmp);
 
+	free_indexes(adb);
+
 	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
 	isc_mem_put(adb->mctx, adb->entries,
 		    sizeof(*adb->entries) * adb->nentries);
@@ -2554,7 +2339,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->aimp = NULL;
 	adb->afmp = NULL;
 	adb->task = NULL;
-	adb->excl = NULL;
 	adb->mctx = NULL;
 	adb->view = view;
 	adb->taskmgr = taskmgr;
@@ -2565,44 +2349,32 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->shutting_down = ISC_FALSE;
 	ISC_LIST_INIT(adb->whenshutdown);
 
-	adb->nentries = nbuckets[0];
+	adb->nentries = ADB_NBUCKETS;
 	adb->entriescnt = 0;
+	adb->entrychains = ADB_NBUCKETS;
 	adb->entries = NULL;
+	adb->entryindex = NULL;
 	adb->deadentries = NULL;
 	adb->entry_sd = NULL;
 	adb->entry_refcnt = NULL;
 	adb->entrylocks = NULL;
-	ISC_EVENT_INIT(&adb->growentries, sizeof(adb->growentries), 0, NULL,
-		       DNS_EVENT_ADBGROWENTRIES, grow_entries, adb,
-		       adb, NULL, NULL);
-	adb->growentries_sent = ISC_FALSE;
 
 	adb->quota = 0;
+	adb->adaptive = ISC_FALSE;
 	adb->atr_freq = 0;
 	adb->atr_low = 0.0;
 	adb->atr_high = 0.0;
 	adb->atr_discount = 0.0;
 
-	adb->nnames = nbuckets[0];
+	adb->nnames = ADB_NBUCKETS;
 	adb->namescnt = 0;
+	adb->namechains = ADB_NBUCKETS;
 	adb->names = NULL;
+	adb->nameindex = NULL;
 	adb->deadnames = NULL;
 	adb->name_sd = NULL;
 	adb->name_refcnt = NULL;
 	adb->namelocks = NULL;
-	ISC_EVENT_INIT(&adb->grownames, sizeof(adb->grownames), 0, NULL,
-		       DNS_EVENT_ADBGROWNAMES, grow_names, adb,
-		       adb, NULL, NULL);
-	adb->grownames_sent = ISC_FALSE;
-
-	result = isc_taskmgr_excltask(adb->taskmgr, &adb->excl);
-	if (result != ISC_R_SUCCESS) {
-		DP(DEF_LEVEL, "adb: task-exclusive mode unavailable, "
-			      "intializing table sizes to %u\n",
-			      nbuckets[11]);
-		adb->nentries = nbuckets[11];
-		adb->nnames = nbuckets[11];
-	}
 
 	isc_mem_attach(mem, &adb->mctx);
 
@@ -2640,6 +2412,9 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 		}\
 	} while (0)
 	ALLOCENTRY(adb, entries);
+	ALLOCENTRY(adb, entryindex);
+	for (i = 0; i < adb->nentries; i++)
+		dns_hashindex_init(&adb->entryindex[i], adb->nentries);
 	ALLOCENTRY(adb, deadentries);
 	ALLOCENTRY(adb, entrylocks);
 	ALLOCENTRY(adb, entry_sd);
@@ -2656,6 +2431,9 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 		}\
 	} while (0)
 	ALLOCNAME(adb, names);
+	ALLOCNAME(adb, nameindex);
+	for (i = 0; i < adb->nnames; i++)
+		dns_hashindex_init(&adb->nameindex[i], adb->nnames);
 	ALLOCNAME(adb, deadnames);
 	ALLOCNAME(adb, namelocks);
 	ALLOCNAME(adb, name_sd);
@@ -2723,8 +2501,8 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (result != ISC_R_SUCCESS)
 		goto fail3;
 
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
+	set_adbstat(adb, adb->entrychains, dns_adbstats_nentries);
+	set_adbstat(adb, adb->namechains, dns_adbstats_nnames);
 
 	/*
 	 * Normal return.
@@ -2744,6 +2522,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
 
  fail1: /* clean up only allocated memory */
+	free_indexes(adb);
 	if (adb->entries != NULL)
 		isc_mem_put(adb->mctx, adb->entries,
 			    sizeof(*adb->entries) * adb->nentries);
@@ -2801,8 +2580,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
  fail0c:
 	DESTROYLOCK(&adb->lock);
  fail0b:
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
 
 	return (result);
@@ -3556,7 +3333,10 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry,
 	if (entry->expires != 0)
 		fprintf(f, " [ttl %d]", entry->expires - now);
 
-	if (adb != NULL && adb->quota != 0 && adb->atr_freq != 0) {
+	if (adb != NULL && adb->adaptive && entry->window.size != 0.0) {
+		fprintf(f, " [window %0.2f] [quota %d]",
+			entry->window.size, entry->quota);
+	} else if (adb != NULL && adb->quota != 0 && adb->atr_freq != 0) {
 		fprintf(f, " [atr %0.2f] [quota %d]",
 			entry->atr, entry->quota);
 	}
@@ -4138,6 +3918,8 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 
 	if (addr->entry->expires == 0 || factor == DNS_ADB_RTTADJAGE)
 		isc_stdtime_get(&now);
+	if (adb->adaptive && factor == DNS_ADB_RTTADJDEFAULT && rtt != 0)
+		adjust_window(adb, addr->entry, rtt);
 	adjustsrtt(addr, rtt, factor, now);
 
 	UNLOCK(&adb->entrylocks[bucket]);
@@ -4232,6 +4014,38 @@ static int quota_adj[] = {
 	312, 307, 303, 298, 294, 290, 286, 282, 278
 };
 
+/*
+ * Caller must hold adbentry lock.  'rtt' is a response time in
+ * microseconds, or zero if the query timed out.
+ */
+static void
+adjust_window(dns_adb_t *adb, dns_adbentry_t *entry, unsigned int rtt) {
+	double max = windowmax(adb);
+	isc_stdtime_t now;
+	unsigned int change;
+
+	if (rtt == 0) {
+		isc_stdtime_get(&now);
+		change = dns_fetchwindow_timeout(&entry->window, max, now);
+		if ((change & DNS_FETCHWINDOW_CLOSED) != 0)
+			inc_adbstats(adb, dns_adbstats_windowed);
+		if ((change & DNS_FETCHWINDOW_CUT) != 0) {
+			inc_adbstats(adb, dns_adbstats_windowcuts);
+			log_quota(entry, "timeout, window decreased to %0.2f",
+				  entry->window.size);
+		}
+	} else if (rtt <= entry->srtt * ADB_WINDOWGRADIENT) {
+		change = dns_fetchwindow_success(&entry->window, max);
+		if ((change & DNS_FETCHWINDOW_OPENED) != 0) {
+			dec_adbstats(adb, dns_adbstats_windowed);
+			log_quota(entry, "window restored to %0.2f",
+				  entry->window.size);
+		}
+	}
+
+	entry->quota = dns_fetchwindow_size(&entry->window, max);
+}
+
 /*
  * Caller must hold adbentry lock
  */
@@ -4241,7 +4055,11 @@ maybe_adjust_quota(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 {
 	double tr;
 
-	UNUSED(adb);
+	if (adb->adaptive) {
+		if (timeout)
+			adjust_window(adb, addr->entry, 0);
+		return;
+	}
 
 	if (adb->quota == 0 || adb->atr_freq == 0)
 		return;
@@ -4690,7 +4508,7 @@ dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 	REQUIRE(name != NULL);
 
 	LOCK(&adb->lock);
-	bucket = dns_name_hash(name, ISC_FALSE) % adb->nnames;
+	bucket = dns_name_fullhash(name, ISC_FALSE) % adb->nnames;
 	LOCK(&adb->namelocks[bucket]);
 	adbname = ISC_LIST_HEAD(adb->names[bucket]);
 	while (adbname != NULL) {
@@ -4786,6 +4604,13 @@ dns_adb_setquota(dns_adb_t *adb, isc_uint32_t quota, isc_uint32_t freq,
 	adb->atr_discount = discount;
 }
 
+void
+dns_adb_setquotaadaptive(dns_adb_t *adb, isc_boolean_t adaptive) {
+	REQUIRE(DNS_ADB_VALID(adb));
+
+	adb->adaptive = adaptive;
+}
+
 isc_boolean_t
 dns_adbentry_overquota(dns_adbentry_t *entry) {
 	isc_boolean_t block;
@@ -12,6 +12,8 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <isc/json.h>
 #include <isc/mem.h>
 #include <isc/print.h>
@@ -160,6 +162,16 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event);
 static void
 overmem_cleaning_action(isc_task_t *task, isc_event_t *event);
 
+/*%
+ * Cache databases of type "sharded" are made of "rbt" databases and
+ * are treated like them.
+ */
+static inline isc_boolean_t
+rbt_based(const char *db_type) {
+	return (ISC_TF(strcmp(db_type, "rbt") == 0 ||
+		       strcmp(db_type, "sharded") == 0));
+}
+
 static inline isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 	return (dns_db_create(cache->mctx, cache->db_type, dns_rootname,
@@ -235,8 +247,9 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	cache->rdclass = rdclass;
 
 	cache->stats = NULL;
-	result = isc_stats_create(cmctx, &cache->stats,
-				  dns_cachestatscounter_max);
+	result = isc_stats_create2(cmctx, &cache->stats,
+				   dns_cachestatscounter_max,
+				   ISC_STATSCREATE_STRIPED);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_filelock;
 
@@ -249,9 +262,10 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	/*
 	 * For databases of type "rbt" we pass hmctx to dns_db_create()
 	 * via cache->db_argv, followed by the rest of the arguments in
-	 * db_argv (of which there really shouldn't be any).
+	 * db_argv (of which there really shouldn't be any, except for the
+	 * number of shards of a "sharded" database).
 	 */
-	if (strcmp(cache->db_type, "rbt") == 0)
+	if (rbt_based(cache->db_type))
 		extra = 1;
 
 	cache->db_argc = db_argc + extra;
@@ -305,7 +319,7 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	 * RBT-type cache DB has its own mechanism of cache cleaning and doesn't
 	 * need the control of the generic cleaner.
 	 */
-	if (strcmp(db_type, "rbt") == 0)
+	if (rbt_based(db_type))
 		result = cache_cleaner_init(cache, NULL, NULL, &cache->cleaner);
 	else {
 		result = cache_cleaner_init(cache, taskmgr, timermgr,
@@ -384,7 +398,7 @@ cache_free(dns_cache_t *cache) {
 		 * as it's a pointer to hmctx
 		 */
 		int extra = 0;
-		if (strcmp(cache->db_type, "rbt") == 0)
+		if (rbt_based(cache->db_type))
 			extra = 1;
 		for (i = extra; i < cache->db_argc; i++)
 			if (cache->db_argv[i] != NULL)
@@ -592,6 +606,17 @@ dns_cache_getname(dns_cache_t *cache) {
 	return (cache->name);
 }
 
+unsigned int
+dns_cache_getshards(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	if (strcmp(cache->db_type, "sharded") != 0)
+		return (1);
+	if (cache->db_argc < 2)
+		return (0);
+	return ((unsigned int)strtoul(cache->db_argv[1], NULL, 10));
+}
+
 /*
  * Initialize the cache cleaner object at *cleaner.
  * Space for the object must be allocated by the caller.
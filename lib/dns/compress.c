@@ -12,13 +12,13 @@
 
 #include <config.h>
 
+#include <isc/buffer.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
-#include <dns/fixedname.h>
-#include <dns/rbt.h>
 #include <dns/result.h>
 
 #define CCTX_MAGIC	ISC_MAGIC('C', 'C', 'T', 'X')
@@ -62,76 +62,6 @@ static unsigned char maptolower[] = {
 	0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
 };
 
-/*
- * The tableindex array below is of size 256, one entry for each
- * unsigned char value. The tableindex array elements are dependent on
- * DNS_COMPRESS_TABLESIZE. The table was created using the following
- * function.
- *
- * static void
- * gentable(unsigned char *table) {
- *         unsigned int i;
- *         const unsigned int left = DNS_COMPRESS_TABLESIZE - 38;
- *         long r;
- *
- *         for (i = 0; i < 26; i++) {
- *                 table['A' + i] = i;
- *                 table['a' + i] = i;
- *         }
- *
- *         for (i = 0; i <= 9; i++)
- *                 table['0' + i] = i + 26;
- *
- *         table['-'] = 36;
- *         table['_'] = 37;
- *
- *         for (i = 0; i < 256; i++) {
- *                 if ((i >= 'a' && i <= 'z') ||
- *                     (i >= 'A' && i <= 'Z') ||
- *                     (i >= '0' && i <= '9') ||
- *                     (i == '-') ||
- *                     (i == '_'))
- *                         continue;
- *                 r = random() % left;
- *                 table[i] = 38 + r;
- *         }
- * }
- */
-static unsigned char tableindex[256] = {
-	0x3e, 0x3e, 0x33, 0x2d, 0x30, 0x38, 0x31, 0x3c,
-	0x2b, 0x33, 0x30, 0x3f, 0x2d, 0x3c, 0x36, 0x3a,
-	0x28, 0x2c, 0x2a, 0x37, 0x3d, 0x34, 0x35, 0x2d,
-	0x39, 0x2b, 0x2f, 0x2c, 0x3b, 0x32, 0x2b, 0x39,
-	0x30, 0x38, 0x28, 0x3c, 0x32, 0x33, 0x39, 0x38,
-	0x27, 0x2b, 0x39, 0x30, 0x27, 0x24, 0x2f, 0x2b,
-	0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21,
-	0x22, 0x3a, 0x29, 0x36, 0x31, 0x3c, 0x35, 0x26,
-	0x31, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x3e, 0x3b, 0x39, 0x2f, 0x25,
-	0x27, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x36, 0x3b, 0x2f, 0x2f, 0x2e,
-	0x29, 0x33, 0x2a, 0x36, 0x28, 0x3f, 0x2e, 0x29,
-	0x2c, 0x29, 0x36, 0x2d, 0x32, 0x3d, 0x33, 0x2a,
-	0x2e, 0x2f, 0x3b, 0x30, 0x3d, 0x39, 0x2b, 0x36,
-	0x2a, 0x2f, 0x2c, 0x26, 0x3a, 0x37, 0x30, 0x3d,
-	0x2a, 0x36, 0x33, 0x2c, 0x38, 0x3d, 0x32, 0x3e,
-	0x26, 0x2a, 0x2c, 0x35, 0x27, 0x39, 0x3b, 0x31,
-	0x2a, 0x37, 0x3c, 0x27, 0x32, 0x29, 0x39, 0x37,
-	0x34, 0x3f, 0x39, 0x2e, 0x38, 0x2b, 0x2c, 0x3e,
-	0x3b, 0x3b, 0x2d, 0x33, 0x3b, 0x3b, 0x32, 0x3d,
-	0x3f, 0x3a, 0x34, 0x26, 0x35, 0x30, 0x31, 0x39,
-	0x27, 0x2f, 0x3d, 0x35, 0x35, 0x36, 0x2e, 0x29,
-	0x38, 0x27, 0x34, 0x32, 0x2c, 0x3c, 0x31, 0x28,
-	0x37, 0x38, 0x37, 0x34, 0x33, 0x29, 0x32, 0x34,
-	0x3f, 0x26, 0x34, 0x34, 0x32, 0x27, 0x30, 0x33,
-	0x33, 0x2d, 0x2b, 0x28, 0x3f, 0x33, 0x2b, 0x39,
-	0x37, 0x39, 0x2c, 0x3d, 0x35, 0x39, 0x27, 0x2f
-};
-
 /***
  ***	Compression
  ***/
@@ -146,7 +76,9 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 	cctx->count = 0;
 	cctx->allowed = DNS_COMPRESS_ENABLED;
 
-	memset(&cctx->table[0], 0, sizeof(cctx->table));
+	memset(cctx->initialtable, 0, sizeof(cctx->initialtable));
+	cctx->table = cctx->initialtable;
+	cctx->mask = DNS_COMPRESS_INITIALSLOTS - 1;
 
 	cctx->magic = CCTX_MAGIC;
 
@@ -155,23 +87,13 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
-
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
-	}
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    (cctx->mask + 1) * sizeof(dns_compressslot_t));
+	cctx->table = NULL;
+	cctx->count = 0;
 
 	cctx->magic = 0;
 	cctx->allowed = 0;
@@ -222,278 +144,252 @@ dns_compress_getedns(dns_compress_t *cctx) {
 }
 
 /*
- * Find the longest match of name in the table.
- * If match is found return ISC_TRUE. prefix, suffix and offset are updated.
- * If no match is found return ISC_FALSE.
+ * The compression table has a slot for each suffix of the names rendered
+ * so far that can be the target of a compression pointer.  A suffix is
+ * identified by its first label and the suffix that follows it: its hash
+ * is the hash of its first label chained onto the hash of the rest, and a
+ * slot matches when the message has that label at the slot's offset,
+ * followed by the suffix already found for the rest of the name.  Names
+ * are looked up from the root one label at a time, so each label is
+ * compared against the message once per candidate slot.
  */
-isc_boolean_t
-dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
-			dns_name_t *prefix, isc_uint16_t *offset)
-{
-	dns_name_t tname;
-	dns_compressnode_t *node = NULL;
-	unsigned int labels, i, n;
-	unsigned int numlabels;
-	unsigned char *p;
 
-	REQUIRE(VALID_CCTX(cctx));
-	REQUIRE(dns_name_isabsolute(name) == ISC_TRUE);
-	REQUIRE(offset != NULL);
+static inline isc_uint32_t
+hashlabel(const unsigned char *label, const isc_uint32_t *previous) {
+	return (isc_hash_function(label, label[0] + 1, ISC_FALSE, previous));
+}
 
-	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
-		return (ISC_FALSE);
+static inline isc_uint16_t
+slothash(isc_uint32_t hash) {
+	return ((isc_uint16_t)(hash ^ (hash >> 16)));
+}
 
-	if (cctx->count == 0)
-		return (ISC_FALSE);
+static inline isc_boolean_t
+matchbytes(const unsigned char *a, const unsigned char *b,
+	   unsigned int length, isc_boolean_t sensitive)
+{
+	if (sensitive)
+		return (ISC_TF(memcmp(a, b, length) == 0));
 
-	labels = dns_name_countlabels(name);
-	INSIST(labels > 0);
+	while (length-- > 0) {
+		if (maptolower[*a++] != maptolower[*b++])
+			return (ISC_FALSE);
+	}
 
-	dns_name_init(&tname, NULL);
+	return (ISC_TRUE);
+}
 
-	numlabels = labels > 3U ? 3U : labels;
-	p = name->ndata;
+/*
+ * Does the message in 'buffer' have the first label of 'suffix' at
+ * 'offset', followed by the rest of 'suffix', which was found at
+ * 'parent' (or is the root if 'parent' is 0)?
+ */
+static isc_boolean_t
+matchsuffix(const isc_buffer_t *buffer, unsigned int offset,
+	    const unsigned char *suffix, unsigned int length,
+	    unsigned int parent, isc_boolean_t sensitive)
+{
+	const unsigned char *msg = isc_buffer_base(buffer);
+	unsigned int used = isc_buffer_usedlength(buffer);
+	unsigned int llen = suffix[0] + 1;
+	unsigned int next = offset + llen;
 
-	for (n = 0; n < numlabels - 1; n++) {
-		unsigned char ch, llen;
-		unsigned int firstoffset, length;
+	if (next > used || msg[offset] != suffix[0] ||
+	    !matchbytes(msg + offset + 1, suffix + 1, llen - 1, sensitive))
+		return (ISC_FALSE);
 
-		firstoffset = p - name->ndata;
-		length = name->length - firstoffset;
+	/*
+	 * The label is followed by the suffix found for the rest of
+	 * the name, a pointer to it, or a copy of the rest of the name.
+	 */
+	if (parent != 0) {
+		if (next == parent)
+			return (ISC_TRUE);
+		if (next + 2 <= used &&
+		    msg[next] == (0xc0 | (parent >> 8)) &&
+		    msg[next + 1] == (parent & 0xff))
+			return (ISC_TRUE);
+	}
 
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of the suffix name.
-		 */
-		ch = p[1];
-		i = tableindex[ch];
-		if (ISC_LIKELY((cctx->allowed &
-				DNS_COMPRESS_CASESENSITIVE) != 0))
-		{
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				if (ISC_LIKELY(memcmp(node->name.ndata,
-						      p, length) == 0))
-					goto found;
-			}
-		} else {
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				unsigned int l, count;
-				unsigned char c;
-				unsigned char *label1, *label2;
-
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				l = labels - n;
-				if (ISC_UNLIKELY(node->name.labels != l))
-					continue;
-
-				label1 = node->name.ndata;
-				label2 = p;
-				while (ISC_LIKELY(l-- > 0)) {
-					count = *label1++;
-					if (count != *label2++)
-						goto cont1;
-
-					/* no bitstring support */
-					INSIST(count <= 63);
-
-					/* Loop unrolled for performance */
-					while (ISC_LIKELY(count > 3)) {
-						c = maptolower[label1[0]];
-						if (c != maptolower[label2[0]])
-							goto cont1;
-						c = maptolower[label1[1]];
-						if (c != maptolower[label2[1]])
-							goto cont1;
-						c = maptolower[label1[2]];
-						if (c != maptolower[label2[2]])
-							goto cont1;
-						c = maptolower[label1[3]];
-						if (c != maptolower[label2[3]])
-							goto cont1;
-						count -= 4;
-						label1 += 4;
-						label2 += 4;
-					}
-					while (ISC_LIKELY(count-- > 0)) {
-						c = maptolower[*label1++];
-						if (c != maptolower[*label2++])
-							goto cont1;
-					}
-				}
-				break;
- cont1:
-				continue;
-			}
-		}
+	length -= llen;
+	return (ISC_TF(next + length <= used &&
+		       matchbytes(msg + next, suffix + llen, length,
+				  sensitive)));
+}
 
-		if (node != NULL)
-			break;
+static isc_boolean_t
+growtable(dns_compress_t *cctx) {
+	dns_compressslot_t *table;
+	unsigned int i, j, mask;
 
-		llen = *p;
-		p += llen + 1;
+	mask = (cctx->mask << 1) | 1;
+	table = isc_mem_get(cctx->mctx, (mask + 1) * sizeof(*table));
+	if (table == NULL)
+		return (ISC_FALSE);
+	memset(table, 0, (mask + 1) * sizeof(*table));
+
+	for (i = 0; i <= cctx->mask; i++) {
+		if (cctx->table[i].offset == 0)
+			continue;
+		j = cctx->table[i].hash & mask;
+		while (table[j].offset != 0)
+			j = (j + 1) & mask;
+		table[j] = cctx->table[i];
 	}
 
- found:
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    (cctx->mask + 1) * sizeof(*table));
+	cctx->table = table;
+	cctx->mask = mask;
+
+	return (ISC_TRUE);
+}
+
+static void
+addslot(dns_compress_t *cctx, isc_uint16_t hash, isc_uint16_t offset) {
+	unsigned int i;
+
 	/*
-	 * If node == NULL, we found no match at all.
+	 * Keep the table at most 3/4 full.  Offsets are below 0x4000, so
+	 * a table of 0x8000 slots never needs to grow, and the 16 bit
+	 * hash is enough to index it.
 	 */
-	if (node == NULL)
-		return (ISC_FALSE);
-
-	if (n == 0)
-		dns_name_reset(prefix);
-	else
-		dns_name_getlabelsequence(name, 0, n, prefix);
+	if ((cctx->count + 1) * 4 > (cctx->mask + 1) * 3 && !growtable(cctx))
+		return;
 
-	*offset = (node->offset & 0x7fff);
-	return (ISC_TRUE);
+	i = hash & cctx->mask;
+	while (cctx->table[i].offset != 0)
+		i = (i + 1) & cctx->mask;
+	cctx->table[i].hash = hash;
+	cctx->table[i].offset = offset;
+	cctx->count++;
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
+/*
+ * Empty slot 'i', moving later slots of the same probe sequences back
+ * so that they can still be found.
+ */
+static void
+removeslot(dns_compress_t *cctx, unsigned int i) {
+	unsigned int j, k;
+
+	for (j = (i + 1) & cctx->mask;
+	     cctx->table[j].offset != 0;
+	     j = (j + 1) & cctx->mask)
+	{
+		k = cctx->table[j].hash & cctx->mask;
+		if ((j > i && (k <= i || k > j)) ||
+		    (j < i && k <= i && k > j))
+		{
+			cctx->table[i] = cctx->table[j];
+			i = j;
+		}
+	}
+
+	cctx->table[i].hash = 0;
+	cctx->table[i].offset = 0;
+	cctx->count--;
 }
 
 void
-dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
-		 const dns_name_t *prefix, isc_uint16_t offset)
+dns_compress_name(dns_compress_t *cctx, const isc_buffer_t *buffer,
+		  const dns_name_t *name, isc_boolean_t compress,
+		  unsigned int *prefix, isc_uint16_t *offset)
 {
-	dns_name_t tname, xname;
-	unsigned int start;
-	unsigned int n;
-	unsigned int count;
-	unsigned int i;
-	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
-	isc_uint16_t toffset;
-	unsigned char *tmp;
-	isc_region_t r;
+	const unsigned char *label;
+	unsigned int labels, i, j, needed, parent;
+	isc_uint32_t hash = 0, h;
+	isc_boolean_t sensitive;
 
 	REQUIRE(VALID_CCTX(cctx));
+	REQUIRE(ISC_BUFFER_VALID(buffer));
 	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(name->offsets != NULL);
+	REQUIRE(prefix != NULL && offset != NULL);
+
+	*prefix = name->length;
+	*offset = 0;
 
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
-	if (offset >= 0x4000)
-		return;
-	dns_name_init(&tname, NULL);
-	dns_name_init(&xname, NULL);
-
-	n = dns_name_countlabels(name);
-	count = dns_name_countlabels(prefix);
-	if (dns_name_isabsolute(prefix))
-		count--;
-	if (count == 0)
-		return;
-	start = 0;
-	dns_name_toregion(name, &r);
-	length = r.length;
-	tmp = isc_mem_get(cctx->mctx, length);
-	if (tmp == NULL)
-		return;
+	sensitive = ISC_TF((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0);
+	labels = name->labels;
+
 	/*
-	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
+	 * Find the longest suffix already in the message, starting from
+	 * the root.  Afterwards label 'i' starts the suffix, which is at
+	 * 'parent' in the message, or 'i' is the root label and 'parent'
+	 * is 0.
 	 */
-	memmove(tmp, r.base, r.length);
-	r.base = tmp;
-	dns_name_fromregion(&xname, &r);
-
-	if (count > 2U)
-		count = 2U;
-
-	while (count > 0) {
-		unsigned char ch;
-
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of tname.
-		 */
-		ch = tname.ndata[1];
-		i = tableindex[ch];
-		tlength = name_length(&tname);
-		toffset = (isc_uint16_t)(offset + (length - tlength));
-		if (toffset >= 0x4000)
-			break;
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
+	parent = 0;
+	for (i = labels - 1; i > 0; i--) {
+		label = name->ndata + name->offsets[i - 1];
+		h = hashlabel(label, (i == labels - 1) ? NULL : &hash);
+		for (j = slothash(h) & cctx->mask;
+		     cctx->table[j].offset != 0;
+		     j = (j + 1) & cctx->mask)
+		{
+			if (cctx->table[j].hash == slothash(h) &&
+			    matchsuffix(buffer, cctx->table[j].offset, label,
+					name->length - name->offsets[i - 1],
+					parent, sensitive))
 				break;
 		}
-		node->count = cctx->count++;
-		/*
-		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
-		 */
-		if (start == 0)
-			toffset |= 0x8000;
-		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		dns_name_init(&node->name, NULL);
-		node->name.length = node->r.length;
-		node->name.ndata = node->r.base;
-		node->name.labels = tname.labels;
-		node->name.attributes = DNS_NAMEATTR_ABSOLUTE;
-		node->next = cctx->table[i];
-		cctx->table[i] = node;
-		start++;
-		n--;
-		count--;
+		if (cctx->table[j].offset == 0)
+			break;
+		hash = h;
+		parent = cctx->table[j].offset;
 	}
 
-	if (start == 0)
-		isc_mem_put(cctx->mctx, tmp, length);
+	if (compress && parent != 0) {
+		*prefix = name->offsets[i];
+		*offset = parent;
+		needed = *prefix + 2;
+	} else
+		needed = name->length;
+
+	/*
+	 * Add the labels in front of the suffix, provided the caller
+	 * can write them.
+	 */
+	if (isc_buffer_availablelength(buffer) < needed)
+		return;
+
+	for (; i > 0; i--) {
+		unsigned int coff;
+
+		label = name->ndata + name->offsets[i - 1];
+		hash = hashlabel(label, (i == labels - 1) ? NULL : &hash);
+		coff = isc_buffer_usedlength(buffer) + name->offsets[i - 1];
+		if (coff != 0 && coff < 0x4000)
+			addslot(cctx, slothash(hash), (isc_uint16_t)coff);
+	}
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
 	unsigned int i;
-	dns_compressnode_t *node;
 
 	REQUIRE(VALID_CCTX(cctx));
 
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
-		}
+	if (offset == 0) {
+		memset(cctx->table, 0,
+		       (cctx->mask + 1) * sizeof(dns_compressslot_t));
+		cctx->count = 0;
+		return;
+	}
+
+	i = 0;
+	while (i <= cctx->mask && cctx->count > 0) {
+		if (cctx->table[i].offset >= offset)
+			removeslot(cctx, i);
+		else
+			i++;
 	}
 }
 
@@ -54,6 +54,7 @@ struct dns_dbimplementation {
 
 #include "rbtdb.h"
 #include "rbtdb64.h"
+#include "shardeddb.h"
 
 static ISC_LIST(dns_dbimplementation_t) implementations;
 static isc_rwlock_t implock;
@@ -61,6 +62,7 @@ static isc_once_t once = ISC_ONCE_INIT;
 
 static dns_dbimplementation_t rbtimp;
 static dns_dbimplementation_t rbt64imp;
+static dns_dbimplementation_t shardedimp;
 
 static void
 initialize(void) {
@@ -78,9 +80,16 @@ initialize(void) {
 	rbt64imp.driverarg = NULL;
 	ISC_LINK_INIT(&rbt64imp, link);
 
+	shardedimp.name = "sharded";
+	shardedimp.create = dns_shardeddb_create;
+	shardedimp.mctx = NULL;
+	shardedimp.driverarg = NULL;
+	ISC_LINK_INIT(&shardedimp, link);
+
 	ISC_LIST_INIT(implementations);
 	ISC_LIST_APPEND(implementations, &rbtimp, link);
 	ISC_LIST_APPEND(implementations, &rbt64imp, link);
+	ISC_LIST_APPEND(implementations, &shardedimp, link);
 }
 
 static inline dns_dbimplementation_t *
@@ -1016,6 +1025,21 @@ dns_db_getsize(dns_db_t *db, dns_dbversion_t *version, isc_uint64_t *records,
 	return (ISC_R_NOTFOUND);
 }
 
+isc_result_t
+dns_db_getversionid(dns_db_t *db, dns_dbversion_t *version,
+		    isc_uint64_t *idp)
+{
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iszone(db) == ISC_TRUE);
+	REQUIRE(version != NULL);
+	REQUIRE(idp != NULL);
+
+	if (db->methods->getversionid != NULL)
+		return ((db->methods->getversionid)(db, version, idp));
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 dns_db_setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 		      isc_stdtime_t resign)
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/util.h>
+
+#include "fetchwindow.h"
+
+/*
+ * Open 'window' to 'max' if it has not been used.
+ */
+static inline void
+use(dns_fetchwindow_t *window, double max) {
+	if (window->size == 0.0)
+		window->size = max;
+}
+
+void
+dns_fetchwindow_init(dns_fetchwindow_t *window) {
+	REQUIRE(window != NULL);
+
+	window->size = 0.0;
+	window->cut = 0;
+}
+
+unsigned int
+dns_fetchwindow_size(dns_fetchwindow_t *window, double max) {
+	REQUIRE(window != NULL);
+	REQUIRE(max >= 1.0);
+
+	use(window, max);
+	return ((unsigned int)window->size);
+}
+
+unsigned int
+dns_fetchwindow_timeout(dns_fetchwindow_t *window, double max,
+			isc_stdtime_t now)
+{
+	unsigned int change = DNS_FETCHWINDOW_CUT;
+
+	REQUIRE(window != NULL);
+	REQUIRE(max >= 1.0);
+	REQUIRE(now != 0);
+
+	use(window, max);
+	if (window->cut == now)
+		return (0);
+	if (window->cut == 0)
+		change |= DNS_FETCHWINDOW_CLOSED;
+
+	window->cut = now;
+	window->size = ISC_MAX(ISC_MIN(window->size, max) / 2, 1.0);
+
+	return (change);
+}
+
+unsigned int
+dns_fetchwindow_success(dns_fetchwindow_t *window, double max) {
+	REQUIRE(window != NULL);
+	REQUIRE(max >= 1.0);
+
+	use(window, max);
+	window->size += 1.0 / window->size;
+	if (window->size < max)
+		return (0);
+
+	window->size = max;
+	if (window->cut == 0)
+		return (0);
+
+	window->cut = 0;
+	return (DNS_FETCHWINDOW_OPENED);
+}
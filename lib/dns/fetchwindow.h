@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_FETCHWINDOW_H
+#define DNS_FETCHWINDOW_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file
+ * \brief
+ * The window of an adaptive fetch quota, as kept by the ADB for each
+ * server and by the resolver for each zone.
+ *
+ * A window grows additively, by one for each window's worth of
+ * successes, and shrinks multiplicatively, being halved on a timeout but
+ * no more than once a second.  It is never less than one nor more than
+ * the maximum passed by the caller, which may change over the life of
+ * the window.  A window that has not been used yet has a size of zero
+ * and starts out fully open, at the maximum.
+ *
+ * A window is "closed" from the first time it is halved until it has
+ * grown back to the maximum; callers keep a gauge of closed windows
+ * from the changes reported by dns_fetchwindow_timeout() and
+ * dns_fetchwindow_success(), and must take a window that is freed while
+ * closed, which has a non-zero 'cut', off the gauge themselves.
+ *
+ * MP:
+ *\li	The caller must serialize access to a window.
+ */
+
+#include <isc/lang.h>
+#include <isc/stdtime.h>
+#include <isc/types.h>
+
+/*%
+ * Changes to a window reported by dns_fetchwindow_timeout() and
+ * dns_fetchwindow_success().
+ */
+#define DNS_FETCHWINDOW_CUT	0x01	/*%< the window was halved */
+#define DNS_FETCHWINDOW_CLOSED	0x02	/*%< ... having been fully open */
+#define DNS_FETCHWINDOW_OPENED	0x04	/*%< it is fully open again */
+
+typedef struct {
+	double			size;	/*%< zero until first used */
+	isc_stdtime_t		cut;	/*%< last halved, or zero if open */
+} dns_fetchwindow_t;
+
+ISC_LANG_BEGINDECLS
+
+void
+dns_fetchwindow_init(dns_fetchwindow_t *window);
+/*%<
+ * Initialize 'window' as unused.
+ */
+
+unsigned int
+dns_fetchwindow_size(dns_fetchwindow_t *window, double max);
+/*%<
+ * The number of fetches 'window' currently allows, opening it to 'max'
+ * first if it has not been used.
+ *
+ * Requires:
+ *\li	'max' >= 1.
+ */
+
+unsigned int
+dns_fetchwindow_timeout(dns_fetchwindow_t *window, double max,
+			isc_stdtime_t now);
+/*%<
+ * Halve 'window', no further than one, after a timeout at 'now', unless
+ * it was already halved during that second.
+ *
+ * Requires:
+ *\li	'max' >= 1.
+ *\li	'now' != 0.
+ *
+ * Returns:
+ *\li	DNS_FETCHWINDOW_CUT, with DNS_FETCHWINDOW_CLOSED if the window
+ *	was fully open, if the window was halved; otherwise 0.
+ */
+
+unsigned int
+dns_fetchwindow_success(dns_fetchwindow_t *window, double max);
+/*%<
+ * Grow 'window' by the reciprocal of its size, no further than 'max',
+ * after a success.
+ *
+ * Requires:
+ *\li	'max' >= 1.
+ *
+ * Returns:
+ *\li	DNS_FETCHWINDOW_OPENED if the window was closed and has grown back
+ *	to 'max'; otherwise 0.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_FETCHWINDOW_H */
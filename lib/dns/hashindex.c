@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include "hashindex.h"
+
+#define HASHCHAIN(index, hashval, size) \
+	(((hashval) / (index)->nbuckets) & ((size) - 1))
+
+void
+dns_hashindex_init(dns_hashindex_t *index, unsigned int nbuckets) {
+	REQUIRE(index != NULL);
+	REQUIRE(nbuckets > 0);
+
+	index->nbuckets = nbuckets;
+	index->size = 1;
+	index->count = 0;
+	ISC_LIST_INIT(index->chain);
+	index->chains = &index->chain;
+}
+
+void
+dns_hashindex_free(isc_mem_t *mctx, dns_hashindex_t *index) {
+	REQUIRE(index != NULL);
+
+	if (index->chains != &index->chain)
+		isc_mem_put(mctx, index->chains,
+			    sizeof(*index->chains) * index->size);
+	index->chains = &index->chain;
+	index->size = 1;
+	ISC_LIST_INIT(index->chain);
+}
+
+/*
+ * Move the members of 'index' to a table of 'size' chains.
+ */
+static isc_boolean_t
+grow(isc_mem_t *mctx, dns_hashindex_t *index, unsigned int size) {
+	dns_hashchain_t *chains;
+	dns_hashlink_t *hlink;
+	unsigned int i;
+
+	chains = isc_mem_get(mctx, sizeof(*chains) * size);
+	if (chains == NULL)
+		return (ISC_FALSE);
+	for (i = 0; i < size; i++)
+		ISC_LIST_INIT(chains[i]);
+
+	for (i = 0; i < index->size; i++) {
+		while ((hlink = ISC_LIST_HEAD(index->chains[i])) != NULL) {
+			ISC_LIST_UNLINK(index->chains[i], hlink, link);
+			ISC_LIST_APPEND(chains[HASHCHAIN(index, hlink->hashval,
+							 size)],
+					hlink, link);
+		}
+	}
+
+	dns_hashindex_free(mctx, index);
+	index->chains = chains;
+	index->size = size;
+
+	return (ISC_TRUE);
+}
+
+unsigned int
+dns_hashindex_add(isc_mem_t *mctx, dns_hashindex_t *index,
+		  dns_hashlink_t *hlink, void *item, unsigned int hashval)
+{
+	unsigned int oldsize, i;
+
+	REQUIRE(index != NULL);
+	REQUIRE(hlink != NULL && !ISC_LINK_LINKED(hlink, link));
+
+	oldsize = index->size;
+	index->count++;
+	if (index->count > index->size * DNS_HASHINDEX_LOAD &&
+	    index->size < DNS_HASHINDEX_MAX)
+		(void)grow(mctx, index,
+			   ISC_MAX(index->size * 2, DNS_HASHINDEX_MIN));
+
+	hlink->item = item;
+	hlink->hashval = hashval;
+	i = HASHCHAIN(index, hashval, index->size);
+	ISC_LIST_PREPEND(index->chains[i], hlink, link);
+
+	return (index->size - oldsize);
+}
+
+void
+dns_hashindex_remove(dns_hashindex_t *index, dns_hashlink_t *hlink) {
+	unsigned int i;
+
+	REQUIRE(index != NULL);
+	REQUIRE(hlink != NULL && ISC_LINK_LINKED(hlink, link));
+	INSIST(index->count > 0);
+
+	index->count--;
+	i = HASHCHAIN(index, hlink->hashval, index->size);
+	ISC_LIST_UNLINK(index->chains[i], hlink, link);
+}
+
+dns_hashlink_t *
+dns_hashindex_first(dns_hashindex_t *index, unsigned int hashval) {
+	REQUIRE(index != NULL);
+
+	return (ISC_LIST_HEAD(index->chains[HASHCHAIN(index, hashval,
+						      index->size)]));
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_HASHINDEX_H
+#define DNS_HASHINDEX_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file
+ * \brief
+ * A growable hash index of the members of one lock bucket of a table
+ * that spreads its members over a fixed number of buckets by hash value,
+ * such as the names and entries of the ADB and the fetch contexts of the
+ * resolver.
+ *
+ * An index starts with a single chain kept in the index itself.  When
+ * its members outnumber its chains by more than DNS_HASHINDEX_LOAD, the
+ * number of chains is raised to DNS_HASHINDEX_MIN and then doubled, up
+ * to DNS_HASHINDEX_MAX; an index is never shrunk.  The chain of a
+ * member is chosen by the quotient of its hash value by the number of
+ * buckets, whose low order bits are independent of the bucket, which is
+ * the remainder.
+ *
+ * Members embed a dns_hashlink_t, which points back to them.  An index
+ * refers to itself while it has one chain, so it must not be copied.
+ *
+ * MP:
+ *\li	The caller must serialize access to an index, normally with the
+ *	lock of its bucket.  Growing an index only affects that index.
+ */
+
+#include <isc/lang.h>
+#include <isc/list.h>
+#include <isc/types.h>
+
+#define DNS_HASHINDEX_MIN	8
+#define DNS_HASHINDEX_MAX	(1U << 16)
+#define DNS_HASHINDEX_LOAD	4
+
+typedef struct dns_hashlink dns_hashlink_t;
+typedef ISC_LIST(dns_hashlink_t) dns_hashchain_t;
+
+struct dns_hashlink {
+	void				*item;
+	unsigned int			hashval;
+	ISC_LINK(dns_hashlink_t)	link;
+};
+
+typedef struct {
+	unsigned int			nbuckets;
+	unsigned int			size;	/*%< a power of 2 */
+	unsigned int			count;
+	dns_hashchain_t			*chains;
+	dns_hashchain_t			chain;	/*%< while 'size' is 1 */
+} dns_hashindex_t;
+
+ISC_LANG_BEGINDECLS
+
+void
+dns_hashindex_init(dns_hashindex_t *index, unsigned int nbuckets);
+/*%<
+ * Initialize 'index' as an empty index of one of 'nbuckets' buckets.
+ */
+
+void
+dns_hashindex_free(isc_mem_t *mctx, dns_hashindex_t *index);
+/*%<
+ * Free the chains of 'index', which were allocated from 'mctx'.  Its
+ * members are not touched.
+ */
+
+unsigned int
+dns_hashindex_add(isc_mem_t *mctx, dns_hashindex_t *index,
+		  dns_hashlink_t *hlink, void *item, unsigned int hashval);
+/*%<
+ * Add 'item', whose hash value is 'hashval', to 'index' through its
+ * link 'hlink'.  The index is grown first if it is full, with memory
+ * from 'mctx'; if that fails, it keeps its size.
+ *
+ * Returns the number of chains added to the index.
+ */
+
+void
+dns_hashindex_remove(dns_hashindex_t *index, dns_hashlink_t *hlink);
+/*%<
+ * Remove the member linked by 'hlink' from 'index'.
+ */
+
+dns_hashlink_t *
+dns_hashindex_first(dns_hashindex_t *index, unsigned int hashval);
+/*%<
+ * The first link on the chain of 'hashval' in 'index'; the rest of the
+ * chain follows through the links' 'link' fields.  Members of the chain
+ * may have other hash values.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_HASHINDEX_H */
@@ -806,6 +806,21 @@ dns_adb_setquota(dns_adb_t *adb, isc_uint32_t quota, isc_uint32_t freq,
  *\li	'adb' is valid.
  */
 
+void
+dns_adb_setquotaadaptive(dns_adb_t *adb, isc_boolean_t adaptive);
+/*%<
+ * Turn adaptive fetch quotas on or off.  While they are on, each address
+ * has a window of fetches that grows by one for every window's worth of
+ * responses that arrive within twice the address's smoothed RTT, and is
+ * halved, at most once a second, when a query to it times out.  The
+ * window replaces the timeout ratio adjustments described for
+ * dns_adb_setquota(), and never exceeds the baseline quota, or 1000 if
+ * that is zero.
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ */
+
 isc_boolean_t
 dns_adbentry_overquota(dns_adbentry_t *entry);
 /*%<
@@ -81,6 +81,10 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
  * dns_cache_create() is a backward compatible version that internally
  * specifies an empty cache name and a single memory context.
  *
+ * A 'db_type' of "sharded" spreads the cache over a number of "rbt"
+ * databases; 'db_argv[0]', if present, is the number of databases as a
+ * decimal string.
+ *
  * Requires:
  *
  *\li	'cmctx' (and 'hmctx' if applicable) is a valid memory context.
@@ -244,6 +248,14 @@ dns_cache_getname(dns_cache_t *cache);
  * Get the cache name.
  */
 
+unsigned int
+dns_cache_getshards(dns_cache_t *cache);
+/*%<
+ * Get the number of databases a "sharded" cache was asked to use: 0 if
+ * the number was not given, so that there is one per CPU.  Caches of
+ * any other type have one database.
+ */
+
 void
 dns_cache_setcachesize(dns_cache_t *cache, size_t size);
 /*%<
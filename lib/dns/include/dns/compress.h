@@ -9,6 +9,7 @@
 #ifndef DNS_COMPRESS_H
 #define DNS_COMPRESS_H 1
 
+#include <isc/buffer.h>
 #include <isc/lang.h>
 #include <isc/region.h>
 
@@ -39,22 +40,18 @@ ISC_LANG_BEGINDECLS
 #define DNS_COMPRESS_ENABLED		0x04
 
 /*
- * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
- * utilizes this assumption.
+ * The compression table is an open-addressed hash table of the suffixes
+ * of the names rendered so far.  It starts out in the compression context
+ * itself with DNS_COMPRESS_INITIALSLOTS slots (a power of 2) and doubles
+ * from the memory context as the message grows.
  */
-#define DNS_COMPRESS_TABLEBITS 6
-#define DNS_COMPRESS_TABLESIZE (1U << DNS_COMPRESS_TABLEBITS)
-#define DNS_COMPRESS_TABLEMASK (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 16
-
-typedef struct dns_compressnode dns_compressnode_t;
-
-struct dns_compressnode {
-	dns_compressnode_t	*next;
-	isc_uint16_t		offset;
-	isc_uint16_t		count;
-	isc_region_t            r;
-	dns_name_t              name;
+#define DNS_COMPRESS_INITIALSLOTS	64
+
+typedef struct dns_compressslot dns_compressslot_t;
+
+struct dns_compressslot {
+	isc_uint16_t		hash;		/*%< Hash of the suffix. */
+	isc_uint16_t		offset;		/*%< 0 if the slot is free. */
 };
 
 struct dns_compress {
@@ -62,10 +59,11 @@ struct dns_compress {
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
 	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
-	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
-	isc_uint16_t		count;		/*%< Number of nodes. */
+	dns_compressslot_t	*table;
+	unsigned int		mask;		/*%< Table size - 1. */
+	unsigned int		count;		/*%< Number of suffixes. */
+	/*% Initial table. */
+	dns_compressslot_t	initialtable[DNS_COMPRESS_INITIALSLOTS];
 	isc_mem_t		*mctx;		/*%< Memory context. */
 };
 
@@ -178,40 +176,33 @@ dns_compress_getedns(dns_compress_t *cctx);
  *\li		-1 .. 255
  */
 
-isc_boolean_t
-dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
-			dns_name_t *prefix, isc_uint16_t *offset);
-/*%<
- *	Finds longest possible match of 'name' in the global compression table.
- *
- *	Requires:
- *\li		'cctx' to be initialized.
- *\li		'name' to be a absolute name.
- *\li		'prefix' to be initialized.
- *\li		'offset' to point to an isc_uint16_t.
- *
- *	Ensures:
- *\li		'prefix' and 'offset' are valid if ISC_TRUE is 	returned.
- *
- *	Returns:
- *\li		#ISC_TRUE / #ISC_FALSE
- */
-
 void
-dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
-		 const dns_name_t *prefix, isc_uint16_t offset);
+dns_compress_name(dns_compress_t *cctx, const isc_buffer_t *buffer,
+		  const dns_name_t *name, isc_boolean_t compress,
+		  unsigned int *prefix, isc_uint16_t *offset);
 /*%<
- *	Add compression pointers for 'name' to the compression table,
- *	not replacing existing pointers.
+ *	Find the longest suffix of 'name' that has already been rendered
+ *	into 'buffer', and prepare to render 'name' at the end of it.
  *
- *	Requires:
- *\li		'cctx' initialized
+ *	If 'compress' is true and a suffix was found, '*prefix' is set to
+ *	the length of the labels of 'name' in front of the suffix and
+ *	'*offset' to the offset of the suffix in 'buffer'; the caller
+ *	should write those labels followed by a pointer to the suffix.
+ *	Otherwise '*prefix' is set to the length of 'name', '*offset' to 0,
+ *	and the caller should write the whole name.
  *
- *\li		'name' must be initialized and absolute, and must remain
- *		valid until the message compression is complete.
+ *	If there is room in 'buffer' for what the caller is to write, the
+ *	labels of 'name' that were not found are added to the compression
+ *	table on the assumption that they are written at the current end
+ *	of 'buffer'.  Suffixes found in the table are checked against the
+ *	contents of 'buffer', so 'name' does not need to remain valid.
  *
- *\li		'prefix' must be a prefix returned by
- *		dns_compress_findglobal(), or the same as 'name'.
+ *	Requires:
+ *\li		'cctx' to be initialized.
+ *\li		'buffer' to hold the message being rendered, starting at
+ *		its base.
+ *\li		'name' to be an absolute name with an offsets table.
+ *\li		'prefix' and 'offset' to be non NULL.
  */
 
 void
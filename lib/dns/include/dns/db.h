@@ -189,6 +189,8 @@ typedef struct dns_dbmethods {
 					dns_name_t *name);
 	isc_result_t	(*getsize)(dns_db_t *db, dns_dbversion_t *version,
 				   isc_uint64_t *records, isc_uint64_t *bytes);
+	isc_result_t	(*getversionid)(dns_db_t *db, dns_dbversion_t *version,
+					isc_uint64_t *idp);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -1520,6 +1522,25 @@ dns_db_getsize(dns_db_t *db, dns_dbversion_t *version, isc_uint64_t *records,
  * \li	#ISC_R_NOTIMPLEMENTED
  */
 
+isc_result_t
+dns_db_getversionid(dns_db_t *db, dns_dbversion_t *version,
+		    isc_uint64_t *idp);
+/*%<
+ * Get a number identifying 'version' of 'db'.  No other version of any
+ * zone database in the process has the same number, so it changes
+ * whenever the contents of the zone may have, and can be remembered
+ * without holding a reference to either the version or the database.
+ *
+ * Requires:
+ * \li	'db' is a valid zone database.
+ * \li	'version' is a valid version.
+ * \li	'idp' != NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
 isc_result_t
 dns_db_findnsec3node(dns_db_t *db, const dns_name_t *name,
 		     isc_boolean_t create, dns_dbnode_t **nodep);
@@ -123,6 +123,11 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The dispatcher gets its own socket bound with SO_REUSEPORT, so
+ *	that several dispatchers can listen on the same address and port.
+ *	An existing dispatcher is never reused for such a request.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -134,6 +139,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
@@ -262,7 +268,11 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 		    dns_dispatch_t **dispp, dns_dispatch_t *dup);
 /*%<
  * Attach to existing dns_dispatch_t if one is found with dns_dispatchmgr_find,
- * otherwise create a new UDP dispatch.
+ * otherwise create a new UDP dispatch.  If 'dup' is not NULL, the new
+ * dispatch uses a duplicate of its socket.  If DNS_DISPATCHATTR_REUSEPORT
+ * is set in 'attributes', a new dispatch with its own SO_REUSEPORT socket
+ * is always created; ISC_R_NOTIMPLEMENTED is returned if the system does
+ * not support it.
  *
  * Requires:
  *\li	All pointer parameters be valid for their respective types.
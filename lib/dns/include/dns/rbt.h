@@ -153,6 +153,7 @@ struct dns_rbtnode {
 	 * separate region of memory.
 	 */
 	void *data;
+	void *typeindex;
 	unsigned int :0;                /* start of bitfields c/o node lock */
 	unsigned int dirty:1;
 	unsigned int wild:1;
@@ -736,16 +737,42 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 			 dns_rbtdeleter_t deleter, void *deleter_arg,
 			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
 			 dns_rbtnode_t **originp, dns_rbt_t **rbtp);
+
+isc_result_t
+dns_rbt_deserialize_tree2(void *base_address, size_t filesize,
+			  off_t header_offset, isc_boolean_t verify,
+			  isc_mem_t *mctx,
+			  dns_rbtdeleter_t deleter, void *deleter_arg,
+			  dns_rbtdatafixer_t datafixer, void *fixer_arg,
+			  dns_rbtnode_t **originp, dns_rbt_t **rbtp);
 /*%<
  * Read a RBT structure and its data from a file.
  *
  * If 'originp' is not NULL, then it is pointed to the root node of the RBT.
  *
+ * dns_rbt_deserialize_tree2() only checks the checksum of the image if
+ * 'verify' is ISC_TRUE; otherwise 'datafixer' is called with a NULL
+ * 'crc'.  The structure of the tree is checked either way.
+ * dns_rbt_deserialize_tree() always checks the checksum.
+ *
  * Notes:
  * \li  The file must be an actual file which allows seek() calls, so it cannot
  *      be a stream.  This condition is not checked in the code.
  */
 
+isc_result_t
+dns_rbt_imagecrc(void *base_address, size_t filesize, off_t header_offset,
+		 isc_uint64_t *crcp);
+/*%<
+ * Get the checksum recorded in the header of the RBT image at
+ * 'header_offset' in the 'filesize' bytes at 'base_address'.  The
+ * checksum is not checked against the image.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_INVALIDFILE	the header does not fit in the file
+ */
+
 void
 dns_rbt_printtext(dns_rbt_t *rbt,
 		  void (*data_printer)(FILE *, void *), FILE *f);
@@ -560,6 +560,20 @@ dns_resolver_setclientsperquery(dns_resolver_t *resolver,
 void
 dns_resolver_setfetchesperzone(dns_resolver_t *resolver, isc_uint32_t clients);
 
+void
+dns_resolver_setzonequotaadaptive(dns_resolver_t *resolver,
+				  isc_boolean_t adaptive);
+/*%<
+ * Turn adaptive fetches-per-zone quotas on or off.  While they are on,
+ * each zone has a window of fetches that grows by one for every
+ * window's worth of fetches that succeed, and is halved, at most once a
+ * second, when a fetch fails after its queries timed out.  The window
+ * never exceeds the fetches-per-zone limit, or 1000 if that is zero.
+ *
+ * Requires:
+ * \li	'resolver' to be valid.
+ */
+
 void
 dns_resolver_getclientsperquery(dns_resolver_t *resolver, isc_uint32_t *cur,
 				isc_uint32_t *min, isc_uint32_t *max);
@@ -690,6 +704,17 @@ dns_resolver_getquotaresponse(dns_resolver_t *resolver, dns_quotatype_t which);
 void
 dns_resolver_dumpfetches(dns_resolver_t *resolver,
 			 isc_statsformat_t format, FILE *fp);
+/*%<
+ * Dump the number of fetches active for each domain, followed by a
+ * comment line for each fetch context bucket that has been used, giving
+ * its current and largest number of fetch contexts, the size of its hash
+ * index and how many lookups, joins and creations it has handled.
+ *
+ * Requires:
+ * \li	'resolver' to be valid.
+ * \li	'format' to be isc_statsformat_file.
+ * \li	'fp' to be non NULL.
+ */
 
 
 #ifdef ENABLE_AFL
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * A cache of rendered responses to queries answered from zone databases.
+ *
+ * A response is stored under its question, a set of caller defined flags
+ * describing everything else in the query that the response depends on
+ * (e.g. the DO bit or the transport), and the advertised UDP buffer size.
+ * It is only valid for the version of the zone database it was built
+ * from, which the cache remembers by its dns_db_getversionid() number
+ * rather than by holding a reference to it.  A lookup made with any
+ * other version (after a reload, a transfer or an update of the zone)
+ * does not find the response, and discards it.  Responses from databases
+ * that do not number their versions are not stored.
+ *
+ * A cached response is returned with the message ID and the question
+ * name of the new query patched in; nothing else is changed.  Owner
+ * names compressed against the question name therefore take the case of
+ * the new question name.
+ *
+ * The cache is split into a number of independently locked stripes.
+ * Each stripe discards its least recently used responses when it holds
+ * more than its share of the configured size.
+ *
+ * MP:
+ *\li	The cache does its own locking.
+ */
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef struct dns_respcache dns_respcache_t;
+
+typedef struct dns_respcachekey {
+	const dns_name_t *	qname;
+	dns_rdatatype_t		qtype;
+	dns_rdataclass_t	qclass;
+	unsigned int		flags;
+	isc_uint16_t		udpsize;
+} dns_respcachekey_t;
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t maxsize,
+		     dns_respcache_t **rcp);
+/*%<
+ * Create a response cache holding up to 'maxsize' bytes of responses.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	maxsize > 0
+ *\li	rcp != NULL && *rcp == NULL
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp);
+/*%<
+ * Free the cache and everything in it.
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		   dns_db_t *db, dns_dbversion_t *version,
+		   dns_messageid_t id, isc_buffer_t *target);
+/*%<
+ * Look for the response to 'key' built from version 'version' of 'db',
+ * and if there is one, copy it to 'target' with its message ID set to
+ * 'id' and its question name set to key->qname.
+ *
+ * Requires:
+ *\li	'rc' is a valid response cache.
+ *\li	key->qname is an absolute name.
+ *\li	'db' is a zone database and 'version' is an open version of it.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ *\li	#ISC_R_NOSPACE		the response does not fit in 'target'
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		  dns_db_t *db, dns_dbversion_t *version,
+		  const isc_region_t *response);
+/*%<
+ * Store 'response', the rendered response to 'key' built from version
+ * 'version' of 'db', replacing any response already stored for 'key'.
+ * Responses too large to be worth caching are silently ignored.
+ *
+ * Requires:
+ *\li	'rc' is a valid response cache.
+ *\li	key->qname is an absolute name, and is the question name of
+ *	'response'.
+ *\li	'db' is a zone database and 'version' is an open version of it.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *rc);
+/*%<
+ * Discard every response.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
@@ -66,7 +66,9 @@ enum {
 	dns_resstatscounter_zonequota = 41,
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
-	dns_resstatscounter_max = 44,
+	dns_resstatscounter_zonewindowed = 44,
+	dns_resstatscounter_zonewindowcuts = 45,
+	dns_resstatscounter_max = 46,
 
 	/*
 	 * DNSSEC stats.
@@ -104,8 +106,10 @@ enum {
 	dns_adbstats_entriescnt = 1,
 	dns_adbstats_nnames = 2,
 	dns_adbstats_namescnt = 3,
+	dns_adbstats_windowed = 4,
+	dns_adbstats_windowcuts = 5,
 
-	dns_adbstats_max = 4,
+	dns_adbstats_max = 6,
 
 	/*
 	 * Cache statistics values.
@@ -237,6 +241,14 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+dns_rdatatypestats_create2(isc_mem_t *mctx, dns_stats_t **statsp,
+			   unsigned int options);
+/*%<
+ * Like dns_rdatatypestats_create(), with 'options' passed to
+ * isc_stats_create2().
+ */
+
 isc_result_t
 dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
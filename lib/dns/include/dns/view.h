@@ -65,6 +65,7 @@
 #include <dns/clientinfo.h>
 #include <dns/dnstap.h>
 #include <dns/fixedname.h>
+#include <dns/respcache.h>
 #include <dns/rrl.h>
 #include <dns/rdatastruct.h>
 #include <dns/rpz.h>
@@ -140,6 +141,7 @@ struct dns_view {
 	dns_rbt_t *			denyanswernames;
 	dns_rbt_t *			answernames_exclude;
 	dns_rrl_t *			rrl;
+	dns_respcache_t *		respcache;
 	isc_boolean_t			provideixfr;
 	isc_boolean_t			requestnsid;
 	isc_boolean_t			sendcookie;
@@ -128,6 +128,8 @@ typedef enum {
 #define DNS_ZONESTATE_ANY		4
 #define DNS_ZONESTATE_AUTOMATIC		5
 
+#define DNS_ZONE_CONFIGHASHLEN		20	/*%< see dns_zone_setconfighash */
+
 ISC_LANG_BEGINDECLS
 
 /***
@@ -2210,6 +2212,29 @@ dns_zone_getadded(dns_zone_t *zone);
  * \li	'zone' to be valid.
  */
 
+void
+dns_zone_setconfighash(dns_zone_t *zone, const unsigned char *hash);
+/*%
+ * Record the DNS_ZONE_CONFIGHASHLEN byte 'hash' of the configuration
+ * 'zone' has just been configured with, or forget the recorded hash
+ * if 'hash' is NULL.  The hash is not interpreted; it lets a server
+ * tell that reconfiguring the zone would leave it unchanged.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
+isc_boolean_t
+dns_zone_confighashequal(dns_zone_t *zone, const unsigned char *hash);
+/*%
+ * Returns ISC_TRUE if 'hash' is the configuration hash recorded for
+ * 'zone' by dns_zone_setconfighash().
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ * \li	'hash' to be non NULL.
+ */
+
 void
 dns_zone_setautomatic(dns_zone_t *zone, isc_boolean_t automatic);
 /*%
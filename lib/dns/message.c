@@ -830,6 +830,185 @@ findname(dns_name_t **foundname, const dns_name_t *target,
 	return (ISC_R_NOTFOUND);
 }
 
+/*%
+ * While a section is parsed, each record's owner name is looked up among
+ * the names already in the section and then its type among the name's
+ * rdatasets.  Once the section holds more than INDEX_THRESHOLD names, a
+ * hash index of the names and of their rdatasets replaces the linear
+ * searches of findname() and dns_message_find(), so that the cost of
+ * parsing a large transfer, update or referral grows linearly with the
+ * number of records.
+ */
+#define INDEX_THRESHOLD		8
+
+typedef struct {
+	dns_name_t *		name;
+	dns_rdataset_t *	rdataset;
+} sectionindex_rds_t;
+
+typedef struct {
+	isc_mem_t *		mctx;
+	unsigned int		bits;
+	dns_name_t **		names;
+	sectionindex_rds_t *	rdatasets;
+} sectionindex_t;
+
+#define INDEX_SIZE(idx)		(1U << (idx)->bits)
+#define INDEX_MASK(idx)		(INDEX_SIZE(idx) - 1)
+
+static void
+sectionindex_init(sectionindex_t *idx) {
+	idx->mctx = NULL;
+	idx->bits = 0;
+	idx->names = NULL;
+	idx->rdatasets = NULL;
+}
+
+static inline isc_boolean_t
+sectionindex_active(sectionindex_t *idx) {
+	return (ISC_TF(idx->names != NULL));
+}
+
+static inline unsigned int
+sectionindex_rdshash(sectionindex_t *idx, const dns_name_t *name,
+		     dns_rdatatype_t type, dns_rdatatype_t covers)
+{
+	isc_uint32_t h;
+
+	/*
+	 * Owner names are unique within the section once indexed, so the
+	 * rdatasets are keyed by the address of their owner name.
+	 */
+	h = (isc_uint32_t)((size_t)name >> 4);
+	h ^= ((isc_uint32_t)type << 16) | covers;
+	h *= 0x9e3779b1U;
+
+	return ((h >> (32 - idx->bits)) & INDEX_MASK(idx));
+}
+
+static void
+sectionindex_addname(sectionindex_t *idx, dns_name_t *name) {
+	unsigned int i;
+
+	i = dns_name_fullhash(name, ISC_FALSE) & INDEX_MASK(idx);
+	while (idx->names[i] != NULL)
+		i = (i + 1) & INDEX_MASK(idx);
+	idx->names[i] = name;
+}
+
+static dns_name_t *
+sectionindex_findname(sectionindex_t *idx, const dns_name_t *target) {
+	dns_name_t *curr;
+	unsigned int i;
+
+	i = dns_name_fullhash(target, ISC_FALSE) & INDEX_MASK(idx);
+	while ((curr = idx->names[i]) != NULL) {
+		if (dns_name_equal(curr, target))
+			return (curr);
+		i = (i + 1) & INDEX_MASK(idx);
+	}
+
+	return (NULL);
+}
+
+static void
+sectionindex_addrdataset(sectionindex_t *idx, dns_name_t *name,
+			 dns_rdataset_t *rdataset)
+{
+	unsigned int i;
+
+	i = sectionindex_rdshash(idx, name, rdataset->type, rdataset->covers);
+	while (idx->rdatasets[i].name != NULL)
+		i = (i + 1) & INDEX_MASK(idx);
+	idx->rdatasets[i].name = name;
+	idx->rdatasets[i].rdataset = rdataset;
+}
+
+static dns_rdataset_t *
+sectionindex_findrdataset(sectionindex_t *idx, const dns_name_t *name,
+			  dns_rdataclass_t rdclass, dns_rdatatype_t type,
+			  dns_rdatatype_t covers)
+{
+	sectionindex_rds_t *curr;
+	unsigned int i;
+
+	i = sectionindex_rdshash(idx, name, type, covers);
+	for (curr = &idx->rdatasets[i];
+	     curr->name != NULL;
+	     curr = &idx->rdatasets[i])
+	{
+		if (curr->name == name && curr->rdataset->rdclass == rdclass &&
+		    curr->rdataset->type == type &&
+		    curr->rdataset->covers == covers)
+			return (curr->rdataset);
+		i = (i + 1) & INDEX_MASK(idx);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Index the names and rdatasets already in 'section'.  'maxentries' is
+ * the largest number of names or rdatasets the section can end up with;
+ * the tables are sized to stay at most half full.  On failure the index
+ * stays inactive and the caller falls back to the linear searches.
+ */
+static void
+sectionindex_build(sectionindex_t *idx, isc_mem_t *mctx,
+		   dns_namelist_t *section, unsigned int maxentries)
+{
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	unsigned int bits = 4;
+
+	REQUIRE(!sectionindex_active(idx));
+
+	while ((1U << bits) < maxentries * 2)
+		bits++;
+
+	idx->bits = bits;
+	idx->names = isc_mem_get(mctx, INDEX_SIZE(idx) * sizeof(dns_name_t *));
+	if (idx->names == NULL) {
+		sectionindex_init(idx);
+		return;
+	}
+	idx->rdatasets = isc_mem_get(mctx, INDEX_SIZE(idx) *
+				     sizeof(sectionindex_rds_t));
+	if (idx->rdatasets == NULL) {
+		isc_mem_put(mctx, idx->names,
+			    INDEX_SIZE(idx) * sizeof(dns_name_t *));
+		sectionindex_init(idx);
+		return;
+	}
+	memset(idx->names, 0, INDEX_SIZE(idx) * sizeof(dns_name_t *));
+	memset(idx->rdatasets, 0, INDEX_SIZE(idx) * sizeof(sectionindex_rds_t));
+	isc_mem_attach(mctx, &idx->mctx);
+
+	for (name = ISC_LIST_HEAD(*section);
+	     name != NULL;
+	     name = ISC_LIST_NEXT(name, link))
+	{
+		sectionindex_addname(idx, name);
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+			sectionindex_addrdataset(idx, name, rdataset);
+	}
+}
+
+static void
+sectionindex_free(sectionindex_t *idx) {
+	if (!sectionindex_active(idx))
+		return;
+
+	isc_mem_put(idx->mctx, idx->names,
+		    INDEX_SIZE(idx) * sizeof(dns_name_t *));
+	isc_mem_put(idx->mctx, idx->rdatasets,
+		    INDEX_SIZE(idx) * sizeof(sectionindex_rds_t));
+	isc_mem_detach(&idx->mctx);
+	sectionindex_init(idx);
+}
+
 isc_result_t
 dns_message_find(const dns_name_t *name, dns_rdataclass_t rdclass,
 		 dns_rdatatype_t type, dns_rdatatype_t covers,
@@ -1231,12 +1410,15 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	isc_boolean_t free_name = ISC_FALSE, free_rdataset = ISC_FALSE;
 	isc_boolean_t preserve_order, best_effort, seen_problem;
 	isc_boolean_t issigzero;
+	sectionindex_t index;
+	unsigned int names = 0;
 
 	preserve_order = ISC_TF(options & DNS_MESSAGEPARSE_PRESERVEORDER);
 	best_effort = ISC_TF(options & DNS_MESSAGEPARSE_BESTEFFORT);
 	seen_problem = ISC_FALSE;
 
 	section = &msg->sections[sectionid];
+	sectionindex_init(&index);
 
 	for (count = 0; count < msg->counts[sectionid]; count++) {
 		int recstart = source->current;
@@ -1247,8 +1429,10 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		free_rdataset = ISC_FALSE;
 
 		name = isc_mempool_get(msg->namepool);
-		if (name == NULL)
-			return (ISC_R_NOMEMORY);
+		if (name == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
 		free_name = ISC_TRUE;
 
 		offsets = newoffsets(msg);
@@ -1470,16 +1654,38 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			 * allocated name since we no longer need it, and set
 			 * our name pointer to point to the name we found.
 			 */
-			result = findname(&name2, name, section);
+			if (sectionindex_active(&index)) {
+				name2 = sectionindex_findname(&index, name);
+				result = (name2 != NULL) ? ISC_R_SUCCESS :
+							   ISC_R_NOTFOUND;
+			} else
+				result = findname(&name2, name, section);
 
 			/*
-			 * If it is a new name, append to the section.
+			 * If it is a new name, append to the section, and
+			 * once the section is large enough start indexing it.
+			 * Every remaining record takes at least 11 octets,
+			 * which bounds the number of names and rdatasets the
+			 * index will have to hold.
 			 */
 			if (result == ISC_R_SUCCESS) {
 				isc_mempool_put(msg->namepool, name);
 				name = name2;
 			} else {
 				ISC_LIST_APPEND(*section, name, link);
+				if (sectionindex_active(&index))
+					sectionindex_addname(&index, name);
+				else if (++names > INDEX_THRESHOLD) {
+					unsigned int left, room;
+
+					left = msg->counts[sectionid] - count;
+					room = isc_buffer_remaininglength(source);
+					if (left > room / 11)
+						left = room / 11;
+					sectionindex_build(&index, msg->mctx,
+							   section,
+							   count + 1 + left);
+				}
 			}
 			free_name = ISC_FALSE;
 		}
@@ -1500,8 +1706,18 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 				DO_ERROR(DNS_R_FORMERR);
 
 			rdataset = NULL;
-			result = dns_message_find(name, rdclass, rdtype,
-						   covers, &rdataset);
+			if (sectionindex_active(&index)) {
+				rdataset = sectionindex_findrdataset(&index,
+								     name,
+								     rdclass,
+								     rdtype,
+								     covers);
+				result = (rdataset != NULL) ? ISC_R_SUCCESS :
+							      ISC_R_NOTFOUND;
+			} else
+				result = dns_message_find(name, rdclass,
+							  rdtype, covers,
+							  &rdataset);
 		}
 
 		/*
@@ -1558,6 +1774,9 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			{
 				ISC_LIST_APPEND(name->list, rdataset, link);
 				free_rdataset = ISC_FALSE;
+				if (sectionindex_active(&index))
+					sectionindex_addrdataset(&index, name,
+								 rdataset);
 			}
 		}
 
@@ -1639,6 +1858,8 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	    !auth_signed(section))
 		DO_ERROR(DNS_R_FORMERR);
 
+	sectionindex_free(&index);
+
 	if (seen_problem)
 		return (DNS_R_RECOVERABLE);
 	return (ISC_R_SUCCESS);
@@ -1648,6 +1869,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		isc_mempool_put(msg->namepool, name);
 	if (free_rdataset)
 		isc_mempool_put(msg->rdspool, rdataset);
+	sectionindex_free(&index);
 
 	return (result);
 }
@@ -4334,7 +4556,7 @@ dns_message_buildopt(dns_message_t *message, dns_rdataset_t **rdatasetp,
 	 * Set EDNS options if applicable
 	 */
 	if (count != 0U) {
-		isc_buffer_t *buf = NULL;
+		isc_buffer_t *buf;
 		isc_boolean_t seenpad = ISC_FALSE;
 		for (i = 0; i < count; i++)
 			len += ednsopts[i].length + 4;
@@ -4344,9 +4566,20 @@ dns_message_buildopt(dns_message_t *message, dns_rdataset_t **rdatasetp,
 			goto cleanup;
 		}
 
-		result = isc_buffer_allocate(message->mctx, &buf, len);
-		if (result != ISC_R_SUCCESS)
-			goto cleanup;
+		/*
+		 * Build the options in the scratch space, which lives as
+		 * long as the rest of the message data, rather than in a
+		 * buffer of their own.
+		 */
+		buf = currentbuffer(message);
+		if (isc_buffer_availablelength(buf) < len) {
+			result = newbuffer(message,
+					   ISC_MAX(len, SCRATCHPAD_SIZE));
+			if (result != ISC_R_SUCCESS)
+				goto cleanup;
+			buf = currentbuffer(message);
+		}
+		rdata->data = isc_buffer_used(buf);
 
 		for (i = 0; i < count; i++)  {
 			if (ednsopts[i].code == DNS_OPT_PAD &&
@@ -4366,9 +4599,7 @@ dns_message_buildopt(dns_message_t *message, dns_rdataset_t **rdatasetp,
 			isc_buffer_putuint16(buf, DNS_OPT_PAD);
 			isc_buffer_putuint16(buf, 0);
 		}
-		rdata->data = isc_buffer_base(buf);
 		rdata->length = len;
-		dns_message_takebuffer(message, &buf);
 		if (seenpad)
 			message->padding_off = len;
 	} else {
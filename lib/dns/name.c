@@ -105,6 +105,241 @@ static unsigned char maptolower[] = {
 #define CONVERTTOASCII(c)
 #define CONVERTFROMASCII(c)
 
+/*
+ * Case folding kernels.
+ *
+ * Only the octets 'A' to 'Z' change when a name is downcased, and label
+ * length octets are never in that range, so whole names (not just their
+ * labels) can be folded and compared in one pass.  On x86 the SSE2 or
+ * AVX2 version is chosen at run time; the scalar versions handle short
+ * runs and other platforms.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__GNUC__) && !defined(__clang__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+     (defined(__clang__) && \
+      (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))))
+#define NAME_USESIMD 1
+#include <immintrin.h>
+#endif
+
+static inline unsigned int
+fold_mismatch_scalar(const unsigned char *a, const unsigned char *b,
+		     unsigned int length)
+{
+	unsigned int i = 0;
+
+	/* Loop unrolled for performance */
+	while (ISC_LIKELY(i + 4 <= length)) {
+		if (maptolower[a[i]] != maptolower[b[i]])
+			return (i);
+		if (maptolower[a[i + 1]] != maptolower[b[i + 1]])
+			return (i + 1);
+		if (maptolower[a[i + 2]] != maptolower[b[i + 2]])
+			return (i + 2);
+		if (maptolower[a[i + 3]] != maptolower[b[i + 3]])
+			return (i + 3);
+		i += 4;
+	}
+	while (ISC_LIKELY(i < length)) {
+		if (maptolower[a[i]] != maptolower[b[i]])
+			return (i);
+		i++;
+	}
+
+	return (length);
+}
+
+static inline void
+fold_copy_scalar(unsigned char *dst, const unsigned char *src,
+		 unsigned int length)
+{
+	while (length-- > 0)
+		*dst++ = maptolower[*src++];
+}
+
+#ifdef NAME_USESIMD
+static isc_once_t simd_once = ISC_ONCE_INIT;
+static isc_boolean_t simd_initialized = ISC_FALSE;
+static enum { simd_none, simd_sse2, simd_avx2 } simd_level = simd_none;
+
+static void
+simd_initialize(void) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		simd_level = simd_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		simd_level = simd_sse2;
+	simd_initialized = ISC_TRUE;
+}
+
+/*
+ * Adding 0x80 - 'A' moves 'A'..'Z' to the bottom of the signed range,
+ * where a single signed comparison picks them out.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+fold_sse2(__m128i v) {
+	__m128i t = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - 'A')));
+	__m128i upper = _mm_cmplt_epi8(t, _mm_set1_epi8((char)(0x80 + 26)));
+
+	return (_mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+
+__attribute__((target("sse2")))
+static unsigned int
+fold_mismatch_sse2(const unsigned char *a, const unsigned char *b,
+		   unsigned int length)
+{
+	unsigned int i, mask;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m128i va, vb;
+
+		va = fold_sse2(_mm_loadu_si128((const __m128i *)(a + i)));
+		vb = fold_sse2(_mm_loadu_si128((const __m128i *)(b + i)));
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffff;
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+
+	return (i + fold_mismatch_scalar(a + i, b + i, length - i));
+}
+
+__attribute__((target("sse2")))
+static void
+fold_copy_sse2(unsigned char *dst, const unsigned char *src,
+	       unsigned int length)
+{
+	unsigned int i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), fold_sse2(v));
+	}
+
+	fold_copy_scalar(dst + i, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+fold_avx2(__m256i v) {
+	__m256i t = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - 'A')));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)),
+					  t);
+
+	return (_mm256_or_si256(v, _mm256_and_si256(upper,
+						    _mm256_set1_epi8(0x20))));
+}
+
+__attribute__((target("avx2")))
+static unsigned int
+fold_mismatch_avx2(const unsigned char *a, const unsigned char *b,
+		   unsigned int length)
+{
+	unsigned int i, mask;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		__m256i va, vb;
+
+		va = fold_avx2(_mm256_loadu_si256((const __m256i *)(a + i)));
+		vb = fold_avx2(_mm256_loadu_si256((const __m256i *)(b + i)));
+		mask = ~(unsigned int)_mm256_movemask_epi8(
+					_mm256_cmpeq_epi8(va, vb));
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+
+	/*
+	 * Finish here rather than in the SSE2 version: mixing legacy SSE
+	 * and AVX instructions is slow.
+	 */
+	if (i + 16 <= length) {
+		__m128i va, vb;
+
+		va = fold_sse2(_mm_loadu_si128((const __m128i *)(a + i)));
+		vb = fold_sse2(_mm_loadu_si128((const __m128i *)(b + i)));
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffff;
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+		i += 16;
+	}
+
+	return (i + fold_mismatch_scalar(a + i, b + i, length - i));
+}
+
+__attribute__((target("avx2")))
+static void
+fold_copy_avx2(unsigned char *dst, const unsigned char *src,
+	       unsigned int length)
+{
+	unsigned int i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), fold_avx2(v));
+	}
+
+	if (i + 16 <= length) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), fold_sse2(v));
+		i += 16;
+	}
+
+	fold_copy_scalar(dst + i, src + i, length - i);
+}
+#endif /* NAME_USESIMD */
+
+/*
+ * Return the offset of the first octet at which 'a' and 'b' differ
+ * when case is ignored, or 'length' if they do not.
+ */
+static inline unsigned int
+fold_mismatch(const unsigned char *a, const unsigned char *b,
+	      unsigned int length)
+{
+#ifdef NAME_USESIMD
+	if (length >= 16) {
+		if (ISC_UNLIKELY(!simd_initialized))
+			RUNTIME_CHECK(isc_once_do(&simd_once,
+						  simd_initialize) ==
+				      ISC_R_SUCCESS);
+		if (simd_level == simd_avx2)
+			return (fold_mismatch_avx2(a, b, length));
+		if (simd_level == simd_sse2)
+			return (fold_mismatch_sse2(a, b, length));
+	}
+#endif
+
+	return (fold_mismatch_scalar(a, b, length));
+}
+
+/*
+ * Copy 'length' octets from 'src' to 'dst', downcasing them.  'dst' may
+ * be the same as 'src'.
+ */
+static inline void
+fold_copy(unsigned char *dst, const unsigned char *src, unsigned int length) {
+#ifdef NAME_USESIMD
+	if (length >= 16) {
+		if (ISC_UNLIKELY(!simd_initialized))
+			RUNTIME_CHECK(isc_once_do(&simd_once,
+						  simd_initialize) ==
+				      ISC_R_SUCCESS);
+		if (simd_level == simd_avx2) {
+			fold_copy_avx2(dst, src, length);
+			return;
+		}
+		if (simd_level == simd_sse2) {
+			fold_copy_sse2(dst, src, length);
+			return;
+		}
+	}
+#endif
+
+	fold_copy_scalar(dst, src, length);
+}
+
 #define INIT_OFFSETS(name, var, default_offsets) \
 	if ((name)->offsets != NULL)		 \
 		var = (name)->offsets;		 \
@@ -711,10 +946,6 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 isc_boolean_t
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
-	unsigned char *label1, *label2;
-
 	/*
 	 * Are 'name1' and 'name2' equal?
 	 *
@@ -738,46 +969,14 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 	if (name1->length != name2->length)
 		return (ISC_FALSE);
 
-	l = name1->labels;
-
-	if (l != name2->labels)
+	if (name1->labels != name2->labels)
 		return (ISC_FALSE);
 
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (ISC_LIKELY(l-- > 0)) {
-		count = *label1++;
-		if (count != *label2++)
-			return (ISC_FALSE);
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			c = maptolower[label1[0]];
-			if (c != maptolower[label2[0]])
-				return (ISC_FALSE);
-			c = maptolower[label1[1]];
-			if (c != maptolower[label2[1]])
-				return (ISC_FALSE);
-			c = maptolower[label1[2]];
-			if (c != maptolower[label2[2]])
-				return (ISC_FALSE);
-			c = maptolower[label1[3]];
-			if (c != maptolower[label2[3]])
-				return (ISC_FALSE);
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++])
-				return (ISC_FALSE);
-		}
-	}
-
-	return (ISC_TRUE);
+	/*
+	 * Equal label lengths are compared along with the label data.
+	 */
+	return (ISC_TF(fold_mismatch(name1->ndata, name2->ndata,
+				     name1->length) == name1->length));
 }
 
 isc_boolean_t
@@ -1701,7 +1900,7 @@ dns_name_downcase(const dns_name_t *source, dns_name_t *name,
 		  isc_buffer_t *target)
 {
 	unsigned char *sndata, *ndata;
-	unsigned int nlen, count, labels;
+	unsigned int nlen, count, labels, offset;
 	isc_buffer_t buffer;
 
 	/*
@@ -1736,24 +1935,20 @@ dns_name_downcase(const dns_name_t *source, dns_name_t *name,
 		return (ISC_R_NOSPACE);
 	}
 
-	while (labels > 0 && nlen > 0) {
-		labels--;
-		count = *sndata++;
-		*ndata++ = count;
-		nlen--;
-		if (count < 64) {
-			INSIST(nlen >= count);
-			while (count > 0) {
-				*ndata++ = maptolower[(*sndata++)];
-				nlen--;
-				count--;
-			}
-		} else {
+	/*
+	 * Check the labels, then downcase the whole name at once.
+	 */
+	for (offset = 0; labels > 0 && offset < nlen; labels--) {
+		count = sndata[offset];
+		if (count >= 64) {
 			FATAL_ERROR(__FILE__, __LINE__,
 				    "Unexpected label type %02x", count);
 			/* Does not return. */
 		}
+		offset += count + 1;
 	}
+	INSIST(offset <= nlen);
+	fold_copy(ndata, sndata, offset);
 
 	if (source != name) {
 		name->labels = source->labels;
@@ -1989,10 +2184,9 @@ dns_name_towire(const dns_name_t *name, dns_compress_t *cctx,
 		isc_buffer_t *target)
 {
 	unsigned int methods;
+	unsigned int prefix;
 	isc_uint16_t offset;
-	dns_name_t gp;	/* Global compression prefix */
-	isc_boolean_t gf;	/* Global compression target found */
-	isc_uint16_t go;	/* Global compression offset */
+	isc_boolean_t compress;
 	dns_offsets_t clo;
 	dns_name_t clname;
 
@@ -2018,50 +2212,27 @@ dns_name_towire(const dns_name_t *name, dns_compress_t *cctx,
 		dns_name_clone(name, &clname);
 		name = &clname;
 	}
-	DNS_NAME_INIT(&gp, NULL);
-
-	offset = target->used;	/*XXX*/
 
 	methods = dns_compress_getmethods(cctx);
-
-	if ((name->attributes & DNS_NAMEATTR_NOCOMPRESS) == 0 &&
-	    (methods & DNS_COMPRESS_GLOBAL14) != 0)
-		gf = dns_compress_findglobal(cctx, name, &gp, &go);
-	else
-		gf = ISC_FALSE;
+	compress = ISC_TF((name->attributes & DNS_NAMEATTR_NOCOMPRESS) == 0 &&
+			  (methods & DNS_COMPRESS_GLOBAL14) != 0);
 
 	/*
-	 * If the offset is too high for 14 bit global compression, we're
-	 * out of luck.
+	 * Names that are not to be compressed still go in the compression
+	 * table, so that later names can point to them.
 	 */
-	if (gf && go >= 0x4000)
-		gf = ISC_FALSE;
+	dns_compress_name(cctx, target, name, compress, &prefix, &offset);
 
-	/*
-	 * Will the compression pointer reduce the message size?
-	 */
-	if (gf && (gp.length + 2) >= name->length)
-		gf = ISC_FALSE;
+	if (target->length - target->used < prefix)
+		return (ISC_R_NOSPACE);
+	(void)memmove((unsigned char *)target->base + target->used,
+		      name->ndata, (size_t)prefix);
+	isc_buffer_add(target, prefix);
 
-	if (gf) {
-		if (target->length - target->used < gp.length)
-			return (ISC_R_NOSPACE);
-		(void)memmove((unsigned char *)target->base + target->used,
-			      gp.ndata, (size_t)gp.length);
-		isc_buffer_add(target, gp.length);
-		go |= 0xc000;
+	if (offset != 0) {
 		if (target->length - target->used < 2)
 			return (ISC_R_NOSPACE);
-		isc_buffer_putuint16(target, go);
-		if (gp.length != 0)
-			dns_compress_add(cctx, name, &gp, offset);
-	} else {
-		if (target->length - target->used < name->length)
-			return (ISC_R_NOSPACE);
-		(void)memmove((unsigned char *)target->base + target->used,
-			      name->ndata, (size_t)name->length);
-		isc_buffer_add(target, name->length);
-		dns_compress_add(cctx, name, name, offset);
+		isc_buffer_putuint16(target, offset | 0xc000);
 	}
 	return (ISC_R_SUCCESS);
 }
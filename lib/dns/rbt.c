@@ -560,7 +560,9 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	temp_node.right_is_relative = 0;
 	temp_node.parent_is_relative = 0;
 	temp_node.data_is_relative = 0;
+	temp_node.typeindex = NULL;
 	temp_node.is_mmapped = 1;
+	ISC_LINK_INIT(&temp_node, deadlink);
 
 	/*
 	 * If the next node is not NULL, calculate the next node's location
@@ -819,6 +821,8 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 		CONFIRM(n->data > (void *) n);
 	} else
 		CONFIRM(n->data == NULL);
+	n->typeindex = NULL;
+	ISC_LINK_INIT(n, deadlink);
 
 	hash_node(rbt, n, fullname);
 
@@ -848,10 +852,12 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 		sizeof(dns_rbtnode_t));
 	hexdump("node data", node_data, datasize);
 #endif
-	isc_crc64_update(crc, (const isc_uint8_t *) &header,
-			sizeof(dns_rbtnode_t));
-	isc_crc64_update(crc, (const isc_uint8_t *) node_data,
-			datasize);
+	if (crc != NULL) {
+		isc_crc64_update(crc, (const isc_uint8_t *) &header,
+				sizeof(dns_rbtnode_t));
+		isc_crc64_update(crc, (const isc_uint8_t *) node_data,
+				datasize);
+	}
 
  cleanup:
 	return (result);
@@ -863,6 +869,39 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 			 dns_rbtdeleter_t deleter, void *deleter_arg,
 			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
 			 dns_rbtnode_t **originp, dns_rbt_t **rbtp)
+{
+	return (dns_rbt_deserialize_tree2(base_address, filesize,
+					  header_offset, ISC_TRUE, mctx,
+					  deleter, deleter_arg,
+					  datafixer, fixer_arg,
+					  originp, rbtp));
+}
+
+isc_result_t
+dns_rbt_imagecrc(void *base_address, size_t filesize, off_t header_offset,
+		 isc_uint64_t *crcp)
+{
+	file_header_t *header;
+
+	REQUIRE(crcp != NULL);
+
+	if (header_offset < 0 ||
+	    (size_t)header_offset + sizeof(*header) > filesize)
+		return (ISC_R_INVALIDFILE);
+
+	header = (file_header_t *)((char *)base_address + header_offset);
+	*crcp = header->crc;
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_rbt_deserialize_tree2(void *base_address, size_t filesize,
+			  off_t header_offset, isc_boolean_t verify,
+			  isc_mem_t *mctx,
+			  dns_rbtdeleter_t deleter, void *deleter_arg,
+			  dns_rbtdatafixer_t datafixer, void *fixer_arg,
+			  dns_rbtnode_t **originp, dns_rbt_t **rbtp)
 {
 	isc_result_t result = ISC_R_SUCCESS;
 	file_header_t *header;
@@ -913,17 +952,21 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 	rehash(rbt, header->nodecount);
 
 	CHECK(treefix(rbt, base_address, filesize, rbt->root,
-		      dns_rootname, datafixer, fixer_arg, &crc));
+		      dns_rootname, datafixer, fixer_arg,
+		      verify ? &crc : NULL));
 
-	isc_crc64_final(&crc);
+	if (verify) {
+		isc_crc64_final(&crc);
 #ifdef DEBUG
-	hexdump("deserializing CRC", (unsigned char *)&crc, sizeof(crc));
+		hexdump("deserializing CRC", (unsigned char *)&crc,
+			sizeof(crc));
 #endif
 
-	/* Check file hash */
-	if (header->crc != crc) {
-		result = ISC_R_INVALIDFILE;
-		goto cleanup;
+		/* Check file hash */
+		if (header->crc != crc) {
+			result = ISC_R_INVALIDFILE;
+			goto cleanup;
+		}
 	}
 
 	if (header->nodecount != rbt->nodecount) {
@@ -2224,6 +2267,7 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	LEFT(node) = NULL;
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
+	node->typeindex = NULL;
 	node->is_mmapped = 0;
 	node->down_is_relative = 0;
 	node->left_is_relative = 0;
@@ -20,6 +20,7 @@
 #include <inttypes.h> /* uintptr_t */
 #endif
 
+#include <isc/atomic.h>
 #include <isc/crc64.h>
 #include <isc/event.h>
 #include <isc/heap.h>
@@ -66,6 +67,8 @@
 #include <dns/zone.h>
 #include <dns/zonekey.h>
 
+#include <sys/stat.h>
+
 #ifndef WIN32
 #include <sys/mman.h>
 #else
@@ -260,7 +263,6 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define settask settask64
 #define setup_delegation setup_delegation64
 #define subtractrdataset subtractrdataset64
-#define ttl_sooner ttl_sooner64
 #define update_cachestats update_cachestats64
 #define update_header update_header64
 #define update_newheader update_newheader64
@@ -370,15 +372,6 @@ typedef isc_mutex_t nodelock_t;
 #define NODE_WEAKDOWNGRADE(l)   ((void)0)
 #endif
 
-/*%
- * Whether to rate-limit updating the LRU to avoid possible thread contention.
- * Our performance measurement has shown the cost is marginal, so it's defined
- * to be 0 by default either with or without threads.
- */
-#ifndef DNS_RBTDB_LIMITLRUUPDATE
-#define DNS_RBTDB_LIMITLRUUPDATE 0
-#endif
-
 /*
  * Allow clients with a virtual time of up to 5 minutes in the past to see
  * records that would have otherwise have expired.
@@ -407,6 +400,10 @@ typedef struct rdatasetheader {
 	unsigned int 			next_is_relative : 1;
 	unsigned int 			node_is_relative : 1;
 	unsigned int 			resign_lsb : 1;
+	unsigned int 			ttlbucket : 9;
+	/*%<
+	 * The bucket of the TTL wheel holding the header, in a cache.
+	 */
 	/*%<
 	 * We don't use the LIST macros, because the LIST structure has
 	 * both head and tail pointers, and is doubly linked.
@@ -436,12 +433,19 @@ typedef struct rdatasetheader {
 	 */
 
 	dns_rbtnode_t                   *node;
-	isc_stdtime_t                   last_used;
+	isc_int32_t                     visited;
+	/*%<
+	 * Set when a cache lookup returns this rdataset, and cleared by
+	 * the LRU sweep in overmem_purge().  It is set under the node
+	 * read lock, so it is not protected by any lock.
+	 */
 	ISC_LINK(struct rdatasetheader) link;
 
 	unsigned int                    heap_index;
 	/*%<
-	 * Used for TTL-based cache cleaning.
+	 * The position of the header in the resigning heap of a zone, or
+	 * one more than its position in its TTL wheel bucket in a cache;
+	 * 0 if it is in neither.
 	 */
 	isc_stdtime_t                   resign;
 	/*%<
@@ -453,6 +457,63 @@ typedef struct rdatasetheader {
 } rdatasetheader_t;
 
 typedef ISC_LIST(rdatasetheader_t)      rdatasetheaderlist_t;
+
+/*%
+ * A cache keeps a TTL wheel for each node lock bucket, to find the
+ * headers whose TTL has expired.  Slot 's' of the wheel holds headers
+ * expiring in the TTLWHEEL_GRANULE second periods 's', 's' plus
+ * TTLWHEEL_SLOTS, and so on; headers already known to have expired are
+ * moved to the "overdue" bucket.  'cursor' is the first period whose
+ * slot has not been checked for expired headers since the period ended.
+ *
+ * Adding, moving and removing a header is O(1); a slot is checked, and
+ * all of its expired headers moved to the overdue bucket, in one pass
+ * once its period is over.  A slot's array of headers is kept while the
+ * database exists, even when it empties, so that headers moving through
+ * the wheel do not allocate and free memory under the node lock.
+ */
+#define TTLWHEEL_SLOTS                  256
+#define TTLWHEEL_GRANULE                32
+#define TTLWHEEL_OVERDUE                TTLWHEEL_SLOTS
+
+/*%
+ * The smallest array of headers a slot of the wheel has once used.
+ */
+#define TTLBUCKET_MIN                   16
+
+typedef struct {
+	rdatasetheader_t                **headers;
+	unsigned int                    count;
+	unsigned int                    size;
+} ttlbucket_t;
+
+typedef struct {
+	ttlbucket_t                     buckets[TTLWHEEL_SLOTS + 1];
+	isc_stdtime_t                   cursor;
+} ttlwheel_t;
+
+/*%
+ * Nodes with at least TYPEINDEX_MIN types have an index of their top
+ * headers sorted by type, so that a lookup by type is a binary search
+ * instead of a walk of the node's list.  Older versions of each type
+ * are still reached through 'down'.  The index is rebuilt whenever the
+ * list of top headers changes; like the list, it is protected by the
+ * node lock.
+ */
+typedef struct {
+	rbtdb_rdatatype_t               type;
+	rdatasetheader_t                *header;
+} typeindexentry_t;
+
+typedef struct {
+	unsigned int                    count;
+	unsigned int                    size;
+	typeindexentry_t                *entries;
+} typeindex_t;
+
+#define TYPEINDEX_MIN                   8
+#define TYPEINDEX_SIZE(n) \
+	(sizeof(typeindex_t) + (n) * sizeof(typeindexentry_t))
 typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 
 #define RDATASET_ATTR_NONEXISTENT       0x0001
@@ -539,6 +600,7 @@ typedef struct {
 	isc_refcount_t                  references;
 	/* Locked by lock. */
 	isc_boolean_t                   exiting;
+	rdatasetheader_t                *lruhand;
 } rbtdb_nodelock_t;
 
 typedef struct rbtdb_changed {
@@ -615,6 +677,9 @@ typedef ISC_LIST(rbtdb_version_t)       rbtdb_versionlist_t;
 struct dns_rbtdb {
 	/* Unlocked. */
 	dns_db_t                        common;
+#ifndef DNS_RBTDB_VERSION64
+	isc_uint32_t			instance;
+#endif
 	/* Locks the data in this struct */
 #if DNS_RBTDB_USERWLOCK
 	isc_rwlock_t                    lock;
@@ -646,7 +711,9 @@ struct dns_rbtdb {
 	/*
 	 * This is a linked list used to implement the LRU cache.  There will
 	 * be node_lock_count linked lists here.  Nodes in bucket 1 will be
-	 * placed on the linked list rdatasets[1].
+	 * placed on the linked list rdatasets[1].  New rdatasets are added
+	 * at the head; overmem_purge() sweeps from the tail towards the head
+	 * with node_locks[1].lruhand ("SIEVE").
 	 */
 	rdatasetheaderlist_t            *rdatasets;
 
@@ -657,13 +724,14 @@ struct dns_rbtdb {
 	rbtnodelist_t                   *deadnodes;
 
 	/*
-	 * Heaps.  These are used for TTL based expiry in a cache,
-	 * or for zone resigning in a zone DB.  hmctx is the memory
-	 * context to use for the heap (which differs from the main
-	 * database memory context in the case of a cache).
+	 * Heaps for zone resigning in a zone DB, or TTL wheels for TTL
+	 * based expiry in a cache.  hmctx is the memory context to use
+	 * for them (which differs from the main database memory context
+	 * in the case of a cache).
 	 */
 	isc_mem_t			*hmctx;
 	isc_heap_t                      **heaps;
+	ttlwheel_t                      *ttlwheels;
 
 	/*
 	 * Base values for the mmap() code.
@@ -725,10 +793,13 @@ static isc_result_t rdataset_getclosest(dns_rdataset_t *rdataset,
 					dns_name_t *name,
 					dns_rdataset_t *neg,
 					dns_rdataset_t *negsig);
-static inline isc_boolean_t need_headerupdate(rdatasetheader_t *header,
-					      isc_stdtime_t now);
-static void update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
-			  isc_stdtime_t now);
+static inline void lru_insert(dns_rbtdb_t *rbtdb, int idx,
+			      rdatasetheader_t *header);
+static inline void lru_unlink(dns_rbtdb_t *rbtdb, int idx,
+			      rdatasetheader_t *header);
+static inline isc_boolean_t need_headerupdate(rdatasetheader_t *header);
+static inline void update_header(dns_rbtdb_t *rbtdb,
+				 rdatasetheader_t *header);
 static void expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
 			  isc_boolean_t tree_locked, expire_t reason);
 static void overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
@@ -1011,13 +1082,157 @@ update_rrsetstats(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
 		dns_rdatasetstats_decrement(rbtdb->rrsetstats, type);
 }
 
+static inline unsigned int
+ttl_bucket(ttlwheel_t *wheel, dns_ttl_t ttl) {
+	if (ttl / TTLWHEEL_GRANULE < wheel->cursor)
+		return (TTLWHEEL_OVERDUE);
+	return ((ttl / TTLWHEEL_GRANULE) % TTLWHEEL_SLOTS);
+}
+
+/*
+ * Move the headers of 'bucket' to a new array of 'size' entries.
+ */
+static isc_boolean_t
+ttl_resize(dns_rbtdb_t *rbtdb, ttlbucket_t *bucket, unsigned int size) {
+	rdatasetheader_t **headers;
+
+	INSIST(size >= bucket->count);
+
+	headers = isc_mem_get(rbtdb->hmctx, size * sizeof(*headers));
+	if (headers == NULL)
+		return (ISC_FALSE);
+	if (bucket->headers != NULL) {
+		memmove(headers, bucket->headers,
+			bucket->count * sizeof(*headers));
+		isc_mem_put(rbtdb->hmctx, bucket->headers,
+			    bucket->size * sizeof(*headers));
+	}
+	bucket->headers = headers;
+	bucket->size = size;
+
+	return (ISC_TRUE);
+}
+
+static isc_result_t
+ttl_add(dns_rbtdb_t *rbtdb, ttlwheel_t *wheel, unsigned int b,
+	rdatasetheader_t *header)
+{
+	ttlbucket_t *bucket = &wheel->buckets[b];
+
+	INSIST(header->heap_index == 0);
+
+	if (bucket->count == bucket->size) {
+		unsigned int size = (bucket->size == 0) ? TTLBUCKET_MIN
+							: bucket->size * 2;
+
+		if (!ttl_resize(rbtdb, bucket, size))
+			return (ISC_R_NOMEMORY);
+	}
+
+	bucket->headers[bucket->count++] = header;
+	header->heap_index = bucket->count;
+	header->ttlbucket = b;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Add 'header' to the TTL wheel of node lock bucket 'idx'.  Caller must
+ * be holding the node lock for writing.
+ */
+static isc_result_t
+ttl_insert(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *header) {
+	ttlwheel_t *wheel = &rbtdb->ttlwheels[idx];
+
+	return (ttl_add(rbtdb, wheel, ttl_bucket(wheel, header->rdh_ttl),
+			header));
+}
+
+/*
+ * Remove 'header' from its TTL wheel.  Caller must be holding the node
+ * lock for writing.
+ */
+static void
+ttl_delete(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	ttlwheel_t *wheel = &rbtdb->ttlwheels[header->node->locknum];
+	ttlbucket_t *bucket = &wheel->buckets[header->ttlbucket];
+	rdatasetheader_t *last;
+
+	INSIST(header->heap_index != 0 &&
+	       header->heap_index <= bucket->count &&
+	       bucket->headers[header->heap_index - 1] == header);
+
+	last = bucket->headers[--bucket->count];
+	bucket->headers[header->heap_index - 1] = last;
+	last->heap_index = header->heap_index;
+	header->heap_index = 0;
+
+	/*
+	 * The array is kept when it empties, as slots are refilled as the
+	 * wheel turns, but halved once it is no more than a quarter full
+	 * so that a burst of headers does not hold on to memory for good.
+	 * If there is no memory for the smaller array the larger one is
+	 * kept.
+	 */
+	if (bucket->size > TTLBUCKET_MIN && bucket->count <= bucket->size / 4)
+		(void)ttl_resize(rbtdb, bucket, bucket->size / 2);
+}
+
+/*
+ * Return a header in node lock bucket 'idx' whose TTL expired before
+ * 'now' less RBTDB_VIRTUAL, or NULL if there is none.  Caller must be
+ * holding the node lock for writing.
+ */
+static rdatasetheader_t *
+ttl_expired(dns_rbtdb_t *rbtdb, int idx, isc_stdtime_t now) {
+	ttlwheel_t *wheel = &rbtdb->ttlwheels[idx];
+	ttlbucket_t *bucket, *overdue = &wheel->buckets[TTLWHEEL_OVERDUE];
+	rdatasetheader_t *header;
+	isc_stdtime_t limit = now - RBTDB_VIRTUAL;
+	unsigned int i, slots = 0;
+
+	/*
+	 * Check the slots of the periods that have ended, moving their
+	 * expired headers to the overdue bucket.  Once every slot has
+	 * been checked, all the expired headers have been found and the
+	 * cursor can catch up.
+	 */
+	while (overdue->count == 0 &&
+	       (wheel->cursor + 1) * TTLWHEEL_GRANULE <= limit)
+	{
+		if (slots++ == TTLWHEEL_SLOTS) {
+			wheel->cursor = limit / TTLWHEEL_GRANULE;
+			break;
+		}
+		bucket = &wheel->buckets[wheel->cursor % TTLWHEEL_SLOTS];
+		for (i = 0; i < bucket->count; ) {
+			header = bucket->headers[i];
+			if (header->rdh_ttl < limit) {
+				/*
+				 * This moves the last header to 'i'.  If
+				 * there is no memory, the header is left
+				 * to the LRU.
+				 */
+				ttl_delete(rbtdb, header);
+				(void)ttl_add(rbtdb, wheel, TTLWHEEL_OVERDUE,
+					      header);
+			} else
+				i++;
+		}
+		wheel->cursor++;
+	}
+
+	if (overdue->count == 0)
+		return (NULL);
+	header = overdue->headers[overdue->count - 1];
+	return (header->rdh_ttl < limit ? header : NULL);
+}
+
 static void
 set_ttl(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, dns_ttl_t newttl) {
-	int idx;
-	isc_heap_t *heap;
+	ttlwheel_t *wheel;
 	dns_ttl_t oldttl;
 
-
 	if (!IS_CACHE(rbtdb)) {
 		header->rdh_ttl = newttl;
 		return;
@@ -1027,35 +1242,23 @@ set_ttl(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, dns_ttl_t newttl) {
 	header->rdh_ttl = newttl;
 
 	/*
-	 * It's possible the rbtdb is not a cache.  If this is the case,
-	 * we will not have a heap, and we move on.  If we do, though,
-	 * we might need to adjust things.
+	 * Move the header to the TTL wheel bucket for its new TTL, if
+	 * it is in the wheel.
 	 */
-	if (header->heap_index == 0 || newttl == oldttl)
+	if (header->heap_index == 0 || newttl == oldttl ||
+	    rbtdb->ttlwheels == NULL)
 		return;
-	idx = header->node->locknum;
-	if (rbtdb->heaps == NULL || rbtdb->heaps[idx] == NULL)
-	    return;
-	heap = rbtdb->heaps[idx];
-
-	if (newttl < oldttl)
-		isc_heap_increased(heap, header->heap_index);
-	else
-		isc_heap_decreased(heap, header->heap_index);
+	wheel = &rbtdb->ttlwheels[header->node->locknum];
+	if (ttl_bucket(wheel, newttl) != header->ttlbucket) {
+		ttl_delete(rbtdb, header);
+		(void)ttl_insert(rbtdb, header->node->locknum, header);
+	}
 }
 
 /*%
- * These functions allow the heap code to rank the priority of each
+ * This function allows the heap code to rank the priority of each
  * element.  It returns ISC_TRUE if v1 happens "sooner" than v2.
  */
-static isc_boolean_t
-ttl_sooner(void *v1, void *v2) {
-	rdatasetheader_t *h1 = v1;
-	rdatasetheader_t *h2 = v2;
-
-	return (ISC_TF(h1->rdh_ttl < h2->rdh_ttl));
-}
-
 static isc_boolean_t
 resign_sooner(void *v1, void *v2) {
 	rdatasetheader_t *h1 = v1;
@@ -1251,7 +1454,7 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 		    rbtdb->node_lock_count * sizeof(rbtnodelist_t));
 	}
 	/*
-	 * Clean up heap objects.
+	 * Clean up heap objects and TTL wheels.
 	 */
 	if (rbtdb->heaps != NULL) {
 		for (i = 0; i < rbtdb->node_lock_count; i++)
@@ -1259,6 +1462,25 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 		isc_mem_put(rbtdb->hmctx, rbtdb->heaps,
 			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
 	}
+	if (rbtdb->ttlwheels != NULL) {
+		for (i = 0; i < rbtdb->node_lock_count; i++) {
+			ttlwheel_t *wheel = &rbtdb->ttlwheels[i];
+			unsigned int b;
+
+			for (b = 0; b <= TTLWHEEL_SLOTS; b++) {
+				ttlbucket_t *bucket = &wheel->buckets[b];
+
+				INSIST(bucket->count == 0);
+				if (bucket->headers != NULL)
+					isc_mem_put(rbtdb->hmctx,
+						    bucket->headers,
+						    bucket->size *
+						    sizeof(*bucket->headers));
+			}
+		}
+		isc_mem_put(rbtdb->hmctx, rbtdb->ttlwheels,
+			    rbtdb->node_lock_count * sizeof(ttlwheel_t));
+	}
 
 	if (rbtdb->rrsetstats != NULL)
 		dns_stats_detach(&rbtdb->rrsetstats);
@@ -1637,11 +1859,16 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 	idx = rdataset->node->locknum;
 	if (ISC_LINK_LINKED(rdataset, link)) {
 		INSIST(IS_CACHE(rbtdb));
-		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], rdataset, link);
+		lru_unlink(rbtdb, idx, rdataset);
 	}
 
-	if (rdataset->heap_index != 0)
-		isc_heap_delete(rbtdb->heaps[idx], rdataset->heap_index);
+	if (rdataset->heap_index != 0) {
+		if (IS_CACHE(rbtdb))
+			ttl_delete(rbtdb, rdataset);
+		else
+			isc_heap_delete(rbtdb->heaps[idx],
+					rdataset->heap_index);
+	}
 	rdataset->heap_index = 0;
 
 	if (rdataset->noqname != NULL)
@@ -1727,6 +1954,134 @@ clean_stale_headers(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *top)
 	top->down = NULL;
 }
 
+static inline void
+free_typeindex(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
+	typeindex_t *index = node->typeindex;
+
+	if (index != NULL) {
+		isc_mem_put(rbtdb->common.mctx, index,
+			    TYPEINDEX_SIZE(index->size));
+		node->typeindex = NULL;
+	}
+}
+
+/*
+ * Rebuild the type index of 'node' after its list of top headers has
+ * changed, or free it if the node no longer has enough types.
+ */
+static void
+update_typeindex(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
+	typeindex_t *index = node->typeindex;
+	typeindexentry_t entry;
+	rdatasetheader_t *header;
+	unsigned int count, i;
+
+	/*
+	 * Caller must be holding the node lock for writing.
+	 */
+
+	count = 0;
+	for (header = node->data; header != NULL; header = header->next)
+		count++;
+
+	if (count < TYPEINDEX_MIN ||
+	    (index != NULL && (index->size < count || index->size > count * 2)))
+	{
+		free_typeindex(rbtdb, node);
+		index = NULL;
+		if (count < TYPEINDEX_MIN)
+			return;
+	}
+
+	if (index == NULL) {
+		/*
+		 * Leave room for a few more types.  If there is no memory,
+		 * lookups walk the list as they do for small nodes.
+		 */
+		index = isc_mem_get(rbtdb->common.mctx,
+				    TYPEINDEX_SIZE(count + 4));
+		if (index == NULL)
+			return;
+		index->size = count + 4;
+		index->entries = (typeindexentry_t *)(index + 1);
+		node->typeindex = index;
+	}
+
+	count = 0;
+	for (header = node->data; header != NULL; header = header->next) {
+		entry.type = header->type;
+		entry.header = header;
+		for (i = count;
+		     i > 0 && index->entries[i - 1].type > entry.type;
+		     i--)
+			index->entries[i] = index->entries[i - 1];
+		index->entries[i] = entry;
+		count++;
+	}
+	index->count = count;
+}
+
+/*
+ * Return the top header of 'type' at 'node', which must have a type
+ * index, or NULL if there is none.
+ */
+static inline rdatasetheader_t *
+find_typeindex(dns_rbtnode_t *node, rbtdb_rdatatype_t type) {
+	typeindex_t *index = node->typeindex;
+	unsigned int low = 0, high = index->count, mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (index->entries[mid].type < type)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < index->count && index->entries[low].type == type)
+		return (index->entries[low].header);
+	return (NULL);
+}
+
+/*
+ * Return the active, extant rdataset of 'type' at 'node' in version
+ * 'serial' of a zone, using the node's type index.
+ */
+static inline rdatasetheader_t *
+zone_findtype(dns_rbtnode_t *node, rbtdb_rdatatype_t type,
+	      rbtdb_serial_t serial)
+{
+	rdatasetheader_t *header;
+
+	for (header = find_typeindex(node, type);
+	     header != NULL;
+	     header = header->down)
+	{
+		if (header->serial <= serial && !IGNORE(header))
+			return (NONEXISTENT(header) ? NULL : header);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Return the active, extant, non-stale rdataset of 'type' at 'node' in
+ * a cache, using the node's type index.
+ */
+static inline rdatasetheader_t *
+cache_findtype(dns_rbtnode_t *node, rbtdb_rdatatype_t type,
+	       isc_stdtime_t now)
+{
+	rdatasetheader_t *header;
+
+	header = find_typeindex(node, type);
+	if (header == NULL || !ACTIVE(header, now) || !EXISTS(header) ||
+	    STALE(header))
+		return (NULL);
+
+	return (header);
+}
+
 static inline void
 clean_cache_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
 	rdatasetheader_t *current, *top_prev, *top_next;
@@ -1754,6 +2109,7 @@ clean_cache_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
 			top_prev = current;
 	}
 	node->dirty = 0;
+	update_typeindex(rbtdb, node);
 }
 
 static inline void
@@ -1880,6 +2236,7 @@ clean_zone_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	}
 	if (!still_dirty)
 		node->dirty = 0;
+	update_typeindex(rbtdb, node);
 }
 
 static void
@@ -3864,7 +4221,15 @@ find_closest_nsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 		found = NULL;
 		foundsig = NULL;
 		empty_node = ISC_TRUE;
-		for (header = node->data;
+		if (node->typeindex != NULL) {
+			found = zone_findtype(node, type, search->serial);
+			if (found != NULL) {
+				foundsig = zone_findtype(node, sigtype,
+							 search->serial);
+				empty_node = ISC_FALSE;
+			}
+		}
+		for (header = (found == NULL) ? node->data : NULL;
 		     header != NULL;
 		     header = header_next) {
 			header_next = header->next;
@@ -4001,6 +4366,48 @@ find_closest_nsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 	return (result);
 }
 
+/*
+ * Find the answer to a query for 'type' at 'node' with the node's type
+ * index, for zone_find().  This only handles the common case: exactly
+ * one of 'type' or (if 'cname_ok') CNAME is present, and there is no
+ * NS rdataset that could make the node a zone cut and no NSEC3
+ * rdataset.  Anything else, including the absence of the type, returns
+ * NULL and is left to the walk of the node's list.
+ */
+static inline rdatasetheader_t *
+zone_findindexed(rbtdb_search_t *search, dns_rbtnode_t *node,
+		 dns_rdatatype_t type, isc_boolean_t cname_ok,
+		 isc_boolean_t maybe_zonecut, rdatasetheader_t **foundsigp)
+{
+	rdatasetheader_t *found, *cname = NULL;
+	rbtdb_serial_t serial = search->serial;
+
+	if (maybe_zonecut &&
+	    zone_findtype(node, dns_rdatatype_ns, serial) != NULL)
+		return (NULL);
+	if (zone_findtype(node, dns_rdatatype_nsec3, serial) != NULL)
+		return (NULL);
+
+	found = zone_findtype(node, type, serial);
+	if (cname_ok && type != dns_rdatatype_cname)
+		cname = zone_findtype(node, dns_rdatatype_cname, serial);
+
+	if (found != NULL && cname == NULL) {
+		*foundsigp = zone_findtype(node,
+				RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig,
+						      type),
+				serial);
+		return (found);
+	}
+	if (found == NULL && cname != NULL) {
+		*foundsigp = zone_findtype(node, RBTDB_RDATATYPE_SIGCNAME,
+					   serial);
+		return (cname);
+	}
+
+	return (NULL);
+}
+
 static isc_result_t
 zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	  dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
@@ -4178,7 +4585,19 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	nsecsig = NULL;
 	cnamesig = NULL;
 	empty_node = ISC_TRUE;
-	for (header = node->data; header != NULL; header = header_next) {
+	if (node->typeindex != NULL && type != dns_rdatatype_any) {
+		found = zone_findindexed(&search, node, type, cname_ok,
+					 maybe_zonecut, &foundsig);
+		if (found != NULL)
+			empty_node = ISC_FALSE;
+	}
+	/*
+	 * Walk the node's list unless the type index had the answer.
+	 */
+	for (header = (found == NULL) ? node->data : NULL;
+	     header != NULL;
+	     header = header_next)
+	{
 		header_next = header->next;
 		/*
 		 * Look for an active, extant rdataset.
@@ -4580,6 +4999,7 @@ check_stale_header(dns_rbtnode_t *node, rdatasetheader_t *header,
 				else
 					node->data = header->next;
 				free_rdataset(search->rbtdb, mctx, header);
+				update_typeindex(search->rbtdb, node);
 			} else {
 				mark_stale_header(search->rbtdb, header);
 				*header_prev = header;
@@ -4759,24 +5179,10 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 			if (foundsig != NULL)
 				bind_rdataset(search->rbtdb, node, foundsig,
 					      search->now, sigrdataset);
-			if (need_headerupdate(found, search->now) ||
-			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now))) {
-				if (locktype != isc_rwlocktype_write) {
-					NODE_UNLOCK(lock, locktype);
-					NODE_LOCK(lock, isc_rwlocktype_write);
-					locktype = isc_rwlocktype_write;
-					POST(locktype);
-				}
-				if (need_headerupdate(found, search->now))
-					update_header(search->rbtdb, found,
-						      search->now);
-				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now)) {
-					update_header(search->rbtdb, foundsig,
-						      search->now);
-				}
-			}
+			if (need_headerupdate(found))
+				update_header(search->rbtdb, found);
+			if (foundsig != NULL && need_headerupdate(foundsig))
+				update_header(search->rbtdb, foundsig);
 		}
 
 	node_exit:
@@ -4874,6 +5280,58 @@ find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 }
 
 
+/*
+ * Find the answer to a query for 'type' at 'node' with the node's type
+ * index, for cache_find().  This only handles the common case: exactly
+ * one of 'type', a negative entry for it, an NXDOMAIN entry or (if
+ * 'cname_ok') CNAME is present, with enough trust for the search
+ * options.  Anything else returns NULL and is left to the walk of the
+ * node's list.
+ */
+static inline rdatasetheader_t *
+cache_findindexed(rbtdb_search_t *search, dns_rbtnode_t *node,
+		  dns_rdatatype_t type, isc_boolean_t cname_ok,
+		  rdatasetheader_t **foundsigp)
+{
+	rdatasetheader_t *candidates[4], *found = NULL;
+	rbtdb_rdatatype_t sigtype;
+	unsigned int i, n = 0;
+
+	candidates[n++] = cache_findtype(node, type, search->now);
+	candidates[n++] = cache_findtype(node, RBTDB_RDATATYPE_VALUE(0, type),
+					 search->now);
+	candidates[n++] = cache_findtype(node, RBTDB_RDATATYPE_NCACHEANY,
+					 search->now);
+	if (cname_ok && type != dns_rdatatype_cname)
+		candidates[n++] = cache_findtype(node, dns_rdatatype_cname,
+						 search->now);
+
+	for (i = 0; i < n; i++) {
+		if (candidates[i] == NULL)
+			continue;
+		if (found != NULL)
+			return (NULL);
+		found = candidates[i];
+	}
+
+	if (found == NULL ||
+	    (DNS_TRUST_ADDITIONAL(found->trust) &&
+	     ((search->options & DNS_DBFIND_ADDITIONALOK) == 0)) ||
+	    (found->trust == dns_trust_glue &&
+	     ((search->options & DNS_DBFIND_GLUEOK) == 0)) ||
+	    (DNS_TRUST_PENDING(found->trust) &&
+	     ((search->options & DNS_DBFIND_PENDINGOK) == 0)))
+		return (NULL);
+
+	if (found->type == dns_rdatatype_cname)
+		sigtype = RBTDB_RDATATYPE_SIGCNAME;
+	else
+		sigtype = RBTDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, type);
+	*foundsigp = cache_findtype(node, sigtype, search->now);
+
+	return (found);
+}
+
 static isc_result_t
 cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	   dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
@@ -4890,7 +5348,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	rdatasetheader_t *header, *header_prev, *header_next;
 	rdatasetheader_t *found, *nsheader;
 	rdatasetheader_t *foundsig, *nssig, *cnamesig;
-	rdatasetheader_t *update, *updatesig;
 	rbtdb_rdatatype_t sigtype, negtype;
 
 	UNUSED(version);
@@ -4913,8 +5370,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	dns_fixedname_init(&search.zonecut_name);
 	dns_rbtnodechain_init(&search.chain, search.rbtdb->common.mctx);
 	search.now = now;
-	update = NULL;
-	updatesig = NULL;
 
 	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
@@ -4976,7 +5431,19 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	cnamesig = NULL;
 	empty_node = ISC_TRUE;
 	header_prev = NULL;
-	for (header = node->data; header != NULL; header = header_next) {
+	if (node->typeindex != NULL && type != dns_rdatatype_any) {
+		found = cache_findindexed(&search, node, type, cname_ok,
+					  &foundsig);
+		if (found != NULL)
+			empty_node = ISC_FALSE;
+	}
+	/*
+	 * Walk the node's list unless the type index had the answer.
+	 */
+	for (header = (found == NULL) ? node->data : NULL;
+	     header != NULL;
+	     header = header_next)
+	{
 		header_next = header->next;
 		if (check_stale_header(node, header,
 				       &locktype, lock, &search,
@@ -5081,13 +5548,13 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsheader, search.now,
 				      rdataset);
-			if (need_headerupdate(nsheader, search.now))
-				update = nsheader;
+			if (need_headerupdate(nsheader))
+				update_header(search.rbtdb, nsheader);
 			if (nssig != NULL) {
 				bind_rdataset(search.rbtdb, node, nssig,
 					      search.now, sigrdataset);
-				if (need_headerupdate(nssig, search.now))
-					updatesig = nssig;
+				if (need_headerupdate(nssig))
+					update_header(search.rbtdb, nssig);
 			}
 			result = DNS_R_DELEGATION;
 			goto node_exit;
@@ -5138,29 +5605,17 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	    result == DNS_R_NCACHENXRRSET) {
 		bind_rdataset(search.rbtdb, node, found, search.now,
 			      rdataset);
-		if (need_headerupdate(found, search.now))
-			update = found;
+		if (need_headerupdate(found))
+			update_header(search.rbtdb, found);
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bind_rdataset(search.rbtdb, node, foundsig, search.now,
 				      sigrdataset);
-			if (need_headerupdate(foundsig, search.now))
-				updatesig = foundsig;
+			if (need_headerupdate(foundsig))
+				update_header(search.rbtdb, foundsig);
 		}
 	}
 
  node_exit:
-	if ((update != NULL || updatesig != NULL) &&
-	    locktype != isc_rwlocktype_write) {
-		NODE_UNLOCK(lock, locktype);
-		NODE_LOCK(lock, isc_rwlocktype_write);
-		locktype = isc_rwlocktype_write;
-		POST(locktype);
-	}
-	if (update != NULL && need_headerupdate(update, search.now))
-		update_header(search.rbtdb, update, search.now);
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now))
-		update_header(search.rbtdb, updatesig, search.now);
-
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
@@ -5300,21 +5755,10 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 		bind_rdataset(search.rbtdb, node, foundsig, search.now,
 			      sigrdataset);
 
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL &&  need_headerupdate(foundsig, search.now))) {
-		if (locktype != isc_rwlocktype_write) {
-			NODE_UNLOCK(lock, locktype);
-			NODE_LOCK(lock, isc_rwlocktype_write);
-			locktype = isc_rwlocktype_write;
-			POST(locktype);
-		}
-		if (need_headerupdate(found, search.now))
-			update_header(search.rbtdb, found, search.now);
-		if (foundsig != NULL &&
-		    need_headerupdate(foundsig, search.now)) {
-			update_header(search.rbtdb, foundsig, search.now);
-		}
-	}
+	if (need_headerupdate(found))
+		update_header(search.rbtdb, found);
+	if (foundsig != NULL && need_headerupdate(foundsig))
+		update_header(search.rbtdb, foundsig);
 
 	NODE_UNLOCK(lock, locktype);
 
@@ -5618,7 +6062,20 @@ zone_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	else
 		sigmatchtype = 0;
 
-	for (header = rbtnode->data; header != NULL; header = header_next) {
+	/*
+	 * With a type index there is no need to walk the list.
+	 */
+	if (rbtnode->typeindex != NULL) {
+		found = zone_findtype(rbtnode, matchtype, serial);
+		if (found != NULL && sigmatchtype != 0)
+			foundsig = zone_findtype(rbtnode, sigmatchtype,
+						 serial);
+	}
+
+	for (header = (rbtnode->typeindex == NULL) ? rbtnode->data : NULL;
+	     header != NULL;
+	     header = header_next)
+	{
 		header_next = header->next;
 		do {
 			if (header->serial <= serial &&
@@ -5682,6 +6139,7 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	isc_result_t result;
 	nodelock_t *lock;
 	isc_rwlocktype_t locktype;
+	isc_boolean_t walk;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	REQUIRE(type != dns_rdatatype_any);
@@ -5706,7 +6164,37 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	else
 		sigmatchtype = 0;
 
-	for (header = rbtnode->data; header != NULL; header = header_next) {
+	/*
+	 * Use the type index if there is one, unless more than one of
+	 * the type and the negative entries that could answer for it is
+	 * present: then only the walk of the list decides between them.
+	 */
+	walk = ISC_TRUE;
+	if (rbtnode->typeindex != NULL) {
+		rdatasetheader_t *neg, *nxdomain;
+
+		found = cache_findtype(rbtnode, matchtype, now);
+		neg = cache_findtype(rbtnode, negtype, now);
+		nxdomain = cache_findtype(rbtnode, RBTDB_RDATATYPE_NCACHEANY,
+					  now);
+		if (neg != NULL) {
+			walk = ISC_TF(found != NULL || nxdomain != NULL);
+			found = neg;
+		} else if (nxdomain != NULL) {
+			walk = ISC_TF(found != NULL);
+			found = nxdomain;
+		} else
+			walk = ISC_FALSE;
+		if (walk)
+			found = NULL;
+		else if (found != NULL && sigmatchtype != 0)
+			foundsig = cache_findtype(rbtnode, sigmatchtype, now);
+	}
+
+	for (header = walk ? rbtnode->data : NULL;
+	     header != NULL;
+	     header = header_next)
+	{
 		header_next = header->next;
 		if (!ACTIVE(header, now)) {
 			if ((header->rdh_ttl < now - RBTDB_VIRTUAL) &&
@@ -6260,6 +6748,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 		else
 			rbtnode->data = newheader;
 		newheader->next = topheader->next;
+		update_typeindex(rbtdb, rbtnode);
 		if (rbtversion != NULL)
 			RWLOCK(&rbtversion->rwlock, isc_rwlocktype_write);
 		if (rbtversion != NULL && !header_nx) {
@@ -6292,15 +6781,9 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				if (ZEROTTL(newheader))
-					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
-							newheader, link);
-				else
-					ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-							 newheader, link);
-				INSIST(rbtdb->heaps != NULL);
-				(void)isc_heap_insert(rbtdb->heaps[idx],
-						      newheader);
+				lru_insert(rbtdb, idx, newheader);
+				INSIST(rbtdb->ttlwheels != NULL);
+				(void)ttl_insert(rbtdb, idx, newheader);
 			} else if (RESIGN(newheader)) {
 				result = resign_insert(rbtdb, idx, newheader);
 				if (result != ISC_R_SUCCESS)
@@ -6322,12 +6805,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			}
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				if (ZEROTTL(newheader))
-					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
-							newheader, link);
-				else
-					ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-							 newheader, link);
+				lru_insert(rbtdb, idx, newheader);
 				/*
 				 * XXXMLG We don't check the return value
 				 * here.  If it fails, we will not do TTL
@@ -6335,9 +6813,8 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 				 * will do it on the LRU side, so memory
 				 * will not leak... for long.
 				 */
-				INSIST(rbtdb->heaps != NULL);
-				(void)isc_heap_insert(rbtdb->heaps[idx],
-						      newheader);
+				INSIST(rbtdb->ttlwheels != NULL);
+				(void)ttl_insert(rbtdb, idx, newheader);
 			} else if (RESIGN(newheader)) {
 				resign_delete(rbtdb, rbtversion, header);
 				result = resign_insert(rbtdb, idx, newheader);
@@ -6389,6 +6866,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			newheader->down = NULL;
 			rbtnode->data = newheader;
 		}
+		update_typeindex(rbtdb, rbtnode);
 		if (rbtversion != NULL && !newheader_nx) {
 			RWLOCK(&rbtversion->rwlock, isc_rwlocktype_write);
 			rbtversion->records +=
@@ -6401,13 +6879,8 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 		}
 		idx = newheader->node->locknum;
 		if (IS_CACHE(rbtdb)) {
-			if (ZEROTTL(newheader))
-				ISC_LIST_APPEND(rbtdb->rdatasets[idx],
-						newheader, link);
-			else
-				ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-						 newheader, link);
-			isc_heap_insert(rbtdb->heaps[idx], newheader);
+			lru_insert(rbtdb, idx, newheader);
+			(void)ttl_insert(rbtdb, idx, newheader);
 		} else if (RESIGN(newheader)) {
 			resign_delete(rbtdb, rbtversion, header);
 			result = resign_insert(rbtdb, idx, newheader);
@@ -6610,7 +7083,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->closest = NULL;
 	newheader->count = init_count++;
 	newheader->trust = rdataset->trust;
-	newheader->last_used = now;
+	newheader->visited = 0;
 	newheader->node = rbtnode;
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
@@ -6702,8 +7175,8 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		if (tree_locked)
 			cleanup_dead_nodes(rbtdb, rbtnode->locknum);
 
-		header = isc_heap_element(rbtdb->heaps[rbtnode->locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL)
+		header = ttl_expired(rbtdb, rbtnode->locknum, now);
+		if (header != NULL)
 			expire_header(rbtdb, header, tree_locked,
 				      expire_ttl);
 
@@ -6796,7 +7269,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
-	newheader->last_used = 0;
+	newheader->visited = 0;
 	newheader->node = rbtnode;
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
 		newheader->attributes |= RDATASET_ATTR_RESIGN;
@@ -6895,10 +7368,10 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			newheader->noqname = NULL;
 			newheader->closest = NULL;
 			newheader->count = 0;
+			newheader->visited = 0;
 			newheader->node = rbtnode;
 			newheader->resign = 0;
 			newheader->resign_lsb = 0;
-			newheader->last_used = 0;
 		} else {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			goto unlock;
@@ -6924,6 +7397,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		topheader->next = newheader;
 		rbtnode->dirty = 1;
 		changed->dirty = ISC_TRUE;
+		update_typeindex(rbtdb, rbtnode);
 		resign_delete(rbtdb, rbtversion, header);
 	} else {
 		/*
@@ -6991,7 +7465,7 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	else
 		newheader->serial = 0;
 	newheader->count = 0;
-	newheader->last_used = 0;
+	newheader->visited = 0;
 	newheader->node = rbtnode;
 
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
@@ -7182,7 +7656,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
-	newheader->last_used = 0;
+	newheader->visited = 0;
 	newheader->node = node;
 	setownercase(newheader, name);
 
@@ -7228,7 +7702,8 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 		count = dns_rdataslab_count(p, sizeof(*header));;
 		rbtdb->current_version->records += count;
 		rbtdb->current_version->bytes += size;
-		isc_crc64_update(crc, p, size);
+		if (crc != NULL)
+			isc_crc64_update(crc, p, size);
 #ifdef DEBUG
 		hexdump("hashing header", p, sizeof(rdatasetheader_t));
 		hexdump("hashing slab", p + sizeof(rdatasetheader_t),
@@ -7261,9 +7736,116 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 		}
 	}
 
+	if (rbtdb != NULL)
+		update_typeindex(rbtdb, rbtnode);
+
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Map images whose checksums have been verified by this process, one
+ * slot per zone name hash.  Every view serving a zone loads the same
+ * image, and so does a reload of an unchanged zone file; only the first
+ * of these loads computes the checksums, the others only check the
+ * structure of the trees as they fix them up.  An image is identified
+ * by its file, its size and modification times to the nanosecond where
+ * the platform records them, and the checksums stored in its tree
+ * headers, so an image rewritten within the same second is verified
+ * again.  Zones whose names share a slot evict each other.
+ */
+#define MAPZONES	1024
+
+typedef struct {
+	unsigned int			namehash;
+	dev_t				dev;
+	ino_t				ino;
+	off_t				size;
+	isc_time_t			mtime;
+	isc_time_t			ctime;
+	isc_uint64_t			crc[3];
+} mapimage_t;
+
+static mapimage_t mapimages[MAPZONES];
+static isc_mutex_t mapimage_lock;
+static isc_once_t mapimage_once = ISC_ONCE_INIT;
+
+static void
+mapimage_initlock(void) {
+	RUNTIME_CHECK(isc_mutex_init(&mapimage_lock) == ISC_R_SUCCESS);
+}
+
+/*
+ * Fill in 'image' for the image of 'rbtdb' in 'fd', mapped at 'base'.
+ * Returns ISC_FALSE if the image can't be identified.
+ */
+static isc_boolean_t
+mapimage_key(dns_rbtdb_t *rbtdb, int fd, char *base, off_t filesize,
+	     rbtdb_file_header_t *header, mapimage_t *image)
+{
+	struct stat sb;
+	isc_uint64_t offsets[3];
+	unsigned int i;
+
+	if (fstat(fd, &sb) != 0)
+		return (ISC_FALSE);
+
+	memset(image, 0, sizeof(*image));
+	image->namehash = dns_name_hash(&rbtdb->common.origin, ISC_FALSE);
+	image->dev = sb.st_dev;
+	image->ino = sb.st_ino;
+	image->size = sb.st_size;
+#ifdef ISC_PLATFORM_HAVESTATNSEC
+	isc_time_set(&image->mtime, sb.st_mtime, sb.st_mtim.tv_nsec);
+	isc_time_set(&image->ctime, sb.st_ctime, sb.st_ctim.tv_nsec);
+#else
+	isc_time_set(&image->mtime, sb.st_mtime, 0);
+	isc_time_set(&image->ctime, sb.st_ctime, 0);
+#endif
+
+	offsets[0] = header->tree;
+	offsets[1] = header->nsec;
+	offsets[2] = header->nsec3;
+	for (i = 0; i < 3; i++) {
+		if (offsets[i] != 0 &&
+		    dns_rbt_imagecrc(base, filesize, (off_t) offsets[i],
+				     &image->crc[i]) != ISC_R_SUCCESS)
+			return (ISC_FALSE);
+	}
+
+	return (ISC_TRUE);
+}
+
+/*
+ * Has 'image' already been verified?
+ */
+static isc_boolean_t
+mapimage_verified(const mapimage_t *image) {
+	isc_boolean_t found;
+
+	RUNTIME_CHECK(isc_once_do(&mapimage_once, mapimage_initlock) ==
+		      ISC_R_SUCCESS);
+
+	LOCK(&mapimage_lock);
+	found = ISC_TF(memcmp(&mapimages[image->namehash % MAPZONES], image,
+			      sizeof(*image)) == 0);
+	UNLOCK(&mapimage_lock);
+
+	return (found);
+}
+
+/*
+ * Remember that 'image' has been verified.
+ */
+static void
+mapimage_setverified(const mapimage_t *image) {
+	RUNTIME_CHECK(isc_once_do(&mapimage_once, mapimage_initlock) ==
+		      ISC_R_SUCCESS);
+
+	LOCK(&mapimage_lock);
+	memmove(&mapimages[image->namehash % MAPZONES], image, sizeof(*image));
+	UNLOCK(&mapimage_lock);
+}
+
 /*
  * Load the RBT database from the image in 'f'
  */
@@ -7279,6 +7861,8 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	dns_rbt_t *tree = NULL, *nsec = NULL, *nsec3 = NULL;
 	int protect, flags;
 	dns_rbtnode_t *origin_node = NULL;
+	isc_boolean_t verify, known;
+	mapimage_t image;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
@@ -7303,13 +7887,17 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 
 	header = (rbtdb_file_header_t *)(base + offset);
 
+	known = mapimage_key(rbtdb, fd, base, filesize, header, &image);
+	verify = ISC_TF(!known || !mapimage_verified(&image));
+
 	if (header->tree != 0) {
-		result = dns_rbt_deserialize_tree(base, filesize,
-						  (off_t) header->tree,
-						  rbtdb->common.mctx,
-						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
-						  NULL, &tree);
+		result = dns_rbt_deserialize_tree2(base, filesize,
+						   (off_t) header->tree,
+						   verify,
+						   rbtdb->common.mctx,
+						   delete_callback, rbtdb,
+						   rbt_datafixer, rbtdb,
+						   NULL, &tree);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 
@@ -7321,23 +7909,25 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	}
 
 	if (header->nsec != 0) {
-		result = dns_rbt_deserialize_tree(base, filesize,
-						  (off_t) header->nsec,
-						  rbtdb->common.mctx,
-						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
-						  NULL, &nsec);
+		result = dns_rbt_deserialize_tree2(base, filesize,
+						   (off_t) header->nsec,
+						   verify,
+						   rbtdb->common.mctx,
+						   delete_callback, rbtdb,
+						   rbt_datafixer, rbtdb,
+						   NULL, &nsec);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 	}
 
 	if (header->nsec3 != 0) {
-		result = dns_rbt_deserialize_tree(base, filesize,
-						  (off_t) header->nsec3,
-						  rbtdb->common.mctx,
-						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
-						  NULL, &nsec3);
+		result = dns_rbt_deserialize_tree2(base, filesize,
+						   (off_t) header->nsec3,
+						   verify,
+						   rbtdb->common.mctx,
+						   delete_callback, rbtdb,
+						   rbt_datafixer, rbtdb,
+						   NULL, &nsec3);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 	}
@@ -7347,6 +7937,9 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	 * rbtdb to use them.
 	 */
 
+	if (known && verify)
+		mapimage_setverified(&image);
+
 	rbtdb->mmap_location = base;
 	rbtdb->mmap_size = (size_t) filesize;
 
@@ -7674,6 +8267,7 @@ delete_callback(void *data, void *arg) {
 	current = data;
 	locknum = current->node->locknum;
 	NODE_LOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
+	free_typeindex(rbtdb, current->node);
 	while (current != NULL) {
 		next = current->next;
 		free_rdataset(rbtdb, rbtdb->common.mctx, current);
@@ -7860,6 +8454,48 @@ getsize(dns_db_t *db, dns_dbversion_t *version, isc_uint64_t *records,
 	return (result);
 }
 
+#ifndef DNS_RBTDB_VERSION64
+/*
+ * A version is identified by the number of its database and its serial.
+ * Every database is given a number of its own when it is created.  The
+ * 64 bit serials of "rbt64" leave no room for one.
+ */
+static isc_once_t instance_once = ISC_ONCE_INIT;
+static isc_mutex_t instance_lock;
+static isc_uint32_t instance_next = 0;
+
+static void
+instance_initlock(void) {
+	RUNTIME_CHECK(isc_mutex_init(&instance_lock) == ISC_R_SUCCESS);
+}
+
+static isc_uint32_t
+new_instance(void) {
+	isc_uint32_t instance;
+
+	RUNTIME_CHECK(isc_once_do(&instance_once, instance_initlock) ==
+		      ISC_R_SUCCESS);
+	LOCK(&instance_lock);
+	instance = ++instance_next;
+	UNLOCK(&instance_lock);
+
+	return (instance);
+}
+
+static isc_result_t
+getversionid(dns_db_t *db, dns_dbversion_t *version, isc_uint64_t *idp) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	rbtdb_version_t *rbtversion = version;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	INSIST(rbtversion->rbtdb == rbtdb);
+
+	*idp = ((isc_uint64_t)rbtdb->instance << 32) | rbtversion->serial;
+
+	return (ISC_R_SUCCESS);
+}
+#endif /* DNS_RBTDB_VERSION64 */
+
 static isc_result_t
 setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
@@ -8076,7 +8712,12 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 	hashsize,
 	nodefullname,
-	getsize
+	getsize,
+#ifndef DNS_RBTDB_VERSION64
+	getversionid
+#else
+	NULL
+#endif
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -8124,6 +8765,7 @@ static dns_dbmethods_t cache_methods = {
 	setcachestats,
 	hashsize,
 	nodefullname,
+	NULL,
 	NULL
 };
 
@@ -8141,12 +8783,8 @@ dns_rbtdb_create
 	isc_result_t result;
 	int i;
 	dns_name_t name;
-	isc_boolean_t (*sooner)(void *, void *);
 	isc_mem_t *hmctx = mctx;
 
-	/* Keep the compiler happy. */
-	UNUSED(driverarg);
-
 	rbtdb = isc_mem_get(mctx, sizeof(*rbtdb));
 	if (rbtdb == NULL)
 		return (ISC_R_NOMEMORY);
@@ -8180,6 +8818,7 @@ dns_rbtdb_create
 	result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
+	isc_rwlock_setreaderbias(&rbtdb->tree_lock, ISC_TRUE);
 
 	/*
 	 * Initialize node_lock_count in a generic way to support future
@@ -8207,7 +8846,16 @@ dns_rbtdb_create
 	rbtdb->cachestats = NULL;
 	rbtdb->rrsetstats = NULL;
 	if (IS_CACHE(rbtdb)) {
-		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
+		/*
+		 * If driverarg is set, the rdatasets are counted in the
+		 * statistics of the database this one is a part of.
+		 */
+		if (driverarg != NULL) {
+			dns_stats_attach(driverarg, &rbtdb->rrsetstats);
+			result = ISC_R_SUCCESS;
+		} else
+			result = dns_rdatasetstats_create(mctx,
+							  &rbtdb->rrsetstats);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_node_locks;
 		rbtdb->rdatasets = isc_mem_get(mctx, rbtdb->node_lock_count *
@@ -8222,22 +8870,42 @@ dns_rbtdb_create
 		rbtdb->rdatasets = NULL;
 
 	/*
-	 * Create the heaps.
+	 * Create the TTL wheels for a cache, or the heaps for a zone.
 	 */
-	rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
-				   sizeof(isc_heap_t *));
-	if (rbtdb->heaps == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto cleanup_rdatasets;
-	}
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++)
-		rbtdb->heaps[i] = NULL;
-	sooner = IS_CACHE(rbtdb) ? ttl_sooner : resign_sooner;
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		result = isc_heap_create(hmctx, sooner, set_index, 0,
-					 &rbtdb->heaps[i]);
-		if (result != ISC_R_SUCCESS)
-			goto cleanup_heaps;
+	rbtdb->heaps = NULL;
+	rbtdb->ttlwheels = NULL;
+	if (IS_CACHE(rbtdb)) {
+		isc_stdtime_t now;
+
+		rbtdb->ttlwheels = isc_mem_get(hmctx,
+					       rbtdb->node_lock_count *
+					       sizeof(ttlwheel_t));
+		if (rbtdb->ttlwheels == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup_rdatasets;
+		}
+		memset(rbtdb->ttlwheels, 0,
+		       rbtdb->node_lock_count * sizeof(ttlwheel_t));
+		isc_stdtime_get(&now);
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++)
+			rbtdb->ttlwheels[i].cursor =
+				(now - RBTDB_VIRTUAL) / TTLWHEEL_GRANULE;
+	} else {
+		rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
+					   sizeof(isc_heap_t *));
+		if (rbtdb->heaps == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup_rdatasets;
+		}
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++)
+			rbtdb->heaps[i] = NULL;
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
+			result = isc_heap_create(hmctx, resign_sooner,
+						 set_index, 0,
+						 &rbtdb->heaps[i]);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup_heaps;
+		}
 	}
 
 	/*
@@ -8270,6 +8938,7 @@ dns_rbtdb_create
 			goto cleanup_deadnodes;
 		}
 		rbtdb->node_locks[i].exiting = ISC_FALSE;
+		rbtdb->node_locks[i].lruhand = NULL;
 	}
 
 	/*
@@ -8396,6 +9065,9 @@ dns_rbtdb_create
 	/*
 	 * Version Initialization.
 	 */
+#ifndef DNS_RBTDB_VERSION64
+	rbtdb->instance = new_instance();
+#endif
 	rbtdb->current_serial = 1;
 	rbtdb->least_serial = 1;
 	rbtdb->next_serial = 2;
@@ -8458,6 +9130,9 @@ dns_rbtdb_create
 		isc_mem_put(hmctx, rbtdb->heaps,
 			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
 	}
+	if (rbtdb->ttlwheels != NULL)
+		isc_mem_put(hmctx, rbtdb->ttlwheels,
+			    rbtdb->node_lock_count * sizeof(ttlwheel_t));
 
  cleanup_rdatasets:
 	if (rbtdb->rdatasets != NULL)
@@ -10156,70 +10831,78 @@ no_glue:
  */
 
 /*%
- * See if a given cache entry that is being reused needs to be updated
- * in the LRU-list.  From the LRU management point of view, this function is
- * expected to return true for almost all cases.  When used with threads,
- * however, this may cause a non-negligible performance penalty because a
- * writer lock will have to be acquired before updating the list.
- * If DNS_RBTDB_LIMITLRUUPDATE is defined to be non 0 at compilation time, this
- * function returns true if the entry has not been updated for some period of
- * time.  We differentiate the NS or glue address case and the others since
- * experiments have shown that the former tends to be accessed relatively
- * infrequently and the cost of cache miss is higher (e.g., a missing NS records
- * may cause external queries at a higher level zone, involving more
- * transactions).
+ * Add a new cache entry to its LRU list.  Entries with a zero TTL are
+ * placed where the next sweep of overmem_purge() starts, so that they
+ * are the first to go; others are added at the head of the list.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static inline void
+lru_insert(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *header) {
+	rdatasetheader_t *hand = rbtdb->node_locks[idx].lruhand;
+
+	if (!ZEROTTL(header))
+		ISC_LIST_PREPEND(rbtdb->rdatasets[idx], header, link);
+	else if (hand == NULL)
+		ISC_LIST_APPEND(rbtdb->rdatasets[idx], header, link);
+	else {
+		ISC_LIST_INSERTAFTER(rbtdb->rdatasets[idx], hand, header,
+				     link);
+		rbtdb->node_locks[idx].lruhand = header;
+	}
+}
+
+/*%
+ * Remove a cache entry from its LRU list, moving the sweep position of
+ * overmem_purge() past it if necessary.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static inline void
+lru_unlink(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *header) {
+	if (rbtdb->node_locks[idx].lruhand == header)
+		rbtdb->node_locks[idx].lruhand = ISC_LIST_PREV(header, link);
+	ISC_LIST_UNLINK(rbtdb->rdatasets[idx], header, link);
+}
+
+/*%
+ * See if a given cache entry that is being reused needs to be marked as
+ * recently used.  Entries that are going away anyway are not, and
+ * entries already marked are skipped so that a popular entry is not
+ * written to on every lookup.
  *
  * Caller must hold the node (read or write) lock.
  */
 static inline isc_boolean_t
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
+need_headerupdate(rdatasetheader_t *header) {
 	if ((header->attributes &
 	     (RDATASET_ATTR_NONEXISTENT |
 	      RDATASET_ATTR_STALE |
 	      RDATASET_ATTR_ZEROTTL)) != 0)
 		return (ISC_FALSE);
 
-#if DNS_RBTDB_LIMITLRUUPDATE
-	if (header->type == dns_rdatatype_ns ||
-	    (header->trust == dns_trust_glue &&
-	     (header->type == dns_rdatatype_a ||
-	      header->type == dns_rdatatype_aaaa))) {
-		/*
-		 * Glue records are updated if at least 60 seconds have passed
-		 * since the previous update time.
-		 */
-		return (header->last_used + 60 <= now);
-	}
-
-	/* Other records are updated if 5 minutes have passed. */
-	return (header->last_used + 300 <= now);
-#else
-	UNUSED(now);
-
-	return (ISC_TRUE);
-#endif
+	return (ISC_TF(header->visited == 0));
 }
 
 /*%
- * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
+ * Mark a given cache entry as recently used.  The entry is not moved in
+ * the LRU list; overmem_purge() will skip it (and clear the mark) the
+ * next time it gets there.  This means a lookup only needs the node read
+ * lock.
  *
- * Caller must hold the node (write) lock.
+ * Caller must hold the node (read or write) lock.
  *
  * Note that the we do NOT touch the heap here, as the TTL has not changed.
  */
-static void
-update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
-	      isc_stdtime_t now)
-{
+static inline void
+update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
 	INSIST(IS_CACHE(rbtdb));
 
-	/* To be checked: can we really assume this? XXXMLG */
-	INSIST(ISC_LINK_LINKED(header, link));
-
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
-	header->last_used = now;
-	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
+#ifdef ISC_PLATFORM_HAVEATOMICSTORE
+	isc_atomic_store(&header->visited, 1);
+#else
+	header->visited = 1;
+#endif
 }
 
 /*%
@@ -10231,6 +10914,13 @@ update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
  * entries of the same name of different RR types while adding RRsets from a
  * single response (consider the case where we're adding A and AAAA glue records
  * of the same NS name).
+ *
+ * Within a bucket the entries not used since the last sweep are found by
+ * moving the bucket's "hand" from the tail of the LRU list towards the head,
+ * clearing the mark of the entries which have been used and purging the first
+ * ones which have not.  The hand starts again at the tail when it falls off
+ * the head; since it clears the marks as it goes, it finds an entry to purge
+ * within one pass of the list.
  */
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
@@ -10246,17 +10936,26 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
 
-		header = isc_heap_element(rbtdb->heaps[locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL) {
+		header = ttl_expired(rbtdb, locknum, now);
+		if (header != NULL) {
 			expire_header(rbtdb, header, tree_locked,
 				      expire_ttl);
 			purgecount--;
 		}
 
-		for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
-		     header != NULL && purgecount > 0;
-		     header = header_prev) {
+		header = rbtdb->node_locks[locknum].lruhand;
+		if (header == NULL)
+			header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
+		while (header != NULL && purgecount > 0) {
 			header_prev = ISC_LIST_PREV(header, link);
+			if (header_prev == NULL)
+				header_prev =
+				     ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
+			if (header->visited != 0) {
+				header->visited = 0;
+				header = header_prev;
+				continue;
+			}
 			/*
 			 * Unlink the entry at this point to avoid checking it
 			 * again even if it's currently used someone else and
@@ -10266,10 +10965,14 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 			 */
 			ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header,
 					link);
+			if (header_prev == header)
+				header_prev = NULL;
 			expire_header(rbtdb, header, tree_locked,
 				      expire_lru);
 			purgecount--;
+			header = header_prev;
 		}
+		rbtdb->node_locks[locknum].lruhand = header;
 
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 				    isc_rwlocktype_write);
@@ -38,6 +38,10 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
  * allocation of heap memory.  Generally this is used for cache databases
  * only.
  *
+ * If 'driverarg' is set for a cache database, it is a dns_stats_t
+ * created by dns_rdatasetstats_create() in which to count the rdatasets
+ * of the database instead of its own.  dns_db_create() passes NULL.
+ *
  * Requires:
  *
  * \li argc == 0 or argv[0] is a valid memory context.
@@ -63,6 +63,9 @@
 #include <dns/tsig.h>
 #include <dns/validator.h>
 
+#include "fetchwindow.h"
+#include "hashindex.h"
+
 #ifdef WANT_QUERYTRACE
 #define RTRACE(m)       isc_log_write(dns_lctx, \
 				      DNS_LOGCATEGORY_RESOLVER, \
@@ -177,6 +180,28 @@
 #endif
 #define RES_NOBUCKET		0xffffffff
 
+/*
+ * With adaptive fetch quotas, each zone has a window of fetches that may
+ * be in progress for names in or beneath it.  The window grows by one
+ * for each window's worth of fetches that succeed and is halved, at most
+ * once a second, when a fetch fails after its queries timed out.  It is
+ * never less than one nor more than fetches-per-zone, or
+ * RES_ZONEWINDOWMAX if that is zero, and is forgotten once the zone has
+ * no fetches in progress.
+ */
+#define RES_ZONEWINDOWMAX	1000.0
+
+/*
+ * The fetch contexts are kept in at least RES_FCTX_BUCKETS lock buckets,
+ * however few tasks the resolver has; buckets beyond the number of tasks
+ * share the task and memory context of an earlier one.  Each bucket has
+ * a hash index of its live contexts, grown under the bucket's lock only,
+ * so joining a fetch in progress does not walk the bucket.
+ */
+#ifndef RES_FCTX_BUCKETS
+#define RES_FCTX_BUCKETS	1021		/* prime */
+#endif
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -270,6 +295,7 @@ struct fetchctx {
 	unsigned int			references;
 	isc_event_t			control_event;
 	ISC_LINK(struct fetchctx)       link;
+	dns_hashlink_t			hlink;
 	ISC_LIST(dns_fetchevent_t)      events;
 	/*% Locked by task event serialization. */
 	dns_name_t			domain;
@@ -412,12 +438,21 @@ struct dns_fetch {
 #define DNS_FETCH_MAGIC			ISC_MAGIC('F', 't', 'c', 'h')
 #define DNS_FETCH_VALID(fetch)		ISC_MAGIC_VALID(fetch, DNS_FETCH_MAGIC)
 
+typedef ISC_LIST(fetchctx_t) fetchctxlist_t;
+
 typedef struct fctxbucket {
 	isc_task_t *			task;
 	isc_mutex_t			lock;
-	ISC_LIST(fetchctx_t)		fctxs;
+	fetchctxlist_t			fctxs;
 	isc_boolean_t			exiting;
 	isc_mem_t *			mctx;
+	/*% Hash index of 'fctxs' */
+	dns_hashindex_t			index;
+	/*% Statistics */
+	isc_uint64_t			lookups;
+	isc_uint64_t			joins;
+	isc_uint64_t			creates;
+	unsigned int			maxcount;
 } fctxbucket_t;
 
 typedef struct fctxcount fctxcount_t;
@@ -428,6 +463,7 @@ struct fctxcount {
 	isc_uint32_t			allowed;
 	isc_uint32_t			dropped;
 	isc_stdtime_t			logged;
+	dns_fetchwindow_t		window;
 	ISC_LINK(fctxcount_t)		link;
 };
 
@@ -502,6 +538,7 @@ struct dns_resolver {
 	isc_boolean_t			priming;
 	unsigned int			spillat;	/* clients-per-query */
 	unsigned int			zspill;		/* fetches-per-zone */
+	isc_boolean_t			zadaptive;
 
 	dns_badcache_t  * 		badcache;	 /* Bad cache. */
 
@@ -1421,12 +1458,22 @@ fcount_logspill(fetchctx_t *fctx, fctxcount_t *counter) {
 	counter->logged = now;
 }
 
+/*%
+ * The largest fetch window of a zone: fetches-per-zone, or
+ * RES_ZONEWINDOWMAX when that is unlimited.
+ */
+static inline double
+zwindowmax(unsigned int spill) {
+	return (spill != 0 ? (double)spill : RES_ZONEWINDOWMAX);
+}
+
 static isc_result_t
 fcount_incr(fetchctx_t *fctx, isc_boolean_t force) {
 	isc_result_t result = ISC_R_SUCCESS;
 	zonebucket_t *dbucket;
 	fctxcount_t *counter;
 	unsigned int bucketnum, spill;
+	isc_boolean_t adaptive;
 
 	REQUIRE(fctx != NULL);
 	REQUIRE(fctx->res != NULL);
@@ -1437,6 +1484,7 @@ fcount_incr(fetchctx_t *fctx, isc_boolean_t force) {
 
 	LOCK(&fctx->res->lock);
 	spill = fctx->res->zspill;
+	adaptive = fctx->res->zadaptive;
 	UNLOCK(&fctx->res->lock);
 
 	dbucket = &fctx->res->dbuckets[bucketnum];
@@ -1460,12 +1508,16 @@ fcount_incr(fetchctx_t *fctx, isc_boolean_t force) {
 			counter->logged = 0;
 			counter->allowed = 1;
 			counter->dropped = 0;
+			dns_fetchwindow_init(&counter->window);
 			dns_fixedname_init(&counter->fdname);
 			counter->domain = dns_fixedname_name(&counter->fdname);
 			dns_name_copy(&fctx->domain, counter->domain, NULL);
 			ISC_LIST_APPEND(dbucket->list, counter, link);
 		}
 	} else {
+		if (adaptive)
+			spill = dns_fetchwindow_size(&counter->window,
+						     zwindowmax(spill));
 		if (!force && spill != 0 && counter->count >= spill) {
 			counter->dropped++;
 			fcount_logspill(fctx, counter);
@@ -1483,6 +1535,72 @@ fcount_incr(fetchctx_t *fctx, isc_boolean_t force) {
 	return (result);
 }
 
+/*
+ * Adjust the fetch window of the fetch context's zone now that the fetch
+ * has finished with 'result'.
+ */
+static void
+fcount_adjust(fetchctx_t *fctx, isc_result_t result) {
+	zonebucket_t *dbucket;
+	fctxcount_t *counter;
+	unsigned int spill, change;
+	isc_boolean_t adaptive, timedout;
+	isc_stdtime_t now;
+	double max;
+
+	REQUIRE(fctx != NULL);
+
+	if (fctx->dbucketnum == RES_NOBUCKET)
+		return;
+
+	LOCK(&fctx->res->lock);
+	spill = fctx->res->zspill;
+	adaptive = fctx->res->zadaptive;
+	UNLOCK(&fctx->res->lock);
+
+	/*
+	 * Only a success or a failure after a timeout says anything about
+	 * how well the zone's servers are keeping up.
+	 */
+	timedout = ISC_TF(result == ISC_R_TIMEDOUT ||
+			  (result != ISC_R_SUCCESS && fctx->timeouts != 0));
+	if (!adaptive || (result != ISC_R_SUCCESS && !timedout))
+		return;
+
+	max = zwindowmax(spill);
+	dbucket = &fctx->res->dbuckets[fctx->dbucketnum];
+
+	LOCK(&dbucket->lock);
+	for (counter = ISC_LIST_HEAD(dbucket->list);
+	     counter != NULL;
+	     counter = ISC_LIST_NEXT(counter, link))
+	{
+		if (dns_name_equal(counter->domain, &fctx->domain))
+			break;
+	}
+
+	if (counter != NULL) {
+		if (timedout) {
+			isc_stdtime_get(&now);
+			change = dns_fetchwindow_timeout(&counter->window,
+							 max, now);
+			if ((change & DNS_FETCHWINDOW_CLOSED) != 0)
+				inc_stats(fctx->res,
+					  dns_resstatscounter_zonewindowed);
+			if ((change & DNS_FETCHWINDOW_CUT) != 0)
+				inc_stats(fctx->res,
+					  dns_resstatscounter_zonewindowcuts);
+		} else {
+			change = dns_fetchwindow_success(&counter->window, max);
+			if ((change & DNS_FETCHWINDOW_OPENED) != 0)
+				dec_stats(fctx->res,
+					  dns_resstatscounter_zonewindowed);
+		}
+	}
+
+	UNLOCK(&dbucket->lock);
+}
+
 static void
 fcount_decr(fetchctx_t *fctx) {
 	zonebucket_t *dbucket;
@@ -1510,6 +1628,9 @@ fcount_decr(fetchctx_t *fctx) {
 		fctx->dbucketnum = RES_NOBUCKET;
 
 		if (counter->count == 0) {
+			if (counter->window.cut != 0)
+				dec_stats(fctx->res,
+					  dns_resstatscounter_zonewindowed);
 			ISC_LIST_UNLINK(dbucket->list, counter, link);
 			isc_mem_put(dbucket->mctx, counter, sizeof(*counter));
 		}
@@ -1647,6 +1768,7 @@ fctx_done(fetchctx_t *fctx, isc_result_t result, int line) {
 
 	fctx->reason = NULL;
 	fctx_stopeverything(fctx, no_response, age_untried);
+	fcount_adjust(fctx, result);
 
 	LOCK(&res->buckets[fctx->bucketnum].lock);
 
@@ -4056,6 +4178,7 @@ fctx_unlink(fetchctx_t *fctx) {
 	res = fctx->res;
 	bucketnum = fctx->bucketnum;
 
+	dns_hashindex_remove(&res->buckets[bucketnum].index, &fctx->hlink);
 	ISC_LIST_UNLINK(res->buckets[bucketnum].fctxs, fctx, link);
 
 	LOCK(&res->nlock);
@@ -4456,8 +4579,8 @@ log_ns_ttl(fetchctx_t *fctx, const char *where) {
 static isc_result_t
 fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	    const dns_name_t *domain, dns_rdataset_t *nameservers,
-	    unsigned int options, unsigned int bucketnum, unsigned int depth,
-	    isc_counter_t *qc, fetchctx_t **fctxp)
+	    unsigned int options, unsigned int bucketnum, unsigned int hashval,
+	    unsigned int depth, isc_counter_t *qc, fetchctx_t **fctxp)
 {
 	fetchctx_t *fctx;
 	isc_result_t result;
@@ -4468,6 +4591,7 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	char buf[DNS_NAME_FORMATSIZE + DNS_RDATATYPE_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	isc_mem_t *mctx;
+	fctxbucket_t *bucket;
 
 	/*
 	 * Caller must be holding the lock for bucket number 'bucketnum'.
@@ -4717,9 +4841,16 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 
 	ISC_LIST_INIT(fctx->events);
 	ISC_LINK_INIT(fctx, link);
+	ISC_LINK_INIT(&fctx->hlink, link);
 	fctx->magic = FCTX_MAGIC;
 
-	ISC_LIST_APPEND(res->buckets[bucketnum].fctxs, fctx, link);
+	bucket = &res->buckets[bucketnum];
+	ISC_LIST_APPEND(bucket->fctxs, fctx, link);
+	(void)dns_hashindex_add(bucket->mctx, &bucket->index, &fctx->hlink,
+				fctx, hashval);
+	if (bucket->index.count > bucket->maxcount)
+		bucket->maxcount = bucket->index.count;
+	bucket->creates++;
 
 	LOCK(&res->nlock);
 	res->nfctx++;
@@ -9426,6 +9557,8 @@ destroy(dns_resolver_t *res) {
 	DESTROYLOCK(&res->lock);
 	for (i = 0; i < res->nbuckets; i++) {
 		INSIST(ISC_LIST_EMPTY(res->buckets[i].fctxs));
+		dns_hashindex_free(res->buckets[i].mctx,
+				   &res->buckets[i].index);
 		isc_task_shutdown(res->buckets[i].task);
 		isc_task_detach(&res->buckets[i].task);
 		DESTROYLOCK(&res->buckets[i].lock);
@@ -9587,54 +9720,74 @@ dns_resolver_create(dns_view_t *view,
 	res->spillatmax = 100;
 	res->spillattimer = NULL;
 	res->zspill = 0;
+	res->zadaptive = ISC_FALSE;
 	res->zero_no_soa_ttl = ISC_FALSE;
 	res->query_timeout = DEFAULT_QUERY_TIMEOUT;
 	res->maxdepth = DEFAULT_RECURSION_DEPTH;
 	res->maxqueries = DEFAULT_MAX_QUERIES;
 	res->quotaresp[dns_quotatype_zone] = DNS_R_DROP;
 	res->quotaresp[dns_quotatype_server] = DNS_R_SERVFAIL;
-	res->nbuckets = ntasks;
+	res->nbuckets = ISC_MAX(ntasks, RES_FCTX_BUCKETS);
 	if (view->resstats != NULL)
-		isc_stats_set(view->resstats, ntasks,
+		isc_stats_set(view->resstats, res->nbuckets,
 			      dns_resstatscounter_buckets);
-	res->activebuckets = ntasks;
+	res->activebuckets = res->nbuckets;
 	res->buckets = isc_mem_get(view->mctx,
-				   ntasks * sizeof(fctxbucket_t));
+				   res->nbuckets * sizeof(fctxbucket_t));
 	if (res->buckets == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto cleanup_res;
 	}
-	for (i = 0; i < ntasks; i++) {
-		result = isc_mutex_init(&res->buckets[i].lock);
+	for (i = 0; i < res->nbuckets; i++) {
+		fctxbucket_t *bucket = &res->buckets[i];
+
+		result = isc_mutex_init(&bucket->lock);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_buckets;
-		res->buckets[i].task = NULL;
-		result = isc_task_create(taskmgr, 0, &res->buckets[i].task);
-		if (result != ISC_R_SUCCESS) {
-			DESTROYLOCK(&res->buckets[i].lock);
-			goto cleanup_buckets;
-		}
-		res->buckets[i].mctx = NULL;
-		snprintf(name, sizeof(name), "res%u", i);
+		bucket->task = NULL;
+		bucket->mctx = NULL;
+		if (i >= ntasks) {
+			/*
+			 * Share the task and memory context of an
+			 * earlier bucket.
+			 */
+			isc_task_attach(res->buckets[i % ntasks].task,
+					&bucket->task);
+			isc_mem_attach(res->buckets[i % ntasks].mctx,
+				       &bucket->mctx);
+		} else {
+			result = isc_task_create(taskmgr, 0, &bucket->task);
+			if (result != ISC_R_SUCCESS) {
+				DESTROYLOCK(&bucket->lock);
+				goto cleanup_buckets;
+			}
+			snprintf(name, sizeof(name), "res%u", i);
 #ifdef ISC_PLATFORM_USETHREADS
-		/*
-		 * Use a separate memory context for each bucket to reduce
-		 * contention among multiple threads.  Do this only when
-		 * enabling threads because it will be require more memory.
-		 */
-		result = isc_mem_create(0, 0, &res->buckets[i].mctx);
-		if (result != ISC_R_SUCCESS) {
-			isc_task_detach(&res->buckets[i].task);
-			DESTROYLOCK(&res->buckets[i].lock);
-			goto cleanup_buckets;
-		}
-		isc_mem_setname(res->buckets[i].mctx, name, NULL);
+			/*
+			 * Use a separate memory context for each task to
+			 * reduce contention among multiple threads.  Do this
+			 * only when enabling threads because it will be
+			 * require more memory.
+			 */
+			result = isc_mem_create(0, 0, &bucket->mctx);
+			if (result != ISC_R_SUCCESS) {
+				isc_task_detach(&bucket->task);
+				DESTROYLOCK(&bucket->lock);
+				goto cleanup_buckets;
+			}
+			isc_mem_setname(bucket->mctx, name, NULL);
 #else
-		isc_mem_attach(view->mctx, &res->buckets[i].mctx);
+			isc_mem_attach(view->mctx, &bucket->mctx);
 #endif
-		isc_task_setname(res->buckets[i].task, name, res);
-		ISC_LIST_INIT(res->buckets[i].fctxs);
-		res->buckets[i].exiting = ISC_FALSE;
+			isc_task_setname(bucket->task, name, res);
+		}
+		ISC_LIST_INIT(bucket->fctxs);
+		bucket->exiting = ISC_FALSE;
+		dns_hashindex_init(&bucket->index, res->nbuckets);
+		bucket->lookups = 0;
+		bucket->joins = 0;
+		bucket->creates = 0;
+		bucket->maxcount = 0;
 		buckets_created++;
 	}
 
@@ -10106,7 +10259,9 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 	dns_fetch_t *fetch;
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int bucketnum;
+	unsigned int bucketnum, hashval;
+	fctxbucket_t *bucket;
+	dns_hashlink_t *hlink;
 	isc_boolean_t new_fctx = ISC_FALSE;
 	isc_event_t *event;
 	unsigned int count = 0;
@@ -10141,25 +10296,34 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 	fetch->mctx = NULL;
 	isc_mem_attach(res->mctx, &fetch->mctx);
 
-	bucketnum = dns_name_fullhash(name, ISC_FALSE) % res->nbuckets;
+	hashval = dns_name_fullhash(name, ISC_FALSE);
+	bucketnum = hashval % res->nbuckets;
+	bucket = &res->buckets[bucketnum];
 
 	LOCK(&res->lock);
 	spillat = res->spillat;
 	spillatmin = res->spillatmin;
 	UNLOCK(&res->lock);
-	LOCK(&res->buckets[bucketnum].lock);
+	LOCK(&bucket->lock);
 
-	if (res->buckets[bucketnum].exiting) {
+	if (bucket->exiting) {
 		result = ISC_R_SHUTTINGDOWN;
 		goto unlock;
 	}
 
 	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
-		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
-		     fctx != NULL;
-		     fctx = ISC_LIST_NEXT(fctx, link)) {
-			if (fctx_match(fctx, name, type, options))
+		bucket->lookups++;
+		for (hlink = dns_hashindex_first(&bucket->index, hashval);
+		     hlink != NULL;
+		     hlink = ISC_LIST_NEXT(hlink, link))
+		{
+			if (hlink->hashval == hashval &&
+			    fctx_match(hlink->item, name, type, options))
+			{
+				fctx = hlink->item;
+				bucket->joins++;
 				break;
+			}
 		}
 	}
 
@@ -10191,7 +10355,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 
 	if (fctx == NULL) {
 		result = fctx_create(res, name, type, domain, nameservers,
-				     options, bucketnum, depth, qc, &fctx);
+				     options, bucketnum, hashval, depth, qc,
+				     &fctx);
 		if (result != ISC_R_SUCCESS)
 			goto unlock;
 		new_fctx = ISC_TRUE;
@@ -10210,7 +10375,7 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 				       DNS_EVENT_FETCHCONTROL,
 				       fctx_start, fctx, NULL,
 				       NULL, NULL);
-			isc_task_send(res->buckets[bucketnum].task, &event);
+			isc_task_send(bucket->task, &event);
 		} else {
 			/*
 			 * We don't care about the result of fctx_unlink()
@@ -10222,7 +10387,7 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 	}
 
  unlock:
-	UNLOCK(&res->buckets[bucketnum].lock);
+	UNLOCK(&bucket->lock);
 
 	if (dodestroy)
 		fctx_destroy(fctx);
@@ -10878,6 +11043,17 @@ dns_resolver_setfetchesperzone(dns_resolver_t *resolver, isc_uint32_t clients)
 	UNLOCK(&resolver->lock);
 }
 
+void
+dns_resolver_setzonequotaadaptive(dns_resolver_t *resolver,
+				  isc_boolean_t adaptive)
+{
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	LOCK(&resolver->lock);
+	resolver->zadaptive = adaptive;
+	UNLOCK(&resolver->lock);
+}
+
 
 isc_boolean_t
 dns_resolver_getzeronosoattl(dns_resolver_t *resolver) {
@@ -10975,7 +11151,7 @@ void
 dns_resolver_dumpfetches(dns_resolver_t *resolver,
 			 isc_statsformat_t format, FILE *fp)
 {
-	int i;
+	unsigned int i;
 
 	REQUIRE(VALID_RESOLVER(resolver));
 	REQUIRE(fp != NULL);
@@ -10989,11 +11165,36 @@ dns_resolver_dumpfetches(dns_resolver_t *resolver,
 		     fc = ISC_LIST_NEXT(fc, link))
 		{
 			dns_name_print(fc->domain, fp);
-			fprintf(fp, ": %d active (%d spilled, %d allowed)\n",
+			fprintf(fp, ": %d active (%d spilled, %d allowed",
 				fc->count, fc->dropped, fc->allowed);
+			if (fc->window.size != 0.0)
+				fprintf(fp, ", window %0.2f",
+					fc->window.size);
+			fprintf(fp, ")\n");
 		}
 		UNLOCK(&resolver->dbuckets[i].lock);
 	}
+
+	/*
+	 * Buckets that have never held a fetch context are left out.
+	 */
+	fprintf(fp, ";\n; Fetch context buckets: %u\n;\n",
+		resolver->nbuckets);
+	for (i = 0; i < resolver->nbuckets; i++) {
+		fctxbucket_t *bucket = &resolver->buckets[i];
+
+		LOCK(&bucket->lock);
+		if (bucket->maxcount != 0) {
+			fprintf(fp, "; bucket %u: %u active (%u most), "
+				"%u chains, %" ISC_PRINT_QUADFORMAT "u lookups, "
+				"%" ISC_PRINT_QUADFORMAT "u joined, "
+				"%" ISC_PRINT_QUADFORMAT "u created\n",
+				i, bucket->index.count, bucket->maxcount,
+				bucket->index.size, bucket->lookups,
+				bucket->joins, bucket->creates);
+		}
+		UNLOCK(&bucket->lock);
+	}
 }
 
 void
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/ht.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#define RESPCACHE_MAGIC		ISC_MAGIC('R', 'C', 'c', 'h')
+#define VALID_RESPCACHE(rc)	ISC_MAGIC_VALID(rc, RESPCACHE_MAGIC)
+
+/*%
+ * Number of independently locked parts of the cache.
+ */
+#define RC_STRIPES		16
+
+/*%
+ * Room for the fixed part of a key: type, class, UDP size and flags.
+ */
+#define RC_KEYHDR		10
+#define RC_KEYMAX		(RC_KEYHDR + DNS_NAME_MAXWIRE)
+
+/*%
+ * A response larger than this fraction of a stripe is not cached.
+ */
+#define RC_ENTRYSHARE		8
+
+typedef struct rcentry rcentry_t;
+typedef struct rcstripe rcstripe_t;
+
+/*%
+ * A cached response, and the database version it was built from.  The
+ * key and then the response follow the structure in the same
+ * allocation.
+ */
+struct rcentry {
+	ISC_LINK(rcentry_t)	link;
+	isc_uint64_t		versionid;
+	unsigned int		keylen;
+	unsigned int		length;
+};
+
+#define ENTRY_KEY(e)		((unsigned char *)((e) + 1))
+#define ENTRY_DATA(e)		(ENTRY_KEY(e) + (e)->keylen)
+#define ENTRY_SIZE(e)		(sizeof(rcentry_t) + (e)->keylen + (e)->length)
+
+/*%
+ * A stripe holds the responses whose keys hash to it.
+ */
+struct rcstripe {
+	isc_mutex_t		lock;
+	isc_ht_t *		entries;
+	ISC_LIST(rcentry_t)	lru;
+	size_t			used;
+};
+
+struct dns_respcache {
+	unsigned int		magic;
+	isc_mem_t *		mctx;
+	size_t			limit;
+	rcstripe_t		stripes[RC_STRIPES];
+};
+
+static unsigned int
+makekey(const dns_respcachekey_t *key, unsigned char *buf) {
+	const unsigned char *ndata = key->qname->ndata;
+	unsigned int i, len = key->qname->length;
+
+	buf[0] = (key->qtype >> 8) & 0xff;
+	buf[1] = key->qtype & 0xff;
+	buf[2] = (key->qclass >> 8) & 0xff;
+	buf[3] = key->qclass & 0xff;
+	buf[4] = (key->udpsize >> 8) & 0xff;
+	buf[5] = key->udpsize & 0xff;
+	buf[6] = (key->flags >> 24) & 0xff;
+	buf[7] = (key->flags >> 16) & 0xff;
+	buf[8] = (key->flags >> 8) & 0xff;
+	buf[9] = key->flags & 0xff;
+
+	/*
+	 * Label lengths are below 'A', so the whole of the wire form can be
+	 * folded in one pass.
+	 */
+	for (i = 0; i < len; i++) {
+		unsigned char c = ndata[i];
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		buf[RC_KEYHDR + i] = c;
+	}
+
+	return (RC_KEYHDR + len);
+}
+
+/*
+ * The hash tables index their buckets with the low bits of the same
+ * hash, so pick the stripe with the high bits.
+ */
+static inline rcstripe_t *
+getstripe(dns_respcache_t *rc, const unsigned char *key, unsigned int len) {
+	isc_uint32_t hash = isc_hash_function(key, len, ISC_TRUE, NULL);
+
+	return (&rc->stripes[(hash >> 24) % RC_STRIPES]);
+}
+
+static void
+unlink_entry(dns_respcache_t *rc, rcstripe_t *stripe, rcentry_t *entry) {
+	isc_result_t result;
+
+	result = isc_ht_delete(stripe->entries, ENTRY_KEY(entry),
+			       entry->keylen);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	stripe->used -= ENTRY_SIZE(entry);
+	isc_mem_put(rc->mctx, entry, ENTRY_SIZE(entry));
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t maxsize,
+		     dns_respcache_t **rcp)
+{
+	dns_respcache_t *rc;
+	isc_result_t result;
+	size_t expected;
+	isc_uint8_t bits;
+	int i;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxsize > 0);
+	REQUIRE(rcp != NULL && *rcp == NULL);
+
+	rc = isc_mem_get(mctx, sizeof(*rc));
+	if (rc == NULL)
+		return (ISC_R_NOMEMORY);
+
+	rc->mctx = NULL;
+	isc_mem_attach(mctx, &rc->mctx);
+	rc->limit = maxsize / RC_STRIPES;
+
+	/*
+	 * Size the tables for responses of a few hundred bytes.
+	 */
+	expected = rc->limit / 256;
+	for (bits = 6; bits < 16 && ((size_t)1 << bits) < expected; bits++)
+		;
+
+	for (i = 0; i < RC_STRIPES; i++) {
+		rcstripe_t *stripe = &rc->stripes[i];
+
+		stripe->entries = NULL;
+		ISC_LIST_INIT(stripe->lru);
+		stripe->used = 0;
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		result = isc_ht_init(&stripe->entries, mctx, bits);
+		if (result != ISC_R_SUCCESS) {
+			DESTROYLOCK(&stripe->lock);
+			goto cleanup;
+		}
+	}
+
+	rc->magic = RESPCACHE_MAGIC;
+	*rcp = rc;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0) {
+		isc_ht_destroy(&rc->stripes[i].entries);
+		DESTROYLOCK(&rc->stripes[i].lock);
+	}
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(*rc));
+	return (result);
+}
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp) {
+	dns_respcache_t *rc;
+	int i;
+
+	REQUIRE(rcp != NULL && VALID_RESPCACHE(*rcp));
+
+	rc = *rcp;
+	*rcp = NULL;
+
+	dns_respcache_flush(rc);
+
+	rc->magic = 0;
+	for (i = 0; i < RC_STRIPES; i++) {
+		isc_ht_destroy(&rc->stripes[i].entries);
+		DESTROYLOCK(&rc->stripes[i].lock);
+	}
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(*rc));
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		   dns_db_t *db, dns_dbversion_t *version,
+		   dns_messageid_t id, isc_buffer_t *target)
+{
+	unsigned char buf[RC_KEYMAX];
+	unsigned int keylen;
+	isc_uint64_t versionid;
+	rcstripe_t *stripe;
+	rcentry_t *entry = NULL;
+	isc_region_t r;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->qname));
+	REQUIRE(version != NULL);
+
+	result = dns_db_getversionid(db, version, &versionid);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+
+	keylen = makekey(key, buf);
+	stripe = getstripe(rc, buf, keylen);
+
+	LOCK(&stripe->lock);
+	result = isc_ht_find(stripe->entries, buf, keylen, (void **)&entry);
+	if (result != ISC_R_SUCCESS)
+		goto unlock;
+
+	if (entry->versionid != versionid) {
+		unlink_entry(rc, stripe, entry);
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+
+	isc_buffer_availableregion(target, &r);
+	if (r.length < entry->length) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	memmove(r.base, ENTRY_DATA(entry), entry->length);
+	r.base[0] = (id >> 8) & 0xff;
+	r.base[1] = id & 0xff;
+	memmove(r.base + DNS_MESSAGE_HEADERLEN, key->qname->ndata,
+		key->qname->length);
+	isc_buffer_add(target, entry->length);
+
+	if (entry != ISC_LIST_HEAD(stripe->lru)) {
+		ISC_LIST_UNLINK(stripe->lru, entry, link);
+		ISC_LIST_PREPEND(stripe->lru, entry, link);
+	}
+
+ unlock:
+	UNLOCK(&stripe->lock);
+	return (result);
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		  dns_db_t *db, dns_dbversion_t *version,
+		  const isc_region_t *response)
+{
+	unsigned char buf[RC_KEYMAX];
+	unsigned int keylen;
+	isc_uint64_t versionid;
+	rcstripe_t *stripe;
+	rcentry_t *entry = NULL, *old = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->qname));
+	REQUIRE(version != NULL);
+	REQUIRE(response != NULL &&
+		response->length >= DNS_MESSAGE_HEADERLEN +
+				    key->qname->length);
+
+	keylen = makekey(key, buf);
+	if (sizeof(*entry) + keylen + response->length >
+	    rc->limit / RC_ENTRYSHARE)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Without a version number there is no telling when the response
+	 * goes out of date.
+	 */
+	result = dns_db_getversionid(db, version, &versionid);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+	entry = isc_mem_get(rc->mctx,
+			    sizeof(*entry) + keylen + response->length);
+	if (entry == NULL)
+		return (ISC_R_NOMEMORY);
+	ISC_LINK_INIT(entry, link);
+	entry->versionid = versionid;
+	entry->keylen = keylen;
+	entry->length = response->length;
+	memmove(ENTRY_KEY(entry), buf, keylen);
+	memmove(ENTRY_DATA(entry), response->base, response->length);
+
+	stripe = getstripe(rc, buf, keylen);
+
+	LOCK(&stripe->lock);
+	result = isc_ht_find(stripe->entries, buf, keylen, (void **)&old);
+	if (result == ISC_R_SUCCESS)
+		unlink_entry(rc, stripe, old);
+	result = isc_ht_add(stripe->entries, buf, keylen, entry);
+	if (result != ISC_R_SUCCESS) {
+		UNLOCK(&stripe->lock);
+		isc_mem_put(rc->mctx, entry, ENTRY_SIZE(entry));
+		return (result);
+	}
+	ISC_LIST_PREPEND(stripe->lru, entry, link);
+	stripe->used += ENTRY_SIZE(entry);
+
+	while (stripe->used > rc->limit) {
+		old = ISC_LIST_TAIL(stripe->lru);
+		INSIST(old != NULL && old != entry);
+		unlink_entry(rc, stripe, old);
+	}
+	UNLOCK(&stripe->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_respcache_flush(dns_respcache_t *rc) {
+	rcentry_t *entry;
+	int i;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+
+	for (i = 0; i < RC_STRIPES; i++) {
+		rcstripe_t *stripe = &rc->stripes[i];
+
+		LOCK(&stripe->lock);
+		while ((entry = ISC_LIST_HEAD(stripe->lru)) != NULL)
+			unlink_entry(rc, stripe, entry);
+		INSIST(stripe->used == 0);
+		UNLOCK(&stripe->lock);
+	}
+}
@@ -0,0 +1,1383 @@
+/*
+ * Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/masterdump.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+#include <dns/stats.h>
+
+#include "rbtdb.h"
+#include "shardeddb.h"
+
+#define SHARDEDDB_MAGIC		ISC_MAGIC('S', 'h', 'D', 'B')
+#define VALID_SHARDEDDB(db)	((db) != NULL && \
+				 (db)->common.impmagic == SHARDEDDB_MAGIC)
+
+/*%
+ * The shards are "rbt" cache databases, and a node of one of them
+ * remembers the hash of its name.  The hash also selects the node lock
+ * within a shard as hashval % (number of node locks), so the shard is
+ * chosen from the high bits to keep the two choices independent.
+ */
+#define HASHSHARD(sdb, h)	(((h) >> 16) % (sdb)->nshards)
+#define NAMESHARD(sdb, name) \
+	HASHSHARD(sdb, dns_name_fullhash(name, ISC_FALSE))
+#define NODESHARD(sdb, node) \
+	HASHSHARD(sdb, ((dns_rbtnode_t *)(node))->hashval)
+
+typedef struct dns_shardeddb {
+	/* Unlocked. */
+	dns_db_t			common;
+	isc_refcount_t			references;
+	unsigned int			nshards;
+	dns_db_t			**shards;
+	dns_stats_t			*rrsetstats;
+} dns_shardeddb_t;
+
+typedef struct shardeddb_load {
+	dns_shardeddb_t			*sdb;
+	dns_rdatacallbacks_t		*callbacks;
+} shardeddb_load_t;
+
+/*%
+ * The database iterator merges the iterators of the shards.
+ *
+ * Every shard holds a node for the root name, and any shard may hold
+ * empty nodes for names whose own node is in another shard (the
+ * interior nodes of its tree); the iterator only returns a node from
+ * the shard its name hashes to, so that every name is returned once.
+ *
+ * When the iterator moves forward, each shard iterator other than the
+ * one at the cursor is positioned at the first of its names after the
+ * cursor, and when it moves backward at the last of its names before
+ * the cursor.  Names are always absolute.
+ */
+typedef struct shardeddb_subiter {
+	dns_dbiterator_t		*iter;
+	isc_result_t			result;
+	dns_fixedname_t			name;
+} shardeddb_subiter_t;
+
+typedef struct shardeddb_dbiterator {
+	dns_dbiterator_t		common;
+	isc_result_t			result;
+	unsigned int			current;
+	isc_boolean_t			forward;
+	isc_boolean_t			between;	/*%< After a partial
+							     seek: the cursor
+							     is between two
+							     names. */
+	dns_fixedname_t			name;
+	shardeddb_subiter_t		*subs;
+} shardeddb_dbiterator_t;
+
+static void		dbiterator_destroy(dns_dbiterator_t **iteratorp);
+static isc_result_t	dbiterator_first(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_last(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_seek(dns_dbiterator_t *iterator,
+					const dns_name_t *name);
+static isc_result_t	dbiterator_prev(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_next(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_current(dns_dbiterator_t *iterator,
+					   dns_dbnode_t **nodep,
+					   dns_name_t *name);
+static isc_result_t	dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_origin(dns_dbiterator_t *iterator,
+					  dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy,
+	dbiterator_first,
+	dbiterator_last,
+	dbiterator_seek,
+	dbiterator_prev,
+	dbiterator_next,
+	dbiterator_current,
+	dbiterator_pause,
+	dbiterator_origin
+};
+
+/*
+ * DB Routines
+ */
+
+static void
+attach(dns_db_t *source, dns_db_t **targetp) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)source;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&sdb->references, NULL);
+
+	*targetp = source;
+}
+
+static void
+free_shardeddb(dns_shardeddb_t *sdb) {
+	isc_mem_t *mctx = sdb->common.mctx;
+	isc_ondestroy_t ondest;
+	unsigned int i;
+
+	for (i = 0; i < sdb->nshards; i++)
+		if (sdb->shards[i] != NULL)
+			dns_db_detach(&sdb->shards[i]);
+	isc_mem_put(mctx, sdb->shards, sdb->nshards * sizeof(dns_db_t *));
+
+	if (sdb->rrsetstats != NULL)
+		dns_stats_detach(&sdb->rrsetstats);
+	if (dns_name_dynamic(&sdb->common.origin))
+		dns_name_free(&sdb->common.origin, mctx);
+	isc_refcount_destroy(&sdb->references);
+
+	sdb->common.impmagic = 0;
+	sdb->common.magic = 0;
+
+	ondest = sdb->common.ondest;
+	isc_mem_putanddetach(&sdb->common.mctx, sdb, sizeof(*sdb));
+	isc_ondestroy_notify(&ondest, sdb);
+}
+
+static void
+detach(dns_db_t **dbp) {
+	dns_shardeddb_t *sdb;
+	unsigned int refs;
+
+	REQUIRE(dbp != NULL);
+	sdb = (dns_shardeddb_t *)*dbp;
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	isc_refcount_decrement(&sdb->references, &refs);
+	if (refs == 0)
+		free_shardeddb(sdb);
+
+	*dbp = NULL;
+}
+
+static isc_result_t
+loading_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset)
+{
+	shardeddb_load_t *loadctx = arg;
+	dns_rdatacallbacks_t *callbacks;
+
+	callbacks = &loadctx->callbacks[NAMESHARD(loadctx->sdb, name)];
+	return ((callbacks->add)(callbacks->add_private, name, rdataset));
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	shardeddb_load_t *loadctx;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+
+	loadctx = isc_mem_get(sdb->common.mctx, sizeof(*loadctx));
+	if (loadctx == NULL)
+		return (ISC_R_NOMEMORY);
+	loadctx->sdb = sdb;
+	loadctx->callbacks = isc_mem_get(sdb->common.mctx,
+					 sdb->nshards *
+					 sizeof(dns_rdatacallbacks_t));
+	if (loadctx->callbacks == NULL) {
+		isc_mem_put(sdb->common.mctx, loadctx, sizeof(*loadctx));
+		return (ISC_R_NOMEMORY);
+	}
+
+	for (i = 0; i < sdb->nshards; i++) {
+		dns_rdatacallbacks_init(&loadctx->callbacks[i]);
+		result = dns_db_beginload(sdb->shards[i],
+					  &loadctx->callbacks[i]);
+		if (result != ISC_R_SUCCESS)
+			break;
+	}
+	if (result != ISC_R_SUCCESS) {
+		while (i-- > 0)
+			(void)dns_db_endload(sdb->shards[i],
+					     &loadctx->callbacks[i]);
+		isc_mem_put(sdb->common.mctx, loadctx->callbacks,
+			    sdb->nshards * sizeof(dns_rdatacallbacks_t));
+		isc_mem_put(sdb->common.mctx, loadctx, sizeof(*loadctx));
+		return (result);
+	}
+
+	callbacks->add = loading_addrdataset;
+	callbacks->add_private = loadctx;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	shardeddb_load_t *loadctx;
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	loadctx = callbacks->add_private;
+	REQUIRE(loadctx != NULL);
+	REQUIRE(loadctx->sdb == sdb);
+
+	for (i = 0; i < sdb->nshards; i++) {
+		tresult = dns_db_endload(sdb->shards[i],
+					 &loadctx->callbacks[i]);
+		if (tresult != ISC_R_SUCCESS && result == ISC_R_SUCCESS)
+			result = tresult;
+	}
+
+	callbacks->add = NULL;
+	callbacks->add_private = NULL;
+
+	isc_mem_put(sdb->common.mctx, loadctx->callbacks,
+		    sdb->nshards * sizeof(dns_rdatacallbacks_t));
+	isc_mem_put(sdb->common.mctx, loadctx, sizeof(*loadctx));
+
+	return (result);
+}
+
+static isc_result_t
+dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
+     dns_masterformat_t masterformat)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_master_dump2(sdb->common.mctx, db, version,
+				 &dns_master_style_default,
+				 filename, masterformat));
+}
+
+/*
+ * Cache databases have no versions to speak of; the shards ignore the
+ * version they are given, so the first shard keeps the books.
+ */
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	dns_db_currentversion(sdb->shards[0], versionp);
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_newversion(sdb->shards[0], versionp));
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	dns_db_attachversion(sdb->shards[0], source, targetp);
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	dns_db_closeversion(sdb->shards[0], versionp, commit);
+}
+
+static isc_result_t
+findnode(dns_db_t *db, const dns_name_t *name, isc_boolean_t create,
+	 dns_dbnode_t **nodep)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_findnode(sdb->shards[NAMESHARD(sdb, name)], name,
+				create, nodep));
+}
+
+static void
+unbind(dns_db_t *shard, dns_dbnode_t **nodep, dns_rdataset_t *rdataset,
+       dns_rdataset_t *sigrdataset)
+{
+	if (nodep != NULL && *nodep != NULL)
+		dns_db_detachnode(shard, nodep);
+	if (rdataset != NULL && dns_rdataset_isassociated(rdataset))
+		dns_rdataset_disassociate(rdataset);
+	if (sigrdataset != NULL && dns_rdataset_isassociated(sigrdataset))
+		dns_rdataset_disassociate(sigrdataset);
+}
+
+/*%
+ * Look for the deepest NS rdataset at 'name' or one of its ancestors
+ * which is deeper than 'minlabels' labels and no deeper than
+ * 'maxlabels' labels, skipping the names which belong to shard 'skip'
+ * as the caller has already searched it.  Each candidate is looked up
+ * in its own shard.
+ */
+static isc_result_t
+find_deepest_zonecut(dns_shardeddb_t *sdb, const dns_name_t *name,
+		     unsigned int skip, unsigned int minlabels,
+		     unsigned int maxlabels, isc_stdtime_t now,
+		     dns_dbnode_t **nodep, dns_name_t *foundname,
+		     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
+		     dns_db_t **shardp)
+{
+	dns_name_t suffix;
+	dns_dbnode_t *node;
+	dns_db_t *shard;
+	unsigned int labels, n;
+	isc_result_t result;
+
+	labels = dns_name_countlabels(name);
+	dns_name_init(&suffix, NULL);
+
+	for (n = maxlabels; n > minlabels; n--) {
+		dns_name_getlabelsequence(name, labels - n, n, &suffix);
+		shard = sdb->shards[NAMESHARD(sdb, &suffix)];
+		if (shard == sdb->shards[skip])
+			continue;
+
+		node = NULL;
+		result = dns_db_findnode(shard, &suffix, ISC_FALSE, &node);
+		if (result != ISC_R_SUCCESS)
+			continue;
+		result = dns_db_findrdataset(shard, node, NULL,
+					     dns_rdatatype_ns, 0, now,
+					     rdataset, sigrdataset);
+		if (result == ISC_R_SUCCESS)
+			result = dns_name_copy(&suffix, foundname, NULL);
+		if (result == ISC_R_SUCCESS) {
+			if (nodep != NULL)
+				*nodep = node;
+			else
+				dns_db_detachnode(shard, &node);
+			*shardp = shard;
+			return (DNS_R_DELEGATION);
+		}
+		/*
+		 * A negative cache entry for the NS type is not a zone cut.
+		 */
+		unbind(shard, &node, rdataset, sigrdataset);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+/*%
+ * Replace the results of a lookup in 'shard' with those of a lookup in
+ * 'newshard', which are held in the 'new' arguments.
+ */
+static isc_result_t
+rebind(dns_db_t *shard, dns_dbnode_t **nodep, dns_name_t *foundname,
+       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
+       dns_dbnode_t *newnode, dns_name_t *newname,
+       dns_rdataset_t *newrdataset, dns_rdataset_t *newsigrdataset)
+{
+	isc_result_t result;
+
+	result = dns_name_copy(newname, foundname, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	unbind(shard, nodep, rdataset, sigrdataset);
+	if (nodep != NULL)
+		*nodep = newnode;
+	if (rdataset != NULL)
+		dns_rdataset_clone(newrdataset, rdataset);
+	if (sigrdataset != NULL &&
+	    dns_rdataset_isassociated(newsigrdataset))
+		dns_rdataset_clone(newsigrdataset, sigrdataset);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * After a lookup in shard 'home' found no deeper zone cut above 'name'
+ * than 'foundname' ('result' is DNS_R_DELEGATION) or none at all
+ * ('result' is ISC_R_NOTFOUND), look for a deeper one in the other
+ * shards.
+ */
+static isc_result_t
+findcut_othershards(dns_shardeddb_t *sdb, const dns_name_t *name,
+		    unsigned int home, isc_result_t result,
+		    unsigned int maxlabels, isc_stdtime_t now,
+		    dns_dbnode_t **nodep, dns_name_t *foundname,
+		    dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_fixedname_t fname;
+	dns_name_t *cutname;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t cut, sigcut;
+	dns_db_t *shard = NULL;
+	unsigned int minlabels = 0;
+	isc_result_t tresult;
+
+	if (result == DNS_R_DELEGATION)
+		minlabels = dns_name_countlabels(foundname);
+	if (minlabels >= maxlabels)
+		return (result);
+
+	dns_fixedname_init(&fname);
+	cutname = dns_fixedname_name(&fname);
+	dns_rdataset_init(&cut);
+	dns_rdataset_init(&sigcut);
+
+	tresult = find_deepest_zonecut(sdb, name, home, minlabels, maxlabels,
+				       now, (nodep != NULL) ? &node : NULL,
+				       cutname, &cut, &sigcut, &shard);
+	if (tresult == DNS_R_DELEGATION) {
+		tresult = rebind(sdb->shards[home], nodep, foundname,
+				 rdataset, sigrdataset, node, cutname,
+				 &cut, &sigcut);
+		if (tresult == ISC_R_SUCCESS) {
+			node = NULL;
+			result = DNS_R_DELEGATION;
+		} else
+			result = tresult;
+		unbind(shard, &node, &cut, &sigcut);
+	}
+
+	return (result);
+}
+
+/*%
+ * Look for an NSEC rdataset covering 'name' in the shards other than
+ * 'home', and keep the one with the greatest owner name.
+ */
+static isc_result_t
+find_coveringnsec(dns_shardeddb_t *sdb, const dns_name_t *name,
+		  unsigned int home, dns_rdatatype_t type,
+		  unsigned int options, isc_stdtime_t now,
+		  dns_dbnode_t **nodep, dns_name_t *foundname,
+		  dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_fixedname_t fbest, fname;
+	dns_name_t *best, *fn;
+	dns_dbnode_t *bestnode = NULL, *node;
+	dns_rdataset_t bestset, bestsig, nsec, signsec;
+	dns_db_t *bestshard = NULL;
+	isc_result_t result;
+	unsigned int i;
+
+	dns_fixedname_init(&fbest);
+	best = dns_fixedname_name(&fbest);
+	dns_fixedname_init(&fname);
+	fn = dns_fixedname_name(&fname);
+	dns_rdataset_init(&bestset);
+	dns_rdataset_init(&bestsig);
+	dns_rdataset_init(&nsec);
+	dns_rdataset_init(&signsec);
+
+	for (i = 0; i < sdb->nshards; i++) {
+		if (i == home)
+			continue;
+		node = NULL;
+		result = dns_db_find(sdb->shards[i], name, NULL, type,
+				     options, now, &node, fn, &nsec, &signsec);
+		if (result == DNS_R_COVERINGNSEC &&
+		    (bestshard == NULL || dns_name_compare(fn, best) > 0))
+		{
+			unbind(bestshard, &bestnode, &bestset, &bestsig);
+			dns_name_copy(fn, best, NULL);
+			bestnode = node;
+			node = NULL;
+			dns_rdataset_clone(&nsec, &bestset);
+			if (dns_rdataset_isassociated(&signsec))
+				dns_rdataset_clone(&signsec, &bestsig);
+			bestshard = sdb->shards[i];
+		}
+		unbind(sdb->shards[i], &node, &nsec, &signsec);
+	}
+
+	if (bestshard == NULL)
+		return (ISC_R_NOTFOUND);
+
+	result = rebind(sdb->shards[home], nodep, foundname, rdataset,
+			sigrdataset, bestnode, best, &bestset, &bestsig);
+	if (result == ISC_R_SUCCESS) {
+		if (nodep != NULL)
+			bestnode = NULL;
+		result = DNS_R_COVERINGNSEC;
+	}
+	unbind(bestshard, &bestnode, &bestset, &bestsig);
+
+	return (result);
+}
+
+static isc_result_t
+find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+     dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+     dns_dbnode_t **nodep, dns_name_t *foundname,
+     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	unsigned int home;
+	isc_result_t result, tresult;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	if (now == 0)
+		isc_stdtime_get(&now);
+
+	home = NAMESHARD(sdb, name);
+	result = dns_db_find(sdb->shards[home], name, version, type, options,
+			     now, nodep, foundname, rdataset, sigrdataset);
+	if ((result != DNS_R_DELEGATION && result != ISC_R_NOTFOUND) ||
+	    sdb->nshards == 1)
+		return (result);
+
+	if ((options & DNS_DBFIND_COVERINGNSEC) != 0) {
+		tresult = find_coveringnsec(sdb, name, home, type, options,
+					    now, nodep, foundname, rdataset,
+					    sigrdataset);
+		if (tresult != ISC_R_NOTFOUND)
+			return (tresult);
+	}
+
+	/*
+	 * The lookup has fallen back to the deepest zone cut, but the home
+	 * shard only knows about the zone cuts at names that belong to it.
+	 */
+	return (findcut_othershards(sdb, name, home, result,
+				    dns_name_countlabels(name), now, nodep,
+				    foundname, rdataset, sigrdataset));
+}
+
+static isc_result_t
+findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
+	    isc_stdtime_t now, dns_dbnode_t **nodep, dns_name_t *foundname,
+	    dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	unsigned int home, maxlabels;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	if (now == 0)
+		isc_stdtime_get(&now);
+
+	home = NAMESHARD(sdb, name);
+	result = dns_db_findzonecut(sdb->shards[home], name, options, now,
+				    nodep, foundname, rdataset, sigrdataset);
+	if ((result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) ||
+	    sdb->nshards == 1)
+		return (result);
+
+	maxlabels = dns_name_countlabels(name);
+	if ((options & DNS_DBFIND_NOEXACT) != 0)
+		maxlabels--;
+	result = findcut_othershards(sdb, name, home,
+				     (result == ISC_R_SUCCESS) ?
+				     DNS_R_DELEGATION : result,
+				     maxlabels, now, nodep, foundname,
+				     rdataset, sigrdataset);
+	if (result == DNS_R_DELEGATION)
+		result = ISC_R_SUCCESS;
+	return (result);
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source, dns_dbnode_t **targetp) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	dns_db_attachnode(sdb->shards[NODESHARD(sdb, source)], source,
+			  targetp);
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+	REQUIRE(targetp != NULL && *targetp != NULL);
+
+	dns_db_detachnode(sdb->shards[NODESHARD(sdb, *targetp)], targetp);
+}
+
+static isc_result_t
+expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_expirenode(sdb->shards[NODESHARD(sdb, node)],
+				  node, now));
+}
+
+static void
+printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	dns_db_printnode(sdb->shards[NODESHARD(sdb, node)], node, out);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	shardeddb_dbiterator_t *sdbiter;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	sdbiter = isc_mem_get(sdb->common.mctx, sizeof(*sdbiter));
+	if (sdbiter == NULL)
+		return (ISC_R_NOMEMORY);
+	sdbiter->subs = isc_mem_get(sdb->common.mctx,
+				    sdb->nshards *
+				    sizeof(shardeddb_subiter_t));
+	if (sdbiter->subs == NULL) {
+		isc_mem_put(sdb->common.mctx, sdbiter, sizeof(*sdbiter));
+		return (ISC_R_NOMEMORY);
+	}
+
+	for (i = 0; i < sdb->nshards; i++) {
+		sdbiter->subs[i].iter = NULL;
+		sdbiter->subs[i].result = ISC_R_NOMORE;
+		dns_fixedname_init(&sdbiter->subs[i].name);
+		result = dns_db_createiterator(sdb->shards[i],
+					       options & ~DNS_DB_RELATIVENAMES,
+					       &sdbiter->subs[i].iter);
+		if (result != ISC_R_SUCCESS)
+			break;
+	}
+	if (result != ISC_R_SUCCESS) {
+		while (i-- > 0)
+			dns_dbiterator_destroy(&sdbiter->subs[i].iter);
+		isc_mem_put(sdb->common.mctx, sdbiter->subs,
+			    sdb->nshards * sizeof(shardeddb_subiter_t));
+		isc_mem_put(sdb->common.mctx, sdbiter, sizeof(*sdbiter));
+		return (result);
+	}
+
+	sdbiter->common.methods = &dbiterator_methods;
+	sdbiter->common.db = NULL;
+	dns_db_attach(db, &sdbiter->common.db);
+	sdbiter->common.relative_names = ISC_FALSE;
+	sdbiter->common.cleaning = ISC_FALSE;
+	sdbiter->common.magic = DNS_DBITERATOR_MAGIC;
+	sdbiter->result = ISC_R_NOMORE;
+	sdbiter->current = 0;
+	sdbiter->forward = ISC_TRUE;
+	sdbiter->between = ISC_FALSE;
+	dns_fixedname_init(&sdbiter->name);
+
+	*iteratorp = (dns_dbiterator_t *)sdbiter;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     dns_rdatatype_t type, dns_rdatatype_t covers,
+	     isc_stdtime_t now, dns_rdataset_t *rdataset,
+	     dns_rdataset_t *sigrdataset)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_findrdataset(sdb->shards[NODESHARD(sdb, node)], node,
+				    version, type, covers, now, rdataset,
+				    sigrdataset));
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     isc_stdtime_t now, dns_rdatasetiter_t **iteratorp)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_allrdatasets(sdb->shards[NODESHARD(sdb, node)], node,
+				    version, now, iteratorp));
+}
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_addrdataset(sdb->shards[NODESHARD(sdb, node)], node,
+				   version, now, rdataset, options,
+				   addedrdataset));
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_subtractrdataset(sdb->shards[NODESHARD(sdb, node)],
+					node, version, rdataset, options,
+					newrdataset));
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	       dns_rdatatype_t type, dns_rdatatype_t covers)
+{
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_deleterdataset(sdb->shards[NODESHARD(sdb, node)],
+				      node, version, type, covers));
+}
+
+static isc_boolean_t
+issecure(dns_db_t *db) {
+	UNUSED(db);
+
+	return (ISC_FALSE);
+}
+
+static unsigned int
+nodecount(dns_db_t *db) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	unsigned int i, count = 0;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		count += dns_db_nodecount(sdb->shards[i]);
+
+	return (count);
+}
+
+static isc_boolean_t
+ispersistent(dns_db_t *db) {
+	UNUSED(db);
+
+	return (ISC_FALSE);
+}
+
+static void
+overmem(dns_db_t *db, isc_boolean_t over) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		dns_db_overmem(sdb->shards[i], over);
+}
+
+static void
+settask(dns_db_t *db, isc_task_t *task) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		dns_db_settask(sdb->shards[i], task);
+}
+
+static isc_result_t
+getoriginnode(dns_db_t *db, dns_dbnode_t **nodep) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_getoriginnode(sdb->shards[NAMESHARD(sdb,
+							   &db->origin)],
+				     nodep));
+}
+
+static isc_boolean_t
+isdnssec(dns_db_t *db) {
+	UNUSED(db);
+
+	return (ISC_FALSE);
+}
+
+static dns_stats_t *
+getrrsetstats(dns_db_t *db) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (sdb->rrsetstats);
+}
+
+static isc_result_t
+setcachestats(dns_db_t *db, isc_stats_t *stats) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	for (i = 0; i < sdb->nshards; i++) {
+		result = dns_db_setcachestats(sdb->shards[i], stats);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static size_t
+hashsize(dns_db_t *db) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+	size_t size = 0;
+	unsigned int i;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	for (i = 0; i < sdb->nshards; i++)
+		size += dns_db_hashsize(sdb->shards[i]);
+
+	return (size);
+}
+
+static isc_result_t
+nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)db;
+
+	REQUIRE(VALID_SHARDEDDB(sdb));
+
+	return (dns_db_nodefullname(sdb->shards[NODESHARD(sdb, node)],
+				    node, name));
+}
+
+static dns_dbmethods_t shardeddb_methods = {
+	attach,
+	detach,
+	beginload,
+	endload,
+	NULL,			/* serialize */
+	dump,
+	currentversion,
+	newversion,
+	attachversion,
+	closeversion,
+	findnode,
+	find,
+	findzonecut,
+	attachnode,
+	detachnode,
+	expirenode,
+	printnode,
+	createiterator,
+	findrdataset,
+	allrdatasets,
+	addrdataset,
+	subtractrdataset,
+	deleterdataset,
+	issecure,
+	nodecount,
+	ispersistent,
+	overmem,
+	settask,
+	getoriginnode,
+	NULL,			/* transfernode */
+	NULL,			/* getnsec3parameters */
+	NULL,			/* findnsec3node */
+	NULL,			/* setsigningtime */
+	NULL,			/* getsigningtime */
+	NULL,			/* resigned */
+	isdnssec,
+	getrrsetstats,
+	NULL,			/* rpz_attach */
+	NULL,			/* rpz_ready */
+	NULL,			/* findnodeext */
+	NULL,			/* findext */
+	setcachestats,
+	hashsize,
+	nodefullname,
+	NULL,			/* getsize */
+	NULL			/* getversionid */
+};
+
+isc_result_t
+dns_shardeddb_create(isc_mem_t *mctx, const dns_name_t *origin,
+		     dns_dbtype_t type, dns_rdataclass_t rdclass,
+		     unsigned int argc, char *argv[], void *driverarg,
+		     dns_db_t **dbp)
+{
+	dns_shardeddb_t *sdb;
+	isc_result_t result;
+	unsigned long nshards;
+	char *end;
+	unsigned int i;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(origin == dns_rootname);
+	REQUIRE(type == dns_dbtype_cache);
+	REQUIRE(dbp != NULL && *dbp == NULL);
+
+	UNUSED(driverarg);
+
+	if (argc > 1) {
+		nshards = strtoul(argv[1], &end, 10);
+		if (*argv[1] == '\0' || *end != '\0' ||
+		    nshards < 1 || nshards > DNS_SHARDEDDB_MAXSHARDS)
+			return (ISC_R_RANGE);
+	} else {
+		nshards = isc_os_ncpus();
+		if (nshards > DNS_SHARDEDDB_MAXSHARDS)
+			nshards = DNS_SHARDEDDB_MAXSHARDS;
+	}
+
+	sdb = isc_mem_get(mctx, sizeof(*sdb));
+	if (sdb == NULL)
+		return (ISC_R_NOMEMORY);
+
+	memset(sdb, 0, sizeof(*sdb));
+	sdb->common.attributes = DNS_DBATTR_CACHE;
+	sdb->common.rdclass = rdclass;
+	sdb->common.methods = &shardeddb_methods;
+	ISC_LIST_INIT(sdb->common.update_listeners);
+	dns_name_init(&sdb->common.origin, NULL);
+	result = dns_name_dupwithoffsets(origin, mctx, &sdb->common.origin);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, sdb, sizeof(*sdb));
+		return (result);
+	}
+
+	result = isc_refcount_init(&sdb->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_origin;
+
+	result = dns_rdatasetstats_create(mctx, &sdb->rrsetstats);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_references;
+
+	sdb->nshards = (unsigned int)nshards;
+	sdb->shards = isc_mem_get(mctx, sdb->nshards * sizeof(dns_db_t *));
+	if (sdb->shards == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_rrsetstats;
+	}
+	for (i = 0; i < sdb->nshards; i++)
+		sdb->shards[i] = NULL;
+
+	/*
+	 * The shards count their rdatasets in our statistics (see
+	 * dns_rbtdb_create()).
+	 */
+	for (i = 0; i < sdb->nshards; i++) {
+		result = dns_rbtdb_create(mctx, origin, type, rdclass,
+					  (argc > 0) ? 1 : 0, argv,
+					  sdb->rrsetstats, &sdb->shards[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_shards;
+	}
+
+	sdb->common.mctx = NULL;
+	isc_mem_attach(mctx, &sdb->common.mctx);
+	isc_ondestroy_init(&sdb->common.ondest);
+	sdb->common.impmagic = SHARDEDDB_MAGIC;
+	sdb->common.magic = DNS_DB_MAGIC;
+
+	*dbp = (dns_db_t *)sdb;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup_shards:
+	for (i = 0; i < sdb->nshards; i++)
+		if (sdb->shards[i] != NULL)
+			dns_db_detach(&sdb->shards[i]);
+	isc_mem_put(mctx, sdb->shards, sdb->nshards * sizeof(dns_db_t *));
+ cleanup_rrsetstats:
+	dns_stats_detach(&sdb->rrsetstats);
+ cleanup_references:
+	isc_refcount_destroy(&sdb->references);
+ cleanup_origin:
+	dns_name_free(&sdb->common.origin, mctx);
+	isc_mem_put(mctx, sdb, sizeof(*sdb));
+
+	return (result);
+}
+
+/*
+ * Database Iterator Methods
+ */
+
+/*%
+ * Note the name at the position of shard iterator 'i', first moving it
+ * in the direction of the iteration past the nodes which belong to
+ * other shards.
+ */
+static void
+settle(shardeddb_dbiterator_t *sdbiter, unsigned int i) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)sdbiter->common.db;
+	shardeddb_subiter_t *sub = &sdbiter->subs[i];
+	dns_dbnode_t *node;
+	unsigned int shard;
+
+	while (sub->result == ISC_R_SUCCESS) {
+		node = NULL;
+		sub->result = dns_dbiterator_current(sub->iter, &node,
+					dns_fixedname_name(&sub->name));
+		if (sub->result == DNS_R_NEWORIGIN)
+			sub->result = ISC_R_SUCCESS;
+		if (sub->result != ISC_R_SUCCESS)
+			break;
+		shard = NODESHARD(sdb, node);
+		dns_db_detachnode(sdb->shards[i], &node);
+		if (shard == i)
+			break;
+		if (sdbiter->forward)
+			sub->result = dns_dbiterator_next(sub->iter);
+		else
+			sub->result = dns_dbiterator_prev(sub->iter);
+	}
+}
+
+/*%
+ * Move the cursor to the first (or, iterating backward, the last) of
+ * the names at the positions of the shard iterators.
+ */
+static isc_result_t
+pick(shardeddb_dbiterator_t *sdbiter) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)sdbiter->common.db;
+	shardeddb_subiter_t *sub;
+	isc_result_t result = ISC_R_NOMORE;
+	unsigned int i, best = 0;
+	int order;
+
+	for (i = 0; i < sdb->nshards; i++) {
+		sub = &sdbiter->subs[i];
+		if (sub->result == ISC_R_NOMORE)
+			continue;
+		if (sub->result != ISC_R_SUCCESS) {
+			result = sub->result;
+			break;
+		}
+		if (result == ISC_R_SUCCESS) {
+			order = dns_name_compare(
+				  dns_fixedname_name(&sub->name),
+				  dns_fixedname_name(&sdbiter->subs[best].name));
+			if (sdbiter->forward ? order >= 0 : order <= 0)
+				continue;
+		}
+		best = i;
+		result = ISC_R_SUCCESS;
+	}
+
+	sdbiter->between = ISC_FALSE;
+	sdbiter->result = result;
+	if (result == ISC_R_SUCCESS) {
+		sdbiter->current = best;
+		result = dns_name_copy(dns_fixedname_name(&sdbiter->subs[best].name),
+				       dns_fixedname_name(&sdbiter->name),
+				       NULL);
+	}
+
+	/*
+	 * Only the shard at the cursor needs to keep its tree locked.
+	 */
+	for (i = 0; i < sdb->nshards; i++)
+		if (sdbiter->result != ISC_R_SUCCESS || i != sdbiter->current)
+			(void)dns_dbiterator_pause(sdbiter->subs[i].iter);
+
+	return (result);
+}
+
+/*%
+ * Position shard iterator 'i' at the first of its names after the name
+ * it was just sought to (or, iterating backward, the last of its names
+ * before it), given the result of the seek.
+ */
+static void
+reposition(shardeddb_dbiterator_t *sdbiter, unsigned int i,
+	   isc_result_t result)
+{
+	dns_dbiterator_t *iter = sdbiter->subs[i].iter;
+
+	if (result == ISC_R_NOTFOUND)
+		result = sdbiter->forward ? dns_dbiterator_first(iter) :
+					    dns_dbiterator_last(iter);
+	else if (result == ISC_R_SUCCESS)
+		result = sdbiter->forward ? dns_dbiterator_next(iter) :
+					    dns_dbiterator_prev(iter);
+	else if (result == DNS_R_PARTIALMATCH) {
+		/*
+		 * The shard iterator is at the predecessor of 'name'.
+		 */
+		result = dns_dbiterator_next(iter);
+		if (!sdbiter->forward) {
+			if (result == ISC_R_SUCCESS)
+				result = dns_dbiterator_prev(iter);
+			else if (result == ISC_R_NOMORE)
+				result = dns_dbiterator_last(iter);
+		}
+	}
+	sdbiter->subs[i].result = result;
+	settle(sdbiter, i);
+}
+
+/*%
+ * Turn the iteration around at the cursor.
+ */
+static void
+turn(shardeddb_dbiterator_t *sdbiter, isc_boolean_t forward) {
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)sdbiter->common.db;
+	dns_name_t *name = dns_fixedname_name(&sdbiter->name);
+	isc_result_t result;
+	unsigned int i;
+
+	sdbiter->forward = forward;
+	for (i = 0; i < sdb->nshards; i++) {
+		if (!sdbiter->between && i == sdbiter->current)
+			continue;
+		result = dns_dbiterator_seek(sdbiter->subs[i].iter, name);
+		reposition(sdbiter, i, result);
+	}
+}
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	shardeddb_dbiterator_t *sdbiter;
+	dns_shardeddb_t *sdb;
+	dns_db_t *db = NULL;
+	unsigned int i;
+
+	REQUIRE(iteratorp != NULL);
+	sdbiter = (shardeddb_dbiterator_t *)*iteratorp;
+	sdb = (dns_shardeddb_t *)sdbiter->common.db;
+
+	for (i = 0; i < sdb->nshards; i++)
+		dns_dbiterator_destroy(&sdbiter->subs[i].iter);
+	isc_mem_put(sdb->common.mctx, sdbiter->subs,
+		    sdb->nshards * sizeof(shardeddb_subiter_t));
+
+	dns_db_attach(sdbiter->common.db, &db);
+	dns_db_detach(&sdbiter->common.db);
+	isc_mem_put(db->mctx, sdbiter, sizeof(*sdbiter));
+	dns_db_detach(&db);
+
+	*iteratorp = NULL;
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator) {
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)iterator->db;
+	unsigned int i;
+
+	sdbiter->forward = ISC_TRUE;
+	for (i = 0; i < sdb->nshards; i++) {
+		sdbiter->subs[i].result =
+			dns_dbiterator_first(sdbiter->subs[i].iter);
+		if (sdbiter->subs[i].result == ISC_R_NOTFOUND)
+			sdbiter->subs[i].result = ISC_R_NOMORE;
+		settle(sdbiter, i);
+	}
+
+	return (pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator) {
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)iterator->db;
+	unsigned int i;
+
+	sdbiter->forward = ISC_FALSE;
+	for (i = 0; i < sdb->nshards; i++) {
+		sdbiter->subs[i].result =
+			dns_dbiterator_last(sdbiter->subs[i].iter);
+		if (sdbiter->subs[i].result == ISC_R_NOTFOUND)
+			sdbiter->subs[i].result = ISC_R_NOMORE;
+		settle(sdbiter, i);
+	}
+
+	return (pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)iterator->db;
+	isc_result_t result;
+	unsigned int i, home;
+
+	result = dns_name_copy(name, dns_fixedname_name(&sdbiter->name),
+			       NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/*
+	 * Only the shard 'name' belongs to can have it; the others are
+	 * positioned for moving forward from it.
+	 */
+	home = NAMESHARD(sdb, name);
+	sdbiter->forward = ISC_TRUE;
+	for (i = 0; i < sdb->nshards; i++) {
+		result = dns_dbiterator_seek(sdbiter->subs[i].iter, name);
+		if (i == home && result == ISC_R_SUCCESS) {
+			sdbiter->subs[i].result = ISC_R_SUCCESS;
+			dns_name_copy(name,
+				      dns_fixedname_name(&sdbiter->subs[i].name),
+				      NULL);
+		} else
+			reposition(sdbiter, i, result);
+	}
+
+	result = pick(sdbiter);
+	if (sdbiter->subs[home].result == ISC_R_SUCCESS &&
+	    dns_name_equal(dns_fixedname_name(&sdbiter->subs[home].name),
+			   name))
+	{
+		INSIST(result != ISC_R_SUCCESS || sdbiter->current == home);
+		return (result);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE)
+		return (result);
+
+	/*
+	 * 'name' is not in the database; all of the shard iterators are
+	 * past it.
+	 */
+	(void)dns_name_copy(name, dns_fixedname_name(&sdbiter->name), NULL);
+	sdbiter->between = ISC_TRUE;
+	sdbiter->result = ISC_R_SUCCESS;
+
+	return (DNS_R_PARTIALMATCH);
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator) {
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	shardeddb_subiter_t *sub;
+
+	if (sdbiter->result != ISC_R_SUCCESS)
+		return (sdbiter->result);
+
+	if (sdbiter->forward || sdbiter->between)
+		turn(sdbiter, ISC_FALSE);
+	if (sdbiter->between)
+		return (pick(sdbiter));
+
+	sub = &sdbiter->subs[sdbiter->current];
+	sub->result = dns_dbiterator_prev(sub->iter);
+	settle(sdbiter, sdbiter->current);
+
+	return (pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	shardeddb_subiter_t *sub;
+
+	if (sdbiter->result != ISC_R_SUCCESS)
+		return (sdbiter->result);
+
+	/*
+	 * After a partial seek the shard iterators are already positioned
+	 * after the name sought.
+	 */
+	if (sdbiter->between)
+		return (pick(sdbiter));
+
+	if (!sdbiter->forward)
+		turn(sdbiter, ISC_TRUE);
+
+	sub = &sdbiter->subs[sdbiter->current];
+	sub->result = dns_dbiterator_next(sub->iter);
+	settle(sdbiter, sdbiter->current);
+
+	return (pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name)
+{
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	dns_dbiterator_t *iter;
+	isc_result_t result;
+
+	REQUIRE(sdbiter->result == ISC_R_SUCCESS);
+
+	if (sdbiter->between)
+		return (ISC_R_NOTFOUND);
+
+	iter = sdbiter->subs[sdbiter->current].iter;
+	iter->cleaning = iterator->cleaning;
+	result = dns_dbiterator_current(iter, nodep, name);
+	iter->cleaning = ISC_FALSE;
+	if (result == DNS_R_NEWORIGIN)
+		result = ISC_R_SUCCESS;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator) {
+	shardeddb_dbiterator_t *sdbiter = (shardeddb_dbiterator_t *)iterator;
+	dns_shardeddb_t *sdb = (dns_shardeddb_t *)iterator->db;
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	unsigned int i;
+
+	for (i = 0; i < sdb->nshards; i++) {
+		tresult = dns_dbiterator_pause(sdbiter->subs[i].iter);
+		if (tresult != ISC_R_SUCCESS && result == ISC_R_SUCCESS)
+			result = tresult;
+	}
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	UNUSED(iterator);
+
+	return (dns_name_copy(dns_rootname, name, NULL));
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_SHARDEDDB_H
+#define DNS_SHARDEDDB_H 1
+
+#include <isc/lang.h>
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file
+ * \brief
+ * A cache database which spreads its names over a number of independent
+ * "rbt" cache databases ("shards"), so that adding names to the cache
+ * does not serialize on a single tree lock.
+ *
+ * A name is stored in the shard selected by its hash; lookups of a name
+ * go to that shard, and the search for the deepest zone cut above a
+ * name (for dns_db_find() delegations and dns_db_findzonecut()) looks
+ * in the shards of each of the name's ancestors.  A DNAME is only
+ * found at an ancestor in the same shard as the name being looked up;
+ * otherwise the name is resolved and its synthesized CNAME is cached.
+ */
+
+#include <dns/db.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * The largest number of shards a database can have.
+ */
+#define DNS_SHARDEDDB_MAXSHARDS		64
+
+isc_result_t
+dns_shardeddb_create(isc_mem_t *mctx, const dns_name_t *base,
+		     dns_dbtype_t type, dns_rdataclass_t rdclass,
+		     unsigned int argc, char *argv[], void *driverarg,
+		     dns_db_t **dbp);
+/*%<
+ * Create a new database of type "sharded".  Called via dns_db_create();
+ * see documentation for that function for more details.
+ *
+ * If argv[0] is set, it points to a valid memory context to be used for
+ * allocation of heap memory by the shards.  If argv[1] is set, it is
+ * the number of shards as a decimal string; otherwise there is one
+ * shard per CPU.
+ *
+ * Requires:
+ *
+ * \li base == dns_rootname and type == dns_dbtype_cache.
+ * \li argc == 0 or argv[0] is a valid memory context.
+ *
+ * Returns:
+ *
+ * \li #ISC_R_SUCCESS
+ * \li #ISC_R_RANGE	argv[1] is not a number between 1 and
+ *			#DNS_SHARDEDDB_MAXSHARDS
+ * \li #ISC_R_NOMEMORY
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SHARDEDDB_H */
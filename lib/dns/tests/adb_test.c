@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/event.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/task.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/events.h>
+#include <dns/result.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+#define RTT		1000
+#define SLOWRTT		(RTT * 3)
+
+typedef struct {
+	dns_view_t		*view;
+	isc_stats_t		*stats;
+	dns_adb_t		*adb;
+	dns_adbaddrinfo_t	*addr;
+} adbtest_t;
+
+/*
+ * Create an ADB with an adaptive quota of 'quota' fetches per server,
+ * and look up a server in it whose smoothed RTT is RTT.
+ */
+static void
+setup(adbtest_t *t, isc_uint32_t quota) {
+	struct in_addr ina;
+	isc_sockaddr_t sa;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	memset(t, 0, sizeof(*t));
+
+	result = dns_test_makeview("view", &t->view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_adb_create(mctx, t->view, timermgr, taskmgr, &t->adb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_view_getadbstats(t->view, &t->stats);
+	ATF_REQUIRE(t->stats != NULL);
+	dns_adb_setquota(t->adb, quota, 0, 0.0, 0.0, 0.0);
+	dns_adb_setquotaadaptive(t->adb, ISC_TRUE);
+
+	ina.s_addr = htonl(0x0a350001);
+	isc_sockaddr_fromin(&sa, &ina, 53);
+	isc_stdtime_get(&now);
+	result = dns_adb_findaddrinfo(t->adb, &sa, &t->addr, now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_adb_adjustsrtt(t->adb, t->addr, RTT, DNS_ADB_RTTADJREPLACE);
+}
+
+static void
+shutdown_done(isc_task_t *task, isc_event_t *event) {
+	isc_boolean_t *done = event->ev_arg;
+
+	UNUSED(task);
+
+	*done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+teardown(adbtest_t *t) {
+	isc_event_t *event;
+	isc_boolean_t done = ISC_FALSE;
+	int i = 0;
+
+	if (t->addr != NULL)
+		dns_adb_freeaddrinfo(t->adb, &t->addr);
+
+	/*
+	 * The ADB refers to the view's statistics until it has shut down.
+	 */
+	event = isc_event_allocate(mctx, NULL, DNS_EVENT_ADBSHUTDOWN,
+				   shutdown_done, &done, sizeof(*event));
+	ATF_REQUIRE(event != NULL);
+	dns_adb_whenshutdown(t->adb, maintask, &event);
+	dns_adb_shutdown(t->adb);
+	dns_adb_detach(&t->adb);
+	while (!done && i++ < 5000)
+		dns_test_nap(1000);
+	ATF_REQUIRE(done);
+
+	isc_stats_detach(&t->stats);
+	dns_view_detach(&t->view);
+}
+
+static void
+getcounter(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+static isc_uint64_t
+getstat(adbtest_t *t, isc_statscounter_t counter) {
+	isc_uint64_t values[dns_adbstats_max];
+
+	memset(values, 0, sizeof(values));
+	isc_stats_dump(t->stats, getcounter, values, ISC_STATSDUMP_VERBOSE);
+	return (values[counter]);
+}
+
+/*
+ * The number of UDP fetches the server admits before it is over quota.
+ */
+static unsigned int
+allowed(adbtest_t *t) {
+	unsigned int i, n = 0;
+
+	while (!dns_adbentry_overquota(t->addr->entry) && n < 10000) {
+		dns_adb_beginudpfetch(t->adb, t->addr);
+		n++;
+	}
+	for (i = 0; i < n; i++)
+		dns_adb_endudpfetch(t->adb, t->addr);
+	return (n);
+}
+
+/*
+ * Report 'n' responses that took 'rtt' microseconds.
+ */
+static void
+respond(adbtest_t *t, unsigned int rtt, unsigned int n) {
+	while (n-- > 0)
+		dns_adb_adjustsrtt(t->adb, t->addr, rtt,
+				   DNS_ADB_RTTADJDEFAULT);
+}
+
+/*
+ * Wait for the start of the next second, leaving the rest of it for
+ * timeouts that must fall within the same second.
+ */
+static isc_stdtime_t
+nextsecond(void) {
+	isc_stdtime_t start, now;
+
+	isc_stdtime_get(&start);
+	do {
+		dns_test_nap(10000);
+		isc_stdtime_get(&now);
+	} while (now == start);
+
+	return (now);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(window);
+ATF_TC_HEAD(window, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a server's adaptive window grows with prompt "
+			  "responses and is halved on timeouts");
+}
+ATF_TC_BODY(window, tc) {
+	adbtest_t t;
+	isc_stdtime_t start, now;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setup(&t, 8);
+	ATF_CHECK_EQ(allowed(&t), 8);
+	respond(&t, RTT, 10);
+	ATF_CHECK_EQ(allowed(&t), 8);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 0);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowcuts), 0);
+
+	/*
+	 * Timeouts within a second halve the window once.
+	 */
+	start = nextsecond();
+	dns_adb_timeout(t.adb, t.addr);
+	dns_adb_timeout(t.adb, t.addr);
+	dns_adb_timeout(t.adb, t.addr);
+	isc_stdtime_get(&now);
+	ATF_REQUIRE_EQ(now, start);
+	ATF_CHECK_EQ(allowed(&t), 4);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 1);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowcuts), 1);
+
+	/*
+	 * Slow responses do not grow it; prompt ones add the reciprocal
+	 * of the window each, so it takes five to grow from four to five
+	 * and 24 to get back to eight.
+	 */
+	respond(&t, SLOWRTT, 1);
+	dns_adb_adjustsrtt(t.adb, t.addr, RTT, DNS_ADB_RTTADJREPLACE);
+	ATF_CHECK_EQ(allowed(&t), 4);
+	respond(&t, RTT, 4);
+	ATF_CHECK_EQ(allowed(&t), 4);
+	respond(&t, RTT, 1);
+	ATF_CHECK_EQ(allowed(&t), 5);
+	respond(&t, RTT, 18);
+	ATF_CHECK_EQ(allowed(&t), 7);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 1);
+	respond(&t, RTT, 1);
+	ATF_CHECK_EQ(allowed(&t), 8);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 0);
+	respond(&t, RTT, 10);
+	ATF_CHECK_EQ(allowed(&t), 8);
+
+	/*
+	 * The window is halved again in each later second with a
+	 * timeout, but not below one, and never exceeds a lowered
+	 * fetches-per-server.
+	 */
+	(void)nextsecond();
+	dns_adb_timeout(t.adb, t.addr);
+	ATF_CHECK_EQ(allowed(&t), 4);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 1);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowcuts), 2);
+
+	dns_adb_setquota(t.adb, 2, 0, 0.0, 0.0, 0.0);
+	(void)nextsecond();
+	dns_adb_timeout(t.adb, t.addr);
+	ATF_CHECK_EQ(allowed(&t), 1);
+	(void)nextsecond();
+	dns_adb_timeout(t.adb, t.addr);
+	ATF_CHECK_EQ(allowed(&t), 1);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 1);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowcuts), 4);
+
+	respond(&t, RTT, 1);
+	ATF_CHECK_EQ(allowed(&t), 2);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 0);
+	respond(&t, RTT, 10);
+	ATF_CHECK_EQ(allowed(&t), 2);
+
+	teardown(&t);
+	dns_test_end();
+}
+
+ATF_TC(free);
+ATF_TC_HEAD(free, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a server freed with a reduced window no longer "
+			  "counts as windowed");
+}
+ATF_TC_BODY(free, tc) {
+	adbtest_t t;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setup(&t, 8);
+	dns_adb_timeout(t.adb, t.addr);
+	ATF_CHECK_EQ(allowed(&t), 4);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 1);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_entriescnt), 1);
+
+	dns_adb_freeaddrinfo(t.adb, &t.addr);
+	dns_adb_flush(t.adb);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_entriescnt), 0);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowed), 0);
+	ATF_CHECK_EQ(getstat(&t, dns_adbstats_windowcuts), 1);
+
+	teardown(&t);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, window);
+	ATF_TP_ADD_TC(tp, free);
+
+	return (atf_no_error());
+}
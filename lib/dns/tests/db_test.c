@@ -17,10 +17,20 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#include <isc/hash.h>
+#include <isc/print.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/journal.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/stats.h>
 
 #include "dnstest.h"
 
@@ -32,6 +42,20 @@
 #define	BIGBUFLEN	(64 * 1024)
 #define TEST_ORIGIN	"test"
 
+static isc_result_t
+make_name(const char *src, dns_name_t *name) {
+	isc_buffer_t b;
+	isc_buffer_constinit(&b, src, strlen(src));
+	isc_buffer_add(&b, strlen(src));
+	return (dns_name_fromtext(name, &b, dns_rootname, 0, NULL));
+}
+
+static void
+nowater(void *arg, int mark) {
+	UNUSED(arg);
+	UNUSED(mark);
+}
+
 /*
  * Individual unit tests
  */
@@ -69,10 +93,398 @@ ATF_TC_BODY(getoriginnode, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+#define LRU_HOT		64
+#define LRU_COLD	512
+#define LRU_NEW		64
+
+static isc_result_t
+lru_add(dns_db_t *db, const char *prefix, unsigned int n,
+	isc_stdtime_t now)
+{
+	static unsigned char addr[4] = { 192, 0, 2, 1 };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node = NULL;
+	char text[64];
+	isc_result_t result;
+
+	rdata.data = addr;
+	rdata.length = sizeof(addr);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	snprintf(text, sizeof(text), "%s%u.example.", prefix, n);
+	result = make_name(text, name);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = dns_db_findnode(db, name, ISC_TRUE, &node);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	dns_db_detachnode(db, &node);
+	return (result);
+}
+
+static isc_result_t
+lru_find(dns_db_t *db, const char *prefix, unsigned int n,
+	 isc_stdtime_t now)
+{
+	dns_fixedname_t fixed, ffound;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	char text[64];
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&ffound);
+	snprintf(text, sizeof(text), "%s%u.example.", prefix, n);
+	result = make_name(text, name);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, now, NULL,
+			     dns_fixedname_name(&ffound), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	return (result);
+}
+
+ATF_TC(lru);
+ATF_TC_HEAD(lru, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "test that recently used cache entries survive "
+			  "overmem purging");
+}
+ATF_TC_BODY(lru, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i, cold;
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+
+	/*
+	 * The "hot" entries are the oldest, so they are the first to be
+	 * considered for purging; looking them up must save them.
+	 */
+	for (i = 0; i < LRU_HOT; i++) {
+		result = lru_add(db, "hot", i, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < LRU_COLD; i++) {
+		result = lru_add(db, "cold", i, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < LRU_HOT; i++) {
+		result = lru_find(db, "hot", i, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/* Every addition now purges entries. */
+	isc_mem_setwater(mymctx, nowater, NULL, 2, 1);
+	for (i = 0; i < LRU_NEW; i++) {
+		result = lru_add(db, "new", i, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	isc_mem_setwater(mymctx, NULL, NULL, 0, 0);
+
+	for (i = 0; i < LRU_HOT; i++) {
+		result = lru_find(db, "hot", i, now);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+	cold = 0;
+	for (i = 0; i < LRU_COLD; i++) {
+		result = lru_find(db, "cold", i, now);
+		if (result == ISC_R_SUCCESS)
+			cold++;
+	}
+	ATF_CHECK(cold < LRU_COLD);
+
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+/*
+ * Entries whose TTL has expired are purged as new entries are added
+ * to their node lock bucket, one per addition.
+ */
+#define TTL_OLD		256
+#define TTL_NEW		4096
+
+static void
+getcounter(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *deleted = arg;
+
+	if (counter == dns_cachestatscounter_deletettl)
+		*deleted = value;
+}
+
+ATF_TC(ttlexpiry);
+ATF_TC_HEAD(ttlexpiry, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "test that expired cache entries are purged");
+}
+ATF_TC_BODY(ttlexpiry, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_stats_t *stats = NULL;
+	isc_stdtime_t now;
+	isc_uint64_t deleted = 0;
+	isc_result_t result;
+	unsigned int i;
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mymctx, &stats, dns_cachestatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_setcachestats(db, stats);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+
+	for (i = 0; i < TTL_OLD; i++) {
+		result = lru_add(db, "old", i, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/* Adding entries before they expire purges nothing. */
+	for (i = 0; i < TTL_OLD; i++) {
+		result = lru_add(db, "early", i, now + 60);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	isc_stats_dump(stats, getcounter, &deleted, 0);
+	ATF_CHECK_EQ(deleted, 0);
+
+	/* Well after the entries expired, they are all purged. */
+	for (i = 0; i < TTL_NEW; i++) {
+		result = lru_add(db, "new", i, now + 7200);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	isc_stats_dump(stats, getcounter, &deleted, 0);
+	ATF_CHECK_EQ(deleted, TTL_OLD * 2);
+
+	for (i = 0; i < TTL_NEW; i++) {
+		result = lru_find(db, "new", i, now + 7200);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	dns_db_detach(&db);
+	isc_stats_detach(&stats);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+/*
+ * Nodes with many types have a type index; check that lookups through
+ * it see the same rdatasets as walking the node, in every version.
+ */
+#define MANYTYPES	12
+
+static isc_result_t
+addtype(dns_db_t *db, dns_dbversion_t *version, dns_dbnode_t *node,
+	dns_rdatatype_t type, isc_stdtime_t now)
+{
+	static unsigned char data[4] = { 1, 2, 3, 4 };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	rdata.data = data;
+	rdata.length = sizeof(data);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = type;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	return (dns_db_addrdataset(db, node, version, now, &rdataset, 0,
+				   NULL));
+}
+
+static isc_result_t
+findtype(dns_db_t *db, dns_dbversion_t *version, dns_name_t *name,
+	 dns_dbnode_t *node, dns_rdatatype_t type, isc_stdtime_t now)
+{
+	dns_fixedname_t ffound;
+	dns_rdataset_t rdataset;
+	isc_result_t result, result2;
+
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, version, type, 0, now, NULL,
+			     dns_fixedname_name(&ffound), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		ATF_CHECK_EQ(rdataset.type, type);
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	result2 = dns_db_findrdataset(db, node, version, type, 0, now,
+				      &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		ATF_CHECK_EQ(rdataset.type, type);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	ATF_CHECK_EQ(result == ISC_R_SUCCESS, result2 == ISC_R_SUCCESS);
+
+	return (result);
+}
+
+ATF_TC(typeindex);
+ATF_TC_HEAD(typeindex, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "test lookups at nodes with many types");
+}
+ATF_TC_BODY(typeindex, tc) {
+	dns_db_t *db = NULL;
+	dns_dbversion_t *v1 = NULL, *v2 = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_mem_t *mymctx = NULL;
+	isc_stdtime_t now;
+	isc_result_t result;
+	dns_rdatatype_t type;
+	unsigned int i;
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = make_name("many." TEST_ORIGIN, name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+
+	/*
+	 * Zone: version 1 has every type, version 2 deletes half of
+	 * them, leaving too few for an index, and adds another.
+	 */
+	result = dns_db_create(mymctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, name, ISC_TRUE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_newversion(db, &v1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < MANYTYPES; i++) {
+		result = addtype(db, v1, node, 65280 + i * 2, 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_db_closeversion(db, &v1, ISC_TRUE);
+
+	dns_db_currentversion(db, &v1);
+	result = dns_db_newversion(db, &v2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < MANYTYPES / 2; i++) {
+		result = dns_db_deleterdataset(db, node, v2, 65280 + i * 2,
+					       0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	result = addtype(db, v2, node, 65281, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (type = 65280; type < 65280 + MANYTYPES * 2; type++) {
+		isc_boolean_t in1 = ISC_TF(type % 2 == 0);
+		isc_boolean_t in2 = ISC_TF(type == 65281 ||
+					   (in1 && type >=
+					    65280 + MANYTYPES));
+
+		result = findtype(db, v1, name, node, type, 0);
+		ATF_CHECK_EQ(result, in1 ? ISC_R_SUCCESS : DNS_R_NXRRSET);
+		result = findtype(db, v2, name, node, type, 0);
+		ATF_CHECK_EQ(result, in2 ? ISC_R_SUCCESS : DNS_R_NXRRSET);
+	}
+
+	dns_db_closeversion(db, &v2, ISC_TRUE);
+	dns_db_closeversion(db, &v1, ISC_FALSE);
+	dns_db_detachnode(db, &node);
+	dns_db_detach(&db);
+
+	/*
+	 * Cache.
+	 */
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, name, ISC_TRUE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < MANYTYPES; i++) {
+		result = addtype(db, NULL, node, 65280 + i * 2, now);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (type = 65280; type < 65280 + MANYTYPES * 2; type++) {
+		result = findtype(db, NULL, name, node, type, now);
+		if (type % 2 == 0)
+			ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		else
+			ATF_CHECK(result != ISC_R_SUCCESS);
+	}
+
+	/* Expired rdatasets are not found through the index either. */
+	result = findtype(db, NULL, name, node, 65280, now + 7200);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
+	ATF_TP_ADD_TC(tp, lru);
+	ATF_TP_ADD_TC(tp, ttlexpiry);
+	ATF_TP_ADD_TC(tp, typeindex);
 	return (atf_no_error());
 }
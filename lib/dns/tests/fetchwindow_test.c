@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/util.h>
+
+#include "../fetchwindow.h"
+
+/*
+ * Helper functions
+ */
+
+#define NOW	1000000
+
+/*
+ * Report 'n' successes to 'window', returning the changes reported by
+ * the last of them.
+ */
+static unsigned int
+succeed(dns_fetchwindow_t *window, double max, unsigned int n) {
+	unsigned int change = 0;
+
+	while (n-- > 0)
+		change = dns_fetchwindow_success(window, max);
+	return (change);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(open);
+ATF_TC_HEAD(open, tc) {
+	atf_tc_set_md_var(tc, "descr", "an unused window opens fully");
+}
+ATF_TC_BODY(open, tc) {
+	dns_fetchwindow_t window;
+
+	UNUSED(tc);
+
+	dns_fetchwindow_init(&window);
+	ATF_CHECK_EQ(window.size, 0.0);
+	ATF_CHECK_EQ(window.cut, 0);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 8);
+	ATF_CHECK_EQ(window.cut, 0);
+
+	/*
+	 * Successes at the maximum leave it there without reporting a
+	 * change.
+	 */
+	dns_fetchwindow_init(&window);
+	ATF_CHECK_EQ(succeed(&window, 8.0, 20), 0);
+	ATF_CHECK_EQ(window.size, 8.0);
+	ATF_CHECK_EQ(window.cut, 0);
+
+	dns_fetchwindow_init(&window);
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW),
+		     DNS_FETCHWINDOW_CUT | DNS_FETCHWINDOW_CLOSED);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 4);
+}
+
+ATF_TC(cut);
+ATF_TC_HEAD(cut, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a window is halved at most once a second, "
+			  "but not below one");
+}
+ATF_TC_BODY(cut, tc) {
+	dns_fetchwindow_t window;
+
+	UNUSED(tc);
+
+	dns_fetchwindow_init(&window);
+	(void)dns_fetchwindow_size(&window, 8.0);
+
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW),
+		     DNS_FETCHWINDOW_CUT | DNS_FETCHWINDOW_CLOSED);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 4);
+	ATF_CHECK_EQ(window.cut, NOW);
+
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW), 0);
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW), 0);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 4);
+
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW + 1),
+		     DNS_FETCHWINDOW_CUT);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 2);
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW + 2),
+		     DNS_FETCHWINDOW_CUT);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 1);
+	ATF_CHECK_EQ(window.size, 1.0);
+
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW + 3),
+		     DNS_FETCHWINDOW_CUT);
+	ATF_CHECK_EQ(window.size, 1.0);
+	ATF_CHECK_EQ(window.cut, NOW + 3);
+}
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a window grows by about one for each window of "
+			  "successes, up to its maximum");
+}
+ATF_TC_BODY(grow, tc) {
+	dns_fetchwindow_t window;
+
+	UNUSED(tc);
+
+	dns_fetchwindow_init(&window);
+	(void)dns_fetchwindow_timeout(&window, 8.0, NOW);
+	ATF_REQUIRE_EQ(window.size, 4.0);
+
+	/*
+	 * Each success adds the reciprocal of the window's size, so a
+	 * window of four takes five successes to reach five, and 24 to
+	 * reach eight.
+	 */
+	ATF_CHECK_EQ(succeed(&window, 8.0, 4), 0);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 4);
+	ATF_CHECK_EQ(succeed(&window, 8.0, 1), 0);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 5);
+
+	ATF_CHECK_EQ(succeed(&window, 8.0, 18), 0);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 8.0), 7);
+	ATF_CHECK_EQ(window.cut, NOW);
+
+	ATF_CHECK_EQ(succeed(&window, 8.0, 1), DNS_FETCHWINDOW_OPENED);
+	ATF_CHECK_EQ(window.size, 8.0);
+	ATF_CHECK_EQ(window.cut, 0);
+
+	ATF_CHECK_EQ(succeed(&window, 8.0, 10), 0);
+	ATF_CHECK_EQ(window.size, 8.0);
+
+	/*
+	 * Once open, the next cut closes the window again, even within
+	 * the second of the last one.
+	 */
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 8.0, NOW),
+		     DNS_FETCHWINDOW_CUT | DNS_FETCHWINDOW_CLOSED);
+	ATF_CHECK_EQ(window.size, 4.0);
+}
+
+ATF_TC(max);
+ATF_TC_HEAD(max, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a window follows changes to its maximum");
+}
+ATF_TC_BODY(max, tc) {
+	dns_fetchwindow_t window;
+
+	UNUSED(tc);
+
+	/*
+	 * A cut halves the maximum if the window is above it...
+	 */
+	dns_fetchwindow_init(&window);
+	(void)dns_fetchwindow_size(&window, 8.0);
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 2.0, NOW),
+		     DNS_FETCHWINDOW_CUT | DNS_FETCHWINDOW_CLOSED);
+	ATF_CHECK_EQ(window.size, 1.0);
+
+	/*
+	 * ...and growth stops at it.
+	 */
+	ATF_CHECK_EQ(succeed(&window, 2.0, 1), DNS_FETCHWINDOW_OPENED);
+	ATF_CHECK_EQ(window.size, 2.0);
+	ATF_CHECK_EQ(succeed(&window, 2.0, 5), 0);
+	ATF_CHECK_EQ(window.size, 2.0);
+
+	/*
+	 * A window that was open at a lower maximum grows towards a
+	 * higher one without being closed.
+	 */
+	ATF_CHECK_EQ(succeed(&window, 4.0, 3), 0);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 4.0), 3);
+	ATF_CHECK_EQ(window.cut, 0);
+
+	/*
+	 * A window of one still allows a fetch.
+	 */
+	dns_fetchwindow_init(&window);
+	ATF_CHECK_EQ(dns_fetchwindow_timeout(&window, 1.0, NOW),
+		     DNS_FETCHWINDOW_CUT | DNS_FETCHWINDOW_CLOSED);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 1.0), 1);
+	ATF_CHECK_EQ(succeed(&window, 1.0, 1), DNS_FETCHWINDOW_OPENED);
+	ATF_CHECK_EQ(dns_fetchwindow_size(&window, 1.0), 1);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, open);
+	ATF_TP_ADD_TC(tp, cut);
+	ATF_TP_ADD_TC(tp, grow);
+	ATF_TP_ADD_TC(tp, max);
+
+	return (atf_no_error());
+}
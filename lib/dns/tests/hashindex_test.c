@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include "../hashindex.h"
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+#define NBUCKETS	7
+#define BUCKET		3
+
+typedef struct {
+	unsigned int	hashval;
+	dns_hashlink_t	hlink;
+} item_t;
+
+/*
+ * The i'th hash value in bucket BUCKET of NBUCKETS buckets.
+ */
+#define HASHVAL(i)	((i) * NBUCKETS + BUCKET)
+
+static item_t *
+make_items(unsigned int n) {
+	item_t *items;
+	unsigned int i;
+
+	items = isc_mem_get(mctx, n * sizeof(*items));
+	ATF_REQUIRE(items != NULL);
+	for (i = 0; i < n; i++) {
+		items[i].hashval = HASHVAL(i);
+		ISC_LINK_INIT(&items[i].hlink, link);
+	}
+	return (items);
+}
+
+/*
+ * Is 'item' on the chain of its hash value in 'index'?
+ */
+static isc_boolean_t
+indexed(dns_hashindex_t *index, item_t *item) {
+	dns_hashlink_t *hlink;
+
+	for (hlink = dns_hashindex_first(index, item->hashval);
+	     hlink != NULL;
+	     hlink = ISC_LIST_NEXT(hlink, link))
+	{
+		if (hlink->item == item) {
+			ATF_CHECK_EQ(hlink, &item->hlink);
+			ATF_CHECK_EQ(hlink->hashval, item->hashval);
+			return (ISC_TRUE);
+		}
+	}
+	return (ISC_FALSE);
+}
+
+/*
+ * The length of the longest chain in 'index'.
+ */
+static unsigned int
+longest(dns_hashindex_t *index) {
+	dns_hashlink_t *hlink;
+	unsigned int i, n, max = 0;
+
+	for (i = 0; i < index->size; i++) {
+		n = 0;
+		for (hlink = ISC_LIST_HEAD(index->chains[i]);
+		     hlink != NULL;
+		     hlink = ISC_LIST_NEXT(hlink, link))
+			n++;
+		if (n > max)
+			max = n;
+	}
+	return (max);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a hash index grows as members are added");
+}
+ATF_TC_BODY(grow, tc) {
+	dns_hashindex_t index;
+	item_t *items;
+	isc_result_t result;
+	unsigned int i, added, n = 40;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	items = make_items(n);
+	dns_hashindex_init(&index, NBUCKETS);
+	ATF_CHECK_EQ(index.size, 1);
+	ATF_CHECK_EQ(index.count, 0);
+	ATF_CHECK_EQ(index.chains, &index.chain);
+
+	/*
+	 * One chain holds DNS_HASHINDEX_LOAD members; the next member
+	 * raises the index to DNS_HASHINDEX_MIN chains, and it doubles
+	 * whenever it is full again.
+	 */
+	for (i = 0; i < n; i++) {
+		added = dns_hashindex_add(mctx, &index, &items[i].hlink,
+					  &items[i], items[i].hashval);
+		ATF_CHECK_EQ(index.count, i + 1);
+		if (i == DNS_HASHINDEX_LOAD) {
+			ATF_CHECK_EQ(added, DNS_HASHINDEX_MIN - 1);
+			ATF_CHECK_EQ(index.size, DNS_HASHINDEX_MIN);
+			ATF_CHECK(index.chains != &index.chain);
+		} else if (i == DNS_HASHINDEX_MIN * DNS_HASHINDEX_LOAD) {
+			ATF_CHECK_EQ(added, DNS_HASHINDEX_MIN);
+			ATF_CHECK_EQ(index.size, DNS_HASHINDEX_MIN * 2);
+		} else
+			ATF_CHECK_EQ(added, 0);
+	}
+	ATF_CHECK_EQ(index.size, DNS_HASHINDEX_MIN * 2);
+
+	/*
+	 * Every member is still found after the moves, and since the
+	 * bucket's hash values are consecutive multiples of the number of
+	 * buckets they are spread evenly over the chains.
+	 */
+	for (i = 0; i < n; i++)
+		ATF_CHECK(indexed(&index, &items[i]));
+	ATF_CHECK_EQ(longest(&index), (n + index.size - 1) / index.size);
+
+	for (i = 0; i < n; i++)
+		dns_hashindex_remove(&index, &items[i].hlink);
+	dns_hashindex_free(mctx, &index);
+	ATF_CHECK_EQ(index.size, 1);
+	ATF_CHECK_EQ(index.chains, &index.chain);
+
+	isc_mem_put(mctx, items, n * sizeof(*items));
+	dns_test_end();
+}
+
+ATF_TC(remove);
+ATF_TC_HEAD(remove, tc) {
+	atf_tc_set_md_var(tc, "descr", "remove members from a hash index");
+}
+ATF_TC_BODY(remove, tc) {
+	dns_hashindex_t index;
+	item_t *items;
+	isc_result_t result;
+	unsigned int i, size, n = 100;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	items = make_items(n);
+	dns_hashindex_init(&index, NBUCKETS);
+	for (i = 0; i < n; i++)
+		(void)dns_hashindex_add(mctx, &index, &items[i].hlink,
+					&items[i], items[i].hashval);
+	size = index.size;
+
+	for (i = 0; i < n; i += 2) {
+		dns_hashindex_remove(&index, &items[i].hlink);
+		ATF_CHECK(!ISC_LINK_LINKED(&items[i].hlink, link));
+	}
+	ATF_CHECK_EQ(index.count, n / 2);
+	for (i = 0; i < n; i++)
+		ATF_CHECK_EQ(indexed(&index, &items[i]), ISC_TF(i % 2 != 0));
+
+	/*
+	 * An index is never shrunk, and removed members can be added
+	 * back.
+	 */
+	for (i = 1; i < n; i += 2)
+		dns_hashindex_remove(&index, &items[i].hlink);
+	ATF_CHECK_EQ(index.count, 0);
+	ATF_CHECK_EQ(index.size, size);
+	ATF_CHECK_EQ(longest(&index), 0);
+
+	for (i = 0; i < n; i++)
+		ATF_CHECK_EQ(dns_hashindex_add(mctx, &index, &items[i].hlink,
+					       &items[i], items[i].hashval),
+			     0);
+	for (i = 0; i < n; i++)
+		ATF_CHECK(indexed(&index, &items[i]));
+
+	for (i = 0; i < n; i++)
+		dns_hashindex_remove(&index, &items[i].hlink);
+	dns_hashindex_free(mctx, &index);
+
+	isc_mem_put(mctx, items, n * sizeof(*items));
+	dns_test_end();
+}
+
+ATF_TC(max);
+ATF_TC_HEAD(max, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a hash index stops growing at DNS_HASHINDEX_MAX");
+}
+ATF_TC_BODY(max, tc) {
+	dns_hashindex_t index;
+	item_t *items;
+	isc_result_t result;
+	unsigned int i, n = DNS_HASHINDEX_MAX * DNS_HASHINDEX_LOAD + 100;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	items = make_items(n);
+	dns_hashindex_init(&index, NBUCKETS);
+	for (i = 0; i < n; i++)
+		(void)dns_hashindex_add(mctx, &index, &items[i].hlink,
+					&items[i], items[i].hashval);
+	ATF_CHECK_EQ(index.count, n);
+	ATF_CHECK_EQ(index.size, DNS_HASHINDEX_MAX);
+	ATF_CHECK_EQ(longest(&index), DNS_HASHINDEX_LOAD + 1);
+	ATF_CHECK(indexed(&index, &items[0]));
+	ATF_CHECK(indexed(&index, &items[n - 1]));
+
+	for (i = 0; i < n; i++)
+		dns_hashindex_remove(&index, &items[i].hlink);
+	dns_hashindex_free(mctx, &index);
+
+	isc_mem_put(mctx, items, n * sizeof(*items));
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, grow);
+	ATF_TP_ADD_TC(tp, remove);
+	ATF_TP_ADD_TC(tp, max);
+
+	return (atf_no_error());
+}
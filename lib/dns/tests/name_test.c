@@ -12,6 +12,7 @@
 
 #include <config.h>
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -24,6 +25,7 @@
 #include <isc/os.h>
 #include <isc/print.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
@@ -277,6 +279,486 @@ ATF_TC_BODY(compression, tc) {
 	dns_test_end();
 }
 
+/*
+ * Check case insensitive comparison, hashing and downcasing against
+ * simple reference versions, with name and label lengths either side
+ * of the vector widths.
+ */
+static unsigned char
+ref_tolower(unsigned char c) {
+	if (c >= 'A' && c <= 'Z')
+		return (c + ('a' - 'A'));
+	return (c);
+}
+
+static int
+ref_compare(const unsigned char *wire1, unsigned int labels1,
+	    const unsigned char *wire2, unsigned int labels2)
+{
+	unsigned int offsets1[128], offsets2[128];
+	unsigned int i, o, l1 = 0, l2 = 0;
+
+	for (o = 0, i = 0; i < labels1; i++, o += wire1[o] + 1)
+		offsets1[i] = o;
+	for (o = 0, i = 0; i < labels2; i++, o += wire2[o] + 1)
+		offsets2[i] = o;
+
+	while (l1 < labels1 && l2 < labels2) {
+		const unsigned char *p1 = wire1 + offsets1[labels1 - 1 - l1];
+		const unsigned char *p2 = wire2 + offsets2[labels2 - 1 - l2];
+		unsigned int n = ISC_MIN(p1[0], p2[0]);
+
+		for (i = 1; i <= n; i++) {
+			if (ref_tolower(p1[i]) != ref_tolower(p2[i]))
+				return ((int)ref_tolower(p1[i]) -
+					(int)ref_tolower(p2[i]));
+		}
+		if (p1[0] != p2[0])
+			return ((int)p1[0] - (int)p2[0]);
+		l1++;
+		l2++;
+	}
+
+	return ((int)labels1 - (int)labels2);
+}
+
+static unsigned int
+randomwire(unsigned char *wire, unsigned int *labelsp) {
+	static const unsigned char chars[] = "@AMZ[`amz{09-_\x80\xc1\xda\xff";
+	unsigned int length = 0, labels = 0, maxlength, count, i;
+
+	maxlength = 1 + (random() % 255);
+	for (;;) {
+		count = 1 + random() % ((random() % 2) == 0 ? 8 : 63);
+		if (length + count + 2 > maxlength)
+			break;
+		wire[length++] = count;
+		for (i = 0; i < count; i++)
+			wire[length++] = chars[random() % (sizeof(chars) - 1)];
+		labels++;
+	}
+	wire[length++] = 0;
+	*labelsp = labels + 1;
+
+	return (length);
+}
+
+static int
+sign(int v) {
+	return ((v > 0) - (v < 0));
+}
+
+ATF_TC(casefold);
+ATF_TC_HEAD(casefold, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "case insensitive compare, hash and downcase");
+}
+ATF_TC_BODY(casefold, tc) {
+	unsigned char wire1[256], wire2[256], lower[256], buf[256];
+	dns_name_t name1, name2, namel, down;
+	isc_buffer_t b;
+	isc_region_t r;
+	unsigned int i, j, len, labels;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, ISC_FALSE), ISC_R_SUCCESS);
+
+	srandom(1);
+	for (i = 0; i < 20000; i++) {
+		len = randomwire(wire1, &labels);
+		for (j = 0; j < len; j++) {
+			lower[j] = ref_tolower(wire1[j]);
+			/* A copy with the case of the letters swapped */
+			if (wire1[j] >= 'a' && wire1[j] <= 'z')
+				wire2[j] = wire1[j] - ('a' - 'A');
+			else
+				wire2[j] = lower[j];
+		}
+
+		r.base = wire1;
+		r.length = len;
+		dns_name_init(&name1, NULL);
+		dns_name_fromregion(&name1, &r);
+		r.base = wire2;
+		dns_name_init(&name2, NULL);
+		dns_name_fromregion(&name2, &r);
+		r.base = lower;
+		dns_name_init(&namel, NULL);
+		dns_name_fromregion(&namel, &r);
+		ATF_REQUIRE_EQ(name1.labels, labels);
+
+		ATF_CHECK(dns_name_equal(&name1, &name2));
+		ATF_CHECK_EQ(dns_name_compare(&name1, &name2), 0);
+		ATF_CHECK_EQ(dns_name_hash(&name1, ISC_FALSE),
+			     dns_name_hash(&namel, ISC_TRUE));
+		ATF_CHECK_EQ(dns_name_fullhash(&name1, ISC_FALSE),
+			     dns_name_fullhash(&namel, ISC_TRUE));
+		ATF_CHECK_EQ(dns_name_hashbylabel(&name1, ISC_FALSE),
+			     dns_name_hashbylabel(&namel, ISC_TRUE));
+		ATF_CHECK_EQ(dns_name_fullhash(&name1, ISC_FALSE),
+			     dns_name_fullhash(&name2, ISC_FALSE));
+
+		isc_buffer_init(&b, buf, sizeof(buf));
+		dns_name_init(&down, NULL);
+		result = dns_name_downcase(&name1, &down, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(down.length, len);
+		ATF_CHECK(memcmp(down.ndata, lower, len) == 0);
+
+		/* Change one octet of a label and compare again */
+		if (len > 1) {
+			unsigned int o = 0;
+
+			j = random() % (len - 1);
+			while (o + wire1[o] < j)
+				o += wire1[o] + 1;
+			if (o != j) {
+				wire2[j] = "aZ[@\x80"[random() % 5];
+				ATF_CHECK_EQ(dns_name_equal(&name1, &name2),
+					     ref_tolower(wire1[j]) ==
+					     ref_tolower(wire2[j]));
+				ATF_CHECK_EQ(sign(dns_name_compare(&name1,
+								   &name2)),
+					     sign(ref_compare(wire1, labels,
+							      wire2, labels)));
+			}
+		}
+
+		/* Compare with another random name */
+		len = randomwire(wire2, &labels);
+		r.base = wire2;
+		r.length = len;
+		dns_name_init(&name2, NULL);
+		dns_name_fromregion(&name2, &r);
+		ATF_CHECK_EQ(sign(dns_name_compare(&name1, &name2)),
+			     sign(ref_compare(wire1, name1.labels,
+					      wire2, labels)));
+	}
+
+	dns_test_end();
+}
+
+#ifdef DNS_BENCHMARK_TESTS
+
+/*
+ * Time the case insensitive name operations on names of typical
+ * lengths, each compared with a copy in a different case.
+ */
+ATF_TC(casefold_benchmark);
+ATF_TC_HEAD(casefold_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark case insensitive name operations");
+}
+ATF_TC_BODY(casefold_benchmark, tc) {
+	static const char *formats[] = {
+		"www.Example%u.COM.",
+		"Mail%u.Corp.Example-University.EDU.",
+		"_443._tcp.host%u.Department.Example.CO.UK.",
+		"a.very.Long.Name%u.in.a.Deeply.Nested.Hierarchy.Of."
+		"Subdomains.Example.NET."
+	};
+	const unsigned int count = 1000, loops = 2000;
+	dns_fixedname_t *fixed1, *fixed2, fdown;
+	unsigned int i, j, k, h = 0;
+	isc_time_t ts1, ts2;
+	isc_result_t result;
+	char text[256];
+	unsigned int f;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fixed1 = isc_mem_get(mctx, count * sizeof(*fixed1));
+	fixed2 = isc_mem_get(mctx, count * sizeof(*fixed2));
+	ATF_REQUIRE(fixed1 != NULL && fixed2 != NULL);
+	for (i = 0; i < count; i++) {
+		snprintf(text, sizeof(text), formats[i % 4], i);
+		dns_fixedname_init(&fixed1[i]);
+		result = dns_name_fromstring(dns_fixedname_name(&fixed1[i]),
+					     text, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		for (j = 0; text[j] != '\0'; j++)
+			text[j] = toupper((unsigned char)text[j]);
+		dns_fixedname_init(&fixed2[i]);
+		result = dns_name_fromstring(dns_fixedname_name(&fixed2[i]),
+					     text, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_fixedname_init(&fdown);
+
+	for (f = 0; f < 5; f++) {
+		static const char *names[] = {
+			"dns_name_equal", "dns_name_compare",
+			"dns_name_hash", "dns_name_fullhash",
+			"dns_name_downcase"
+		};
+
+		result = isc_time_now(&ts1);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		for (k = 0; k < loops; k++) {
+			for (i = 0; i < count; i++) {
+				dns_name_t *n1 = dns_fixedname_name(&fixed1[i]);
+				dns_name_t *n2 = dns_fixedname_name(&fixed2[i]);
+
+				switch (f) {
+				case 0:
+					h += dns_name_equal(n1, n2);
+					break;
+				case 1:
+					h += dns_name_compare(n1, n2);
+					break;
+				case 2:
+					h += dns_name_hash(n1, ISC_FALSE);
+					break;
+				case 3:
+					h += dns_name_fullhash(n1, ISC_FALSE);
+					break;
+				case 4:
+					(void)dns_name_downcase(n2,
+						dns_fixedname_name(&fdown),
+						NULL);
+					break;
+				}
+			}
+		}
+
+		result = isc_time_now(&ts2);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		printf("%-20s %f ns/call\n", names[f],
+		       isc_time_microdiff(&ts2, &ts1) * 1000.0 /
+		       (count * loops));
+	}
+
+	/* Keep the results live. */
+	printf("(%u)\n", h);
+
+	isc_mem_put(mctx, fixed1, count * sizeof(*fixed1));
+	isc_mem_put(mctx, fixed2, count * sizeof(*fixed2));
+
+	dns_test_end();
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+
+/*
+ * Write many names into one message, rolling part of it back, and check
+ * that they all decompress to the names written.
+ */
+static void
+manyname(unsigned int i, isc_boolean_t junk, dns_name_t *name) {
+	char text[64];
+	isc_result_t result;
+
+	if (junk)
+		snprintf(text, sizeof(text), "j%u.example.net.", i);
+	else if (i % 3 == 0)
+		snprintf(text, sizeof(text), "z%u.example.com.", i % 37);
+	else
+		snprintf(text, sizeof(text), "%s%u.z%u.Example.COM.",
+			 (i % 2) == 0 ? "h" : "H", i, i % 37);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+compress_many(isc_boolean_t sensitive) {
+	dns_compress_t cctx;
+	dns_decompress_t dctx;
+	dns_fixedname_t fixed, dfixed;
+	dns_name_t *name, *dname;
+	isc_buffer_t source, target;
+	static unsigned char buf[65535];
+	unsigned char dbuf[DNS_NAME_MAXWIRE];
+	unsigned int i, mark = 0, length = 0;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&dfixed);
+	dname = dns_fixedname_name(&dfixed);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, sensitive);
+
+	/* Leave room for a message header. */
+	isc_buffer_init(&target, buf, sizeof(buf));
+	memset(buf, 0, 12);
+	isc_buffer_add(&target, 12);
+
+	for (i = 0; i < 5000; i++) {
+		if (i == 1000) {
+			unsigned int j;
+
+			/* Write names that are then rolled back. */
+			mark = isc_buffer_usedlength(&target);
+			for (j = 0; j < 500; j++) {
+				manyname(j, ISC_TRUE, name);
+				result = dns_name_towire(name, &cctx, &target);
+				ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			}
+			dns_compress_rollback(&cctx, (isc_uint16_t)mark);
+			isc_buffer_subtract(&target,
+					    isc_buffer_usedlength(&target) -
+					    mark);
+		}
+		manyname(i, ISC_FALSE, name);
+		length += name->length;
+		result = dns_name_towire(name, &cctx, &target);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_compress_invalidate(&cctx);
+
+	/* Most names share the zone and their z label. */
+	ATF_CHECK(isc_buffer_usedlength(&target) < length / 2);
+
+	isc_buffer_init(&source, buf, isc_buffer_usedlength(&target));
+	isc_buffer_add(&source, isc_buffer_usedlength(&target));
+	isc_buffer_setactive(&source, isc_buffer_usedlength(&target));
+	isc_buffer_forward(&source, 12);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+
+	for (i = 0; i < 5000; i++) {
+		isc_buffer_t dtarget;
+
+		isc_buffer_init(&dtarget, dbuf, sizeof(dbuf));
+		result = dns_name_fromwire(dname, &source, &dctx, 0,
+					   &dtarget);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		manyname(i, ISC_FALSE, name);
+		if (sensitive)
+			ATF_CHECK(dns_name_caseequal(name, dname));
+		else
+			ATF_CHECK(dns_name_equal(name, dname));
+	}
+	ATF_CHECK_EQ(isc_buffer_remaininglength(&source), 0);
+	dns_decompress_invalidate(&dctx);
+}
+
+ATF_TC(compression_many);
+ATF_TC_HEAD(compression_many, tc) {
+	atf_tc_set_md_var(tc, "descr", "compression of many names");
+}
+ATF_TC_BODY(compression_many, tc) {
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, ISC_FALSE), ISC_R_SUCCESS);
+
+	compress_many(ISC_FALSE);
+	compress_many(ISC_TRUE);
+
+	dns_test_end();
+}
+
+#ifdef DNS_BENCHMARK_TESTS
+
+/*
+ * Render a zone transfer of 100000 names, as xfrout packs it into
+ * messages of up to 64k, with a fresh compression context for each
+ * message.
+ */
+ATF_TC(compression_benchmark);
+ATF_TC_HEAD(compression_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark name compression over a zone transfer");
+}
+ATF_TC_BODY(compression_benchmark, tc) {
+	static unsigned char buf[65535];
+	dns_fixedname_t *owners, mx;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	isc_time_t ts1, ts2;
+	unsigned int i, pass, messages = 0;
+	const unsigned int count = 100000, passes = 20;
+	isc_result_t result;
+	char text[64];
+	double t;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	owners = isc_mem_get(mctx, count * sizeof(*owners));
+	ATF_REQUIRE(owners != NULL);
+	for (i = 0; i < count; i++) {
+		dns_fixedname_init(&owners[i]);
+		snprintf(text, sizeof(text), "host%u.sub%u.example.com.",
+			 i, i % 100);
+		result = dns_name_fromstring(dns_fixedname_name(&owners[i]),
+					     text, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	dns_fixedname_init(&mx);
+	result = dns_name_fromstring(dns_fixedname_name(&mx),
+				     "mail.example.com.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (pass = 0; pass < passes; pass++) {
+		i = 0;
+		while (i < count) {
+			ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx),
+				       ISC_R_SUCCESS);
+			dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+			isc_buffer_init(&target, buf, sizeof(buf));
+			isc_buffer_add(&target, 12);
+			messages++;
+
+			/* Owner, type to rdlength, MX preference and name */
+			for (; i < count; i++) {
+				unsigned int used;
+
+				used = isc_buffer_usedlength(&target);
+				result = dns_name_towire(
+					dns_fixedname_name(&owners[i]),
+					&cctx, &target);
+				if (result == ISC_R_SUCCESS &&
+				    isc_buffer_availablelength(&target) >= 12)
+				{
+					isc_buffer_add(&target, 12);
+					result = dns_name_towire(
+						dns_fixedname_name(&mx),
+						&cctx, &target);
+				}
+				if (result != ISC_R_SUCCESS ||
+				    isc_buffer_availablelength(&target) < 12)
+				{
+					dns_compress_rollback(&cctx,
+							      (isc_uint16_t)used);
+					break;
+				}
+			}
+			dns_compress_invalidate(&cctx);
+		}
+	}
+
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%u names in %u messages, %f seconds, %f names/second\n",
+	       2 * count * passes, messages, t / 1000000.0,
+	       (2 * count * passes) / (t / 1000000.0));
+
+	isc_mem_put(mctx, owners, count * sizeof(*owners));
+
+	dns_test_end();
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -381,6 +863,12 @@ ATF_TC_BODY(benchmark, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
 	ATF_TP_ADD_TC(tp, compression);
+	ATF_TP_ADD_TC(tp, compression_many);
+	ATF_TP_ADD_TC(tp, casefold);
+#ifdef DNS_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, compression_benchmark);
+	ATF_TP_ADD_TC(tp, casefold_benchmark);
+#endif /* DNS_BENCHMARK_TESTS */
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
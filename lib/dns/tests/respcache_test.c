@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+#include <dns/result.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static isc_result_t
+make_name(const char *src, dns_name_t *name) {
+	isc_buffer_t b;
+	isc_buffer_constinit(&b, src, strlen(src));
+	isc_buffer_add(&b, strlen(src));
+	return (dns_name_fromtext(name, &b, dns_rootname, 0, NULL));
+}
+
+static void
+create_zone(dns_db_t **dbp) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	origin = dns_fixedname_name(&fixed);
+	result = make_name("example", origin);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, dbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Commit an (empty) new version of 'db'.
+ */
+static void
+bump_version(dns_db_t *db) {
+	dns_dbversion_t *version = NULL;
+	isc_result_t result;
+
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+}
+
+/*
+ * Build a fake response to a question for 'name': a header with
+ * message ID 0, the question, and 'extra' octets of 0xaa.
+ */
+static unsigned int
+make_response(const dns_name_t *name, unsigned int extra,
+	      unsigned char *buf)
+{
+	unsigned int len = 0;
+
+	memset(buf, 0, DNS_MESSAGE_HEADERLEN);
+	buf[2] = 0x84;
+	len = DNS_MESSAGE_HEADERLEN;
+	memmove(buf + len, name->ndata, name->length);
+	len += name->length;
+	memset(buf + len, 0, 4);
+	buf[len + 1] = 1;
+	buf[len + 3] = 1;
+	len += 4;
+	memset(buf + len, 0xaa, extra);
+	return (len + extra);
+}
+
+static void
+set_key(dns_respcachekey_t *key, const dns_name_t *qname) {
+	key->qname = qname;
+	key->qtype = dns_rdatatype_a;
+	key->qclass = dns_rdataclass_in;
+	key->flags = 0;
+	key->udpsize = 4096;
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(find);
+ATF_TC_HEAD(find, tc) {
+	atf_tc_set_md_var(tc, "descr", "a cached response is found with "
+				       "the new ID and question name case");
+}
+ATF_TC_BODY(find, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t f1, f2;
+	dns_name_t *stored, *asked;
+	dns_respcachekey_t key;
+	unsigned char response[512], out[512], small[16];
+	isc_buffer_t b;
+	isc_region_t r;
+	unsigned int len;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	create_zone(&db);
+	dns_db_currentversion(db, &version);
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&f1);
+	stored = dns_fixedname_name(&f1);
+	ATF_REQUIRE_EQ(make_name("www.example", stored), ISC_R_SUCCESS);
+	dns_fixedname_init(&f2);
+	asked = dns_fixedname_name(&f2);
+	ATF_REQUIRE_EQ(make_name("WwW.ExAmPle", asked), ISC_R_SUCCESS);
+
+	set_key(&key, asked);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	len = make_response(stored, 100, response);
+	r.base = response;
+	r.length = len;
+	set_key(&key, stored);
+	result = dns_respcache_add(rc, &key, db, version, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Same question in another case, new ID */
+	set_key(&key, asked);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, version, 0x1234, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&b), len);
+	ATF_CHECK_EQ(out[0], 0x12);
+	ATF_CHECK_EQ(out[1], 0x34);
+	ATF_CHECK(memcmp(out + 2, response + 2,
+			 DNS_MESSAGE_HEADERLEN - 2) == 0);
+	ATF_CHECK(memcmp(out + DNS_MESSAGE_HEADERLEN, asked->ndata,
+			 asked->length) == 0);
+	ATF_CHECK(memcmp(out + DNS_MESSAGE_HEADERLEN + asked->length,
+			 response + DNS_MESSAGE_HEADERLEN + stored->length,
+			 len - DNS_MESSAGE_HEADERLEN - stored->length) == 0);
+
+	/* Not enough room */
+	isc_buffer_init(&b, small, sizeof(small));
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+
+	/* Any other part of the key differs */
+	key.flags = 1;
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	set_key(&key, asked);
+	key.udpsize = 512;
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	set_key(&key, asked);
+	key.qtype = dns_rdatatype_aaaa;
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&rc);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(invalidate);
+ATF_TC_HEAD(invalidate, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses are dropped when the zone "
+				       "version or database changes");
+}
+ATF_TC_BODY(invalidate, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_db_t *db = NULL, *db2 = NULL;
+	dns_dbversion_t *v1 = NULL, *v2 = NULL, *v3 = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_respcachekey_t key;
+	unsigned char response[512], out[512];
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	create_zone(&db);
+	dns_db_currentversion(db, &v1);
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	ATF_REQUIRE_EQ(make_name("www.example", name), ISC_R_SUCCESS);
+	set_key(&key, name);
+	r.base = response;
+	r.length = make_response(name, 50, response);
+
+	result = dns_respcache_add(rc, &key, db, v1, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, v1, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* A new version of the zone */
+	bump_version(db);
+	dns_db_currentversion(db, &v2);
+	ATF_REQUIRE(v2 != v1);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, v2, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* The old version's response is gone too */
+	result = dns_respcache_find(rc, &key, db, v1, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* A response added with an old version is not found later */
+	result = dns_respcache_add(rc, &key, db, v1, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_find(rc, &key, db, v2, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	result = dns_respcache_add(rc, &key, db, v2, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, v2, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* A reloaded zone */
+	create_zone(&db2);
+	dns_db_currentversion(db2, &v3);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db2, v3, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* Flushing */
+	result = dns_respcache_add(rc, &key, db2, v3, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_respcache_flush(rc);
+	result = dns_respcache_find(rc, &key, db2, v3, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = dns_respcache_add(rc, &key, db2, v3, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_find(rc, &key, db2, v3, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	dns_respcache_destroy(&rc);
+	dns_db_closeversion(db, &v1, ISC_FALSE);
+	dns_db_closeversion(db, &v2, ISC_FALSE);
+	dns_db_closeversion(db2, &v3, ISC_FALSE);
+	dns_db_detach(&db);
+	dns_db_detach(&db2);
+	dns_test_end();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr", "the cache stays within its size "
+				       "by dropping old responses");
+}
+ATF_TC_BODY(evict, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_respcachekey_t key;
+	unsigned char response[512], out[512];
+	char text[64];
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+	size_t maxsize = 64 * 1024;
+	unsigned int i, found = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	create_zone(&db);
+	dns_db_currentversion(db, &version);
+	result = dns_respcache_create(mctx, maxsize, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+
+	for (i = 0; i < 2000; i++) {
+		snprintf(text, sizeof(text), "n%u.example", i);
+		ATF_REQUIRE_EQ(make_name(text, name), ISC_R_SUCCESS);
+		set_key(&key, name);
+		r.base = response;
+		r.length = make_response(name, 200, response);
+		result = dns_respcache_add(rc, &key, db, version, &r);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		/* The response just added is always there */
+		isc_buffer_init(&b, out, sizeof(out));
+		result = dns_respcache_find(rc, &key, db, version, 1, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 2000; i++) {
+		snprintf(text, sizeof(text), "n%u.example", i);
+		ATF_REQUIRE_EQ(make_name(text, name), ISC_R_SUCCESS);
+		set_key(&key, name);
+		isc_buffer_init(&b, out, sizeof(out));
+		result = dns_respcache_find(rc, &key, db, version, 1, &b);
+		if (result == ISC_R_SUCCESS)
+			found++;
+	}
+	ATF_CHECK(found > 0);
+	ATF_CHECK(found * 200 < maxsize);
+
+	/* Responses too large for a stripe are not kept */
+	ATF_REQUIRE_EQ(make_name("big.example", name), ISC_R_SUCCESS);
+	set_key(&key, name);
+	r.length = make_response(name, 480, response);
+	dns_respcache_destroy(&rc);
+	result = dns_respcache_create(mctx, 16 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_add(rc, &key, db, version, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&rc);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(nopin);
+ATF_TC_HEAD(nopin, tc) {
+	atf_tc_set_md_var(tc, "descr", "cached responses do not keep their "
+				       "database or version alive");
+}
+ATF_TC_BODY(nopin, tc) {
+	dns_respcache_t *rc = NULL;
+	isc_mem_t *dbmctx = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_respcachekey_t key;
+	unsigned char response[512], out[512];
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The database gets a memory context of its own, so that it can
+	 * be seen to be freed.
+	 */
+	result = isc_mem_create(0, 0, &dbmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	ATF_REQUIRE_EQ(make_name("example", name), ISC_R_SUCCESS);
+	result = dns_db_create(dbmctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &version);
+
+	ATF_REQUIRE_EQ(make_name("www.example", name), ISC_R_SUCCESS);
+	set_key(&key, name);
+	r.base = response;
+	r.length = make_response(name, 50, response);
+	result = dns_respcache_add(rc, &key, db, version, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* Committing a new version frees the old one */
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	bump_version(db);
+	dns_db_currentversion(db, &version);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, db, version, 1, &b);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = dns_respcache_add(rc, &key, db, version, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The database goes away while the cache still has a response */
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	dns_db_detach(&db);
+	ATF_CHECK_EQ(isc_mem_inuse(dbmctx), 0);
+	isc_mem_destroy(&dbmctx);
+
+	dns_respcache_destroy(&rc);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, find);
+	ATF_TP_ADD_TC(tp, invalidate);
+	ATF_TP_ADD_TC(tp, evict);
+	ATF_TP_ADD_TC(tp, nopin);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+#include <dns/result.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+#define NAMES		200
+
+static isc_stdtime_t now;
+
+static isc_result_t
+make_name(const char *src, dns_name_t *name) {
+	isc_buffer_t b;
+	isc_buffer_constinit(&b, src, strlen(src));
+	isc_buffer_add(&b, strlen(src));
+	return (dns_name_fromtext(name, &b, dns_rootname, 0, NULL));
+}
+
+static char eight[] = "8";
+
+static void
+create_cache(const char *impl, dns_db_t **dbp) {
+	char *argv[2];
+	isc_result_t result;
+
+	/* "sharded" databases get eight shards. */
+	argv[0] = (char *)mctx;
+	argv[1] = eight;
+	result = dns_db_create(mctx, impl, dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in,
+			       strcmp(impl, "sharded") == 0 ? 2 : 1, argv,
+			       dbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+add_rdata(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	  unsigned char *data, unsigned int length)
+{
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = make_name(owner, name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	rdata.data = data;
+	rdata.length = length;
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = type;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, name, ISC_TRUE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+}
+
+static void
+add_a(dns_db_t *db, const char *owner) {
+	static unsigned char addr[4] = { 192, 0, 2, 1 };
+
+	add_rdata(db, owner, dns_rdatatype_a, addr, sizeof(addr));
+}
+
+static void
+add_ns(dns_db_t *db, const char *owner) {
+	static unsigned char ns[] = "\002ns\007example";
+
+	add_rdata(db, owner, dns_rdatatype_ns, ns, sizeof(ns));
+}
+
+static isc_boolean_t
+hasdata(dns_db_t *db, dns_dbnode_t *node) {
+	dns_rdatasetiter_t *iter = NULL;
+	isc_result_t result;
+
+	result = dns_db_allrdatasets(db, node, NULL, now, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rdatasetiter_first(iter);
+	dns_rdatasetiter_destroy(&iter);
+	return (ISC_TF(result == ISC_R_SUCCESS));
+}
+
+/*
+ * Walk 'db' and store the names with data in 'names', returning how
+ * many there are.
+ */
+static unsigned int
+walk(dns_db_t *db, isc_boolean_t forward, dns_fixedname_t *names,
+     unsigned int max)
+{
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	unsigned int n = 0;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+
+	result = dns_db_createiterator(db, 0, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (result = forward ? dns_dbiterator_first(iter) :
+				dns_dbiterator_last(iter);
+	     result == ISC_R_SUCCESS;
+	     result = forward ? dns_dbiterator_next(iter) :
+				dns_dbiterator_prev(iter))
+	{
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		if (hasdata(db, node)) {
+			ATF_REQUIRE(n < max);
+			dns_fixedname_init(&names[n]);
+			dns_name_copy(name, dns_fixedname_name(&names[n]),
+				      NULL);
+			n++;
+		}
+		dns_db_detachnode(db, &node);
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_NOMORE);
+
+	dns_dbiterator_destroy(&iter);
+	return (n);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(zonecut);
+ATF_TC_HEAD(zonecut, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "delegations are found across shards");
+}
+ATF_TC_BODY(zonecut, tc) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed, ffound, fexample;
+	dns_name_t *name, *found, *example;
+	char text[DNS_NAME_FORMATSIZE];
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	create_cache("sharded", &db);
+	add_ns(db, "example.");
+	add_ns(db, "sub.example.");
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&ffound);
+	found = dns_fixedname_name(&ffound);
+	dns_fixedname_init(&fexample);
+	example = dns_fixedname_name(&fexample);
+	result = make_name("example.", example);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * With eight shards most of these names are not in the
+	 * shard of either delegation.
+	 */
+	for (i = 0; i < NAMES; i++) {
+		snprintf(text, sizeof(text), "host%u.example.", i);
+		result = make_name(text, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, now,
+				     &node, found, &rdataset, NULL);
+		ATF_CHECK_EQ(result, DNS_R_DELEGATION);
+		ATF_CHECK(dns_name_equal(found, example));
+		ATF_CHECK_EQ(rdataset.type, dns_rdatatype_ns);
+		if (dns_rdataset_isassociated(&rdataset))
+			dns_rdataset_disassociate(&rdataset);
+		if (node != NULL)
+			dns_db_detachnode(db, &node);
+
+		snprintf(text, sizeof(text), "a.host%u.sub.example.", i);
+		result = make_name(text, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_findzonecut(db, name, 0, now, NULL, found,
+					    &rdataset, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		dns_name_format(found, text, sizeof(text));
+		ATF_CHECK_STREQ(text, "sub.example");
+		if (dns_rdataset_isassociated(&rdataset))
+			dns_rdataset_disassociate(&rdataset);
+	}
+
+	/* Names outside of any delegation. */
+	result = make_name("example.org.", name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findzonecut(db, name, 0, now, NULL, found,
+				    &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* NOEXACT skips the delegation at the name itself. */
+	result = make_name("sub.example.", name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findzonecut(db, name, DNS_DBFIND_NOEXACT, now, NULL,
+				    found, &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_name_equal(found, example));
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(iterate);
+ATF_TC_HEAD(iterate, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "iteration visits the names of all shards in order");
+}
+ATF_TC_BODY(iterate, tc) {
+	dns_db_t *rbt = NULL, *sharded = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t *expect, *forward, *backward, fixed;
+	dns_name_t *name;
+	char text[DNS_NAME_FORMATSIZE];
+	unsigned int i, n, nf, nb;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	expect = malloc(3 * (NAMES + 1) * sizeof(*expect));
+	ATF_REQUIRE(expect != NULL);
+	forward = expect + NAMES + 1;
+	backward = forward + NAMES + 1;
+
+	create_cache("rbt", &rbt);
+	create_cache("sharded", &sharded);
+	for (i = 0; i < NAMES; i++) {
+		snprintf(text, sizeof(text), "n%u.d%u.example.", i, i % 7);
+		add_a(rbt, text);
+		add_a(sharded, text);
+	}
+	add_a(rbt, "example.");
+	add_a(sharded, "example.");
+
+	n = walk(rbt, ISC_TRUE, expect, NAMES + 1);
+	ATF_REQUIRE_EQ(n, NAMES + 1);
+	nf = walk(sharded, ISC_TRUE, forward, NAMES + 1);
+	nb = walk(sharded, ISC_FALSE, backward, NAMES + 1);
+	ATF_REQUIRE_EQ(nf, n);
+	ATF_REQUIRE_EQ(nb, n);
+	for (i = 0; i < n; i++) {
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&expect[i]),
+					 dns_fixedname_name(&forward[i])));
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&expect[i]),
+				dns_fixedname_name(&backward[n - 1 - i])));
+	}
+
+	/*
+	 * Seeking a missing name leaves the iterator between its
+	 * neighbours.
+	 */
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_db_createiterator(sharded, 0, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = make_name("n10.d3.example.", name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_seek(iter, name);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* "n10a" sorts after "n101" and "n108". */
+	result = make_name("n10a.d3.example.", name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < n; i++)
+		if (dns_name_compare(dns_fixedname_name(&expect[i]), name) > 0)
+			break;
+	ATF_REQUIRE(i < n);
+	result = dns_dbiterator_seek(iter, name);
+	ATF_CHECK_EQ(result, DNS_R_PARTIALMATCH);
+	result = dns_dbiterator_next(iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(sharded, &node);
+	/* The iterator may stop at empty nodes; skip them. */
+	while (!dns_name_equal(name, dns_fixedname_name(&expect[i]))) {
+		ATF_REQUIRE(dns_name_compare(name,
+				dns_fixedname_name(&expect[i])) < 0);
+		result = dns_dbiterator_next(iter);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_detachnode(sharded, &node);
+	}
+
+	/* Going back from there finds the name before the gap. */
+	result = dns_dbiterator_prev(iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(sharded, &node);
+	ATF_CHECK(dns_name_compare(name,
+				   dns_fixedname_name(&expect[i])) < 0);
+	ATF_CHECK(dns_name_compare(name,
+				   dns_fixedname_name(&expect[i - 1])) >= 0);
+
+	dns_dbiterator_destroy(&iter);
+	free(expect);
+	dns_db_detach(&rbt);
+	dns_db_detach(&sharded);
+	dns_test_end();
+}
+
+ATF_TC(shards);
+ATF_TC_HEAD(shards, tc) {
+	atf_tc_set_md_var(tc, "descr", "the shard count is checked");
+}
+ATF_TC_BODY(shards, tc) {
+	dns_db_t *db = NULL;
+	char *argv[2];
+	char zero[] = "0", toomany[] = "65";
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	argv[0] = (char *)mctx;
+	argv[1] = zero;
+	result = dns_db_create(mctx, "sharded", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in,
+			       2, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	argv[1] = toomany;
+	result = dns_db_create(mctx, "sharded", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in,
+			       2, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	result = dns_db_create(mctx, "sharded", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in,
+			       1, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (db != NULL)
+		dns_db_detach(&db);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, zonecut);
+	ATF_TP_ADD_TC(tp, iterate);
+	ATF_TP_ADD_TC(tp, shards);
+
+	return (atf_no_error());
+}
@@ -47,6 +47,7 @@
 #include <dns/request.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/respcache.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
 #include <dns/stats.h>
@@ -203,6 +204,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->denyanswernames = NULL;
 	view->answernames_exclude = NULL;
 	view->rrl = NULL;
+	view->respcache = NULL;
 	view->provideixfr = ISC_TRUE;
 	view->maxcachettl = 7 * 24 * 3600;
 	view->maxncachettl = 3 * 3600;
@@ -380,6 +382,8 @@ destroy(dns_view_t *view) {
 	if (view->resolver != NULL)
 		dns_resolver_detach(&view->resolver);
 	dns_rrl_view_destroy(view);
+	if (view->respcache != NULL)
+		dns_respcache_destroy(&view->respcache);
 	if (view->rpzs != NULL)
 		dns_rpz_detach_rpzs(&view->rpzs);
 	if (view->catzs != NULL)
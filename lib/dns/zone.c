@@ -365,6 +365,12 @@ struct dns_zone {
 	 */
 	isc_boolean_t           automatic;
 
+	/*%
+	 * Hash of the configuration the zone was last configured with.
+	 */
+	isc_boolean_t           hasconfighash;
+	unsigned char           confighash[DNS_ZONE_CONFIGHASHLEN];
+
 	/*%
 	 * response policy data to be relayed to the database
 	 */
@@ -1034,6 +1040,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->privatetype = (dns_rdatatype_t)0xffffU;
 	zone->added = ISC_FALSE;
 	zone->automatic = ISC_FALSE;
+	zone->hasconfighash = ISC_FALSE;
 	zone->rpzs = NULL;
 	zone->rpz_num = DNS_RPZ_INVALID_NUM;
 
@@ -18064,6 +18071,35 @@ dns_zone_getadded(dns_zone_t *zone) {
 	return (zone->added);
 }
 
+void
+dns_zone_setconfighash(dns_zone_t *zone, const unsigned char *hash) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	if (hash != NULL) {
+		memmove(zone->confighash, hash, sizeof(zone->confighash));
+		zone->hasconfighash = ISC_TRUE;
+	} else
+		zone->hasconfighash = ISC_FALSE;
+	UNLOCK_ZONE(zone);
+}
+
+isc_boolean_t
+dns_zone_confighashequal(dns_zone_t *zone, const unsigned char *hash) {
+	isc_boolean_t equal;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(hash != NULL);
+
+	LOCK_ZONE(zone);
+	equal = ISC_TF(zone->hasconfighash &&
+		       memcmp(zone->confighash, hash,
+			      sizeof(zone->confighash)) == 0);
+	UNLOCK_ZONE(zone);
+
+	return (equal);
+}
+
 isc_result_t
 dns_zone_dlzpostload(dns_zone_t *zone, dns_db_t *db)
 {
@@ -83,6 +83,7 @@ dns_zt_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, dns_zt_t **ztp) {
 	result = isc_rwlock_init(&zt->rwlock, 0, 0);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbt;
+	isc_rwlock_setreaderbias(&zt->rwlock, ISC_TRUE);
 
 	zt->mctx = NULL;
 	isc_mem_attach(mctx, &zt->mctx);
@@ -29,6 +29,9 @@ typedef enum {
 #ifdef ISC_PLATFORM_USETHREADS
 #if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
 #define ISC_RWLOCK_USEATOMIC 1
+#ifdef ISC_PLATFORM_HAVEATOMICSTORE
+#define ISC_RWLOCK_USEBIAS 1
+#endif
 #endif
 
 struct isc_rwlock {
@@ -67,6 +70,17 @@ struct isc_rwlock {
 	/* Unlocked. */
 	unsigned int		write_quota;
 
+#ifdef ISC_RWLOCK_USEBIAS
+	/*
+	 * Reader bias; see isc_rwlock_setreaderbias().  bias_id is set
+	 * before the lock is shared, rbias is read or modified atomically,
+	 * and bias_inhibit is modified by writers only.
+	 */
+	isc_int32_t		bias_id;
+	isc_int32_t		rbias;
+	isc_uint64_t		bias_inhibit;
+#endif
+
 #else  /* ISC_PLATFORM_HAVEXADD && ISC_PLATFORM_HAVECMPXCHG */
 
 	/*%< Locked by lock. */
@@ -122,6 +136,32 @@ isc_rwlock_downgrade(isc_rwlock_t *rwl);
 void
 isc_rwlock_destroy(isc_rwlock_t *rwl);
 
+void
+isc_rwlock_setreaderbias(isc_rwlock_t *rwl, isc_boolean_t bias);
+/*%<
+ * Turn the reader bias of 'rwl' on or off.  While a lock is
+ * reader-biased, readers record themselves in per-thread slots instead
+ * of updating the shared lock word, so concurrent readers do not contend
+ * with each other; in exchange, a writer must revoke the bias and wait
+ * for those readers to leave, which makes writing more expensive.  The
+ * bias is restored some time after the last revocation.  Suitable for
+ * locks that are read far more often than they are written.
+ *
+ * Locks are created without reader bias unless the library is compiled
+ * with RWLOCK_DEFAULT_READERBIAS defined to 1.  This is a no-op when
+ * the platform does not provide the needed atomic operations.
+ *
+ * Notes:
+ *
+ *\li	A reader holding a reader-biased lock on the biased path cannot
+ *	upgrade it; isc_rwlock_tryupgrade() returns #ISC_R_LOCKBUSY.
+ *
+ * Requires:
+ *
+ *\li	'rwl' is a valid rwlock that is not held and is not yet shared
+ *	with other threads.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* ISC_RWLOCK_H */
@@ -68,6 +68,7 @@
 #define isc_socket_detach isc__socket_detach
 #define isc_socketmgr_create isc__socketmgr_create
 #define isc_socketmgr_create2 isc__socketmgr_create2
+#define isc_socketmgr_create3 isc__socketmgr_create3
 #define isc_socketmgr_destroy isc__socketmgr_destroy
 #define isc_socket_open isc__socket_open
 #define isc_socket_close isc__socket_close
@@ -125,6 +126,14 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT prior to calling
+ * bind() (AF_INET and AF_INET6), so that several sockets can be bound to
+ * the same address and port and the kernel distributes incoming
+ * datagrams among them.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -203,7 +212,17 @@ enum {
 	isc_sockstatscounter_rawrecvfail = 60,
 	isc_sockstatscounter_rawactive = 61,
 
-	isc_sockstatscounter_max = 62
+	isc_sockstatscounter_udp4recvbatch = 62,
+	isc_sockstatscounter_udp6recvbatch = 63,
+	isc_sockstatscounter_udp4recvbatchmsg = 64,
+	isc_sockstatscounter_udp6recvbatchmsg = 65,
+
+	isc_sockstatscounter_udp4sendbatch = 66,
+	isc_sockstatscounter_udp6sendbatch = 67,
+	isc_sockstatscounter_udp4sendbatchmsg = 68,
+	isc_sockstatscounter_udp6sendbatchmsg = 69,
+
+	isc_sockstatscounter_max = 70
 };
 
 /***
@@ -705,6 +724,8 @@ isc_socket_bind(isc_socket_t *sock, const isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED -- ISC_SOCKET_REUSEPORT was requested but
+ *	is not supported by the system.
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -1026,11 +1047,20 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		      unsigned int maxsocks);
+
+isc_result_t
+isc_socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
  * "maxsocks" being zero.
+ * isc_socketmgr_create3() runs "nthreads" watcher threads, each with
+ * its own event loop; every socket is watched by exactly one of them,
+ * chosen by its file descriptor.  isc_socketmgr_create2() is equivalent
+ * of isc_socketmgr_create3() with "nthreads" being one.  "nthreads" is
+ * ignored when the library is built without threads.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -1222,6 +1252,24 @@ isc__socketmgr_setreserved(isc_socketmgr_t *mgr, isc_uint32_t);
  * Temporary.  For use by named only.
  */
 
+isc_result_t
+isc_socketmgr_setcpus(isc_socketmgr_t *mgr, const isc_uint32_t *cpus,
+		      unsigned int ncpus);
+/*%<
+ * Bind watcher thread 'n' of 'mgr' to CPU 'cpus[n % ncpus]'.  If 'ncpus'
+ * is zero, the watchers are unbound and may run on any CPU.
+ *
+ * Requires:
+ *\li	'mgr' is a valid socket manager.
+ *
+ *\li	'cpus' != NULL or 'ncpus' == 0.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_RANGE		-- a CPU in 'cpus' does not exist
+ *\li	#ISC_R_NOTIMPLEMENTED	-- threads cannot be bound on this system
+ */
+
 void
 isc__socketmgr_maxudp(isc_socketmgr_t *mgr, int maxudp);
 /*%<
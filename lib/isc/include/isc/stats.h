@@ -22,6 +22,11 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_STATSDUMP_VERBOSE	0x00000001 /*%< dump 0-value counters */
 
+/*%<
+ * Flag(s) for isc_stats_create2().
+ */
+#define ISC_STATSCREATE_STRIPED	0x00000001 /*%< per-CPU counter stripes */
+
 /*%<
  * Dump callback type.
  */
@@ -44,6 +49,29 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options);
+/*%<
+ * Like isc_stats_create(), but if 'options' has the ISC_STATSCREATE_STRIPED
+ * flag and there is more than one CPU, each counter is kept in one stripe
+ * per CPU, each stripe on its own cache lines.  Threads update the stripe
+ * assigned to them, so that counters updated by every query do not bounce
+ * between CPUs; the stripes are summed by isc_stats_dump().  This costs
+ * ncounters * 8 bytes per CPU, so it is meant for server-wide counters
+ * rather than per-zone ones.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -561,6 +561,16 @@ isc_task_gettag(isc_task_t *task);
  *\li	'task' is a valid task.
  */
 
+unsigned int
+isc_task_getthreadid(isc_task_t *task);
+/*%<
+ * Get the index of the worker thread whose run queue 'task' belongs to.
+ * Other workers may still run the task when that worker is busy.
+ *
+ * Requires:
+ *\li	'task' is a valid task.
+ */
+
 isc_result_t
 isc_task_beginexclusive(isc_task_t *task);
 /*%<
@@ -670,6 +680,11 @@ isc_taskmgr_create(isc_mem_t *mctx, unsigned int workers,
  *	create 'workers' threads, but if at least one thread creation
  *	succeeds, isc_taskmgr_create() may return ISC_R_SUCCESS.
  *
+ *\li	Each worker thread has its own run queue.  Tasks are assigned to
+ *	the run queues in turn as they are created, and are always made
+ *	ready on their own queue; a worker with nothing to do will run
+ *	ready tasks from the other workers' queues.
+ *
  *\li	If 'default_quantum' is non-zero, then it will be used as the default
  *	quantum value when tasks are created.  If zero, then an implementation
  *	defined default quantum will be used.
@@ -769,6 +784,24 @@ isc_taskmgr_setexcltask(isc_taskmgr_t *mgr, isc_task_t *task);
  *\li	'task' is a valid task.
  */
 
+isc_result_t
+isc_taskmgr_setcpus(isc_taskmgr_t *mgr, const isc_uint32_t *cpus,
+		    unsigned int ncpus);
+/*%<
+ * Bind worker thread 'n' of 'mgr' to CPU 'cpus[n % ncpus]'.  If 'ncpus'
+ * is zero, the workers are unbound and may run on any CPU.
+ *
+ * Requires:
+ *\li	'manager' is a valid task manager.
+ *
+ *\li	'cpus' != NULL or 'ncpus' == 0.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_RANGE		-- a CPU in 'cpus' does not exist
+ *\li	#ISC_R_NOTIMPLEMENTED	-- threads cannot be bound on this system
+ */
+
 isc_result_t
 isc_taskmgr_excltask(isc_taskmgr_t *mgr, isc_task_t **taskp);
 /*%<
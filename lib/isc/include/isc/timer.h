@@ -342,9 +342,18 @@ isc_timermgr_createinctx(isc_mem_t *mctx, isc_appctx_t *actx,
 
 isc_result_t
 isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		     unsigned int nthreads);
 /*%<
  * Create a timer manager.  isc_timermgr_createinctx() also associates
  * the new manager with the specified application context.
+ * isc_timermgr_create2() runs "nthreads" timer threads, each serving
+ * its own timing wheel; every timer is placed on one of the wheels when
+ * it is created.  isc_timermgr_create() is equivalent of
+ * isc_timermgr_create2() with "nthreads" being one.  "nthreads" is
+ * ignored when the library is built without threads.
  *
  * Notes:
  *
@@ -358,6 +367,8 @@ isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
  *
  *\li	'actx' is a valid application context (for createinctx()).
  *
+ *\li	'nthreads' > 0 (for create2()).
+ *
  * Ensures:
  *
  *\li	'*managerp' is a valid isc_timermgr_t.
@@ -26,6 +26,7 @@
 #include <isc/string.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
@@ -48,6 +49,10 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define NUM_BASIC_BLOCKS	64		/*%< must be > 1 */
 #define TABLE_INCREMENT		1024
 #define DEBUGLIST_COUNT		1024
+#define TCACHE_MAXTHREADS	64		/*%< threads with private caches */
+#define TCACHE_BYTES		4096		/*%< bytes per magazine */
+#define TCACHE_MINITEMS		4
+#define TCACHE_MAXITEMS		64
 
 /*
  * Types.
@@ -78,6 +83,27 @@ struct element {
 	element *		next;
 };
 
+/*%
+ * A magazine is a short list of free items of one size owned by a single
+ * thread, which pushes and pops them without taking any lock.  Items in
+ * a magazine are still accounted as in use by the context or pool that
+ * handed them out; they go back through the locked paths in batches.
+ */
+typedef struct magazine {
+	element *		items;
+	unsigned int		count;
+} magazine_t;
+
+typedef struct tcache {
+	size_t			cached;		/*%< bytes held in mags */
+	magazine_t *		mags;		/*%< indexed by size class */
+} tcache_t;
+
+typedef struct pooltcache {
+	magazine_t		mag;
+	unsigned int		gets;		/*%< stats only */
+} pooltcache_t;
+
 typedef struct {
 	/*!
 	 * This structure must be ALIGNMENT_SIZE bytes.
@@ -117,6 +143,18 @@ static isc_mutex_t 		createlock;
  */
 static isc_uint64_t		totallost;
 
+#ifdef ISC_PLATFORM_USETHREADS
+/*%
+ * Thread cache slots.  A thread is given a slot the first time it uses a
+ * context or pool that has thread caches, and gives it back when it
+ * exits.  tcache_ids[TCACHE_MAXTHREADS] marks threads that found every
+ * slot taken; they always use the locked paths.  Locked by contextslock.
+ */
+static isc_thread_key_t		tcache_key;
+static isc_boolean_t		tcache_inuse[TCACHE_MAXTHREADS];
+static unsigned int		tcache_ids[TCACHE_MAXTHREADS + 1];
+#endif
+
 struct isc__mem {
 	isc_mem_t		common;
 	isc_ondestroy_t		ondestroy;
@@ -161,6 +199,8 @@ struct isc__mem {
 	unsigned int		debuglistcnt;
 #endif
 
+	tcache_t **		tcache;		/*%< per thread slot, or NULL */
+
 	unsigned int		memalloc_failures;
 	ISC_LINK(isc__mem_t)	link;
 };
@@ -185,6 +225,8 @@ struct isc__mempool {
 	unsigned int	fillcount;	/*%< # of items to fetch on each fill */
 	/*%< Stats only. */
 	unsigned int	gets;		/*%< # of requests to this pool */
+	/*%< Per thread slot, or NULL; each entry owned by its thread. */
+	pooltcache_t  **tcache;
 	/*%< Debugging only. */
 #if ISC_MEMPOOL_NAMES
 	char		name[16];	/*%< printed name in stats reports */
@@ -708,8 +750,12 @@ mem_getunlocked(isc__mem_t *ctx, size_t size) {
 	 * The stats[] uses the _actual_ "size" requested by the
 	 * caller, with the caveat (in the code above) that "size" >= the
 	 * max. size (max_size) ends up getting recorded as a call to
-	 * max_size.
+	 * max_size.  Contexts with thread caches record "new_size", as
+	 * a cached block may be handed out again for any size that
+	 * rounds up to it.
 	 */
+	if (ctx->tcache != NULL)
+		size = new_size;
 	ctx->stats[size].gets++;
 	ctx->stats[size].totalgets++;
 	ctx->stats[new_size].freefrags--;
@@ -778,8 +824,10 @@ mem_putunlocked(isc__mem_t *ctx, void *mem, size_t size) {
 	 * The stats[] uses the _actual_ "size" requested by the
 	 * caller, with the caveat (in the code above) that "size" >= the
 	 * max. size (max_size) ends up getting recorded as a call to
-	 * max_size.
+	 * max_size.  See mem_getunlocked() for contexts with thread caches.
 	 */
+	if (ctx->tcache != NULL)
+		size = new_size;
 	INSIST(ctx->stats[size].gets != 0U);
 	ctx->stats[size].gets--;
 	ctx->stats[new_size].freefrags++;
@@ -877,6 +925,319 @@ mem_putstats(isc__mem_t *ctx, void *ptr, size_t size) {
 	ctx->malloced -= size;
 }
 
+/*
+ * Thread caches.
+ */
+
+#if ISC_MEM_TRACKLINES
+#define TCACHE_TRACING()	((isc_mem_debugging & TRACE_OR_RECORD) != 0)
+#else
+#define TCACHE_TRACING()	ISC_FALSE
+#endif
+
+#ifdef ISC_PLATFORM_USETHREADS
+static void
+tcache_release(void *arg) {
+	unsigned int id = *(unsigned int *)arg;
+
+	if (id < TCACHE_MAXTHREADS) {
+		LOCK(&contextslock);
+		tcache_inuse[id] = ISC_FALSE;
+		UNLOCK(&contextslock);
+	}
+}
+#endif
+
+/*%
+ * Return the calling thread's cache slot, or -1 if it has none.
+ */
+static inline int
+tcache_slot(void) {
+#ifdef ISC_PLATFORM_USETHREADS
+	unsigned int *idp;
+	unsigned int i;
+
+	idp = isc_thread_key_getspecific(tcache_key);
+	if (ISC_UNLIKELY(idp == NULL)) {
+		LOCK(&contextslock);
+		for (i = 0; i < TCACHE_MAXTHREADS; i++)
+			if (!tcache_inuse[i])
+				break;
+		if (i < TCACHE_MAXTHREADS)
+			tcache_inuse[i] = ISC_TRUE;
+		UNLOCK(&contextslock);
+		idp = &tcache_ids[i];
+		RUNTIME_CHECK(isc_thread_key_setspecific(tcache_key,
+							 idp) == 0);
+	}
+	if (*idp < TCACHE_MAXTHREADS)
+		return ((int)*idp);
+#endif
+	return (-1);
+}
+
+static inline unsigned int
+tcache_capacity(size_t size) {
+	size_t count = TCACHE_BYTES / size;
+
+	if (count < TCACHE_MINITEMS)
+		return (TCACHE_MINITEMS);
+	if (count > TCACHE_MAXITEMS)
+		return (TCACHE_MAXITEMS);
+	return ((unsigned int)count);
+}
+
+/*%
+ * Return the calling thread's cache slot if a block of 'size' bytes
+ * may be served from the thread caches of 'ctx', or -1 if the locked
+ * path must be used.
+ */
+static inline int
+mem_tcacheslot(isc__mem_t *ctx, size_t size) {
+	if (ctx->tcache == NULL || quantize(size) >= ctx->max_size ||
+	    TCACHE_TRACING())
+		return (-1);
+	return (tcache_slot());
+}
+
+/*%
+ * Bytes in use, not counting blocks sitting in thread caches.  The
+ * cached byte counts are read without their owners' cooperation, so
+ * the result may be off by a few blocks while the caches are busy.
+ */
+static size_t
+mem_inuse(isc__mem_t *ctx) {
+	size_t inuse = ctx->inuse;
+	unsigned int i;
+
+	if (ctx->tcache == NULL)
+		return (inuse);
+	for (i = 0; i < TCACHE_MAXTHREADS; i++) {
+		tcache_t *tc = ctx->tcache[i];
+		if (tc != NULL)
+			inuse -= tc->cached;
+	}
+	return (inuse);
+}
+
+/*
+ * Items in thread caches are still counted in mpctx->allocated; these
+ * return the number actually given out and the number of requests.
+ */
+static unsigned int
+mempool_allocated(const isc__mempool_t *mpctx) {
+	unsigned int allocated = mpctx->allocated;
+	unsigned int i;
+
+	if (mpctx->tcache == NULL)
+		return (allocated);
+	for (i = 0; i < TCACHE_MAXTHREADS; i++) {
+		pooltcache_t *ptc = mpctx->tcache[i];
+		if (ptc != NULL)
+			allocated -= ptc->mag.count;
+	}
+	return (allocated);
+}
+
+static unsigned int
+mempool_gets(const isc__mempool_t *mpctx) {
+	unsigned int gets = mpctx->gets;
+	unsigned int i;
+
+	if (mpctx->tcache == NULL)
+		return (gets);
+	for (i = 0; i < TCACHE_MAXTHREADS; i++) {
+		pooltcache_t *ptc = mpctx->tcache[i];
+		if (ptc != NULL)
+			gets += ptc->gets;
+	}
+	return (gets);
+}
+
+/*%
+ * Return the thread cache for 'slot', creating it if needed.  Requires
+ * the context lock.
+ */
+static tcache_t *
+mem_tcachecreate(isc__mem_t *ctx, int slot) {
+	tcache_t *tc = ctx->tcache[slot];
+	size_t size;
+
+	if (tc != NULL)
+		return (tc);
+
+	size = sizeof(*tc) +
+	       (ctx->max_size / ALIGNMENT_SIZE + 1) * sizeof(magazine_t);
+	tc = (ctx->memalloc)(ctx->arg, size);
+	if (tc == NULL)
+		return (NULL);
+	memset(tc, 0, size);
+	tc->mags = (magazine_t *)(tc + 1);
+	ctx->malloced += size;
+	if (ctx->malloced > ctx->maxmalloced)
+		ctx->maxmalloced = ctx->malloced;
+	ctx->tcache[slot] = tc;
+
+	return (tc);
+}
+
+/*%
+ * Pop a block from the calling thread's cache without locking.
+ */
+static inline void *
+mem_tcacheget(isc__mem_t *ctx, int slot, size_t size) {
+	tcache_t *tc = ctx->tcache[slot];
+	size_t new_size = quantize(size);
+	magazine_t *mag;
+	element *item;
+
+	if (tc == NULL)
+		return (NULL);
+	mag = &tc->mags[new_size / ALIGNMENT_SIZE];
+	item = mag->items;
+	if (item == NULL)
+		return (NULL);
+	mag->items = item->next;
+	mag->count--;
+	tc->cached -= new_size;
+
+#if ISC_MEM_FILL
+	memset(item, 0xbe, new_size); /* Mnemonic for "beef". */
+#endif
+
+	return (item);
+}
+
+/*%
+ * Get a block for the caller and refill the calling thread's magazine
+ * to half its capacity.  Requires the context lock.
+ */
+static void *
+mem_tcachefill(isc__mem_t *ctx, int slot, size_t size) {
+	size_t new_size = quantize(size);
+	unsigned int i, count;
+	tcache_t *tc;
+	magazine_t *mag;
+	element *item;
+	void *ret;
+
+	ret = mem_getunlocked(ctx, new_size);
+	tc = mem_tcachecreate(ctx, slot);
+	if (ret == NULL || tc == NULL)
+		return (ret);
+
+	mag = &tc->mags[new_size / ALIGNMENT_SIZE];
+	count = tcache_capacity(new_size) / 2;
+	for (i = mag->count; i < count; i++) {
+		item = mem_getunlocked(ctx, new_size);
+		if (item == NULL)
+			break;
+		item->next = mag->items;
+		mag->items = item;
+		mag->count++;
+		tc->cached += new_size;
+	}
+
+	return (ret);
+}
+
+/*%
+ * Push a block onto the calling thread's cache without locking.
+ * Returns ISC_FALSE if the magazine is full (or missing).
+ */
+static inline isc_boolean_t
+mem_tcacheput(isc__mem_t *ctx, int slot, void *mem, size_t size) {
+	tcache_t *tc = ctx->tcache[slot];
+	size_t new_size = quantize(size);
+	magazine_t *mag;
+	element *item;
+
+	if (tc == NULL)
+		return (ISC_FALSE);
+	mag = &tc->mags[new_size / ALIGNMENT_SIZE];
+	if (mag->count >= tcache_capacity(new_size))
+		return (ISC_FALSE);
+
+#if ISC_MEM_FILL
+#if ISC_MEM_CHECKOVERRUN
+	check_overrun(mem, size, new_size);
+#endif
+	memset(mem, 0xde, new_size); /* Mnemonic for "dead". */
+#endif
+
+	item = (element *)mem;
+	item->next = mag->items;
+	mag->items = item;
+	mag->count++;
+	tc->cached += new_size;
+
+	return (ISC_TRUE);
+}
+
+/*%
+ * Return half of the calling thread's magazine to the free lists and
+ * cache 'mem'.  Requires the context lock.
+ */
+static void
+mem_tcacheflush(isc__mem_t *ctx, int slot, void *mem, size_t size) {
+	size_t new_size = quantize(size);
+	unsigned int count;
+	tcache_t *tc;
+	magazine_t *mag;
+	element *item;
+
+	tc = mem_tcachecreate(ctx, slot);
+	if (tc == NULL) {
+		mem_putunlocked(ctx, mem, size);
+		return;
+	}
+
+	mag = &tc->mags[new_size / ALIGNMENT_SIZE];
+	count = tcache_capacity(new_size) / 2;
+	while (mag->count > count) {
+		item = mag->items;
+		mag->items = item->next;
+		mag->count--;
+		tc->cached -= new_size;
+		mem_putunlocked(ctx, item, new_size);
+	}
+	RUNTIME_CHECK(mem_tcacheput(ctx, slot, mem, size));
+}
+
+/*%
+ * Return everything held in thread caches to the free lists and free
+ * the caches.  Called when the context is destroyed.
+ */
+static void
+mem_tcachedestroy(isc__mem_t *ctx) {
+	size_t size, i;
+	tcache_t *tc;
+	magazine_t *mag;
+	element *item;
+	int slot;
+
+	size = sizeof(*tc) +
+	       (ctx->max_size / ALIGNMENT_SIZE + 1) * sizeof(magazine_t);
+	for (slot = 0; slot < TCACHE_MAXTHREADS; slot++) {
+		tc = ctx->tcache[slot];
+		if (tc == NULL)
+			continue;
+		for (i = 0; i <= ctx->max_size / ALIGNMENT_SIZE; i++) {
+			mag = &tc->mags[i];
+			while (mag->items != NULL) {
+				item = mag->items;
+				mag->items = item->next;
+				mem_putunlocked(ctx, item, i * ALIGNMENT_SIZE);
+			}
+		}
+		(ctx->memfree)(ctx->arg, tc);
+		ctx->malloced -= size;
+	}
+	(ctx->memfree)(ctx->arg, ctx->tcache);
+	ctx->malloced -= TCACHE_MAXTHREADS * sizeof(tcache_t *);
+	ctx->tcache = NULL;
+}
+
 /*
  * Private.
  */
@@ -901,6 +1262,16 @@ initialize_action(void) {
 	RUNTIME_CHECK(isc_mutex_init(&contextslock) == ISC_R_SUCCESS);
 	ISC_LIST_INIT(contexts);
 	totallost = 0;
+#ifdef ISC_PLATFORM_USETHREADS
+	{
+		unsigned int i;
+
+		for (i = 0; i <= TCACHE_MAXTHREADS; i++)
+			tcache_ids[i] = i;
+		RUNTIME_CHECK(isc_thread_key_create(&tcache_key,
+						    tcache_release) == 0);
+	}
+#endif
 }
 
 /*
@@ -987,6 +1358,7 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+	ctx->tcache = NULL;
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -1013,6 +1385,22 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 		       ctx->max_size * sizeof(element *));
 		ctx->malloced += ctx->max_size * sizeof(element *);
 		ctx->maxmalloced += ctx->max_size * sizeof(element *);
+#ifdef ISC_PLATFORM_USETHREADS
+		if ((flags & ISC_MEMFLAG_NOLOCK) == 0) {
+			ctx->tcache = (memalloc)(arg, TCACHE_MAXTHREADS *
+						      sizeof(tcache_t *));
+			if (ctx->tcache == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto error;
+			}
+			memset(ctx->tcache, 0,
+			       TCACHE_MAXTHREADS * sizeof(tcache_t *));
+			ctx->malloced += TCACHE_MAXTHREADS *
+					 sizeof(tcache_t *);
+			ctx->maxmalloced += TCACHE_MAXTHREADS *
+					    sizeof(tcache_t *);
+		}
+#endif
 	}
 
 #if ISC_MEM_TRACKLINES
@@ -1047,6 +1435,8 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 			(memfree)(arg, ctx->stats);
 		if (ctx->freelists != NULL)
 			(memfree)(arg, ctx->freelists);
+		if (ctx->tcache != NULL)
+			(memfree)(arg, ctx->tcache);
 #if ISC_MEM_TRACKLINES
 		if (ctx->debuglist != NULL)
 			(ctx->memfree)(ctx->arg, ctx->debuglist);
@@ -1064,6 +1454,9 @@ destroy(isc__mem_t *ctx) {
 	unsigned int i;
 	isc_ondestroy_t ondest;
 
+	if (ctx->tcache != NULL)
+		mem_tcachedestroy(ctx);
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += ctx->inuse;
@@ -1296,7 +1689,9 @@ void *
 isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	void *ptr;
+	size_t inuse;
 	isc_boolean_t call_water = ISC_FALSE;
+	int slot;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
@@ -1304,8 +1699,17 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-		MCTXLOCK(ctx, &ctx->lock);
-		ptr = mem_getunlocked(ctx, size);
+		slot = mem_tcacheslot(ctx, size);
+		if (slot >= 0) {
+			ptr = mem_tcacheget(ctx, slot, size);
+			if (ptr != NULL)
+				return (ptr);
+			MCTXLOCK(ctx, &ctx->lock);
+			ptr = mem_tcachefill(ctx, slot, size);
+		} else {
+			MCTXLOCK(ctx, &ctx->lock);
+			ptr = mem_getunlocked(ctx, size);
+		}
 	} else {
 		ptr = mem_get(ctx, size);
 		MCTXLOCK(ctx, &ctx->lock);
@@ -1314,17 +1718,18 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	}
 
 	ADD_TRACE(ctx, ptr, size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
+	inuse = mem_inuse(ctx);
+	if (ctx->hi_water != 0U && inuse > ctx->hi_water) {
 		ctx->is_overmem = ISC_TRUE;
 		if (!ctx->hi_called)
 			call_water = ISC_TRUE;
 	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	if (inuse > ctx->maxinuse) {
+		ctx->maxinuse = inuse;
+		if (ctx->hi_water != 0U && inuse > ctx->hi_water &&
 		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
 			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
+				(unsigned long)inuse);
 	}
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1339,7 +1744,8 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	isc_boolean_t call_water = ISC_FALSE;
 	size_info *si;
-	size_t oldsize;
+	size_t oldsize, inuse;
+	int slot;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	REQUIRE(ptr != NULL);
@@ -1356,11 +1762,20 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+	slot = -1;
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+		slot = mem_tcacheslot(ctx, size);
+		if (slot >= 0 && mem_tcacheput(ctx, slot, ptr, size))
+			return;
+	}
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
 
-	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+	if (slot >= 0) {
+		mem_tcacheflush(ctx, slot, ptr, size);
+	} else if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		mem_putunlocked(ctx, ptr, size);
 	} else {
 		mem_putstats(ctx, ptr, size);
@@ -1372,7 +1787,8 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	 * when the context was pushed over hi_water but then had
 	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
 	 */
-	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
+	inuse = mem_inuse(ctx);
+	if ((inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
 		ctx->is_overmem = ISC_FALSE;
 		if (ctx->hi_called)
 			call_water = ISC_TRUE;
@@ -1506,8 +1922,8 @@ isc_mem_stats(isc_mem_t *ctx0, FILE *out) {
 			"(not tracked)",
 #endif
 			(unsigned long) pool->size, pool->maxalloc,
-			pool->allocated, pool->freecount, pool->freemax,
-			pool->fillcount, pool->gets,
+			mempool_allocated(pool), pool->freecount,
+			pool->freemax, pool->fillcount, mempool_gets(pool),
 			(pool->lock == NULL ? "N" : "Y"));
 		pool = ISC_LIST_NEXT(pool, link);
 	}
@@ -1552,6 +1968,7 @@ void *
 isc___mem_allocate(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	size_info *si;
+	size_t inuse;
 	isc_boolean_t call_water = ISC_FALSE;
 
 	REQUIRE(VALID_CONTEXT(ctx));
@@ -1562,22 +1979,23 @@ isc___mem_allocate(isc_mem_t *ctx0, size_t size FLARG) {
 		mem_getstats(ctx, si[-1].u.size);
 
 	ADD_TRACE(ctx, si, si[-1].u.size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	inuse = mem_inuse(ctx);
+	if (ctx->hi_water != 0U && inuse > ctx->hi_water &&
 	    !ctx->is_overmem) {
 		ctx->is_overmem = ISC_TRUE;
 	}
 
 	if (ctx->hi_water != 0U && !ctx->hi_called &&
-	    ctx->inuse > ctx->hi_water) {
+	    inuse > ctx->hi_water) {
 		ctx->hi_called = ISC_TRUE;
 		call_water = ISC_TRUE;
 	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	if (inuse > ctx->maxinuse) {
+		ctx->maxinuse = inuse;
+		if (ctx->hi_water != 0U && inuse > ctx->hi_water &&
 		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
 			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
+				(unsigned long)inuse);
 	}
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1630,7 +2048,7 @@ void
 isc___mem_free(isc_mem_t *ctx0, void *ptr FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	size_info *si;
-	size_t size;
+	size_t size, inuse;
 	isc_boolean_t call_water= ISC_FALSE;
 
 	REQUIRE(VALID_CONTEXT(ctx));
@@ -1661,13 +2079,14 @@ isc___mem_free(isc_mem_t *ctx0, void *ptr FLARG) {
 	 * when the context was pushed over hi_water but then had
 	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
 	 */
+	inuse = mem_inuse(ctx);
 	if (ctx->is_overmem &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+	    (inuse < ctx->lo_water || ctx->lo_water == 0U)) {
 		ctx->is_overmem = ISC_FALSE;
 	}
 
 	if (ctx->hi_called &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+	    (inuse < ctx->lo_water || ctx->lo_water == 0U)) {
 		ctx->hi_called = ISC_FALSE;
 
 		if (ctx->water != NULL)
@@ -1754,7 +2173,7 @@ isc__mem_inuse(isc_mem_t *ctx0) {
 	REQUIRE(VALID_CONTEXT(ctx));
 	MCTXLOCK(ctx, &ctx->lock);
 
-	inuse = ctx->inuse;
+	inuse = mem_inuse(ctx);
 
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1815,7 +2234,7 @@ isc__mem_setwater(isc_mem_t *ctx0, isc_mem_water_t water, void *water_arg,
 	} else {
 		if (ctx->hi_called &&
 		    (ctx->water != water || ctx->water_arg != water_arg ||
-		     ctx->inuse < lowater || lowater == 0U))
+		     mem_inuse(ctx) < lowater || lowater == 0U))
 			callwater = ISC_TRUE;
 		ctx->water = water;
 		ctx->water_arg = water_arg;
@@ -1880,6 +2299,127 @@ isc_mem_gettag(isc_mem_t *ctx0) {
  * Memory pool stuff
  */
 
+/*%
+ * Take an item off the free list, filling it from the memory context if
+ * needed, and count it as allocated.  Requires the pool lock.
+ */
+static void *
+mempool_getunlocked(isc__mempool_t *mpctx) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+	unsigned int i;
+
+	/*
+	 * Don't let the caller go over quota
+	 */
+	if (ISC_UNLIKELY(mpctx->allocated >= mpctx->maxalloc))
+		return (NULL);
+
+	if (ISC_UNLIKELY(mpctx->items == NULL)) {
+		/*
+		 * We need to dip into the well.  Lock the memory context
+		 * here and fill up our free list.
+		 */
+		MCTXLOCK(mctx, &mctx->lock);
+		for (i = 0; i < mpctx->fillcount; i++) {
+			if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+				item = mem_getunlocked(mctx, mpctx->size);
+			} else {
+				item = mem_get(mctx, mpctx->size);
+				if (item != NULL)
+					mem_getstats(mctx, mpctx->size);
+			}
+			if (ISC_UNLIKELY(item == NULL))
+				break;
+			item->next = mpctx->items;
+			mpctx->items = item;
+			mpctx->freecount++;
+		}
+		MCTXUNLOCK(mctx, &mctx->lock);
+	}
+
+	/*
+	 * If we didn't get any items, return NULL.
+	 */
+	item = mpctx->items;
+	if (ISC_UNLIKELY(item == NULL))
+		return (NULL);
+
+	mpctx->items = item->next;
+	INSIST(mpctx->freecount > 0);
+	mpctx->freecount--;
+	mpctx->allocated++;
+
+	return (item);
+}
+
+/*%
+ * Return an allocated item to the free list, or to the memory context
+ * if the free list is full.  Requires the pool lock.
+ */
+static void
+mempool_putunlocked(isc__mempool_t *mpctx, void *mem) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+
+	INSIST(mpctx->allocated > 0);
+	mpctx->allocated--;
+
+	/*
+	 * If our free list is full, return this to the mctx directly.
+	 */
+	if (mpctx->freecount >= mpctx->freemax) {
+		MCTXLOCK(mctx, &mctx->lock);
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			mem_putunlocked(mctx, mem, mpctx->size);
+		} else {
+			mem_putstats(mctx, mem, mpctx->size);
+			mem_put(mctx, mem, mpctx->size);
+		}
+		MCTXUNLOCK(mctx, &mctx->lock);
+		return;
+	}
+
+	/*
+	 * Otherwise, attach it to our free list and bump the counter.
+	 */
+	mpctx->freecount++;
+	item = (element *)mem;
+	item->next = mpctx->items;
+	mpctx->items = item;
+}
+
+/*%
+ * Return the calling thread's cache slot if 'mpctx' may be served from
+ * thread caches, or -1 if the locked path must be used.  Pools with an
+ * allocation quota are never cached so that the quota stays exact.
+ */
+static inline int
+mempool_tcacheslot(isc__mempool_t *mpctx) {
+	if (mpctx->tcache == NULL || mpctx->maxalloc != UINT_MAX ||
+	    TCACHE_TRACING())
+		return (-1);
+	return (tcache_slot());
+}
+
+/*%
+ * Return the pool cache for 'slot', creating it if needed.  Requires
+ * the pool lock.
+ */
+static pooltcache_t *
+mempool_tcachecreate(isc__mempool_t *mpctx, int slot) {
+	pooltcache_t *ptc = mpctx->tcache[slot];
+
+	if (ptc == NULL) {
+		ptc = isc_mem_get((isc_mem_t *)mpctx->mctx, sizeof(*ptc));
+		if (ptc == NULL)
+			return (NULL);
+		memset(ptc, 0, sizeof(*ptc));
+		mpctx->tcache[slot] = ptc;
+	}
+	return (ptc);
+}
+
 isc_result_t
 isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	isc__mem_t *mctx = (isc__mem_t *)mctx0;
@@ -1909,6 +2449,7 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	mpctx->freemax = 1;
 	mpctx->fillcount = 1;
 	mpctx->gets = 0;
+	mpctx->tcache = NULL;
 #if ISC_MEMPOOL_NAMES
 	mpctx->name[0] = 0;
 #endif
@@ -1952,10 +2493,34 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	isc__mem_t *mctx;
 	isc_mutex_t *lock;
 	element *item;
+	pooltcache_t *ptc;
+	unsigned int i;
 
 	REQUIRE(mpctxp != NULL);
 	mpctx = (isc__mempool_t *)*mpctxp;
 	REQUIRE(VALID_MEMPOOL(mpctx));
+
+	/*
+	 * Return the items held in thread caches to the free list.
+	 */
+	if (mpctx->tcache != NULL) {
+		for (i = 0; i < TCACHE_MAXTHREADS; i++) {
+			ptc = mpctx->tcache[i];
+			if (ptc == NULL)
+				continue;
+			while (ptc->mag.items != NULL) {
+				item = ptc->mag.items;
+				ptc->mag.items = item->next;
+				mempool_putunlocked(mpctx, item);
+			}
+			isc_mem_put((isc_mem_t *)mpctx->mctx, ptc,
+				    sizeof(*ptc));
+		}
+		isc_mem_put((isc_mem_t *)mpctx->mctx, mpctx->tcache,
+			    TCACHE_MAXTHREADS * sizeof(pooltcache_t *));
+		mpctx->tcache = NULL;
+	}
+
 #if ISC_MEMPOOL_NAMES
 	if (mpctx->allocated > 0)
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -2019,67 +2584,75 @@ isc__mempool_associatelock(isc_mempool_t *mpctx0, isc_mutex_t *lock) {
 	REQUIRE(lock != NULL);
 
 	mpctx->lock = lock;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	/*
+	 * A locked pool is shared between threads; give it thread caches
+	 * unless the memory context cannot be shared.  If they cannot be
+	 * allocated the pool simply uses the lock every time.
+	 */
+	if ((mpctx->mctx->flags & ISC_MEMFLAG_NOLOCK) == 0) {
+		mpctx->tcache = isc_mem_get((isc_mem_t *)mpctx->mctx,
+					    TCACHE_MAXTHREADS *
+					    sizeof(pooltcache_t *));
+		if (mpctx->tcache != NULL)
+			memset(mpctx->tcache, 0,
+			       TCACHE_MAXTHREADS * sizeof(pooltcache_t *));
+	}
+#endif
 }
 
 void *
 isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
-	element *item;
+	element *item, *extra;
 	isc__mem_t *mctx;
-	unsigned int i;
+	pooltcache_t *ptc;
+	unsigned int count;
+	int slot;
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
 	mctx = mpctx->mctx;
 
+	slot = mempool_tcacheslot(mpctx);
+	if (slot >= 0) {
+		ptc = mpctx->tcache[slot];
+		if (ptc != NULL && ptc->mag.items != NULL) {
+			item = ptc->mag.items;
+			ptc->mag.items = item->next;
+			ptc->mag.count--;
+			ptc->gets++;
+			return (item);
+		}
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
-	/*
-	 * Don't let the caller go over quota
-	 */
-	if (ISC_UNLIKELY(mpctx->allocated >= mpctx->maxalloc)) {
-		item = NULL;
-		goto out;
-	}
+	item = mempool_getunlocked(mpctx);
+	if (item != NULL) {
+		mpctx->gets++;
 
-	if (ISC_UNLIKELY(mpctx->items == NULL)) {
 		/*
-		 * We need to dip into the well.  Lock the memory context
-		 * here and fill up our free list.
+		 * Refill the calling thread's magazine to half its
+		 * capacity while we hold the lock.
 		 */
-		MCTXLOCK(mctx, &mctx->lock);
-		for (i = 0; i < mpctx->fillcount; i++) {
-			if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-				item = mem_getunlocked(mctx, mpctx->size);
-			} else {
-				item = mem_get(mctx, mpctx->size);
-				if (item != NULL)
-					mem_getstats(mctx, mpctx->size);
+		if (slot >= 0 &&
+		    (ptc = mempool_tcachecreate(mpctx, slot)) != NULL)
+		{
+			count = tcache_capacity(mpctx->size) / 2;
+			while (ptc->mag.count < count) {
+				extra = mempool_getunlocked(mpctx);
+				if (extra == NULL)
+					break;
+				extra->next = ptc->mag.items;
+				ptc->mag.items = extra;
+				ptc->mag.count++;
 			}
-			if (ISC_UNLIKELY(item == NULL))
-				break;
-			item->next = mpctx->items;
-			mpctx->items = item;
-			mpctx->freecount++;
 		}
-		MCTXUNLOCK(mctx, &mctx->lock);
 	}
 
-	/*
-	 * If we didn't get any items, return NULL.
-	 */
-	item = mpctx->items;
-	if (ISC_UNLIKELY(item == NULL))
-		goto out;
-
-	mpctx->items = item->next;
-	INSIST(mpctx->freecount > 0);
-	mpctx->freecount--;
-	mpctx->gets++;
-	mpctx->allocated++;
-
- out:
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
 
@@ -2089,6 +2662,8 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 		ADD_TRACE(mctx, item, mpctx->size, file, line);
 		MCTXUNLOCK(mctx, &mctx->lock);
 	}
+#else
+	UNUSED(mctx);
 #endif /* ISC_MEM_TRACKLINES */
 
 	return (item);
@@ -2100,50 +2675,59 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	isc__mem_t *mctx;
 	element *item;
+	pooltcache_t *ptc;
+	unsigned int count;
+	int slot;
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mem != NULL);
 
 	mctx = mpctx->mctx;
 
+	count = 0;
+	slot = mempool_tcacheslot(mpctx);
+	if (slot >= 0) {
+		count = tcache_capacity(mpctx->size);
+		ptc = mpctx->tcache[slot];
+		if (ptc != NULL && ptc->mag.count < count) {
+			item = (element *)mem;
+			item->next = ptc->mag.items;
+			ptc->mag.items = item;
+			ptc->mag.count++;
+			return;
+		}
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
-	INSIST(mpctx->allocated > 0);
-	mpctx->allocated--;
-
 #if ISC_MEM_TRACKLINES
 	if ((isc_mem_debugging & TRACE_OR_RECORD) != 0) {
 		MCTXLOCK(mctx, &mctx->lock);
 		DELETE_TRACE(mctx, mem, mpctx->size, file, line);
 		MCTXUNLOCK(mctx, &mctx->lock);
 	}
+#else
+	UNUSED(mctx);
 #endif /* ISC_MEM_TRACKLINES */
 
-	/*
-	 * If our free list is full, return this to the mctx directly.
-	 */
-	if (mpctx->freecount >= mpctx->freemax) {
-		MCTXLOCK(mctx, &mctx->lock);
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			mem_putunlocked(mctx, mem, mpctx->size);
-		} else {
-			mem_putstats(mctx, mem, mpctx->size);
-			mem_put(mctx, mem, mpctx->size);
+	if (slot >= 0 && (ptc = mempool_tcachecreate(mpctx, slot)) != NULL) {
+		/*
+		 * The calling thread's magazine is full (or new): hand
+		 * half of it back to the pool and keep 'mem'.
+		 */
+		while (ptc->mag.count > count / 2) {
+			item = ptc->mag.items;
+			ptc->mag.items = item->next;
+			ptc->mag.count--;
+			mempool_putunlocked(mpctx, item);
 		}
-		MCTXUNLOCK(mctx, &mctx->lock);
-		if (mpctx->lock != NULL)
-			UNLOCK(mpctx->lock);
-		return;
-	}
-
-	/*
-	 * Otherwise, attach it to our free list and bump the counter.
-	 */
-	mpctx->freecount++;
-	item = (element *)mem;
-	item->next = mpctx->items;
-	mpctx->items = item;
+		item = (element *)mem;
+		item->next = ptc->mag.items;
+		ptc->mag.items = item;
+		ptc->mag.count++;
+	} else
+		mempool_putunlocked(mpctx, mem);
 
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
@@ -2249,7 +2833,7 @@ isc__mempool_getallocated(isc_mempool_t *mpctx0) {
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
-	allocated = mpctx->allocated;
+	allocated = mempool_allocated(mpctx);
 
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
@@ -2391,6 +2975,7 @@ xml_renderctx(isc__mem_t *ctx, summarystat_t *summary,
 	      xmlTextWriterPtr writer)
 {
 	int xmlrc;
+	size_t inuse;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
@@ -2430,11 +3015,12 @@ xml_renderctx(isc__mem_t *ctx, summarystat_t *summary,
 					    (isc_uint64_t)ctx->total));
 	TRY0(xmlTextWriterEndElement(writer)); /* total */
 
-	summary->inuse += ctx->inuse;
+	inuse = mem_inuse(ctx);
+	summary->inuse += inuse;
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "inuse"));
 	TRY0(xmlTextWriterWriteFormatString(writer,
 					    "%" ISC_PRINT_QUADFORMAT "u",
-					    (isc_uint64_t)ctx->inuse));
+					    (isc_uint64_t)inuse));
 	TRY0(xmlTextWriterEndElement(writer)); /* inuse */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "maxinuse"));
@@ -2581,6 +3167,7 @@ json_renderctx(isc__mem_t *ctx, summarystat_t *summary, json_object *array) {
 	isc_result_t result = ISC_R_FAILURE;
 	json_object *ctxobj, *obj;
 	char buf[1024];
+	size_t inuse;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	REQUIRE(summary != NULL);
@@ -2592,8 +3179,9 @@ json_renderctx(isc__mem_t *ctx, summarystat_t *summary, json_object *array) {
 		(ctx->max_size + 1) * sizeof(struct stats) +
 		ctx->max_size * sizeof(element *) +
 		ctx->basic_table_count * sizeof(char *);
+	inuse = mem_inuse(ctx);
 	summary->total += ctx->total;
-	summary->inuse += ctx->inuse;
+	summary->inuse += inuse;
 	summary->malloced += ctx->malloced;
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0)
 		summary->blocksize += ctx->basic_table_count *
@@ -2628,7 +3216,7 @@ json_renderctx(isc__mem_t *ctx, summarystat_t *summary, json_object *array) {
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "total", obj);
 
-	obj = json_object_new_int64(ctx->inuse);
+	obj = json_object_new_int64(inuse);
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "inuse", obj);
 
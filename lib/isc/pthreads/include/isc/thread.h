@@ -42,6 +42,14 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, int cpu);
+/*%<
+ * Bind 'thread' to CPU 'cpu', or let it run on any CPU if 'cpu' is
+ * negative.  Returns ISC_R_RANGE if 'cpu' does not exist and
+ * ISC_R_NOTIMPLEMENTED if threads cannot be bound on this system.
+ */
+
 /* XXX We could do fancier error handling... */
 
 #define isc_thread_join(t, rp) \
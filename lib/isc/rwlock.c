@@ -17,9 +17,12 @@
 #include <isc/atomic.h>
 #include <isc/magic.h>
 #include <isc/msgs.h>
+#include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
+#include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #define RWLOCK_MAGIC		ISC_MAGIC('R', 'W', 'L', 'k')
@@ -39,11 +42,54 @@
 #define RWLOCK_MAX_ADAPTIVE_COUNT 100
 #endif
 
+#ifndef RWLOCK_DEFAULT_READERBIAS
+#define RWLOCK_DEFAULT_READERBIAS 0
+#endif
+
 #if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
 static isc_result_t
 isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
 #endif
 
+#ifdef ISC_RWLOCK_USEBIAS
+/*
+ * Reader bias, after "BRAVO -- Biased Locking for Reader-Writer Locks"
+ * (Dice and Kogan, 2019).  Each thread owns a row of bias_table.  While
+ * a lock is biased (rbias is BIAS_ON), a reader takes it by storing the
+ * lock's id in the slot of its row that the id hashes to, and then
+ * checking that the bias is still on; cnt_and_flag is not touched.  A
+ * writer takes the lock as usual, revokes the bias and waits until no
+ * row holds the lock's id.  BIAS_REVOKING marks a revocation that a
+ * non-blocking writer could not finish; the next writer finishes it.
+ * Readers on the ordinary path turn the bias back on once
+ * BIAS_INHIBIT_MULTIPLIER times the duration of the last revocation has
+ * passed, which bounds the time writers spend revoking.
+ *
+ * Threads that find every row taken always use the ordinary path.
+ */
+#define BIAS_ROWS		64
+#define BIAS_COLUMNS		32
+#define BIAS_INHIBIT_MULTIPLIER	9
+
+#define BIAS_OFF		0
+#define BIAS_ON			1
+#define BIAS_REVOKING		2
+
+#define BIAS_LOAD(x)		(*(volatile isc_int32_t *)&(x))
+
+#define NS_PER_S		1000000000
+
+static isc_once_t		bias_once = ISC_ONCE_INIT;
+static isc_mutex_t		bias_lock;
+static isc_thread_key_t		bias_key;
+static isc_int32_t		bias_nextid;
+/*% Locked by bias_lock. */
+static isc_boolean_t		bias_inuse[BIAS_ROWS];
+static unsigned int		bias_rows[BIAS_ROWS + 1];
+/*% Slots are written by their row's thread only. */
+static isc_int32_t		bias_table[BIAS_ROWS][BIAS_COLUMNS];
+#endif /* ISC_RWLOCK_USEBIAS */
+
 #ifdef ISC_RWLOCK_TRACE
 #include <stdio.h>		/* Required for fprintf/stderr. */
 #include <isc/thread.h>		/* Required for isc_thread_self(). */
@@ -118,6 +164,11 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 	if (write_quota == 0)
 		write_quota = RWLOCK_DEFAULT_WRITE_QUOTA;
 	rwl->write_quota = write_quota;
+#ifdef ISC_RWLOCK_USEBIAS
+	rwl->bias_id = 0;
+	rwl->rbias = BIAS_OFF;
+	rwl->bias_inhibit = 0;
+#endif
 #else
 	rwl->type = isc_rwlocktype_read;
 	rwl->original = isc_rwlocktype_none;
@@ -160,6 +211,9 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 
 	rwl->magic = RWLOCK_MAGIC;
 
+	if (RWLOCK_DEFAULT_READERBIAS)
+		isc_rwlock_setreaderbias(rwl, ISC_TRUE);
+
 	return (ISC_R_SUCCESS);
 
   destroy_rcond:
@@ -191,6 +245,54 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 	DESTROYLOCK(&rwl->lock);
 }
 
+#ifdef ISC_RWLOCK_USEBIAS
+static void
+bias_release(void *arg) {
+	unsigned int row = *(unsigned int *)arg;
+
+	if (row < BIAS_ROWS) {
+		LOCK(&bias_lock);
+		bias_inuse[row] = ISC_FALSE;
+		UNLOCK(&bias_lock);
+	}
+}
+
+static void
+bias_initialize(void) {
+	unsigned int i;
+
+	RUNTIME_CHECK(isc_mutex_init(&bias_lock) == ISC_R_SUCCESS);
+	for (i = 0; i <= BIAS_ROWS; i++)
+		bias_rows[i] = i;
+	RUNTIME_CHECK(isc_thread_key_create(&bias_key, bias_release) == 0);
+}
+#endif /* ISC_RWLOCK_USEBIAS */
+
+void
+isc_rwlock_setreaderbias(isc_rwlock_t *rwl, isc_boolean_t bias) {
+	REQUIRE(VALID_RWLOCK(rwl));
+
+#ifdef ISC_RWLOCK_USEBIAS
+	REQUIRE(rwl->write_requests == rwl->write_completions &&
+		rwl->cnt_and_flag == 0);
+
+	if (!bias) {
+		rwl->rbias = BIAS_OFF;
+		rwl->bias_id = 0;
+		return;
+	}
+
+	RUNTIME_CHECK(isc_once_do(&bias_once, bias_initialize) ==
+		      ISC_R_SUCCESS);
+	while (rwl->bias_id == 0)
+		rwl->bias_id = isc_atomic_xadd(&bias_nextid, 1) + 1;
+	rwl->rbias = BIAS_ON;
+	rwl->bias_inhibit = 0;
+#else
+	UNUSED(bias);
+#endif
+}
+
 #if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
 
 /*
@@ -258,6 +360,156 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 #define WRITER_ACTIVE	0x1
 #define READER_INCR	0x2
 
+#ifdef ISC_RWLOCK_USEBIAS
+static inline isc_uint64_t
+bias_now(void) {
+	isc_time_t now;
+
+	RUNTIME_CHECK(isc_time_now(&now) == ISC_R_SUCCESS);
+	return ((isc_uint64_t)isc_time_seconds(&now) * NS_PER_S +
+		isc_time_nanoseconds(&now));
+}
+
+/*%
+ * Return the calling thread's slot for 'rwl', or NULL if the thread has
+ * no row.
+ */
+static inline isc_int32_t *
+bias_slot(isc_rwlock_t *rwl) {
+	unsigned int *rowp;
+	unsigned int i, column;
+
+	rowp = isc_thread_key_getspecific(bias_key);
+	if (ISC_UNLIKELY(rowp == NULL)) {
+		LOCK(&bias_lock);
+		for (i = 0; i < BIAS_ROWS; i++)
+			if (!bias_inuse[i])
+				break;
+		if (i < BIAS_ROWS)
+			bias_inuse[i] = ISC_TRUE;
+		UNLOCK(&bias_lock);
+		rowp = &bias_rows[i];
+		RUNTIME_CHECK(isc_thread_key_setspecific(bias_key,
+							 rowp) == 0);
+	}
+	if (*rowp >= BIAS_ROWS)
+		return (NULL);
+	column = (isc_uint32_t)rwl->bias_id % BIAS_COLUMNS;
+	return (&bias_table[*rowp][column]);
+}
+
+/*%
+ * Try to take a read lock on the biased path.  The slot is published
+ * before the bias is checked again, so a writer revoking the bias either
+ * sees the slot or is seen by us.
+ */
+static inline isc_boolean_t
+bias_readlock(isc_rwlock_t *rwl) {
+	isc_int32_t *slot;
+
+	if (BIAS_LOAD(rwl->rbias) != BIAS_ON)
+		return (ISC_FALSE);
+
+	slot = bias_slot(rwl);
+	if (slot == NULL || *slot != 0)
+		return (ISC_FALSE);
+
+	isc_atomic_store(slot, rwl->bias_id);
+	if (BIAS_LOAD(rwl->rbias) == BIAS_ON)
+		return (ISC_TRUE);
+	isc_atomic_store(slot, 0);
+
+	return (ISC_FALSE);
+}
+
+/*%
+ * Release a read lock taken on the biased path, if that is how the
+ * caller holds it.
+ */
+static inline isc_boolean_t
+bias_readunlock(isc_rwlock_t *rwl) {
+	isc_int32_t *slot;
+
+	slot = bias_slot(rwl);
+	if (slot == NULL || *slot != rwl->bias_id)
+		return (ISC_FALSE);
+
+	isc_atomic_store(slot, 0);
+
+	return (ISC_TRUE);
+}
+
+/*%
+ * Called by a reader that holds 'rwl' on the ordinary path: turn the
+ * bias back on once the inhibition period has passed.
+ */
+static inline void
+bias_restore(isc_rwlock_t *rwl) {
+	if (rwl->bias_id != 0 && BIAS_LOAD(rwl->rbias) == BIAS_OFF &&
+	    bias_now() >= rwl->bias_inhibit)
+		(void)isc_atomic_cmpxchg(&rwl->rbias, BIAS_OFF, BIAS_ON);
+}
+
+/*%
+ * Revoke the bias of 'rwl', which the caller has just locked for
+ * writing, and wait for readers on the biased path to leave.  If 'wait'
+ * is false and some are still there, return ISC_FALSE; the caller must
+ * then give the lock up again.
+ */
+static isc_boolean_t
+bias_revoke(isc_rwlock_t *rwl, isc_boolean_t wait) {
+	isc_uint64_t start, now;
+	unsigned int row, column, spins;
+
+	if (BIAS_LOAD(rwl->rbias) == BIAS_OFF)
+		return (ISC_TRUE);
+
+	start = bias_now();
+	isc_atomic_store(&rwl->rbias, BIAS_REVOKING);
+
+	column = (isc_uint32_t)rwl->bias_id % BIAS_COLUMNS;
+	for (row = 0; row < BIAS_ROWS; row++) {
+		spins = 0;
+		while (BIAS_LOAD(bias_table[row][column]) == rwl->bias_id) {
+			if (!wait)
+				return (ISC_FALSE);
+			if (spins++ < RWLOCK_MAX_ADAPTIVE_COUNT) {
+#ifdef ISC_PLATFORM_BUSYWAITNOP
+				ISC_PLATFORM_BUSYWAITNOP;
+#endif
+			} else
+				isc_thread_yield();
+		}
+	}
+
+	now = bias_now();
+	if (now > start)
+		rwl->bias_inhibit = now + (now - start) *
+				    BIAS_INHIBIT_MULTIPLIER;
+	else
+		rwl->bias_inhibit = now;
+	isc_atomic_store(&rwl->rbias, BIAS_OFF);
+
+	return (ISC_TRUE);
+}
+
+/*%
+ * Undo setting WRITER_ACTIVE after a failed revocation, and wake up
+ * anyone who went to sleep because of it.
+ */
+static void
+bias_abandon(isc_rwlock_t *rwl) {
+	(void)isc_atomic_xadd(&rwl->cnt_and_flag, -WRITER_ACTIVE);
+
+	LOCK(&rwl->lock);
+	if (rwl->readers_waiting > 0)
+		BROADCAST(&rwl->readable);
+	if (rwl->write_requests != rwl->write_completions)
+		BROADCAST(&rwl->writeable);
+	UNLOCK(&rwl->lock);
+}
+#endif /* ISC_RWLOCK_USEBIAS */
+
 static isc_result_t
 isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	isc_int32_t cntflag;
@@ -327,6 +579,10 @@ isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 		 * matter).
 		 */
 		rwl->write_granted = 0;
+
+#ifdef ISC_RWLOCK_USEBIAS
+		bias_restore(rwl);
+#endif
 	} else {
 		isc_int32_t prev_writer;
 
@@ -356,6 +612,10 @@ isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 			UNLOCK(&rwl->lock);
 		}
 
+#ifdef ISC_RWLOCK_USEBIAS
+		(void)bias_revoke(rwl, ISC_TRUE);
+#endif
+
 		INSIST((rwl->cnt_and_flag & WRITER_ACTIVE) != 0);
 		rwl->write_granted++;
 	}
@@ -377,6 +637,11 @@ isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	if (max_cnt > RWLOCK_MAX_ADAPTIVE_COUNT)
 		max_cnt = RWLOCK_MAX_ADAPTIVE_COUNT;
 
+#ifdef ISC_RWLOCK_USEBIAS
+	if (type == isc_rwlocktype_read && bias_readlock(rwl))
+		return (ISC_R_SUCCESS);
+#endif
+
 	do {
 		if (cnt++ >= max_cnt) {
 			result = isc__rwlock_lock(rwl, type);
@@ -404,6 +669,11 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 #endif
 
 	if (type == isc_rwlocktype_read) {
+#ifdef ISC_RWLOCK_USEBIAS
+		if (bias_readlock(rwl))
+			return (ISC_R_SUCCESS);
+#endif
+
 		/* If a writer is waiting or working, we fail. */
 		if (rwl->write_requests != rwl->write_completions)
 			return (ISC_R_LOCKBUSY);
@@ -430,6 +700,10 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 
 			return (ISC_R_LOCKBUSY);
 		}
+
+#ifdef ISC_RWLOCK_USEBIAS
+		bias_restore(rwl);
+#endif
 	} else {
 		/* Try locking without entering the waiting queue. */
 		cntflag = isc_atomic_cmpxchg(&rwl->cnt_and_flag, 0,
@@ -437,6 +711,13 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 		if (cntflag != 0)
 			return (ISC_R_LOCKBUSY);
 
+#ifdef ISC_RWLOCK_USEBIAS
+		if (!bias_revoke(rwl, ISC_FALSE)) {
+			bias_abandon(rwl);
+			return (ISC_R_LOCKBUSY);
+		}
+#endif
+
 		/*
 		 * XXXJT: jump into the queue, possibly breaking the writer
 		 * order.
@@ -460,6 +741,18 @@ isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 
 	REQUIRE(VALID_RWLOCK(rwl));
 
+#ifdef ISC_RWLOCK_USEBIAS
+	/*
+	 * A reader on the biased path is not counted in cnt_and_flag, so
+	 * it cannot be upgraded in place.
+	 */
+	if (rwl->bias_id != 0) {
+		isc_int32_t *slot = bias_slot(rwl);
+		if (slot != NULL && *slot == rwl->bias_id)
+			return (ISC_R_LOCKBUSY);
+	}
+#endif
+
 	/* Try to acquire write access. */
 	prevcnt = isc_atomic_cmpxchg(&rwl->cnt_and_flag,
 				     READER_INCR, WRITER_ACTIVE);
@@ -471,6 +764,14 @@ isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 	       (prevcnt & ~WRITER_ACTIVE) != 0);
 
 	if (prevcnt == READER_INCR) {
+#ifdef ISC_RWLOCK_USEBIAS
+		if (!bias_revoke(rwl, ISC_FALSE)) {
+			/* Go back to reading. */
+			(void)isc_atomic_xadd(&rwl->cnt_and_flag, READER_INCR);
+			bias_abandon(rwl);
+			return (ISC_R_LOCKBUSY);
+		}
+#endif
 		/*
 		 * We are the only reader and have been upgraded.
 		 * Now jump into the head of the writer waiting queue.
@@ -517,6 +818,11 @@ isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 #endif
 
 	if (type == isc_rwlocktype_read) {
+#ifdef ISC_RWLOCK_USEBIAS
+		if (rwl->bias_id != 0 && bias_readunlock(rwl))
+			return (ISC_R_SUCCESS);
+#endif
+
 		prev_cnt = isc_atomic_xadd(&rwl->cnt_and_flag, -READER_INCR);
 
 		/*
@@ -870,4 +1176,11 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 	rwl->magic = 0;
 }
 
+void
+isc_rwlock_setreaderbias(isc_rwlock_t *rwl, isc_boolean_t bias) {
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	UNUSED(bias);
+}
+
 #endif /* ISC_PLATFORM_USETHREADS */
@@ -18,10 +18,13 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC			ISC_MAGIC('S', 't', 'a', 't')
@@ -76,6 +79,30 @@ typedef struct {
 typedef isc_uint64_t isc_stat_t;
 #endif
 
+/*%
+ * Striped counters: each stripe is a full set of counters, padded to
+ * a multiple of ISC_STATS_CACHELINE bytes.  Threads are assigned stripes
+ * round-robin in the order they first touch a striped counter set.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVEXADD)
+#define ISC_STATS_USESTRIPES 1
+#else
+#define ISC_STATS_USESTRIPES 0
+#endif
+
+#ifndef ISC_STATS_MAXSTRIPES
+#define ISC_STATS_MAXSTRIPES	32
+#endif
+#define ISC_STATS_CACHELINE	64
+
+#if ISC_STATS_USESTRIPES
+static isc_once_t		stripe_once = ISC_ONCE_INIT;
+static isc_thread_key_t		stripe_key;
+static unsigned int		stripe_nextid;
+static unsigned int		stripe_ncpus;
+static unsigned int		stripe_ids[ISC_STATS_MAXSTRIPES];
+#endif
+
 struct isc_stats {
 	/*% Unlocked */
 	unsigned int	magic;
@@ -94,6 +121,12 @@ struct isc_stats {
 #endif
 	isc_stat_t	*counters;
 
+	/*% Unlocked; 'counters' has 'nstripes' sets of 'stride' counters */
+	unsigned int	nstripes;
+	int		stride;
+	void		*countersmem;
+	size_t		countersmemsize;
+
 	/*%
 	 * We don't want to lock the counters while we are dumping, so we first
 	 * copy the current counter values into a local array.  This buffer
@@ -108,10 +141,51 @@ struct isc_stats {
 	isc_uint64_t	*copiedcounters;
 };
 
+#if ISC_STATS_USESTRIPES
+static void
+stripe_initialize(void) {
+	unsigned int i;
+
+	for (i = 0; i < ISC_STATS_MAXSTRIPES; i++)
+		stripe_ids[i] = i;
+	stripe_ncpus = isc_os_ncpus();
+	if (stripe_ncpus > ISC_STATS_MAXSTRIPES)
+		stripe_ncpus = ISC_STATS_MAXSTRIPES;
+	RUNTIME_CHECK(isc_thread_key_create(&stripe_key, NULL) == 0);
+}
+
+/*%
+ * Return the calling thread's counters in 'stats'.
+ */
+static inline isc_stat_t *
+stripe_counters(isc_stats_t *stats) {
+	unsigned int *idp;
+
+	if (stats->nstripes == 1)
+		return (stats->counters);
+
+	idp = isc_thread_key_getspecific(stripe_key);
+	if (ISC_UNLIKELY(idp == NULL)) {
+		unsigned int id;
+
+		id = isc_atomic_xadd((isc_int32_t *)&stripe_nextid, 1);
+		idp = &stripe_ids[id % ISC_STATS_MAXSTRIPES];
+		RUNTIME_CHECK(isc_thread_key_setspecific(stripe_key,
+							 idp) == 0);
+	}
+	return (stats->counters + (*idp % stats->nstripes) * stats->stride);
+}
+#else
+#define stripe_counters(stats)	((stats)->counters)
+#endif /* ISC_STATS_USESTRIPES */
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, unsigned int options,
+	     isc_stats_t **statsp)
+{
 	isc_stats_t *stats;
 	isc_result_t result = ISC_R_SUCCESS;
+	size_t misalign;
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
@@ -123,11 +197,38 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
-	if (stats->counters == NULL) {
+	stats->nstripes = 1;
+	stats->stride = ncounters;
+#if ISC_STATS_USESTRIPES
+	if ((options & ISC_STATSCREATE_STRIPED) != 0) {
+		RUNTIME_CHECK(isc_once_do(&stripe_once, stripe_initialize) ==
+			      ISC_R_SUCCESS);
+		stats->nstripes = stripe_ncpus;
+	}
+#else
+	UNUSED(options);
+#endif
+	if (stats->nstripes > 1) {
+		int perline = ISC_STATS_CACHELINE / sizeof(isc_stat_t);
+
+		stats->stride = (ncounters + perline - 1) / perline * perline;
+		stats->countersmemsize = sizeof(isc_stat_t) * stats->stride *
+					 stats->nstripes + ISC_STATS_CACHELINE;
+	} else
+		stats->countersmemsize = sizeof(isc_stat_t) * ncounters;
+
+	stats->countersmem = isc_mem_get(mctx, stats->countersmemsize);
+	if (stats->countersmem == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
 	}
+	stats->counters = stats->countersmem;
+	if (stats->nstripes > 1) {
+		misalign = (size_t)stats->counters % ISC_STATS_CACHELINE;
+		if (misalign != 0)
+			stats->counters += (ISC_STATS_CACHELINE - misalign) /
+					   sizeof(isc_stat_t);
+	}
 	stats->copiedcounters = isc_mem_get(mctx,
 					    sizeof(isc_uint64_t) * ncounters);
 	if (stats->copiedcounters == NULL) {
@@ -142,7 +243,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 #endif
 
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
+	memset(stats->countersmem, 0, stats->countersmemsize);
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -153,7 +254,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	return (result);
 
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->countersmem, stats->countersmemsize);
 
 #if ISC_STATS_LOCKCOUNTERS
 clean_copiedcounters:
@@ -197,8 +298,8 @@ isc_stats_detach(isc_stats_t **statsp) {
 	if (stats->references == 0) {
 		isc_mem_put(stats->mctx, stats->copiedcounters,
 			    sizeof(isc_stat_t) * stats->ncounters);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
+		isc_mem_put(stats->mctx, stats->countersmem,
+			    stats->countersmemsize);
 		UNLOCK(&stats->lock);
 		DESTROYLOCK(&stats->lock);
 #if ISC_STATS_LOCKCOUNTERS
@@ -220,6 +321,7 @@ isc_stats_ncounters(isc_stats_t *stats) {
 
 static inline void
 incrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = stripe_counters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -232,7 +334,7 @@ incrementcounter(isc_stats_t *stats, int counter) {
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, 1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, 1);
 	/*
 	 * If the lower 32-bit field overflows, increment the higher field.
 	 * Note that it's *theoretically* possible that the lower field
@@ -242,13 +344,13 @@ incrementcounter(isc_stats_t *stats, int counter) {
 	 * by the write (exclusive) lock.
 	 */
 	if (prev == (isc_int32_t)0xffffffff)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi, 1);
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi, 1);
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], 1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], 1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]++;
+	counters[counter]++;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -258,6 +360,7 @@ incrementcounter(isc_stats_t *stats, int counter) {
 
 static inline void
 decrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = stripe_counters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -265,16 +368,16 @@ decrementcounter(isc_stats_t *stats, int counter) {
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, -1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, -1);
 	if (prev == 0)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi,
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi,
 				-1);
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], -1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], -1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]--;
+	counters[counter]--;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -284,6 +387,8 @@ decrementcounter(isc_stats_t *stats, int counter) {
 
 static void
 copy_counters(isc_stats_t *stats) {
+	isc_stat_t *counters;
+	unsigned int s;
 	int i;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -294,18 +399,23 @@ copy_counters(isc_stats_t *stats) {
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
-	for (i = 0; i < stats->ncounters; i++) {
+	memset(stats->copiedcounters, 0,
+	       sizeof(isc_uint64_t) * stats->ncounters);
+	for (s = 0; s < stats->nstripes; s++) {
+		counters = stats->counters + s * stats->stride;
+		for (i = 0; i < stats->ncounters; i++) {
 #if ISC_STATS_USEMULTIFIELDS
-		stats->copiedcounters[i] =
-			(isc_uint64_t)(stats->counters[i].hi) << 32 |
-			stats->counters[i].lo;
+			stats->copiedcounters[i] +=
+				(isc_uint64_t)(counters[i].hi) << 32 |
+				counters[i].lo;
 #elif ISC_STATS_HAVEATOMICQ
-		/* use xaddq(..., 0) as an atomic load */
-		stats->copiedcounters[i] =
-			(isc_uint64_t)isc_atomic_xaddq((isc_int64_t *)&stats->counters[i], 0);
+			/* use xaddq(..., 0) as an atomic load */
+			stats->copiedcounters[i] +=
+				(isc_uint64_t)isc_atomic_xaddq((isc_int64_t *)&counters[i], 0);
 #else
-		stats->copiedcounters[i] = stats->counters[i];
+			stats->copiedcounters[i] += counters[i];
 #endif
+		}
 	}
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -317,7 +427,16 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 0, statsp));
+}
+
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options)
+{
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, options, statsp));
 }
 
 void
@@ -358,6 +477,9 @@ void
 isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	      isc_statscounter_t counter)
 {
+	isc_stat_t *counters;
+	unsigned int s;
+
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
@@ -369,14 +491,21 @@ isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
+	/*
+	 * The value goes in the first stripe and the others are cleared.
+	 */
+	for (s = 0; s < stats->nstripes; s++) {
+		counters = stats->counters + s * stats->stride;
 #if ISC_STATS_USEMULTIFIELDS
-	stats->counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
-	stats->counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
+		counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
+		counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
 #elif ISC_STATS_HAVEATOMICQ
-	isc_atomic_storeq((isc_int64_t *)&stats->counters[counter], val);
+		isc_atomic_storeq((isc_int64_t *)&counters[counter], val);
 #else
-	stats->counters[counter] = val;
+		counters[counter] = val;
 #endif
+		val = 0;
+	}
 
 #if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_write);
@@ -109,8 +109,10 @@ struct isc__task {
 	isc_time_t			tnow;
 	char				name[16];
 	void *				tag;
+	unsigned int			threadid;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the run queue lock of 'threadid'. */
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -126,11 +128,40 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+typedef struct isc__taskqueue isc__taskqueue_t;
+
+/*%
+ * Each worker thread owns a run queue.  A task is bound to one run queue
+ * when it is created and is always made ready on that queue; a worker
+ * whose own queue is empty will take ready tasks from its peers' queues
+ * before going to sleep.
+ */
+struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by run queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_running;
+	unsigned int			tasks_ready;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_condition_t			work_available;
+	isc_boolean_t			idle;
+	/* Locked by task manager lock. */
+	isc_thread_t *			thread;	/* NULL if not started */
+	int				cpu;	/* -1 if not bound */
+#endif /* ISC_PLATFORM_USETHREADS */
+};
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
 	isc_mem_t *			mctx;
 	isc_mutex_t			lock;
+	unsigned int			nqueues;
+	isc__taskqueue_t *		queues;
 #ifdef ISC_PLATFORM_USETHREADS
 	unsigned int			workers;
 	isc_thread_t *			threads;
@@ -138,19 +169,24 @@ struct isc__taskmgr {
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			curq;
 	isc_taskmgrmode_t		mode;
+	isc_boolean_t			exiting;
+
+	/*
+	 * Workers stop taking tasks from the run queues while a pause
+	 * or exclusive mode is requested, and wait on 'halt_cond'
+	 * until it is released.  The requester waits on the same
+	 * condition until enough workers have halted.
+	 */
 #ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
-	isc_condition_t			exclusive_granted;
-	isc_condition_t			paused;
+	isc_mutex_t			halt_lock;
+	isc_condition_t			halt_cond;
+	/* Locked by halt lock. */
+	unsigned int			halted;
 #endif /* ISC_PLATFORM_USETHREADS */
-	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
 	isc_boolean_t			pause_requested;
 	isc_boolean_t			exclusive_requested;
-	isc_boolean_t			exiting;
 
 	/*
 	 * Multiple threads can read/write 'excl' at the same time, so we need
@@ -244,13 +280,16 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task);
+
+static void
+wake_all_queues(isc__taskmgr_t *manager);
 
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
@@ -321,7 +360,7 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
+		wake_all_queues(manager);
 	}
 #endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
@@ -365,6 +404,7 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	isc_time_settoepoch(&task->tnow);
 	memset(task->name, 0, sizeof(task->name));
 	task->tag = NULL;
+	task->threadid = 0;
 	INIT_LINK(task, link);
 	INIT_LINK(task, ready_link);
 	INIT_LINK(task, ready_priority_link);
@@ -374,6 +414,11 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		/*
+		 * Spread new tasks over the run queues.
+		 */
+		task->threadid = manager->curq;
+		manager->curq = (manager->curq + 1) % manager->nqueues;
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -452,16 +497,47 @@ task_shutdown(isc__task_t *task) {
 	return (was_idle);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * Wake up one sleeping worker other than the owner of run queue
+ * 'threadid', so that it can take ready tasks from a busy peer.
+ *
+ * The 'idle' flags are only read as a hint here; the choice is confirmed
+ * under the run queue lock.
+ *
+ * Caller must not hold any run queue lock.
+ */
+static void
+wake_idle_peer(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *peer;
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues; i++) {
+		peer = &manager->queues[(threadid + i) % manager->nqueues];
+		if (!peer->idle)
+			continue;
+		LOCK(&peer->lock);
+		if (peer->idle) {
+			SIGNAL(&peer->work_available);
+			UNLOCK(&peer->lock);
+			return;
+		}
+		UNLOCK(&peer->lock);
+	}
+}
+#endif /* USE_WORKER_THREADS */
+
 /*
- * Moves a task onto the appropriate run queue.
+ * Moves a task onto its run queue.
  *
- * Caller must NOT hold manager lock.
+ * Caller must NOT hold manager lock or any run queue lock.
  */
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 #ifdef USE_WORKER_THREADS
-	isc_boolean_t has_privilege = isc__task_privilege((isc_task_t *) task);
+	isc_boolean_t idle;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -469,13 +545,24 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
-	push_readyq(manager, task);
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
+	push_readyq(queue, task);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	idle = queue->idle;
+	if (idle)
+		SIGNAL(&queue->work_available);
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+
+#ifdef USE_WORKER_THREADS
+	/*
+	 * The owner of the queue is busy; let a sleeping worker
+	 * pick the task up instead if there is one.
+	 */
+	if (!idle)
+		wake_idle_peer(manager, task->threadid);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline isc_boolean_t
@@ -908,6 +995,15 @@ isc__task_gettag(isc_task_t *task0) {
 	return (task->tag);
 }
 
+unsigned int
+isc_task_getthreadid(isc_task_t *task0) {
+	isc__task_t *task = (isc__task_t *)task0;
+
+	REQUIRE(VALID_TASK(task));
+
+	return (task->threadid);
+}
+
 void
 isc__task_getcurrenttime(isc_task_t *task0, isc_stdtime_t *t) {
 	isc__task_t *task = (isc__task_t *)task0;
@@ -937,68 +1033,207 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return ISC_TRUE if the current ready list for the manager, which is
+ * Return ISC_TRUE if the current ready list for 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * The manager mode is read without holding the manager lock; every
+ * mode change is followed by wake_all_queues().
+ *
+ * Caller must hold the run queue lock.
  */
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__tasklist_t list;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+		list = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		list = queue->ready_priority_tasks;
 
-	return (ISC_TF(EMPTY(queue)));
+	return (ISC_TF(EMPTY(list)));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list of 'queue'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the run queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
+		queue->tasks_ready--;
 	}
 
 	return (task);
 }
 
 /*
- * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
- * flag set, then also push it onto the ready_priority_tasks queue.
+ * Push 'task' onto the ready_tasks list of 'queue'.  If 'task' has the
+ * privilege flag set, then also push it onto the ready_priority_tasks
+ * list.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the run queue lock.
  */
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task) {
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	queue->tasks_ready++;
 }
 
+/*
+ * Wake up every worker sleeping on its run queue, e.g. so that it
+ * notices a mode change, a pause or exclusive request, or shutdown.
+ *
+ * Caller may hold the manager lock, but must not hold any run queue lock.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
+wake_all_queues(isc__taskmgr_t *manager) {
+#ifdef USE_WORKER_THREADS
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		BROADCAST(&queue->work_available);
+		UNLOCK(&queue->lock);
+	}
+#else
+	UNUSED(manager);
+#endif /* USE_WORKER_THREADS */
+}
+
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON)
+/*
+ * Sum the running and ready task counters of all run queues.
+ */
+static void
+count_tasks(isc__taskmgr_t *manager, unsigned int *runningp,
+	    unsigned int *readyp)
+{
+	isc__taskqueue_t *queue;
+	unsigned int i, running = 0, ready = 0;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		running += queue->tasks_running;
+		ready += queue->tasks_ready;
+		UNLOCK(&queue->lock);
+	}
+
+	if (runningp != NULL)
+		*runningp = running;
+	if (readyp != NULL)
+		*readyp = ready;
+}
+#endif /* HAVE_LIBXML2 || HAVE_JSON */
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Take the first task from the current ready list of some other worker's
+ * run queue, or return NULL if there is none.
+ *
+ * The tasks_ready counters are only read as a hint to skip empty queues.
+ *
+ * Caller must not hold any run queue lock.
+ */
+static isc__task_t *
+steal_readyq(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *victim;
+	isc__task_t *task;
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues; i++) {
+		victim = &manager->queues[(threadid + i) % manager->nqueues];
+		if (victim->tasks_ready == 0)
+			continue;
+		LOCK(&victim->lock);
+		task = pop_readyq(manager, victim);
+		UNLOCK(&victim->lock);
+		if (task != NULL)
+			return (task);
+	}
+
+	return (NULL);
+}
+
+/*
+ * If we are in privileged execution mode and no privileged task is
+ * running or ready on any run queue, then we're stuck.  Automatically
+ * drop privileges at that point and continue with the regular ready
+ * queues.
+ *
+ * Caller must not hold any run queue lock.
+ */
+static void
+check_privileged(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	isc_boolean_t stuck = ISC_TRUE;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	if (manager->mode == isc_taskmgrmode_normal) {
+		UNLOCK(&manager->lock);
+		return;
+	}
+	for (i = 0; stuck && i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		if (queue->tasks_running != 0 ||
+		    !EMPTY(queue->ready_priority_tasks))
+			stuck = ISC_FALSE;
+		UNLOCK(&queue->lock);
+	}
+	if (stuck) {
+		manager->mode = isc_taskmgrmode_normal;
+		wake_all_queues(manager);
+	}
+	UNLOCK(&manager->lock);
+}
+
+/*
+ * Park the calling worker while a pause or exclusive mode is in effect.
+ *
+ * Caller must not hold any run queue lock.
+ */
+static void
+halt(isc__taskmgr_t *manager) {
+	LOCK(&manager->halt_lock);
+	manager->halted++;
+	BROADCAST(&manager->halt_cond);
+	while (manager->pause_requested || manager->exclusive_requested) {
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+					    ISC_MSGSET_GENERAL,
+					    ISC_MSG_WAIT, "halt"));
+		WAIT(&manager->halt_cond, &manager->halt_lock);
+	}
+	manager->halted--;
+	UNLOCK(&manager->halt_lock);
+}
+#endif /* USE_WORKER_THREADS */
+
+static void
+dispatch(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue;
 	isc__task_t *task;
 #ifndef USE_WORKER_THREADS
 	unsigned int total_dispatch_count = 0;
@@ -1008,6 +1243,9 @@ dispatch(isc__taskmgr_t *manager) {
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(threadid < manager->nqueues);
+
+	queue = &manager->queues[threadid];
 
 	/*
 	 * Again we're trying to hold the lock for as short a time as possible
@@ -1057,46 +1295,81 @@ dispatch(isc__taskmgr_t *manager) {
 	 *
 	 * For N iterations of the loop, this code does N+1 locks and N+1
 	 * unlocks.  The while expression is always protected by the lock.
+	 *
+	 * The lock held here is the run queue lock of this worker, not
+	 * the manager lock, so workers only contend with each other when
+	 * one of them runs out of work and takes tasks from a peer.
 	 */
 
 #ifndef USE_WORKER_THREADS
 	ISC_LIST_INIT(new_ready_tasks);
 	ISC_LIST_INIT(new_priority_tasks);
 #endif
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 
 	while (!FINISHED(manager)) {
 #ifdef USE_WORKER_THREADS
 		/*
 		 * For reasons similar to those given in the comment in
 		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
+		 * the task while only holding the run queue lock, and then
 		 * change the task to running state while only holding the
 		 * task lock.
 		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
+		 * If a pause or exclusive mode has been requested, don't
+		 * do any work until it's been released.
 		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
+		if (manager->pause_requested || manager->exclusive_requested) {
+			UNLOCK(&queue->lock);
+			halt(manager);
+			LOCK(&queue->lock);
+			continue;
+		}
+
+		task = pop_readyq(manager, queue);
+		if (task == NULL) {
+			/*
+			 * Our own run queue is empty; look for work on
+			 * the other workers' queues before sleeping.
+			 */
+			UNLOCK(&queue->lock);
+			task = steal_readyq(manager, threadid);
+			if (task == NULL &&
+			    manager->mode != isc_taskmgrmode_normal)
+				check_privileged(manager);
+			LOCK(&queue->lock);
+		}
+
+		if (task == NULL) {
+			if (empty_readyq(manager, queue) &&
+			    !manager->pause_requested &&
+			    !manager->exclusive_requested &&
+			    !FINISHED(manager))
+			{
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_GENERAL,
+							    ISC_MSG_WAIT,
+							    "wait"));
+				queue->idle = ISC_TRUE;
+				WAIT(&queue->work_available, &queue->lock);
+				queue->idle = ISC_FALSE;
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_TASK,
+							    ISC_MSG_AWAKE,
+							    "awake"));
+			}
+			continue;
 		}
 #else /* USE_WORKER_THREADS */
 		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
+		    empty_readyq(manager, queue))
 			break;
+
+		task = pop_readyq(manager, queue);
 #endif /* USE_WORKER_THREADS */
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
 
-		task = pop_readyq(manager);
 		if (task != NULL) {
 			unsigned int dispatch_count = 0;
 			isc_boolean_t done = ISC_FALSE;
@@ -1107,13 +1380,13 @@ dispatch(isc__taskmgr_t *manager) {
 			INSIST(VALID_TASK(task));
 
 			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
+			 * Note we only unlock the run queue lock if we
+			 * actually have a task to do.  We must reacquire the
+			 * run queue lock before exiting the 'if (task != NULL)'
+			 * block.
 			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
+			queue->tasks_running++;
+			UNLOCK(&queue->lock);
 
 			LOCK(&task->lock);
 			INSIST(task->state == task_state_ready);
@@ -1228,17 +1501,8 @@ dispatch(isc__taskmgr_t *manager) {
 			if (finished)
 				task_finished(task);
 
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
-			}
-#endif /* USE_WORKER_THREADS */
+			LOCK(&queue->lock);
+			queue->tasks_running--;
 			if (requeue) {
 				/*
 				 * We know we're awake, so we don't have
@@ -1260,7 +1524,17 @@ dispatch(isc__taskmgr_t *manager) {
 				 * might even hurt rather than help.
 				 */
 #ifdef USE_WORKER_THREADS
-				push_readyq(manager, task);
+				/*
+				 * A task taken from another worker's queue
+				 * goes back to its own queue.
+				 */
+				if (task->threadid == threadid)
+					push_readyq(queue, task);
+				else {
+					UNLOCK(&queue->lock);
+					task_ready(task);
+					LOCK(&queue->lock);
+				}
 #else
 				ENQUEUE(new_ready_tasks, task, ready_link);
 				if ((task->flags & TASK_F_PRIVILEGED) != 0)
@@ -1270,32 +1544,18 @@ dispatch(isc__taskmgr_t *manager) {
 #endif
 			}
 		}
-
-#ifdef USE_WORKER_THREADS
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
-		}
-#endif
 	}
 
 #ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
 			    ready_priority_link);
-	manager->tasks_ready += tasks_ready;
-	if (empty_readyq(manager))
+	queue->tasks_ready += tasks_ready;
+	if (empty_readyq(manager, queue))
 		manager->mode = isc_taskmgrmode_normal;
 #endif
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 #ifdef USE_WORKER_THREADS
@@ -1304,12 +1564,21 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue->manager, queue->threadid);
+
+	/*
+	 * An exiting worker will never run another task; count it as
+	 * halted so that late exclusive requests don't wait for it.
+	 */
+	LOCK(&queue->manager->halt_lock);
+	queue->manager->halted++;
+	BROADCAST(&queue->manager->halt_cond);
+	UNLOCK(&queue->manager->halt_lock);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1322,14 +1591,60 @@ run(void *uap) {
 }
 #endif /* USE_WORKER_THREADS */
 
+static isc_result_t
+queue_init(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
+	isc_result_t result;
+
+	queue->manager = manager;
+	queue->threadid = threadid;
+	result = isc_mutex_init(&queue->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_WORKER_THREADS
+	if (isc_condition_init(&queue->work_available) != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		DESTROYLOCK(&queue->lock);
+		return (ISC_R_UNEXPECTED);
+	}
+	queue->idle = ISC_FALSE;
+	queue->thread = NULL;
+	queue->cpu = -1;
+#endif /* USE_WORKER_THREADS */
+	INIT_LIST(queue->ready_tasks);
+	INIT_LIST(queue->ready_priority_tasks);
+	queue->tasks_running = 0;
+	queue->tasks_ready = 0;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+queue_destroy(isc__taskqueue_t *queue) {
+	INSIST(EMPTY(queue->ready_tasks));
+	INSIST(EMPTY(queue->ready_priority_tasks));
+
+#ifdef USE_WORKER_THREADS
+	(void)isc_condition_destroy(&queue->work_available);
+#endif /* USE_WORKER_THREADS */
+	DESTROYLOCK(&queue->lock);
+}
+
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
+	unsigned int i;
 
+	for (i = 0; i < manager->nqueues; i++)
+		queue_destroy(&manager->queues[i]);
+	isc_mem_put(manager->mctx, manager->queues,
+		    manager->nqueues * sizeof(isc__taskqueue_t));
 #ifdef USE_WORKER_THREADS
-	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
-	(void)isc_condition_destroy(&manager->paused);
+	(void)isc_condition_destroy(&manager->halt_cond);
+	DESTROYLOCK(&manager->halt_lock);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
 	DESTROYLOCK(&manager->lock);
@@ -1392,47 +1707,53 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		goto cleanup_mgr;
 	}
 
+	/*
+	 * One run queue per worker thread; the non-threaded manager
+	 * uses a single queue.
+	 */
+#ifdef USE_WORKER_THREADS
+	manager->nqueues = workers;
+#else
+	manager->nqueues = 1;
+#endif /* USE_WORKER_THREADS */
+	manager->queues = isc_mem_get(mctx, manager->nqueues *
+				      sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_lock;
+	}
+	for (i = 0; i < manager->nqueues; i++) {
+		result = queue_init(manager, i);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_queues;
+	}
+
 #ifdef USE_WORKER_THREADS
 	manager->workers = 0;
 	manager->threads = isc_mem_allocate(mctx,
 					    workers * sizeof(isc_thread_t));
 	if (manager->threads == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_lock;
+		goto cleanup_queues;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
+	result = isc_mutex_init(&manager->halt_lock);
+	if (result != ISC_R_SUCCESS)
 		goto cleanup_threads;
-	}
-	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
-	}
-	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
+	if (isc_condition_init(&manager->halt_cond) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 		result = ISC_R_UNEXPECTED;
-		goto cleanup_exclusivegranted;
+		goto cleanup_haltlock;
 	}
+	manager->halted = 0;
 #endif /* USE_WORKER_THREADS */
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
+	manager->curq = 0;
 	manager->exclusive_requested = ISC_FALSE;
 	manager->pause_requested = ISC_FALSE;
 	manager->exiting = ISC_FALSE;
@@ -1443,16 +1764,19 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  A queue whose worker failed to start is
+	 * drained by the other workers.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[i],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			char name[16];	/* thread name limit on Linux */
 			snprintf(name, sizeof(name), "isc-worker%04d", i);
 			isc_thread_setname(manager->threads[manager->workers],
 					   name);
+			manager->queues[i].thread =
+				&manager->threads[manager->workers];
 			manager->workers++;
 			started++;
 		}
@@ -1475,15 +1799,19 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	return (ISC_R_SUCCESS);
 
 #ifdef USE_WORKER_THREADS
- cleanup_exclusivegranted:
-	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
+ cleanup_haltlock:
+	DESTROYLOCK(&manager->halt_lock);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
+#endif /* USE_WORKER_THREADS */
+ cleanup_queues:
+	while (i > 0)
+		queue_destroy(&manager->queues[--i]);
+	isc_mem_put(mctx, manager->queues,
+		    manager->nqueues * sizeof(isc__taskqueue_t));
  cleanup_lock:
+	DESTROYLOCK(&manager->excl_lock);
 	DESTROYLOCK(&manager->lock);
-#endif
  cleanup_mgr:
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	return (result);
@@ -1562,8 +1890,14 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
-			push_readyq(manager, task);
+		if (task_shutdown(task)) {
+			isc__taskqueue_t *queue;
+
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
+			push_readyq(queue, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
 #ifdef USE_WORKER_THREADS
@@ -1572,7 +1906,7 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * there's work left to do, and if there are already no tasks left
 	 * it will cause the workers to see manager->exiting.
 	 */
-	BROADCAST(&manager->work_available);
+	wake_all_queues(manager);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1605,7 +1939,10 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
-	manager->mode = mode;
+	if (manager->mode != mode) {
+		manager->mode = mode;
+		wake_all_queues(manager);
+	}
 	UNLOCK(&manager->lock);
 }
 
@@ -1632,9 +1969,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_FALSE);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(manager, &manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1650,7 +1987,7 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
 
-	dispatch(manager);
+	dispatch(manager, 0);
 
 	return (ISC_R_SUCCESS);
 }
@@ -1659,24 +1996,26 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
+
+	LOCK(&manager->halt_lock);
 	manager->pause_requested = ISC_TRUE;
-	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
-		WAIT(&manager->paused, &manager->lock);
+	wake_all_queues(manager);
+	while (manager->halted < manager->workers) {
+		WAIT(&manager->halt_cond, &manager->halt_lock);
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&manager->halt_lock);
 }
 
 void
 isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
-	LOCK(&manager->lock);
+	LOCK(&manager->halt_lock);
 	if (manager->pause_requested) {
 		manager->pause_requested = ISC_FALSE;
-		BROADCAST(&manager->work_available);
+		BROADCAST(&manager->halt_cond);
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&manager->halt_lock);
 }
 #endif /* USE_WORKER_THREADS */
 
@@ -1694,6 +2033,43 @@ isc_taskmgr_setexcltask(isc_taskmgr_t *mgr0, isc_task_t *task0) {
 	UNLOCK(&mgr->excl_lock);
 }
 
+isc_result_t
+isc_taskmgr_setcpus(isc_taskmgr_t *mgr0, const isc_uint32_t *cpus,
+		    unsigned int ncpus)
+{
+	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
+	isc_result_t result = ISC_R_SUCCESS;
+#ifdef USE_WORKER_THREADS
+	isc__taskqueue_t *queue;
+	unsigned int i;
+	int cpu;
+#endif /* USE_WORKER_THREADS */
+
+	REQUIRE(VALID_MANAGER(mgr));
+	REQUIRE(cpus != NULL || ncpus == 0);
+
+#ifdef USE_WORKER_THREADS
+	LOCK(&mgr->lock);
+	for (i = 0; i < mgr->nqueues; i++) {
+		queue = &mgr->queues[i];
+		cpu = (ncpus == 0) ? -1 : (int)cpus[i % ncpus];
+		if (queue->thread == NULL || queue->cpu == cpu)
+			continue;
+		result = isc_thread_setaffinity(*queue->thread, cpu);
+		if (result != ISC_R_SUCCESS)
+			break;
+		queue->cpu = cpu;
+	}
+	UNLOCK(&mgr->lock);
+#else
+	UNUSED(cpus);
+	if (ncpus != 0)
+		result = ISC_R_NOTIMPLEMENTED;
+#endif /* USE_WORKER_THREADS */
+
+	return (result);
+}
+
 isc_result_t
 isc_taskmgr_excltask(isc_taskmgr_t *mgr0, isc_task_t **taskp) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *) mgr0;
@@ -1724,16 +2100,17 @@ isc__task_beginexclusive(isc_task_t *task0) {
  *  it should be here, it fails on shutdown server->task
  */
 
-	LOCK(&manager->lock);
+	LOCK(&manager->halt_lock);
 	if (manager->exclusive_requested) {
-		UNLOCK(&manager->lock);
+		UNLOCK(&manager->halt_lock);
 		return (ISC_R_LOCKBUSY);
 	}
 	manager->exclusive_requested = ISC_TRUE;
-	while (manager->tasks_running > 1) {
-		WAIT(&manager->exclusive_granted, &manager->lock);
+	wake_all_queues(manager);
+	while (manager->halted + 1 < manager->workers) {
+		WAIT(&manager->halt_cond, &manager->halt_lock);
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&manager->halt_lock);
 #else
 	UNUSED(task0);
 #endif
@@ -1747,11 +2124,11 @@ isc__task_endexclusive(isc_task_t *task0) {
 	isc__taskmgr_t *manager = task->manager;
 
 	REQUIRE(task->state == task_state_running);
-	LOCK(&manager->lock);
+	LOCK(&manager->halt_lock);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
-	BROADCAST(&manager->work_available);
-	UNLOCK(&manager->lock);
+	BROADCAST(&manager->halt_cond);
+	UNLOCK(&manager->halt_lock);
 #else
 	UNUSED(task0);
 #endif
@@ -1760,7 +2137,7 @@ isc__task_endexclusive(isc_task_t *task0) {
 void
 isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	isc__task_t *task = (isc__task_t *)task0;
-	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue = &task->manager->queues[task->threadid];
 	isc_boolean_t oldpriv;
 
 	LOCK(&task->lock);
@@ -1774,14 +2151,14 @@ isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 isc_boolean_t
@@ -1815,9 +2192,14 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int tasks_running, tasks_ready;
+#ifdef ISC_PLATFORM_USETHREADS
+	unsigned int i;
+#endif /* ISC_PLATFORM_USETHREADS */
 	int xmlrc;
 
 	LOCK(&mgr->lock);
+	count_tasks(mgr, &tasks_running, &tasks_ready);
 
 	/*
 	 * Write out the thread-model, and some details about each depending
@@ -1832,6 +2214,28 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "worker-threads"));
 	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->workers));
 	TRY0(xmlTextWriterEndElement(writer)); /* worker-threads */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "workers"));
+	for (i = 0; i < mgr->nqueues; i++) {
+		if (mgr->queues[i].thread == NULL)
+			continue;
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "worker"));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "id"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u", i));
+		TRY0(xmlTextWriterEndElement(writer)); /* id */
+
+		if (mgr->queues[i].cpu >= 0) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "cpu"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+						       mgr->queues[i].cpu));
+			TRY0(xmlTextWriterEndElement(writer)); /* cpu */
+		}
+
+		TRY0(xmlTextWriterEndElement(writer)); /* worker */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* workers */
 #else /* ISC_PLATFORM_USETHREADS */
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "type"));
 	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR "non-threaded"));
@@ -1848,11 +2252,11 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", tasks_running));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", tasks_ready));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
@@ -1926,8 +2330,13 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
 	json_object *obj = NULL, *array = NULL, *taskobj = NULL;
+	unsigned int tasks_running, tasks_ready;
+#ifdef ISC_PLATFORM_USETHREADS
+	unsigned int i;
+#endif /* ISC_PLATFORM_USETHREADS */
 
 	LOCK(&mgr->lock);
+	count_tasks(mgr, &tasks_running, &tasks_ready);
 
 	/*
 	 * Write out the thread-model, and some details about each depending
@@ -1941,6 +2350,29 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	obj = json_object_new_int(mgr->workers);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "worker-threads", obj);
+
+	array = json_object_new_array();
+	CHECKMEM(array);
+	for (i = 0; i < mgr->nqueues; i++) {
+		if (mgr->queues[i].thread == NULL)
+			continue;
+
+		taskobj = json_object_new_object();
+		CHECKMEM(taskobj);
+		json_object_array_add(array, taskobj);
+
+		obj = json_object_new_int(i);
+		CHECKMEM(obj);
+		json_object_object_add(taskobj, "id", obj);
+
+		if (mgr->queues[i].cpu >= 0) {
+			obj = json_object_new_int(mgr->queues[i].cpu);
+			CHECKMEM(obj);
+			json_object_object_add(taskobj, "cpu", obj);
+		}
+	}
+	json_object_object_add(tasks, "workers", array);
+	array = NULL;
 #else /* ISC_PLATFORM_USETHREADS */
 	obj = json_object_new_string("non-threaded");
 	CHECKMEM(obj);
@@ -1955,11 +2387,11 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
-	obj = json_object_new_int(mgr->tasks_running);
+	obj = json_object_new_int(tasks_running);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(tasks_ready);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
@@ -16,8 +16,11 @@
 #include "isctest.h"
 
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/thread.h>
+#include <isc/util.h>
 
 static void *
 default_memalloc(void *arg, size_t size) {
@@ -141,12 +144,111 @@ ATF_TC_BODY(isc_mem_inuse, tc) {
 	isc_test_end();
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+#define TC_THREADS	8
+#define TC_ITEMS	32
+
+static isc_mem_t *tc_mctx = NULL;
+static isc_mempool_t *tc_pool = NULL;
+static void *tc_items[TC_THREADS][TC_ITEMS];
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+tcache_thread(isc_threadarg_t arg) {
+	unsigned int id = *(unsigned int *)arg;
+	void *items[TC_ITEMS];
+	unsigned int i, j;
+
+	for (i = 0; i < 1000; i++) {
+		for (j = 0; j < TC_ITEMS; j++) {
+			items[j] = isc_mem_get(tc_mctx, 8 + (i + j) % 200);
+			ATF_REQUIRE(items[j] != NULL);
+		}
+		for (j = 0; j < TC_ITEMS; j++)
+			isc_mem_put(tc_mctx, items[j], 8 + (i + j) % 200);
+		for (j = 0; j < TC_ITEMS; j++) {
+			items[j] = isc_mempool_get(tc_pool);
+			ATF_REQUIRE(items[j] != NULL);
+		}
+		for (j = 0; j < TC_ITEMS; j++)
+			isc_mempool_put(tc_pool, items[j]);
+	}
+
+	/* Leave some items for another thread to free. */
+	for (j = 0; j < TC_ITEMS; j++)
+		tc_items[id][j] = isc_mempool_get(tc_pool);
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_mem_tcache);
+ATF_TC_HEAD(isc_mem_tcache, tc) {
+	atf_tc_set_md_var(tc, "descr", "test accounting with thread caches");
+}
+
+ATF_TC_BODY(isc_mem_tcache, tc) {
+	isc_result_t result;
+	isc_thread_t threads[TC_THREADS];
+	unsigned int ids[TC_THREADS];
+	isc_mutex_t lock;
+	size_t before, after;
+	unsigned int i, j;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_mem_create(0, 0, &tc_mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	before = isc_mem_inuse(tc_mctx);
+
+	result = isc_mempool_create(tc_mctx, 64, &tc_pool);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_mempool_associatelock(tc_pool, &lock);
+
+	for (i = 0; i < TC_THREADS; i++) {
+		ids[i] = i;
+		result = isc_thread_create(tcache_thread, &ids[i],
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < TC_THREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	ATF_CHECK_EQ(isc_mempool_getallocated(tc_pool),
+		     TC_THREADS * TC_ITEMS);
+	for (i = 0; i < TC_THREADS; i++)
+		for (j = 0; j < TC_ITEMS; j++)
+			isc_mempool_put(tc_pool, tc_items[i][j]);
+	ATF_CHECK_EQ(isc_mempool_getallocated(tc_pool), 0);
+
+	isc_mempool_destroy(&tc_pool);
+	after = isc_mem_inuse(tc_mctx);
+
+	printf("inuse_before=%lu, inuse_after=%lu\n",
+	       (unsigned long)before, (unsigned long)after);
+	ATF_CHECK_EQ(before, after);
+
+	/* Fails on leaked memory, including anything left in caches. */
+	isc_mem_destroy(&tc_mctx);
+	DESTROYLOCK(&lock);
+	isc_test_end();
+}
+#endif
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_mem_total);
 	ATF_TP_ADD_TC(tp, isc_mem_inuse);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, isc_mem_tcache);
+#endif
 
 	return (atf_no_error());
 }
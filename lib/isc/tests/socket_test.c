@@ -313,6 +313,89 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test UDP sendto/recv with sockets spread over several watchers */
+ATF_TC(udp_watchers);
+ATF_TC_HEAD(udp_watchers, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv, multiple watchers");
+}
+ATF_TC_BODY(udp_watchers, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr[4];
+	struct in_addr in;
+	isc_socket_t *s[4] = { NULL, NULL, NULL, NULL };
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[BUFSIZ];
+	completion_t completion;
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Replace the default manager with one running four watchers;
+	 * consecutive descriptors land on different watchers.
+	 */
+	isc_socketmgr_destroy(&socketmgr);
+	result = isc_socketmgr_create3(mctx, &socketmgr, 0, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < 4; i++) {
+		isc_sockaddr_fromin(&addr[i], &in, 0);
+		result = isc_socket_create(socketmgr, PF_INET,
+					   isc_sockettype_udp, &s[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i], 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_getsockname(s[i], &addr[i]);
+		ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+				 isc_result_totext(result));
+		ATF_REQUIRE(isc_sockaddr_getport(&addr[i]) != 0);
+	}
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Pass a message around the ring of sockets.
+	 */
+	for (i = 0; i < 4; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+
+		completion_init(&completion);
+		result = isc_socket_sendto(s[i], &r, task, event_done,
+					   &completion, &addr[(i + 1) % 4],
+					   NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+
+		r.base = (void *) recvbuf;
+		r.length = BUFSIZ;
+		completion_init(&completion);
+		result = isc_socket_recv(s[(i + 1) % 4], &r, 1, task,
+					 event_done, &completion);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf, sendbuf);
+	}
+
+	isc_task_detach(&task);
+
+	for (i = 0; i < 4; i++)
+		isc_socket_detach(&s[i]);
+
+	isc_test_end();
+}
+
 /* Test TCP sendto/recv (IPv4) */
 ATF_TC(udp_dscp_v4);
 ATF_TC_HEAD(udp_dscp_v4, tc) {
@@ -780,6 +863,7 @@ ATF_TC_BODY(net_probedscp, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_watchers);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v4);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v6);
 	ATF_TP_ADD_TC(tp, udp_dscp_v4);
@@ -14,7 +14,6 @@
 
 #include <isc/app.h>
 #include <isc/condition.h>
-#include <isc/heap.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -64,49 +63,96 @@
 #define VALID_TIMER(t)			ISC_MAGIC_VALID(t, TIMER_MAGIC)
 
 typedef struct isc__timer isc__timer_t;
+typedef struct isc__timerwheel isc__timerwheel_t;
 typedef struct isc__timermgr isc__timermgr_t;
+typedef LIST(isc__timer_t) timerlist_t;
 
 struct isc__timer {
 	/*! Not locked. */
 	isc_timer_t			common;
 	isc__timermgr_t *		manager;
+	isc__timerwheel_t *		wheel;
 	isc_mutex_t			lock;
 	/*! Locked by timer lock. */
 	unsigned int			references;
 	isc_time_t			idle;
-	/*! Locked by manager lock. */
+	/*! Locked by wheel lock. */
 	isc_timertype_t			type;
 	isc_time_t			expires;
 	isc_interval_t			interval;
 	isc_task_t *			task;
 	isc_taskaction_t		action;
 	void *				arg;
-	unsigned int			index;
 	isc_time_t			due;
+	isc_uint64_t			tick;		/*%< 'due' in wheel ticks */
+	timerlist_t *			slot;		/*%< NULL if unscheduled */
+	LINK(isc__timer_t)		slotlink;
 	LINK(isc__timer_t)		link;
 };
 
-#define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
-#define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, TIMER_MANAGER_MAGIC)
+/*
+ * Timing wheel geometry.  A wheel counts time in ticks from its epoch.
+ * The root level has one slot per tick for the next WHEEL_ROOTSIZE
+ * ticks; each of the WHEEL_LEVELS upper levels has WHEEL_LEVELSIZE
+ * slots, each covering a whole turn of the level below.  Timers further
+ * out than the wheel spans are parked in the last slot they can reach
+ * and placed again when it is cascaded.
+ */
+#define WHEEL_TICK			1000000		/*%< ns per tick */
+#define WHEEL_ROOTBITS			8
+#define WHEEL_ROOTSIZE			(1 << WHEEL_ROOTBITS)
+#define WHEEL_ROOTMASK			(WHEEL_ROOTSIZE - 1)
+#define WHEEL_LEVELBITS			6
+#define WHEEL_LEVELSIZE			(1 << WHEEL_LEVELBITS)
+#define WHEEL_LEVELMASK			(WHEEL_LEVELSIZE - 1)
+#define WHEEL_LEVELS			4
+#define WHEEL_SHIFT(l)			(WHEEL_ROOTBITS + (l) * WHEEL_LEVELBITS)
+#define WHEEL_SPAN			(((isc_uint64_t)1 << \
+					  WHEEL_SHIFT(WHEEL_LEVELS)) - 1)
+
+#define NS_PER_S			1000000000
 
-struct isc__timermgr {
+/*%
+ * Each timer wheel is served by its own thread and has its own lock, so
+ * timers on different wheels never contend with each other.  A timer is
+ * placed on one wheel when it is created and stays there.
+ */
+struct isc__timerwheel {
 	/* Not locked. */
-	isc_timermgr_t			common;
-	isc_mem_t *			mctx;
+	isc__timermgr_t *		manager;
 	isc_mutex_t			lock;
-	/* Locked by manager lock. */
+	/* Locked by wheel lock. */
 	isc_boolean_t			done;
+	isc_time_t			epoch;		/*%< time of tick 0 */
 	LIST(isc__timer_t)		timers;
 	unsigned int			nscheduled;
+	unsigned int			nroot;		/*%< # in root level */
+	isc_uint64_t			curtick;	/*%< next tick to run */
+	isc_uint64_t			duetick;	/*%< next wakeup */
 	isc_time_t			due;
+	timerlist_t			root[WHEEL_ROOTSIZE];
+	timerlist_t			levels[WHEEL_LEVELS][WHEEL_LEVELSIZE];
 #ifdef USE_TIMER_THREAD
 	isc_condition_t			wakeup;
 	isc_thread_t			thread;
 #endif	/* USE_TIMER_THREAD */
+};
+
+#define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
+#define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, TIMER_MANAGER_MAGIC)
+
+struct isc__timermgr {
+	/* Not locked. */
+	isc_timermgr_t			common;
+	isc_mem_t *			mctx;
+	isc_mutex_t			lock;
+	unsigned int			nwheels;
+	isc__timerwheel_t *		wheels;
+	/* Locked by manager lock. */
+	unsigned int			curwheel;
 #ifdef USE_SHARED_MANAGER
 	unsigned int			refs;
 #endif /* USE_SHARED_MANAGER */
-	isc_heap_t *			heap;
 };
 
 /*%
@@ -134,6 +180,9 @@ void
 isc__timer_detach(isc_timer_t **timerp);
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		      unsigned int nthreads);
 void
 isc_timermgr_poke(isc_timermgr_t *manager0);
 void
@@ -174,12 +223,203 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+/*
+ * Convert between times and wheel ticks.  Due times are rounded up to
+ * the next tick so that a timer never fires early.
+ */
+static inline isc_uint64_t
+time2tick(isc__timerwheel_t *wheel, const isc_time_t *t,
+	  isc_boolean_t roundup)
+{
+	isc_uint64_t ns;
+
+	if (isc_time_compare(t, &wheel->epoch) <= 0)
+		return (0);
+
+	ns = (isc_uint64_t)(isc_time_seconds(t) -
+			    isc_time_seconds(&wheel->epoch)) * NS_PER_S;
+	ns += isc_time_nanoseconds(t);
+	ns -= isc_time_nanoseconds(&wheel->epoch);
+	if (roundup)
+		ns += WHEEL_TICK - 1;
+
+	return (ns / WHEEL_TICK);
+}
+
+static inline void
+tick2time(isc__timerwheel_t *wheel, isc_uint64_t tick, isc_time_t *t) {
+	isc_interval_t interval;
+	isc_uint64_t ns = tick * WHEEL_TICK;
+
+	isc_interval_set(&interval, (unsigned int)(ns / NS_PER_S),
+			 (unsigned int)(ns % NS_PER_S));
+	RUNTIME_CHECK(isc_time_add(&wheel->epoch, &interval, t) ==
+		      ISC_R_SUCCESS);
+}
+
+/*%
+ * Put 'timer' in the wheel slot for its tick.
+ */
+static inline void
+wheel_link(isc__timerwheel_t *wheel, isc__timer_t *timer) {
+	isc_uint64_t tick = timer->tick, delta;
+	timerlist_t *slot;
+	unsigned int level;
+
+	if (tick < wheel->curtick) {
+		/*
+		 * Already due: run it with the next tick.
+		 */
+		slot = &wheel->root[wheel->curtick & WHEEL_ROOTMASK];
+		wheel->nroot++;
+	} else if ((delta = tick - wheel->curtick) < WHEEL_ROOTSIZE) {
+		slot = &wheel->root[tick & WHEEL_ROOTMASK];
+		wheel->nroot++;
+	} else {
+		if (delta > WHEEL_SPAN)
+			tick = wheel->curtick + WHEEL_SPAN;
+		for (level = 0; level < WHEEL_LEVELS - 1; level++)
+			if (delta < ((isc_uint64_t)1 << WHEEL_SHIFT(level + 1)))
+				break;
+		slot = &wheel->levels[level][(tick >> WHEEL_SHIFT(level)) &
+					     WHEEL_LEVELMASK];
+	}
+
+	APPEND(*slot, timer, slotlink);
+	timer->slot = slot;
+}
+
+static inline void
+wheel_unlink(isc__timerwheel_t *wheel, isc__timer_t *timer) {
+	timerlist_t *slot = timer->slot;
+
+	if (slot >= &wheel->root[0] && slot < &wheel->root[WHEEL_ROOTSIZE]) {
+		INSIST(wheel->nroot > 0);
+		wheel->nroot--;
+	}
+	UNLINK(*slot, timer, slotlink);
+	timer->slot = NULL;
+}
+
+/*%
+ * Called when the root level wraps: move the timers in the upper level
+ * slots that have come into range down the wheel.
+ */
+static void
+wheel_cascade(isc__timerwheel_t *wheel) {
+	timerlist_t *slot;
+	isc__timer_t *timer;
+	unsigned int level, index;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		index = (wheel->curtick >> WHEEL_SHIFT(level)) &
+			WHEEL_LEVELMASK;
+		slot = &wheel->levels[level][index];
+		while ((timer = HEAD(*slot)) != NULL) {
+			wheel_unlink(wheel, timer);
+			wheel_link(wheel, timer);
+		}
+		if (index != 0)
+			break;
+	}
+}
+
+/*%
+ * The clock has gone backwards: restart the wheel at 'now' so that new
+ * timers are not held up until the clock catches up with it again.
+ */
+static void
+wheel_rebase(isc__timerwheel_t *wheel, isc_time_t *now) {
+	timerlist_t timers;
+	isc__timer_t *timer;
+	unsigned int i, level;
+
+	INIT_LIST(timers);
+	for (i = 0; i < WHEEL_ROOTSIZE; i++) {
+		while ((timer = HEAD(wheel->root[i])) != NULL) {
+			wheel_unlink(wheel, timer);
+			APPEND(timers, timer, slotlink);
+		}
+	}
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_LEVELSIZE; i++) {
+			while ((timer = HEAD(wheel->levels[level][i])) != NULL) {
+				wheel_unlink(wheel, timer);
+				APPEND(timers, timer, slotlink);
+			}
+		}
+	}
+
+	wheel->epoch = *now;
+	wheel->curtick = 0;
+	while ((timer = HEAD(timers)) != NULL) {
+		UNLINK(timers, timer, slotlink);
+		timer->tick = time2tick(wheel, &timer->due, ISC_TRUE);
+		wheel_link(wheel, timer);
+	}
+}
+
+/*%
+ * Find the next tick at which the wheel has work to do: either a root
+ * slot with timers in it, or an upper level slot that must be cascaded.
+ */
+static isc_boolean_t
+wheel_next(isc__timerwheel_t *wheel, isc_uint64_t *tickp) {
+	isc_uint64_t next = ISC_UINT64_MAX, first;
+	unsigned int i, level;
+
+	if (wheel->nscheduled == 0)
+		return (ISC_FALSE);
+
+	if (wheel->nroot > 0) {
+		for (i = 0; i < WHEEL_ROOTSIZE; i++) {
+			if (!EMPTY(wheel->root[(wheel->curtick + i) &
+					       WHEEL_ROOTMASK])) {
+				next = wheel->curtick + i;
+				break;
+			}
+		}
+	}
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		first = (wheel->curtick +
+			 ((isc_uint64_t)1 << WHEEL_SHIFT(level)) - 1) >>
+			WHEEL_SHIFT(level);
+		for (i = 0; i < WHEEL_LEVELSIZE; i++) {
+			if (!EMPTY(wheel->levels[level][(first + i) &
+							WHEEL_LEVELMASK])) {
+				if (((first + i) << WHEEL_SHIFT(level)) < next)
+					next = (first + i) <<
+						WHEEL_SHIFT(level);
+				break;
+			}
+		}
+	}
+
+	INSIST(next != ISC_UINT64_MAX);
+	*tickp = next;
+	return (ISC_TRUE);
+}
+
+/*%
+ * Recompute when the wheel next needs to run.
+ */
+static void
+wheel_setdue(isc__timerwheel_t *wheel) {
+	if (wheel_next(wheel, &wheel->duetick))
+		tick2time(wheel, wheel->duetick, &wheel->due);
+	else {
+		wheel->duetick = ISC_UINT64_MAX;
+		isc_time_settoepoch(&wheel->due);
+	}
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	isc_result_t result;
-	isc__timermgr_t *manager;
+	isc__timerwheel_t *wheel;
 	isc_time_t due;
-	int cmp;
+	isc_uint64_t tick;
 #ifdef USE_TIMER_THREAD
 	isc_boolean_t timedwait;
 #endif
@@ -194,15 +434,15 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	UNUSED(signal_ok);
 #endif /* USE_TIMER_THREAD */
 
-	manager = timer->manager;
+	wheel = timer->wheel;
 
 #ifdef USE_TIMER_THREAD
 	/*!
-	 * If the manager was timed wait, we may need to signal the
-	 * manager to force a wakeup.
+	 * If the wheel was timed wait, we may need to signal the
+	 * wheel to force a wakeup.
 	 */
-	timedwait = ISC_TF(manager->nscheduled > 0 &&
-			   isc_time_seconds(&manager->due) != 0);
+	timedwait = ISC_TF(wheel->nscheduled > 0 &&
+			   isc_time_seconds(&wheel->due) != 0);
 #endif
 
 	/*
@@ -230,41 +470,34 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	 * Schedule the timer.
 	 */
 
-	if (timer->index > 0) {
+	if (timer->slot != NULL) {
 		/*
 		 * Already scheduled.
 		 */
-		cmp = isc_time_compare(&due, &timer->due);
-		timer->due = due;
-		switch (cmp) {
-		case -1:
-			isc_heap_increased(manager->heap, timer->index);
-			break;
-		case 1:
-			isc_heap_decreased(manager->heap, timer->index);
-			break;
-		case 0:
-			/* Nothing to do. */
-			break;
-		}
+		wheel_unlink(wheel, timer);
 	} else {
-		timer->due = due;
-		result = isc_heap_insert(manager->heap, timer);
-		if (result != ISC_R_SUCCESS) {
-			INSIST(result == ISC_R_NOMEMORY);
-			return (ISC_R_NOMEMORY);
+		/*
+		 * An empty wheel can be moved forward to the present, so
+		 * it does not have to step through the idle period.
+		 */
+		if (wheel->nscheduled == 0) {
+			tick = time2tick(wheel, now, ISC_FALSE);
+			if (tick > wheel->curtick)
+				wheel->curtick = tick;
 		}
-		manager->nscheduled++;
+		wheel->nscheduled++;
 	}
+	timer->due = due;
+	timer->tick = time2tick(wheel, &due, ISC_TRUE);
+	wheel_link(wheel, timer);
 
 	XTRACETIMER(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				   ISC_MSG_SCHEDULE, "schedule"), timer, due);
 
 	/*
-	 * If this timer is at the head of the queue, we need to ensure
-	 * that we won't miss it if it has a more recent due time than
-	 * the current "next" timer.  We do this either by waking up the
-	 * run thread, or explicitly setting the value in the manager.
+	 * If this timer is due before the wheel's next run, we need to
+	 * ensure that we won't miss it.  We do this either by waking up
+	 * the run thread, or explicitly setting the value in the wheel.
 	 */
 #ifdef USE_TIMER_THREAD
 
@@ -281,11 +514,11 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 		isc_time_t then;
 
 		isc_interval_set(&fifteen, 15, 0);
-		result = isc_time_add(&manager->due, &fifteen, &then);
+		result = isc_time_add(&wheel->due, &fifteen, &then);
 
 		if (result == ISC_R_SUCCESS &&
 		    isc_time_compare(&then, now) < 0) {
-			SIGNAL(&manager->wakeup);
+			SIGNAL(&wheel->wakeup);
 			signal_ok = ISC_FALSE;
 			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
 				      ISC_LOGMODULE_TIMER, ISC_LOG_WARNING,
@@ -293,16 +526,20 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 		}
 	}
 
-	if (timer->index == 1 && signal_ok) {
-		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-				      ISC_MSG_SIGNALSCHED,
-				      "signal (schedule)"));
-		SIGNAL(&manager->wakeup);
+	if (timer->tick < wheel->duetick) {
+		wheel->duetick = timer->tick;
+		if (signal_ok) {
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					      ISC_MSG_SIGNALSCHED,
+					      "signal (schedule)"));
+			SIGNAL(&wheel->wakeup);
+		}
 	}
 #else /* USE_TIMER_THREAD */
-	if (timer->index == 1 &&
-	    isc_time_compare(&timer->due, &manager->due) < 0)
-		manager->due = timer->due;
+	if (timer->tick < wheel->duetick) {
+		wheel->duetick = timer->tick;
+		tick2time(wheel, timer->tick, &wheel->due);
+	}
 #endif /* USE_TIMER_THREAD */
 
 	return (ISC_R_SUCCESS);
@@ -310,45 +547,33 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 
 static inline void
 deschedule(isc__timer_t *timer) {
-#ifdef USE_TIMER_THREAD
-	isc_boolean_t need_wakeup = ISC_FALSE;
-#endif
-	isc__timermgr_t *manager;
+	isc__timerwheel_t *wheel;
 
 	/*
 	 * The caller must ensure locking.
+	 *
+	 * The wheel thread is not woken up: if this was the next timer
+	 * due, the thread finds nothing to do and goes back to sleep.
 	 */
 
-	manager = timer->manager;
-	if (timer->index > 0) {
-#ifdef USE_TIMER_THREAD
-		if (timer->index == 1)
-			need_wakeup = ISC_TRUE;
-#endif
-		isc_heap_delete(manager->heap, timer->index);
-		timer->index = 0;
-		INSIST(manager->nscheduled > 0);
-		manager->nscheduled--;
-#ifdef USE_TIMER_THREAD
-		if (need_wakeup) {
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-					      ISC_MSG_SIGNALDESCHED,
-					      "signal (deschedule)"));
-			SIGNAL(&manager->wakeup);
-		}
-#endif /* USE_TIMER_THREAD */
+	wheel = timer->wheel;
+	if (timer->slot != NULL) {
+		wheel_unlink(wheel, timer);
+		INSIST(wheel->nscheduled > 0);
+		wheel->nscheduled--;
 	}
 }
 
 static void
 destroy(isc__timer_t *timer) {
 	isc__timermgr_t *manager = timer->manager;
+	isc__timerwheel_t *wheel = timer->wheel;
 
 	/*
 	 * The caller must ensure it is safe to destroy the timer.
 	 */
 
-	LOCK(&manager->lock);
+	LOCK(&wheel->lock);
 
 	(void)isc_task_purgerange(timer->task,
 				  timer,
@@ -356,9 +581,9 @@ destroy(isc__timer_t *timer) {
 				  ISC_TIMEREVENT_LASTEVENT,
 				  NULL);
 	deschedule(timer);
-	UNLINK(manager->timers, timer, link);
+	UNLINK(wheel->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&wheel->lock);
 
 	isc_task_detach(&timer->task);
 	DESTROYLOCK(&timer->lock);
@@ -375,6 +600,7 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 {
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
 	isc__timer_t *timer;
+	isc__timerwheel_t *wheel;
 	isc_result_t result;
 	isc_time_t now;
 
@@ -447,7 +673,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 * keep track of whether arg started as a true const.
 	 */
 	DE_CONST(arg, timer->arg);
-	timer->index = 0;
+	timer->tick = 0;
+	timer->slot = NULL;
+	ISC_LINK_INIT(timer, slotlink);
 	result = isc_mutex_init(&timer->lock);
 	if (result != ISC_R_SUCCESS) {
 		isc_task_detach(&timer->task);
@@ -459,7 +687,17 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	timer->common.magic = ISCAPI_TIMER_MAGIC;
 	timer->common.methods = (isc_timermethods_t *)&timermethods;
 
+	/*
+	 * Spread timers over the wheels.
+	 */
 	LOCK(&manager->lock);
+	wheel = &manager->wheels[manager->curwheel];
+	if (++manager->curwheel == manager->nwheels)
+		manager->curwheel = 0;
+	UNLOCK(&manager->lock);
+	timer->wheel = wheel;
+
+	LOCK(&wheel->lock);
 
 	/*
 	 * Note we don't have to lock the timer like we normally would because
@@ -471,9 +709,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	else
 		result = ISC_R_SUCCESS;
 	if (result == ISC_R_SUCCESS)
-		APPEND(manager->timers, timer, link);
+		APPEND(wheel->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&wheel->lock);
 
 	if (result != ISC_R_SUCCESS) {
 		timer->common.impmagic = 0;
@@ -497,6 +735,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	isc__timer_t *timer = (isc__timer_t *)timer0;
 	isc_time_t now;
 	isc__timermgr_t *manager;
+	isc__timerwheel_t *wheel;
 	isc_result_t result;
 
 	/*
@@ -508,6 +747,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	REQUIRE(VALID_TIMER(timer));
 	manager = timer->manager;
 	REQUIRE(VALID_MANAGER(manager));
+	wheel = timer->wheel;
 
 	if (expires == NULL)
 		expires = isc_time_epoch;
@@ -532,7 +772,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	LOCK(&wheel->lock);
 	LOCK(&timer->lock);
 
 	if (purge)
@@ -560,7 +800,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	UNLOCK(&wheel->lock);
 
 	return (result);
 }
@@ -655,22 +895,58 @@ isc__timer_detach(isc_timer_t **timerp) {
 }
 
 static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	isc_boolean_t done = ISC_FALSE, post_event, need_schedule;
+dispatch(isc__timerwheel_t *wheel, isc_time_t *now) {
+	isc_boolean_t post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
 	isc__timer_t *timer;
 	isc_result_t result;
 	isc_boolean_t idle;
+	isc_uint64_t nowtick, next;
+	timerlist_t expired;
+	unsigned int index;
 
 	/*!
-	 * The caller must be holding the manager lock.
+	 * The caller must be holding the wheel lock.
 	 */
 
-	while (manager->nscheduled > 0 && !done) {
-		timer = isc_heap_element(manager->heap, 1);
-		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
-		if (isc_time_compare(now, &timer->due) >= 0) {
+	nowtick = time2tick(wheel, now, ISC_FALSE);
+	if (nowtick + 1 < wheel->curtick) {
+		wheel_rebase(wheel, now);
+		nowtick = 0;
+	}
+	while (wheel->nscheduled > 0 && wheel->curtick <= nowtick) {
+		index = wheel->curtick & WHEEL_ROOTMASK;
+		if (index == 0)
+			wheel_cascade(wheel);
+		else if (wheel->nroot == 0) {
+			/*
+			 * Nothing can be due before the next cascade.
+			 */
+			next = wheel->curtick + WHEEL_ROOTSIZE - index;
+			wheel->curtick = ISC_MIN(next, nowtick + 1);
+			continue;
+		}
+
+		/*
+		 * Take the timers for this tick off the wheel first, as
+		 * rescheduling one can put it back into the same slot.
+		 */
+		INIT_LIST(expired);
+		while ((timer = HEAD(wheel->root[index])) != NULL) {
+			wheel_unlink(wheel, timer);
+			APPEND(expired, timer, slotlink);
+			timer->slot = &expired;
+		}
+		wheel->curtick++;
+
+		while ((timer = HEAD(expired)) != NULL) {
+			UNLINK(expired, timer, slotlink);
+			timer->slot = NULL;
+			INSIST(timer->type != isc_timertype_inactive);
+			INSIST(wheel->nscheduled > 0);
+			wheel->nscheduled--;
+
 			if (timer->type == isc_timertype_ticker) {
 				type = ISC_TIMEREVENT_TICK;
 				post_event = ISC_TRUE;
@@ -730,7 +1006,7 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 				/*
 				 * XXX We could preallocate this event.
 				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
+				event = (isc_timerevent_t *)isc_event_allocate(wheel->manager->mctx,
 							   timer,
 							   type,
 							   timer->action,
@@ -750,10 +1026,6 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 							 "allocate event"));
 			}
 
-			timer->index = 0;
-			isc_heap_delete(manager->heap, 1);
-			manager->nscheduled--;
-
 			if (need_schedule) {
 				result = schedule(timer, now, ISC_FALSE);
 				if (result != ISC_R_SUCCESS)
@@ -766,11 +1038,10 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 							"timer"),
 							 result);
 			}
-		} else {
-			manager->due = timer->due;
-			done = ISC_TRUE;
 		}
 	}
+
+	wheel_setdue(wheel);
 }
 
 #ifdef USE_TIMER_THREAD
@@ -779,38 +1050,38 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__timermgr_t *manager = uap;
+	isc__timerwheel_t *wheel = uap;
 	isc_time_t now;
 	isc_result_t result;
 
-	LOCK(&manager->lock);
-	while (!manager->done) {
+	LOCK(&wheel->lock);
+	while (!wheel->done) {
 		TIME_NOW(&now);
 
 		XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 					  ISC_MSG_RUNNING,
 					  "running"), now);
 
-		dispatch(manager, &now);
+		dispatch(wheel, &now);
 
-		if (manager->nscheduled > 0) {
+		if (wheel->nscheduled > 0) {
 			XTRACETIME2(isc_msgcat_get(isc_msgcat,
 						   ISC_MSGSET_GENERAL,
 						   ISC_MSG_WAITUNTIL,
 						   "waituntil"),
-				    manager->due, now);
-			result = WAITUNTIL(&manager->wakeup, &manager->lock, &manager->due);
+				    wheel->due, now);
+			result = WAITUNTIL(&wheel->wakeup, &wheel->lock, &wheel->due);
 			INSIST(result == ISC_R_SUCCESS ||
 			       result == ISC_R_TIMEDOUT);
 		} else {
 			XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						  ISC_MSG_WAIT, "wait"), now);
-			WAIT(&manager->wakeup, &manager->lock);
+			WAIT(&wheel->wakeup, &wheel->lock);
 		}
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				      ISC_MSG_WAKEUP, "wakeup"));
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&wheel->lock);
 
 #ifdef OPENSSL_LEAKS
 	ERR_remove_state(0);
@@ -820,40 +1091,107 @@ run(void *uap) {
 }
 #endif /* USE_TIMER_THREAD */
 
-static isc_boolean_t
-sooner(void *v1, void *v2) {
-	isc__timer_t *t1, *t2;
+static void
+wheel_destroy(isc__timerwheel_t *wheel) {
+#ifdef USE_TIMER_THREAD
+	(void)isc_condition_destroy(&wheel->wakeup);
+#endif /* USE_TIMER_THREAD */
+	DESTROYLOCK(&wheel->lock);
+}
 
-	t1 = v1;
-	t2 = v2;
-	REQUIRE(VALID_TIMER(t1));
-	REQUIRE(VALID_TIMER(t2));
+static isc_result_t
+wheel_init(isc__timermgr_t *manager, isc__timerwheel_t *wheel) {
+	isc_result_t result;
+	unsigned int i, level;
+
+	wheel->manager = manager;
+	wheel->done = ISC_FALSE;
+	INIT_LIST(wheel->timers);
+	wheel->nscheduled = 0;
+	wheel->nroot = 0;
+	TIME_NOW(&wheel->epoch);
+	wheel->curtick = 0;
+	wheel->duetick = ISC_UINT64_MAX;
+	isc_time_settoepoch(&wheel->due);
+	for (i = 0; i < WHEEL_ROOTSIZE; i++)
+		INIT_LIST(wheel->root[i]);
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		for (i = 0; i < WHEEL_LEVELSIZE; i++)
+			INIT_LIST(wheel->levels[level][i]);
+
+	result = isc_mutex_init(&wheel->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_TIMER_THREAD
+	if (isc_condition_init(&wheel->wakeup) != ISC_R_SUCCESS) {
+		DESTROYLOCK(&wheel->lock);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+	if (isc_thread_create(run, wheel, &wheel->thread) !=
+	    ISC_R_SUCCESS) {
+		wheel_destroy(wheel);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_thread_create() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+	isc_thread_setname(wheel->thread, "isc-timer");
+#endif
 
-	if (isc_time_compare(&t1->due, &t2->due) < 0)
-		return (ISC_TRUE);
-	return (ISC_FALSE);
+	return (ISC_R_SUCCESS);
 }
 
 static void
-set_index(void *what, unsigned int index) {
-	isc__timer_t *timer;
+wheel_shutdown(isc__timerwheel_t *wheel) {
+	LOCK(&wheel->lock);
 
-	timer = what;
-	REQUIRE(VALID_TIMER(timer));
+	REQUIRE(EMPTY(wheel->timers));
+	wheel->done = ISC_TRUE;
+
+#ifdef USE_TIMER_THREAD
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+			      ISC_MSG_SIGNALDESTROY, "signal (destroy)"));
+	SIGNAL(&wheel->wakeup);
+#endif /* USE_TIMER_THREAD */
+
+	UNLOCK(&wheel->lock);
 
-	timer->index = index;
+#ifdef USE_TIMER_THREAD
+	/*
+	 * Wait for thread to exit.
+	 */
+	if (isc_thread_join(wheel->thread, NULL) != ISC_R_SUCCESS)
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_thread_join() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+#endif /* USE_TIMER_THREAD */
 }
 
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
+	return (isc__timermgr_create2(mctx, managerp, 1));
+}
+
+isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		      unsigned int nthreads)
+{
 	isc__timermgr_t *manager;
 	isc_result_t result;
+	unsigned int i;
 
 	/*
 	 * Create a timer manager.
 	 */
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(nthreads > 0);
 
 #ifdef USE_SHARED_MANAGER
 	if (timermgr != NULL) {
@@ -863,6 +1201,10 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	}
 #endif /* USE_SHARED_MANAGER */
 
+#ifndef USE_TIMER_THREAD
+	nthreads = 1;
+#endif
+
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
 		return (ISC_R_NOMEMORY);
@@ -871,51 +1213,37 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	manager->common.magic = ISCAPI_TIMERMGR_MAGIC;
 	manager->common.methods = (isc_timermgrmethods_t *)&timermgrmethods;
 	manager->mctx = NULL;
-	manager->done = ISC_FALSE;
-	INIT_LIST(manager->timers);
-	manager->nscheduled = 0;
-	isc_time_settoepoch(&manager->due);
-	manager->heap = NULL;
-	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
-	if (result != ISC_R_SUCCESS) {
-		INSIST(result == ISC_R_NOMEMORY);
+	manager->curwheel = 0;
+	manager->nwheels = 0;
+	manager->wheels = isc_mem_get(mctx, nthreads * sizeof(*manager->wheels));
+	if (manager->wheels == NULL) {
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (ISC_R_NOMEMORY);
 	}
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS) {
-		isc_heap_destroy(&manager->heap);
+		isc_mem_put(mctx, manager->wheels,
+			    nthreads * sizeof(*manager->wheels));
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (result);
 	}
 	isc_mem_attach(mctx, &manager->mctx);
-#ifdef USE_TIMER_THREAD
-	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
-	}
-	if (isc_thread_create(run, manager, &manager->thread) !=
-	    ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		(void)isc_condition_destroy(&manager->wakeup);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
+	for (i = 0; i < nthreads; i++) {
+		result = wheel_init(manager, &manager->wheels[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0) {
+				wheel_shutdown(&manager->wheels[i]);
+				wheel_destroy(&manager->wheels[i]);
+			}
+			isc_mem_detach(&manager->mctx);
+			DESTROYLOCK(&manager->lock);
+			isc_mem_put(mctx, manager->wheels,
+				    nthreads * sizeof(*manager->wheels));
+			isc_mem_put(mctx, manager, sizeof(*manager));
+			return (result);
+		}
 	}
-	isc_thread_setname(manager->thread, "isc-timer");
-#endif
+	manager->nwheels = nthreads;
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 	timermgr = manager;
@@ -930,10 +1258,12 @@ void
 isc_timermgr_poke(isc_timermgr_t *manager0) {
 #ifdef USE_TIMER_THREAD
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
+	unsigned int i;
 
 	REQUIRE(VALID_MANAGER(manager));
 
-	SIGNAL(&manager->wakeup);
+	for (i = 0; i < manager->nwheels; i++)
+		SIGNAL(&manager->wheels[i].wakeup);
 #else
 	UNUSED(manager0);
 #endif
@@ -943,6 +1273,7 @@ void
 isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	isc__timermgr_t *manager;
 	isc_mem_t *mctx;
+	unsigned int i;
 
 	/*
 	 * Destroy a timer manager.
@@ -952,9 +1283,8 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	manager = (isc__timermgr_t *)*managerp;
 	REQUIRE(VALID_MANAGER(manager));
 
-	LOCK(&manager->lock);
-
 #ifdef USE_SHARED_MANAGER
+	LOCK(&manager->lock);
 	manager->refs--;
 	if (manager->refs > 0) {
 		UNLOCK(&manager->lock);
@@ -962,45 +1292,27 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 		return;
 	}
 	timermgr = NULL;
+	UNLOCK(&manager->lock);
 #endif /* USE_SHARED_MANAGER */
 
 #ifndef USE_TIMER_THREAD
 	isc__timermgr_dispatch((isc_timermgr_t *)manager);
 #endif
 
-	REQUIRE(EMPTY(manager->timers));
-	manager->done = ISC_TRUE;
-
-#ifdef USE_TIMER_THREAD
-	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-			      ISC_MSG_SIGNALDESTROY, "signal (destroy)"));
-	SIGNAL(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
-
-	UNLOCK(&manager->lock);
-
-#ifdef USE_TIMER_THREAD
-	/*
-	 * Wait for thread to exit.
-	 */
-	if (isc_thread_join(manager->thread, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-#endif /* USE_TIMER_THREAD */
+	for (i = 0; i < manager->nwheels; i++)
+		wheel_shutdown(&manager->wheels[i]);
 
 	/*
 	 * Clean up.
 	 */
-#ifdef USE_TIMER_THREAD
-	(void)isc_condition_destroy(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
+	for (i = 0; i < manager->nwheels; i++)
+		wheel_destroy(&manager->wheels[i]);
 	DESTROYLOCK(&manager->lock);
-	isc_heap_destroy(&manager->heap);
 	manager->common.impmagic = 0;
 	manager->common.magic = 0;
 	mctx = manager->mctx;
+	isc_mem_put(mctx, manager->wheels,
+		    manager->nwheels * sizeof(*manager->wheels));
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	isc_mem_detach(&mctx);
 
@@ -1020,9 +1332,9 @@ isc__timermgr_nextevent(isc_timermgr_t *manager0, isc_time_t *when) {
 	if (manager == NULL)
 		manager = timermgr;
 #endif
-	if (manager == NULL || manager->nscheduled == 0)
+	if (manager == NULL || manager->wheels[0].nscheduled == 0)
 		return (ISC_R_NOTFOUND);
-	*when = manager->due;
+	*when = manager->wheels[0].due;
 	return (ISC_R_SUCCESS);
 }
 
@@ -1038,7 +1350,7 @@ isc__timermgr_dispatch(isc_timermgr_t *manager0) {
 	if (manager == NULL)
 		return;
 	TIME_NOW(&now);
-	dispatch(manager, &now);
+	dispatch(&manager->wheels[0], &now);
 }
 #endif /* USE_TIMER_THREAD */
 
@@ -1108,6 +1420,25 @@ isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	return (result);
 }
 
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		     unsigned int nthreads)
+{
+	isc_result_t result;
+
+	if (isc_bind9)
+		return (isc__timermgr_create2(mctx, managerp, nthreads));
+
+	LOCK(&createlock);
+
+	REQUIRE(timermgr_createfunc != NULL);
+	result = (*timermgr_createfunc)(mctx, managerp);
+
+	UNLOCK(&createlock);
+
+	return (result);
+}
+
 void
 isc_timermgr_destroy(isc_timermgr_t **managerp) {
 	REQUIRE(*managerp != NULL && ISCAPI_TIMERMGR_VALID(*managerp));
@@ -320,6 +320,7 @@ typedef isc_event_t intev_t;
 
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -384,13 +385,20 @@ struct isc__socket {
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
-struct isc__socketmgr {
+/*%
+ * A socket watcher.  Each watcher has its own event multiplexer and
+ * control pipe, and (when threaded) its own thread.  A descriptor is
+ * always watched by the watcher that FDTHREAD() selects for it.
+ */
+struct isc__socketthread {
 	/* Not locked. */
-	isc_socketmgr_t		common;
-	isc_mem_t	       *mctx;
-	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
-	isc_stats_t		*stats;
+	isc__socketmgr_t	*manager;
+	int			threadid;
+#ifdef USE_WATCHER_THREAD
+	isc_thread_t		thread;
+	int			pipe_fds[2];
+	int			cpu;	/* locked by manager lock */
+#endif /* USE_WATCHER_THREAD */
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -408,13 +416,37 @@ struct isc__socketmgr {
 	int			nevents;
 	struct pollfd		*events;
 #endif	/* USE_DEVPOLL */
+#ifdef USE_SELECT
+	/* Locked by manager lock. */
+	fd_set			*read_fds;
+	fd_set			*read_fds_copy;
+	fd_set			*write_fds;
+	fd_set			*write_fds_copy;
+	int			maxfd;
+#endif	/* USE_SELECT */
+	/* Only updated by the watcher itself. */
+	isc_uint64_t		wakeups;
+	isc_uint64_t		fdevents;
+};
+
+/*%
+ * Descriptors are spread over the watchers by their number.
+ */
+#define FDTHREAD(m, fd)		(&(m)->threads[(fd) % (m)->nthreads])
+
+struct isc__socketmgr {
+	/* Not locked. */
+	isc_socketmgr_t		common;
+	isc_mem_t	       *mctx;
+	isc_mutex_t		lock;
+	isc_mutex_t		*fdlock;
+	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -428,16 +460,8 @@ struct isc__socketmgr {
 
 	/* Locked by manager lock. */
 	ISC_LIST(isc__socket_t)	socklist;
-#ifdef USE_SELECT
-	fd_set			*read_fds;
-	fd_set			*read_fds_copy;
-	fd_set			*write_fds;
-	fd_set			*write_fds_copy;
-	int			maxfd;
-#endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 #else /* USE_WATCHER_THREAD */
 	unsigned int		refs;
@@ -463,10 +487,29 @@ static isc__socketmgr_t *socketmgr = NULL;
 # define MAXSCATTERGATHER_RECV	(ISC_SOCKET_MAXSCATTERGATHER)
 #endif
 
+/*
+ * Batched UDP I/O.  Where recvmmsg() and sendmmsg() are available,
+ * internal_recv() and internal_send() move up to MAXBATCH_UDP datagrams
+ * per system call between a UDP socket and its queued done events.
+ * Each datagram in a batch gets its own BATCH_CMSGSPACE bytes of
+ * control message space.
+ */
+#if defined(HAVE_RECVMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_RECVMMSG	1
+#endif
+#if defined(HAVE_SENDMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_SENDMMSG	1
+#endif
+#define MAXBATCH_UDP		16
+#define BATCH_CMSGSPACE		256
+
 static isc_result_t socket_create(isc_socketmgr_t *manager0, int pf,
 				  isc_sockettype_t type,
 				  isc_socket_t **socketp,
 				  isc_socket_t *dup_socket);
+static int doio_recvfail(isc__socket_t *, isc_socketevent_t *, int, int);
+static int doio_recvdone(isc__socket_t *, isc_socketevent_t *,
+			 struct msghdr *, int, size_t);
 static void send_recvdone_event(isc__socket_t *, isc_socketevent_t **);
 static void send_senddone_event(isc__socket_t *, isc_socketevent_t **);
 static void send_connectdone_event(isc__socket_t *, isc_socket_connev_t **);
@@ -486,7 +529,7 @@ static void build_msghdr_send(isc__socket_t *, isc_socketevent_t *,
 static void build_msghdr_recv(isc__socket_t *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 #ifdef USE_WATCHER_THREAD
-static isc_boolean_t process_ctlfd(isc__socketmgr_t *manager);
+static isc_boolean_t process_ctlfd(isc__socketthread_t *thread);
 #endif
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
 
@@ -598,6 +641,9 @@ isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks);
 isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads);
+isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
 isc_socketmgr_setstats(isc_socketmgr_t *manager0, isc_stats_t *stats);
@@ -684,7 +730,11 @@ enum {
 	STATID_ACCEPT = 7,
 	STATID_SENDFAIL = 8,
 	STATID_RECVFAIL = 9,
-	STATID_ACTIVE = 10
+	STATID_ACTIVE = 10,
+	STATID_RECVBATCH = 11,
+	STATID_RECVBATCHMSG = 12,
+	STATID_SENDBATCH = 13,
+	STATID_SENDBATCHMSG = 14
 };
 static const isc_statscounter_t udp4statsindex[] = {
 	isc_sockstatscounter_udp4open,
@@ -697,7 +747,11 @@ static const isc_statscounter_t udp4statsindex[] = {
 	-1,
 	isc_sockstatscounter_udp4sendfail,
 	isc_sockstatscounter_udp4recvfail,
-	isc_sockstatscounter_udp4active
+	isc_sockstatscounter_udp4active,
+	isc_sockstatscounter_udp4recvbatch,
+	isc_sockstatscounter_udp4recvbatchmsg,
+	isc_sockstatscounter_udp4sendbatch,
+	isc_sockstatscounter_udp4sendbatchmsg
 };
 static const isc_statscounter_t udp6statsindex[] = {
 	isc_sockstatscounter_udp6open,
@@ -710,7 +764,11 @@ static const isc_statscounter_t udp6statsindex[] = {
 	-1,
 	isc_sockstatscounter_udp6sendfail,
 	isc_sockstatscounter_udp6recvfail,
-	isc_sockstatscounter_udp6active
+	isc_sockstatscounter_udp6active,
+	isc_sockstatscounter_udp6recvbatch,
+	isc_sockstatscounter_udp6recvbatchmsg,
+	isc_sockstatscounter_udp6sendbatch,
+	isc_sockstatscounter_udp6sendbatchmsg
 };
 static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4open,
@@ -723,7 +781,11 @@ static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4accept,
 	isc_sockstatscounter_tcp4sendfail,
 	isc_sockstatscounter_tcp4recvfail,
-	isc_sockstatscounter_tcp4active
+	isc_sockstatscounter_tcp4active,
+	-1,
+	-1,
+	-1,
+	-1
 };
 static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6open,
@@ -736,7 +798,11 @@ static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6accept,
 	isc_sockstatscounter_tcp6sendfail,
 	isc_sockstatscounter_tcp6recvfail,
-	isc_sockstatscounter_tcp6active
+	isc_sockstatscounter_tcp6active,
+	-1,
+	-1,
+	-1,
+	-1
 };
 static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixopen,
@@ -749,7 +815,11 @@ static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixaccept,
 	isc_sockstatscounter_unixsendfail,
 	isc_sockstatscounter_unixrecvfail,
-	isc_sockstatscounter_unixactive
+	isc_sockstatscounter_unixactive,
+	-1,
+	-1,
+	-1,
+	-1
 };
 static const isc_statscounter_t fdwatchstatsindex[] = {
 	-1,
@@ -762,6 +832,10 @@ static const isc_statscounter_t fdwatchstatsindex[] = {
 	-1,
 	isc_sockstatscounter_fdwatchsendfail,
 	isc_sockstatscounter_fdwatchrecvfail,
+	-1,
+	-1,
+	-1,
+	-1,
 	-1
 };
 static const isc_statscounter_t rawstatsindex[] = {
@@ -775,7 +849,11 @@ static const isc_statscounter_t rawstatsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_rawrecvfail,
-	isc_sockstatscounter_rawactive
+	isc_sockstatscounter_rawactive,
+	-1,
+	-1,
+	-1,
+	-1
 };
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
@@ -894,7 +972,7 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 }
 
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -907,11 +985,12 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
 #elif defined(USE_EPOLL)
+	isc__socketmgr_t *manager = thread->manager;
 	struct epoll_event event;
 	uint32_t oldevents;
 	int ret;
@@ -928,7 +1007,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -939,6 +1018,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 
 	return (result);
 #elif defined(USE_DEVPOLL)
+	isc__socketmgr_t *manager = thread->manager;
 	struct pollfd pfd;
 	int lockid = FDLOCK_ID(fd);
 
@@ -950,7 +1030,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	pfd.fd = fd;
 	pfd.revents = 0;
 	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -962,11 +1042,13 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 
 	return (result);
 #elif defined(USE_SELECT)
+	isc__socketmgr_t *manager = thread->manager;
+
 	LOCK(&manager->lock);
 	if (msg == SELECT_POKE_READ)
-		FD_SET(fd, manager->read_fds);
+		FD_SET(fd, thread->read_fds);
 	if (msg == SELECT_POKE_WRITE)
-		FD_SET(fd, manager->write_fds);
+		FD_SET(fd, thread->write_fds);
 	UNLOCK(&manager->lock);
 
 	return (result);
@@ -974,7 +1056,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -987,11 +1069,12 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
 #elif defined(USE_EPOLL)
+	isc__socketmgr_t *manager = thread->manager;
 	struct epoll_event event;
 	int ret;
 	int op;
@@ -1006,7 +1089,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1016,6 +1099,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	}
 	return (result);
 #elif defined(USE_DEVPOLL)
+	isc__socketmgr_t *manager = thread->manager;
 	struct pollfd pfds[2];
 	size_t writelen = sizeof(pfds[0]);
 	int lockid = FDLOCK_ID(fd);
@@ -1043,7 +1127,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -1055,11 +1139,13 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 
 	return (result);
 #elif defined(USE_SELECT)
+	isc__socketmgr_t *manager = thread->manager;
+
 	LOCK(&manager->lock);
 	if (msg == SELECT_POKE_READ)
-		FD_CLR(fd, manager->read_fds);
+		FD_CLR(fd, thread->read_fds);
 	else if (msg == SELECT_POKE_WRITE)
-		FD_CLR(fd, manager->write_fds);
+		FD_CLR(fd, thread->write_fds);
 	UNLOCK(&manager->lock);
 
 	return (result);
@@ -1068,6 +1154,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 
 static void
 wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+	isc__socketthread_t *thread = FDTHREAD(manager, fd);
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -1083,8 +1170,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		/* No one should be updating fdstate, so no need to lock it */
 		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
 		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
@@ -1101,8 +1188,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 	if (manager->fdstate[fd] != MANAGED) {
@@ -1114,7 +1201,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1130,12 +1217,12 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 
 #ifdef USE_WATCHER_THREAD
 /*
- * Poke the select loop when there is something for us to do.
+ * Poke a watcher's select loop when there is something for it to do.
  * The write is required (by POSIX) to complete.  That is, we
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+select_poke_thread(isc__socketthread_t *thread, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1144,7 +1231,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1170,16 +1257,33 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	INSIST(cc == sizeof(buf));
 }
 
+/*
+ * Poke the watcher responsible for 'fd'.  A shutdown request is sent
+ * to every watcher.
+ */
+static void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	int i;
+
+	if (msg == SELECT_POKE_SHUTDOWN) {
+		for (i = 0; i < mgr->nthreads; i++)
+			select_poke_thread(&mgr->threads[i], fd, msg);
+		return;
+	}
+
+	select_poke_thread(FDTHREAD(mgr, fd), fd, msg);
+}
+
 /*
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1854,11 +1958,8 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	int cc;
 	struct iovec iov[MAXSCATTERGATHER_RECV];
 	size_t read_count;
-	size_t actual_count;
 	struct msghdr msghdr;
-	isc_buffer_t *buffer;
 	int recv_errno;
-	char strbuf[ISC_STRERRORSIZE];
 
 	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
 
@@ -1873,18 +1974,33 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	dump_msg(&msghdr);
 #endif
 
-	if (cc < 0) {
-		if (SOFT_ERROR(recv_errno))
-			return (DOIO_SOFT);
+	if (cc < 0)
+		return (doio_recvfail(sock, dev, cc, recv_errno));
 
-		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
-			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
-			socket_log(sock, NULL, IOEVENT,
-				   isc_msgcat, ISC_MSGSET_SOCKET,
-				   ISC_MSG_DOIORECV,
-				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
-				   sock->fd, cc, recv_errno, strbuf);
-		}
+	return (doio_recvdone(sock, dev, &msghdr, cc, read_count));
+}
+
+/*
+ * Classify a failed receive into 'dev'.  Return values are those of
+ * doio_recv().
+ */
+static int
+doio_recvfail(isc__socket_t *sock, isc_socketevent_t *dev, int cc,
+	      int recv_errno)
+{
+	char strbuf[ISC_STRERRORSIZE];
+
+	if (SOFT_ERROR(recv_errno))
+		return (DOIO_SOFT);
+
+	if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+		isc__strerror(recv_errno, strbuf, sizeof(strbuf));
+		socket_log(sock, NULL, IOEVENT,
+			   isc_msgcat, ISC_MSGSET_SOCKET,
+			   ISC_MSG_DOIORECV,
+			   "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
+			   sock->fd, cc, recv_errno, strbuf);
+	}
 
 #define SOFT_OR_HARD(_system, _isc) \
 	if (recv_errno == _system) { \
@@ -1904,34 +2020,45 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 		return (DOIO_HARD); \
 	}
 
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
-		/* HPUX 11.11 can return EADDRNOTAVAIL. */
-		SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		/* Should never get this one but it was seen. */
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
+	/* HPUX 11.11 can return EADDRNOTAVAIL. */
+	SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	/* Should never get this one but it was seen. */
 #ifdef ENOPROTOOPT
-		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
 #endif
-		/*
-		 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
-		 * errors.
-		 */
+	/*
+	 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
+	 * errors.
+	 */
 #ifdef EPROTO
-		SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
 #endif
-		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
 
 #undef SOFT_OR_HARD
 #undef ALWAYS_HARD
 
-		dev->result = isc__errno2result(recv_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_RECVFAIL]);
-		return (DOIO_HARD);
-	}
+	dev->result = isc__errno2result(recv_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_RECVFAIL]);
+	return (DOIO_HARD);
+}
+
+/*
+ * Finish a receive of 'cc' bytes into 'dev' using 'msghdr', as set
+ * up by build_msghdr_recv().  Return values are those of doio_recv().
+ */
+static int
+doio_recvdone(isc__socket_t *sock, isc_socketevent_t *dev,
+	      struct msghdr *msghdr, int cc, size_t read_count)
+{
+	size_t actual_count;
+	isc_buffer_t *buffer;
 
 	/*
 	 * On TCP and UNIX sockets, zero length reads indicate EOF,
@@ -1953,7 +2080,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -1991,7 +2118,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * If there are control messages attached, run through them and pull
 	 * out the interesting bits.
 	 */
-	process_cmsg(sock, &msghdr, dev);
+	process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -2031,6 +2158,79 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+#ifdef USE_RECVMMSG
+/*
+ * Receive datagrams for up to MAXBATCH_UDP of the done events at the
+ * head of a UDP socket's receive queue with a single recvmmsg() call.
+ * Completed events are posted; an event whose datagram was dropped
+ * stays on the queue.
+ *
+ * Returns:
+ *	DOIO_SUCCESS	Every event in the batch was given a datagram, so
+ *			more may be waiting.
+ *
+ *	DOIO_SOFT	The socket has been drained, or a soft I/O error
+ *			was encountered.
+ *
+ *	DOIO_HARD	A hard I/O error was encountered; the event at the
+ *			head of the queue has been posted with the error.
+ */
+static int
+doio_recvmmsg(isc__socket_t *sock) {
+	isc_socketevent_t *devs[MAXBATCH_UDP];
+	struct mmsghdr msgs[MAXBATCH_UDP];
+	struct iovec iov[MAXBATCH_UDP][MAXSCATTERGATHER_RECV];
+	size_t read_count[MAXBATCH_UDP];
+	union {
+		struct cmsghdr hdr;
+		char buf[BATCH_CMSGSPACE];
+	} cmsg[MAXBATCH_UDP];
+	isc_socketevent_t *dev;
+	int cc, i, n;
+	int recv_errno;
+	int result;
+
+	INSIST(sock->type == isc_sockettype_udp);
+	INSIST(sock->recvcmsgbuflen <= sizeof(cmsg[0].buf));
+
+	n = 0;
+	for (dev = ISC_LIST_HEAD(sock->recv_list);
+	     dev != NULL && n < MAXBATCH_UDP;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		build_msghdr_recv(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  &read_count[n]);
+		if (msgs[n].msg_hdr.msg_control != NULL)
+			msgs[n].msg_hdr.msg_control = cmsg[n].buf;
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	cc = recvmmsg(sock->fd, msgs, n, 0, NULL);
+	recv_errno = errno;
+
+	if (cc < 0) {
+		dev = devs[0];
+		result = doio_recvfail(sock, dev, cc, recv_errno);
+		if (result == DOIO_HARD)
+			send_recvdone_event(sock, &dev);
+		return (result);
+	}
+
+	inc_stats(sock->manager->stats, sock->statsindex[STATID_RECVBATCH]);
+	for (i = 0; i < cc; i++) {
+		inc_stats(sock->manager->stats,
+			  sock->statsindex[STATID_RECVBATCHMSG]);
+		if (doio_recvdone(sock, devs[i], &msgs[i].msg_hdr,
+				  (int)msgs[i].msg_len,
+				  read_count[i]) == DOIO_SUCCESS)
+			send_recvdone_event(sock, &devs[i]);
+	}
+
+	return ((cc < n) ? DOIO_SOFT : DOIO_SUCCESS);
+}
+#endif /* USE_RECVMMSG */
+
 /*
  * Returns:
  *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
@@ -2157,6 +2357,79 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+#ifdef USE_SENDMMSG
+/*
+ * Send the datagrams for up to MAXBATCH_UDP of the done events at the
+ * head of a UDP socket's send queue with a single sendmmsg() call, and
+ * post the events that were sent.
+ *
+ * Returns the number of datagrams sent.  Zero means nothing was sent
+ * and the event at the head of the queue should be handed to
+ * doio_send(), which will retry it and deal with any error.
+ */
+static int
+doio_sendmmsg(isc__socket_t *sock) {
+	isc_socketevent_t *devs[MAXBATCH_UDP];
+	struct mmsghdr msgs[MAXBATCH_UDP];
+	struct iovec iov[MAXBATCH_UDP][MAXSCATTERGATHER_SEND];
+	size_t write_count[MAXBATCH_UDP];
+	union {
+		struct cmsghdr hdr;
+		char buf[BATCH_CMSGSPACE];
+	} cmsg[MAXBATCH_UDP];
+	isc_socketevent_t *dev;
+	int cc, i, n;
+
+	INSIST(sock->type == isc_sockettype_udp);
+	INSIST(sock->sendcmsgbuflen <= sizeof(cmsg[0].buf));
+
+	n = 0;
+	for (dev = ISC_LIST_HEAD(sock->send_list);
+	     dev != NULL && n < MAXBATCH_UDP;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		/*
+		 * Without per packet DSCP, build_msghdr_send() applies
+		 * the DSCP value to the socket itself, which would affect
+		 * every datagram in the batch.
+		 */
+		if ((dev->attributes & ISC_SOCKEVENTATTR_DSCP) != 0 &&
+		    !sock->pktdscp)
+			break;
+
+		build_msghdr_send(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  &write_count[n]);
+		if (msgs[n].msg_hdr.msg_controllen != 0U) {
+			memmove(cmsg[n].buf, msgs[n].msg_hdr.msg_control,
+				msgs[n].msg_hdr.msg_controllen);
+			msgs[n].msg_hdr.msg_control = cmsg[n].buf;
+		}
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	if (n == 0)
+		return (0);
+
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	if (cc <= 0)
+		return (0);
+
+	inc_stats(sock->manager->stats, sock->statsindex[STATID_SENDBATCH]);
+	for (i = 0; i < cc; i++) {
+		inc_stats(sock->manager->stats,
+			  sock->statsindex[STATID_SENDBATCHMSG]);
+		devs[i]->n += msgs[i].msg_len;
+		if (msgs[i].msg_len != write_count[i])
+			continue;
+		devs[i]->result = ISC_R_SUCCESS;
+		send_senddone_event(sock, &devs[i]);
+	}
+
+	return (cc);
+}
+#endif /* USE_SENDMMSG */
+
 /*
  * Kill.
  *
@@ -2165,6 +2438,7 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
  */
 static void
 socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
+	isc__socketthread_t *thread = FDTHREAD(manager, fd);
 	isc_sockettype_t type = sock->type;
 	int lockid = FDLOCK_ID(fd);
 
@@ -2189,8 +2463,8 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 	} else
 		select_poke(manager, fd, SELECT_POKE_CLOSE);
 
@@ -2201,29 +2475,31 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 	}
 
 	/*
-	 * update manager->maxfd here (XXX: this should be implemented more
+	 * update thread->maxfd here (XXX: this should be implemented more
 	 * efficiently)
 	 */
 #ifdef USE_SELECT
 	LOCK(&manager->lock);
-	if (manager->maxfd == fd) {
+	if (thread->maxfd == fd) {
 		int i;
 
-		manager->maxfd = 0;
+		thread->maxfd = 0;
 		for (i = fd - 1; i >= 0; i--) {
+			if (FDTHREAD(manager, i) != thread)
+				continue;
 			lockid = FDLOCK_ID(i);
 
 			LOCK(&manager->fdlock[lockid]);
 			if (manager->fdstate[i] == MANAGED) {
-				manager->maxfd = i;
+				thread->maxfd = i;
 				UNLOCK(&manager->fdlock[lockid]);
 				break;
 			}
 			UNLOCK(&manager->fdlock[lockid]);
 		}
 #ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (thread->maxfd < thread->pipe_fds[0])
+			thread->maxfd = thread->pipe_fds[0];
 #endif
 	}
 
@@ -3025,8 +3301,8 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 	LOCK(&manager->lock);
 	ISC_LIST_APPEND(manager->socklist, sock, link);
 #ifdef USE_SELECT
-	if (manager->maxfd < sock->fd)
-		manager->maxfd = sock->fd;
+	if (FDTHREAD(manager, sock->fd)->maxfd < sock->fd)
+		FDTHREAD(manager, sock->fd)->maxfd = sock->fd;
 #endif
 	UNLOCK(&manager->lock);
 
@@ -3103,8 +3379,8 @@ isc__socket_open(isc_socket_t *sock0) {
 
 #ifdef USE_SELECT
 		LOCK(&sock->manager->lock);
-		if (sock->manager->maxfd < sock->fd)
-			sock->manager->maxfd = sock->fd;
+		if (FDTHREAD(sock->manager, sock->fd)->maxfd < sock->fd)
+			FDTHREAD(sock->manager, sock->fd)->maxfd = sock->fd;
 		UNLOCK(&sock->manager->lock);
 #endif
 	}
@@ -3166,8 +3442,8 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 	LOCK(&manager->lock);
 	ISC_LIST_APPEND(manager->socklist, sock, link);
 #ifdef USE_SELECT
-	if (manager->maxfd < sock->fd)
-		manager->maxfd = sock->fd;
+	if (FDTHREAD(manager, sock->fd)->maxfd < sock->fd)
+		FDTHREAD(manager, sock->fd)->maxfd = sock->fd;
 #endif
 	UNLOCK(&manager->lock);
 
@@ -3732,8 +4008,8 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 		LOCK(&manager->lock);
 
 #ifdef USE_SELECT
-		if (manager->maxfd < fd)
-			manager->maxfd = fd;
+		if (FDTHREAD(manager, fd)->maxfd < fd)
+			FDTHREAD(manager, fd)->maxfd = fd;
 #endif
 
 		socket_log(sock, &NEWCONNSOCK(dev)->peer_address, CREATION,
@@ -3803,6 +4079,20 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->recv_list);
 	while (dev != NULL) {
+#ifdef USE_RECVMMSG
+		/*
+		 * With more than one receive queued on a UDP socket, fill
+		 * as many of them as possible with one system call.
+		 */
+		if (sock->type == isc_sockettype_udp &&
+		    ISC_LIST_NEXT(dev, ev_link) != NULL)
+		{
+			if (doio_recvmmsg(sock) == DOIO_SOFT)
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->recv_list);
+			continue;
+		}
+#endif
 		switch (doio_recv(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3871,6 +4161,20 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
 	while (dev != NULL) {
+#ifdef USE_SENDMMSG
+		/*
+		 * Flush queued UDP responses with one system call.  The
+		 * 'maxudp' simulation is only implemented by doio_send().
+		 */
+		if (sock->type == isc_sockettype_udp &&
+		    sock->manager->maxudp == 0 &&
+		    ISC_LIST_NEXT(dev, ev_link) != NULL &&
+		    doio_sendmmsg(sock) != 0)
+		{
+			dev = ISC_LIST_HEAD(sock->send_list);
+			continue;
+		}
+#endif
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3978,9 +4282,10 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
+process_fd(isc__socketthread_t *thread, int fd, isc_boolean_t readable,
 	   isc_boolean_t writeable)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	isc__socket_t *sock;
 	isc_boolean_t unlock_sock;
 	isc_boolean_t unwatch_read = ISC_FALSE, unwatch_write = ISC_FALSE;
@@ -3993,8 +4298,8 @@ process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
 	if (manager->fdstate[fd] == CLOSE_PENDING) {
 		UNLOCK(&manager->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
@@ -4039,15 +4344,16 @@ check_write:
  unlock_fd:
 	UNLOCK(&manager->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t readable, writable;
 	isc_boolean_t done = ISC_FALSE;
@@ -4055,7 +4361,7 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
@@ -4070,34 +4376,37 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
+		thread->fdevents++;
 		readable = ISC_TF(events[i].filter == EVFILT_READ);
 		writable = ISC_TF(events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4107,11 +4416,12 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
+		thread->fdevents++;
 		if ((events[i].events & EPOLLERR) != 0 ||
 		    (events[i].events & EPOLLHUP) != 0) {
 			/*
@@ -4124,28 +4434,29 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			int fd = events[i].data.fd;
 			events[i].events |= manager->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4155,38 +4466,41 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		thread->fdevents++;
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
 	int i;
 
-	REQUIRE(maxfd <= (int)manager->maxsocks);
+	REQUIRE(maxfd <= (int)thread->manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		if (FD_ISSET(i, readfds) || FD_ISSET(i, writefds))
+			thread->fdevents++;
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -4194,11 +4508,12 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static isc_boolean_t
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
 		manager_log(manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
@@ -4242,7 +4557,8 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
+	isc__socketmgr_t *manager = thread->manager;
 	isc_boolean_t done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4268,34 +4584,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = ISC_FALSE;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4305,7 +4621,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4313,23 +4629,23 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
 #elif defined(USE_SELECT)
 			LOCK(&manager->lock);
-			memmove(manager->read_fds_copy, manager->read_fds,
+			memmove(thread->read_fds_copy, thread->read_fds,
 				manager->fd_bufsize);
-			memmove(manager->write_fds_copy, manager->write_fds,
+			memmove(thread->write_fds_copy, thread->write_fds,
 				manager->fd_bufsize);
-			maxfd = manager->maxfd + 1;
+			maxfd = thread->maxfd + 1;
 			UNLOCK(&manager->lock);
 
-			cc = select(maxfd, manager->read_fds_copy,
-				    manager->write_fds_copy, NULL, NULL);
+			cc = select(maxfd, thread->read_fds_copy,
+				    thread->write_fds_copy, NULL, NULL);
 #endif	/* USE_KQUEUE */
 
 			if (cc < 0 && !SOFT_ERROR(errno)) {
@@ -4369,17 +4685,19 @@ watcher(void *uap) {
 #endif
 		} while (cc < 0);
 
+		thread->wakeups++;
+
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
-			    manager->write_fds_copy);
+		process_fds(thread, maxfd, thread->read_fds_copy,
+			    thread->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
-		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+		if (FD_ISSET(ctlfd, thread->read_fds_copy))
+			done = process_ctlfd(thread);
 #endif
 	}
 
@@ -4400,6 +4718,42 @@ isc__socketmgr_setreserved(isc_socketmgr_t *manager0, isc_uint32_t reserved) {
 	manager->reserved = reserved;
 }
 
+isc_result_t
+isc_socketmgr_setcpus(isc_socketmgr_t *manager0, const isc_uint32_t *cpus,
+		      unsigned int ncpus)
+{
+	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc_result_t result = ISC_R_SUCCESS;
+#ifdef USE_WATCHER_THREAD
+	isc__socketthread_t *thread;
+	int i, cpu;
+#endif /* USE_WATCHER_THREAD */
+
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(cpus != NULL || ncpus == 0);
+
+#ifdef USE_WATCHER_THREAD
+	LOCK(&manager->lock);
+	for (i = 0; i < manager->nthreads; i++) {
+		thread = &manager->threads[i];
+		cpu = (ncpus == 0) ? -1 : (int)cpus[i % ncpus];
+		if (thread->cpu == cpu)
+			continue;
+		result = isc_thread_setaffinity(thread->thread, cpu);
+		if (result != ISC_R_SUCCESS)
+			break;
+		thread->cpu = cpu;
+	}
+	UNLOCK(&manager->lock);
+#else
+	UNUSED(cpus);
+	if (ncpus != 0)
+		result = ISC_R_NOTIMPLEMENTED;
+#endif /* USE_WATCHER_THREAD */
+
+	return (result);
+}
+
 void
 isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
@@ -4414,20 +4768,47 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
 	isc_result_t result;
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
+    defined(USE_WATCHER_THREAD)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
+#ifdef USE_SELECT
+	isc__socketmgr_t *manager = thread->manager;
+#endif
+
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		return (ISC_R_UNEXPECTED);
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4435,28 +4816,30 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
+	}
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4464,44 +4847,34 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		return (ISC_R_NOMEMORY);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
 	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4509,87 +4882,77 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		goto close_pipe;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_SELECT)
-	UNUSED(result);
-
-#if ISC_SOCKET_MAXSOCKETS > FD_SETSIZE
-	/*
-	 * Note: this code should also cover the case of MAXSOCKETS <=
-	 * FD_SETSIZE, but we separate the cases to avoid possible portability
-	 * issues regarding howmany() and the actual representation of fd_set.
-	 */
-	manager->fd_bufsize = howmany(manager->maxsocks, NFDBITS) *
-		sizeof(fd_mask);
-#else
-	manager->fd_bufsize = sizeof(fd_set);
-#endif
-
-	manager->read_fds = NULL;
-	manager->read_fds_copy = NULL;
-	manager->write_fds = NULL;
-	manager->write_fds_copy = NULL;
-
-	manager->read_fds = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->read_fds != NULL)
-		manager->read_fds_copy = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->read_fds_copy != NULL)
-		manager->write_fds = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->write_fds != NULL) {
-		manager->write_fds_copy = isc_mem_get(mctx,
-						      manager->fd_bufsize);
-	}
-	if (manager->write_fds_copy == NULL) {
-		if (manager->write_fds != NULL) {
-			isc_mem_put(mctx, manager->write_fds,
+	thread->read_fds = NULL;
+	thread->read_fds_copy = NULL;
+	thread->write_fds = NULL;
+	thread->write_fds_copy = NULL;
+
+	thread->read_fds = isc_mem_get(mctx, manager->fd_bufsize);
+	if (thread->read_fds != NULL)
+		thread->read_fds_copy = isc_mem_get(mctx, manager->fd_bufsize);
+	if (thread->read_fds_copy != NULL)
+		thread->write_fds = isc_mem_get(mctx, manager->fd_bufsize);
+	if (thread->write_fds != NULL) {
+		thread->write_fds_copy = isc_mem_get(mctx,
+						     manager->fd_bufsize);
+	}
+	if (thread->write_fds_copy == NULL) {
+		if (thread->write_fds != NULL) {
+			isc_mem_put(mctx, thread->write_fds,
 				    manager->fd_bufsize);
 		}
-		if (manager->read_fds_copy != NULL) {
-			isc_mem_put(mctx, manager->read_fds_copy,
+		if (thread->read_fds_copy != NULL) {
+			isc_mem_put(mctx, thread->read_fds_copy,
 				    manager->fd_bufsize);
 		}
-		if (manager->read_fds != NULL) {
-			isc_mem_put(mctx, manager->read_fds,
+		if (thread->read_fds != NULL) {
+			isc_mem_put(mctx, thread->read_fds,
 				    manager->fd_bufsize);
 		}
-		return (ISC_R_NOMEMORY);
+		result = ISC_R_NOMEMORY;
+		goto close_pipe;
 	}
-	memset(manager->read_fds, 0, manager->fd_bufsize);
-	memset(manager->write_fds, 0, manager->fd_bufsize);
+	memset(thread->read_fds, 0, manager->fd_bufsize);
+	memset(thread->write_fds, 0, manager->fd_bufsize);
 
 #ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	thread->maxfd = thread->pipe_fds[0];
 #else /* USE_WATCHER_THREAD */
-	manager->maxfd = 0;
+	thread->maxfd = 0;
 #endif /* USE_WATCHER_THREAD */
 #endif	/* USE_KQUEUE */
 
 	return (ISC_R_SUCCESS);
+
+ close_pipe:
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+	return (result);
 }
 
 static void
-cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+cleanup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
 #ifdef USE_WATCHER_THREAD
 	isc_result_t result;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "epoll_ctl(DEL) %s",
@@ -4599,44 +4962,58 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
 #elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
 #elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
-	isc_mem_put(mctx, manager->fdpollinfo,
-		    sizeof(pollinfo_t) * manager->maxsocks);
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
 #elif defined(USE_SELECT)
-	if (manager->read_fds != NULL)
-		isc_mem_put(mctx, manager->read_fds, manager->fd_bufsize);
-	if (manager->read_fds_copy != NULL)
-		isc_mem_put(mctx, manager->read_fds_copy, manager->fd_bufsize);
-	if (manager->write_fds != NULL)
-		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
-	if (manager->write_fds_copy != NULL)
-		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
+	if (thread->read_fds != NULL)
+		isc_mem_put(mctx, thread->read_fds,
+			    thread->manager->fd_bufsize);
+	if (thread->read_fds_copy != NULL)
+		isc_mem_put(mctx, thread->read_fds_copy,
+			    thread->manager->fd_bufsize);
+	if (thread->write_fds != NULL)
+		isc_mem_put(mctx, thread->write_fds,
+			    thread->manager->fd_bufsize);
+	if (thread->write_fds_copy != NULL)
+		isc_mem_put(mctx, thread->write_fds_copy,
+			    thread->manager->fd_bufsize);
 #endif	/* USE_KQUEUE */
+
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
 }
 
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create3(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
+{
+	return (isc__socketmgr_create3(mctx, managerp, maxsocks, 1));
+}
+
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
 #ifdef USE_WATCHER_THREAD
-	char strbuf[ISC_STRERRORSIZE];
+	char name[32];
 #endif
 	isc_result_t result;
 
@@ -4656,6 +5033,13 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
+#ifdef USE_WATCHER_THREAD
+	if (nthreads < 1)
+		nthreads = 1;
+#else
+	/* Without threads, the single watcher is run by the application. */
+	nthreads = 1;
+#endif
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
@@ -4685,7 +5069,39 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		goto free_manager;
 	}
 	memset(manager->epoll_events, 0, manager->maxsocks * sizeof(uint32_t));
+#elif defined(USE_DEVPOLL)
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
+	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
+#if ISC_SOCKET_MAXSOCKETS > FD_SETSIZE
+	/*
+	 * Note: this code should also cover the case of MAXSOCKETS <=
+	 * FD_SETSIZE, but we separate the cases to avoid possible portability
+	 * issues regarding howmany() and the actual representation of fd_set.
+	 */
+	manager->fd_bufsize = howmany(manager->maxsocks, NFDBITS) *
+		sizeof(fd_mask);
+#else
+	manager->fd_bufsize = sizeof(fd_set);
 #endif
+#endif
+	manager->threads = isc_mem_get(mctx,
+				       nthreads * sizeof(isc__socketthread_t));
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
+	memset(manager->threads, 0, nthreads * sizeof(isc__socketthread_t));
+	manager->nthreads = nthreads;
 	manager->stats = NULL;
 
 	manager->common.methods = &socketmgrmethods;
@@ -4723,56 +5139,48 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 #endif /* USE_SHARED_MANAGER */
 
+	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
+
 	/*
-	 * Set up initial state for the select loop
+	 * Set up initial state for the select loops, then start up the
+	 * select/poll threads.  'i' counts the watchers that need to be
+	 * cleaned up on failure.
 	 */
-	result = setup_watcher(mctx, manager);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+	for (i = 0; i < nthreads; i++) {
+		isc__socketthread_t *thread = &manager->threads[i];
 
-	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
+		thread->manager = manager;
+		thread->threadid = i;
+		result = setup_watcher(mctx, thread);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
 
 #ifdef USE_WATCHER_THREAD
-	/*
-	 * Start up the select/poll thread.
-	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (i = 0; i < nthreads; i++) {
+		isc__socketthread_t *thread = &manager->threads[i];
+
+		if (isc_thread_create(watcher, thread, &thread->thread) !=
+		    ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			result = ISC_R_UNEXPECTED;
+			goto cleanup_threads;
+		}
+		snprintf(name, sizeof(name), "isc-socket-%d", i);
+		isc_thread_setname(thread->thread, name);
+		thread->cpu = -1;
 	}
-	isc_thread_setname(manager->watcher, "isc-socket");
 #endif /* USE_WATCHER_THREAD */
 	isc_mem_attach(mctx, &manager->mctx);
 
@@ -4783,14 +5191,30 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	return (ISC_R_SUCCESS);
 
-cleanup:
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
+cleanup_threads:
+	{
+		int j;
+
+		/*
+		 * Stop the watchers that were already started; the
+		 * shutdown message is only sent to the running ones.
+		 */
+		for (j = 0; j < i; j++) {
+			select_poke_thread(&manager->threads[j], 0,
+					   SELECT_POKE_SHUTDOWN);
+			(void)isc_thread_join(manager->threads[j].thread,
+					      NULL);
+		}
+	}
+	i = nthreads;
+#endif /* USE_WATCHER_THREAD */
+
+cleanup:
+	while (--i >= 0)
+		cleanup_watcher(mctx, &manager->threads[i]);
 
 #ifdef USE_WATCHER_THREAD
-cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif	/* USE_WATCHER_THREAD */
 
@@ -4807,11 +5231,20 @@ free_manager:
 		isc_mem_put(mctx, manager->fdlock,
 			    FDLOCK_COUNT * sizeof(isc_mutex_t));
 	}
+	if (manager->threads != NULL) {
+		isc_mem_put(mctx, manager->threads,
+			    manager->nthreads * sizeof(isc__socketthread_t));
+	}
 #if defined(USE_EPOLL)
 	if (manager->epoll_events != NULL) {
 		isc_mem_put(mctx, manager->epoll_events,
 			    manager->maxsocks * sizeof(uint32_t));
 	}
+#elif defined(USE_DEVPOLL)
+	if (manager->fdpollinfo != NULL) {
+		isc_mem_put(mctx, manager->fdpollinfo,
+			    sizeof(pollinfo_t) * manager->maxsocks);
+	}
 #endif
 	if (manager->fdstate != NULL) {
 		isc_mem_put(mctx, manager->fdstate,
@@ -4894,7 +5327,7 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	UNLOCK(&manager->lock);
 
 	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
+	 * Here, poke our select/poll threads.  Do this by closing the write
 	 * half of the pipe, which will send EOF to the read half.
 	 * This is currently a no-op in the non-threaded case.
 	 */
@@ -4902,23 +5335,27 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Wait for the threads to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread,
+				    NULL) != ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+	}
 #endif /* USE_WATCHER_THREAD */
 
 	/*
 	 * Clean up.
 	 */
-	cleanup_watcher(manager->mctx, manager);
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_watcher(manager->mctx, &manager->threads[i]);
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
@@ -4929,7 +5366,12 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 #if defined(USE_EPOLL)
 	isc_mem_put(manager->mctx, manager->epoll_events,
 		    manager->maxsocks * sizeof(uint32_t));
+#elif defined(USE_DEVPOLL)
+	isc_mem_put(manager->mctx, manager->fdpollinfo,
+		    sizeof(pollinfo_t) * manager->maxsocks);
 #endif
+	isc_mem_put(manager->mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
 	isc_mem_put(manager->mctx, manager->fds,
 		    manager->maxsocks * sizeof(isc__socket_t *));
 	isc_mem_put(manager->mctx, manager->fdstate,
@@ -5577,6 +6019,27 @@ isc__socket_bind(isc_socket_t *sock0, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT,
+			       (void *)&on, sizeof(on)) < 0) {
+			isc__strerror(errno, strbuf, sizeof(strbuf));
+			UNLOCK(&sock->lock);
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "setsockopt(%d, SO_REUSEPORT) %s: %s",
+					 sock->fd,
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"),
+					 strbuf);
+			return (ISC_R_UNEXPECTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -6388,6 +6851,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			  isc_socketwait_t **swaitp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	int n;
 #ifdef USE_KQUEUE
 	struct timespec ts, *tsp;
@@ -6409,6 +6873,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 #endif
 	if (manager == NULL)
 		return (0);
+	thread = &manager->threads[0];
 
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
@@ -6417,8 +6882,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -6426,32 +6891,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -6459,21 +6924,21 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
 	swait_private.nevents = n;
 #elif defined(USE_SELECT)
-	memmove(manager->read_fds_copy, manager->read_fds, manager->fd_bufsize);
-	memmove(manager->write_fds_copy, manager->write_fds,
+	memmove(thread->read_fds_copy, thread->read_fds, manager->fd_bufsize);
+	memmove(thread->write_fds_copy, thread->write_fds,
 		manager->fd_bufsize);
 
-	swait_private.readset = manager->read_fds_copy;
-	swait_private.writeset = manager->write_fds_copy;
-	swait_private.maxfd = manager->maxfd + 1;
+	swait_private.readset = thread->read_fds_copy;
+	swait_private.writeset = thread->write_fds_copy;
+	swait_private.maxfd = thread->maxfd + 1;
 
 	n = select(swait_private.maxfd, swait_private.readset,
 		   swait_private.writeset, NULL, tvp);
@@ -6497,10 +6962,12 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 		return (ISC_R_NOTFOUND);
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(&manager->threads[0], manager->threads[0].events,
+			  swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(&manager->threads[0], swait->maxfd, swait->readset,
+		    swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
@@ -6564,6 +7031,24 @@ _socktype(isc_sockettype_t type)
 	else
 		return ("not-initialized");
 }
+
+/*
+ * Count the sockets watched by 'thread'.  Caller must hold the manager lock.
+ */
+static unsigned int
+_watchersockets(isc__socketmgr_t *mgr, isc__socketthread_t *thread) {
+	isc__socket_t *sock;
+	unsigned int count = 0;
+
+	for (sock = ISC_LIST_HEAD(mgr->socklist);
+	     sock != NULL;
+	     sock = ISC_LIST_NEXT(sock, link))
+	{
+		if (sock->fd >= 0 && FDTHREAD(mgr, sock->fd) == thread)
+			count++;
+	}
+	return (count);
+}
 #endif
 
 #ifdef HAVE_LIBXML2
@@ -6576,6 +7061,7 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc_sockaddr_t addr;
 	ISC_SOCKADDR_LEN_T len;
 	int xmlrc;
+	int i;
 
 	LOCK(&mgr->lock);
 
@@ -6585,6 +7071,48 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer));
 #endif	/* USE_SHARED_MANAGER */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "watchers"));
+	for (i = 0; i < mgr->nthreads; i++) {
+		isc__socketthread_t *thread = &mgr->threads[i];
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "watcher"));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "id"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+						    thread->threadid));
+		TRY0(xmlTextWriterEndElement(writer));
+
+#ifdef USE_WATCHER_THREAD
+		if (thread->cpu >= 0) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "cpu"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+							    thread->cpu));
+			TRY0(xmlTextWriterEndElement(writer));
+		}
+#endif /* USE_WATCHER_THREAD */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "sockets"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+					_watchersockets(mgr, thread)));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "wakeups"));
+		TRY0(xmlTextWriterWriteFormatString(writer,
+					"%" ISC_PRINT_QUADFORMAT "u",
+					thread->wakeups));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "events"));
+		TRY0(xmlTextWriterWriteFormatString(writer,
+					"%" ISC_PRINT_QUADFORMAT "u",
+					thread->fdevents));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterEndElement(writer)); /* watcher */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* watchers */
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "sockets"));
 	sock = ISC_LIST_HEAD(mgr->socklist);
 	while (sock != NULL) {
@@ -6595,6 +7123,14 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 		TRY0(xmlTextWriterWriteFormatString(writer, "%p", sock));
 		TRY0(xmlTextWriterEndElement(writer));
 
+		if (sock->fd >= 0) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "watcher"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+					FDTHREAD(mgr, sock->fd)->threadid));
+			TRY0(xmlTextWriterEndElement(writer)); /* watcher */
+		}
+
 		if (sock->name[0] != 0) {
 			TRY0(xmlTextWriterStartElement(writer,
 						       ISC_XMLCHAR "name"));
@@ -6694,6 +7230,8 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	isc_sockaddr_t addr;
 	ISC_SOCKADDR_LEN_T len;
 	json_object *obj, *array = json_object_new_array();
+	json_object *watchers = NULL;
+	int i;
 
 	CHECKMEM(array);
 
@@ -6705,6 +7243,42 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	json_object_object_add(stats, "references", obj);
 #endif	/* USE_SHARED_MANAGER */
 
+	watchers = json_object_new_array();
+	CHECKMEM(watchers);
+	for (i = 0; i < mgr->nthreads; i++) {
+		isc__socketthread_t *thread = &mgr->threads[i];
+		json_object *entry = json_object_new_object();
+
+		CHECKMEM(entry);
+		json_object_array_add(watchers, entry);
+
+		obj = json_object_new_int(thread->threadid);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "id", obj);
+
+#ifdef USE_WATCHER_THREAD
+		if (thread->cpu >= 0) {
+			obj = json_object_new_int(thread->cpu);
+			CHECKMEM(obj);
+			json_object_object_add(entry, "cpu", obj);
+		}
+#endif /* USE_WATCHER_THREAD */
+
+		obj = json_object_new_int64(_watchersockets(mgr, thread));
+		CHECKMEM(obj);
+		json_object_object_add(entry, "sockets", obj);
+
+		obj = json_object_new_int64(thread->wakeups);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "wakeups", obj);
+
+		obj = json_object_new_int64(thread->fdevents);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "events", obj);
+	}
+	json_object_object_add(stats, "watchers", watchers);
+	watchers = NULL;
+
 	sock = ISC_LIST_HEAD(mgr->socklist);
 	while (sock != NULL) {
 		json_object *states, *entry = json_object_new_object();
@@ -6720,6 +7294,13 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 		CHECKMEM(obj);
 		json_object_object_add(entry, "id", obj);
 
+		if (sock->fd >= 0) {
+			obj = json_object_new_int(FDTHREAD(mgr,
+							   sock->fd)->threadid);
+			CHECKMEM(obj);
+			json_object_object_add(entry, "watcher", obj);
+		}
+
 		if (sock->name[0] != 0) {
 			obj = json_object_new_string(sock->name);
 			CHECKMEM(obj);
@@ -6805,6 +7386,9 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	result = ISC_R_SUCCESS;
 
  error:
+	if (watchers != NULL)
+		json_object_put(watchers);
+
 	if (array != NULL)
 		json_object_put(array);
 
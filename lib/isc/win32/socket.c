@@ -2655,6 +2655,19 @@ isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
 	return (isc_socketmgr_create2(mctx, managerp, 0));
 }
 
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads)
+{
+	/*
+	 * The completion port already spreads I/O over its own pool of
+	 * threads, so the number of watchers is not configurable here.
+	 */
+	UNUSED(nthreads);
+
+	return (isc__socketmgr_create2(mctx, managerp, maxsocks));
+}
+
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
@@ -3259,6 +3272,10 @@ isc__socket_bind(isc_socket_t *sock, const isc_sockaddr_t *sockaddr,
 		UNLOCK(&sock->lock);
 		return (ISC_R_FAMILYMISMATCH);
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	/*
 	 * Only set SO_REUSEADDR when we want a specific port.
 	 */
@@ -3974,6 +3991,16 @@ isc__socketmgr_setreserved(isc_socketmgr_t *manager, isc_uint32_t reserved) {
 	UNUSED(reserved);
 }
 
+isc_result_t
+isc_socketmgr_setcpus(isc_socketmgr_t *manager, const isc_uint32_t *cpus,
+		      unsigned int ncpus)
+{
+	UNUSED(manager);
+	UNUSED(cpus);
+
+	return (ncpus == 0 ? ISC_R_SUCCESS : ISC_R_NOTIMPLEMENTED);
+}
+
 void
 isc___socketmgr_maxudp(isc_socketmgr_t *manager, int maxudp) {
 
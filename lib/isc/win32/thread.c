@@ -63,6 +63,24 @@ isc_thread_setname(isc_thread_t thread, const char *name) {
 	UNUSED(name);
 }
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, int cpu) {
+	DWORD_PTR mask, sysmask;
+
+	if (cpu < 0) {
+		if (!GetProcessAffinityMask(GetCurrentProcess(),
+					    &mask, &sysmask))
+			return (ISC_R_FAILURE);
+	} else if (cpu >= (int)(sizeof(mask) * 8))
+		return (ISC_R_RANGE);
+	else
+		mask = (DWORD_PTR)1 << cpu;
+
+	if (SetThreadAffinityMask(thread, mask) == 0)
+		return (cpu < 0 ? ISC_R_FAILURE : ISC_R_RANGE);
+	return (ISC_R_SUCCESS);
+}
+
 void *
 isc_thread_key_getspecific(isc_thread_key_t key) {
 	return(TlsGetValue(key));
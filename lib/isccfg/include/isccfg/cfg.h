@@ -475,6 +475,7 @@ cfg_printx(const cfg_obj_t *obj, unsigned int flags,
 
 #define CFG_PRINTER_XKEY        0x1     /* '?' out shared keys. */
 #define CFG_PRINTER_ONELINE     0x2     /* print config as a single line */
+#define CFG_PRINTER_NOZONES     0x4     /* omit zones and views */
 
 /*%<
  * Print the configuration object 'obj' by repeatedly calling the
@@ -483,6 +484,10 @@ cfg_printx(const cfg_obj_t *obj, unsigned int flags,
  *
  * If CFG_PRINTER_XKEY the contents of shared keys will be obscured
  * by replacing them with question marks ('?')
+ *
+ * If CFG_PRINTER_NOZONES the "zone" and "view" statements of maps
+ * are left out, so that what is printed of a configuration or a view
+ * is the context its zones are configured in.
  */
 
 void
@@ -1938,6 +1938,10 @@ cfg_print_mapbody(cfg_printer_t *pctx, const cfg_obj_t *obj) {
 		for (clause = *clauseset;
 		     clause->name != NULL;
 		     clause++) {
+			if ((pctx->flags & CFG_PRINTER_NOZONES) != 0 &&
+			    (strcasecmp(clause->name, "zone") == 0 ||
+			     strcasecmp(clause->name, "view") == 0))
+				continue;
 			result = isc_symtab_lookup(obj->value.map.symtab,
 						   clause->name, 0, &symval);
 			if (result == ISC_R_SUCCESS) {